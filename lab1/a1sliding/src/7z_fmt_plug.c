@@ -17,6 +17,7 @@ john_register_one(&fmt_sevenzip);
 
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #include <openssl/aes.h>
 #ifdef _OPENMP
 #include <omp.h>
@@ -32,13 +33,20 @@ john_register_one(&fmt_sevenzip);
 #include "sha2.h"
 #include "crc32.h"
 #include "unicode.h"
+#include "threadpool.h"
+#include "sse-intrinsics.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL		"7z"
 #define FORMAT_NAME		"7-Zip"
 #define FORMAT_TAG		"$7z$"
 #define TAG_LENGTH		4
-#define ALGORITHM_NAME		"SHA256 AES 32/" ARCH_BITS_STR
+#define ALGORITHM_NAME_SCALAR	"SHA256 AES 32/" ARCH_BITS_STR
+#ifdef MMX_COEF_SHA256
+#define ALGORITHM_NAME		"SHA256 " SHA256_ALGORITHM_NAME " AES"
+#else
+#define ALGORITHM_NAME		ALGORITHM_NAME_SCALAR
+#endif
 #define BENCHMARK_COMMENT	" (512K iterations)"
 #define BENCHMARK_LENGTH	-1
 #define BINARY_SIZE		0
@@ -46,12 +54,31 @@ john_register_one(&fmt_sevenzip);
 #define PLAINTEXT_LENGTH	125
 #define SALT_SIZE		sizeof(struct custom_salt)
 #define SALT_ALIGN		4
+#ifdef MMX_COEF_SHA256
+/* Keys are hashed in groups of equal length, more of them fill more groups */
+#define MIN_KEYS_PER_CRYPT	MMX_COEF_SHA256
+#define MAX_KEYS_PER_CRYPT	(MMX_COEF_SHA256 * 8)
+#else
 #define MIN_KEYS_PER_CRYPT	1
 #define MAX_KEYS_PER_CRYPT	1
+#endif
 #define OMP_SCALE               1 // tuned on core i7
 
 #define BIG_ENOUGH 		(8192 * 32)
 
+/*
+ * The KDF hashes 2^NumCyclesPower times the UTF-16 password followed by
+ * an 8-byte little-endian round counter.  With L bytes of password, that
+ * stream repeats (but for the counters) every lcm(L + 8, 64) bytes, which
+ * is at most this many SHA-256 blocks.
+ */
+#define PERIOD_BLOCKS		((PLAINTEXT_LENGTH * 2 + 8) / 2)
+
+#ifdef MMX_COEF_SHA256
+/* Byte i of the message of lane index, as SSEi_MIXED_IN wants it */
+#define GETPOS(i, index)	( (index)*4 + ((i)&(0xffffffff-3))*MMX_COEF_SHA256 + (3-((i)&3)) )
+#endif
+
 static struct fmt_tests sevenzip_tests[] = {
 	/* CRC checks passes for these hashes */
 	{"$7z$0$19$0$1122$8$d1f50227759415890000000000000000$1412385885$112$112$5e5b8b734adf52a64c541a5a5369023d7cccb78bd910c0092535dfb013a5df84ac692c5311d2e7bbdc580f5b867f7b5dd43830f7b4f37e41c7277e228fb92a6dd854a31646ad117654182253706dae0c069d3f4ce46121d52b6f20741a0bb39fc61113ce14d22f9184adafd6b5333fb1", "password"},
@@ -64,7 +91,18 @@ static struct fmt_tests sevenzip_tests[] = {
 };
 
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
+static UTF16 (*saved_utf16)[PLAINTEXT_LENGTH + 1];
+static int *saved_len; /* of saved_utf16, in bytes */
 static int *cracked;
+#ifdef MMX_COEF_SHA256
+static int *mix_order;
+static ARCH_WORD_32 *period_buf; /* per thread */
+static int period_threads;
+/* Whether kdf_select() picked the SIMD KDF */
+static int kdf_simd_on;
+
+static void kdf_select(struct fmt_main *self);
+#endif
 
 static struct custom_salt {
 	int NumCyclesPower;
@@ -92,8 +130,23 @@ static void init(struct fmt_main *self)
 #endif
 	saved_key = mem_calloc_tiny(sizeof(*saved_key) *
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	saved_utf16 = mem_calloc_tiny(sizeof(*saved_utf16) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	saved_len = mem_calloc_tiny(sizeof(*saved_len) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	cracked = mem_calloc_tiny(sizeof(*cracked) *
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+#ifdef MMX_COEF_SHA256
+	/* Each length's last group may be padded with up to COEF - 1 keys */
+	mix_order = mem_calloc_tiny(sizeof(*mix_order) *
+			(self->params.max_keys_per_crypt +
+			 (PLAINTEXT_LENGTH + 1) * MMX_COEF_SHA256), MEM_ALIGN_WORD);
+	/* For kdf_select(); crypt_all() sizes it for the final pool */
+	period_threads = 1;
+	period_buf = mem_calloc_tiny(PERIOD_BLOCKS * 64 * MMX_COEF_SHA256,
+			MEM_ALIGN_SIMD);
+	kdf_select(self);
+#endif
 	CRC32_Init(&crc);
 }
 
@@ -271,12 +324,32 @@ static int sevenzip_decrypt(unsigned char *derived_key, unsigned char *data)
 	if(AES_set_decrypt_key(derived_key, 256, &akey) < 0) {
 		fprintf(stderr, "AES_set_decrypt_key failed in crypt!\n");
 	}
+	margin = nbytes = cur_salt->length - cur_salt->unpacksize;
+
+	/*
+	 * Early reject: nearly all wrong keys fail the padding check already
+	 * in the last block, so decrypt just that one before the whole data.
+	 */
+	if (margin > 0 && cur_salt->length >= 16 && !(cur_salt->length & 15)) {
+		unsigned char *last = cur_salt->data + cur_salt->length - 16;
+		unsigned char *prev = cur_salt->length > 16 ? last - 16 : iv;
+		unsigned char block[16];
+
+		AES_decrypt(last, block, &akey);
+		for (i = margin < 16 ? 16 - margin : 0; i < 16; i++)
+			if (block[i] != prev[i]) {
+#ifdef _MSC_VER
+				free(out);
+#endif
+				return -1;
+			}
+	}
+
 	AES_cbc_encrypt(cur_salt->data, out, cur_salt->length, &akey, iv, AES_DECRYPT);
 
 	/* various verifications tests */
 
 	// test 0, padding check, bad hack :-(
-	margin = nbytes = cur_salt->length - cur_salt->unpacksize;
 	i = cur_salt->length - 1;
 	while (nbytes > 0) {
 		if (out[i] != 0) {
@@ -329,55 +402,59 @@ static int sevenzip_decrypt(unsigned char *derived_key, unsigned char *data)
 
 
 
-void sevenzip_kdf(UTF8 *password, unsigned char *master)
+/* gcd(len + 8, 64), len + 8 bytes being one round of the KDF stream */
+static MAYBE_INLINE unsigned int period_gcd(unsigned int len)
 {
-	int len;
-	long long rounds = (long long) 1 << cur_salt->NumCyclesPower;
-	long long round;
-	UTF16 buffer[PLAINTEXT_LENGTH + 1];
-#if !ARCH_LITTLE_ENDIAN
-	int i;
-	unsigned char temp[8] = { 0,0,0,0,0,0,0,0 };
-#endif
+	unsigned int low = (len + 8) & ~(len + 7);
+
+	return low < 64 ? low : 64;
+}
+
+/*
+ * Hashes whole periods of the stream (of up to PERIOD_BLOCKS blocks) at a
+ * time, rather than the password and the counter of each round apart.
+ */
+static void sevenzip_kdf(int index, ARCH_WORD_32 rounds, unsigned char *master)
+{
+	unsigned char buf[PERIOD_BLOCKS * 64];
+	ARCH_WORD_32 round;
+	unsigned int len = saved_len[index];
+	unsigned int per = 64 / period_gcd(len);
+	unsigned int i, n;
 	SHA256_CTX sha;
 
-	/* Convert password to utf-16-le format (--encoding aware) */
-	len = enc_to_utf16(buffer, PLAINTEXT_LENGTH, password, strlen((char*)password));
-	if (len <= 0) {
-		password[-len] = 0; // match truncation
-		len = strlen16(buffer);
+	for (i = 0; i < per; i++) {
+		memcpy(&buf[i * (len + 8)], saved_utf16[index], len);
+		memset(&buf[i * (len + 8) + len], 0, 8);
 	}
-	len *= 2;
-
-	/* kdf */
-        SHA256_Init(&sha);
-	for (round = 0; round < rounds; round++) {
-		//SHA256_Update(&sha, "", cur_salt->SaltSize);
-		SHA256_Update(&sha, (char*)buffer, len);
-#if ARCH_LITTLE_ENDIAN
-		SHA256_Update(&sha, (char*)&round, 8);
-#else
-		SHA256_Update(&sha, temp, 8);
-		for (i = 0; i < 8; i++)
-			if (++(temp[i]) != 0)
-				break;
-#endif
+
+	SHA256_Init(&sha);
+	for (round = 0; round < rounds; round += n) {
+		n = rounds - round < per ? rounds - round : per;
+		/* Counters stay below 2^24, their upper bytes are left zero */
+		for (i = 0; i < n; i++) {
+			unsigned char *p = &buf[i * (len + 8) + len];
+			ARCH_WORD_32 c = round + i;
+
+			p[0] = c;
+			p[1] = c >> 8;
+			p[2] = c >> 16;
+			p[3] = c >> 24;
+		}
+		SHA256_Update(&sha, buf, n * (len + 8));
 	}
 	SHA256_Final(master, &sha);
 }
 
-static int crypt_all(int *pcount, struct db_salt *salt)
+static void crypt_range(int start, int end, int thread, void *arg)
 {
-	int count = *pcount;
-	int index = 0;
-#ifdef _OPENMP
-#pragma omp parallel for
-	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
-#endif
-	{
+	int index;
+
+	for (index = start; index < end; index++) {
 		/* derive key */
 		unsigned char master[32];
-		sevenzip_kdf((unsigned char*)saved_key[index], master);
+		sevenzip_kdf(index, (ARCH_WORD_32)1 << cur_salt->NumCyclesPower,
+		             master);
 
 		/* do decryption and checks */
 		if(sevenzip_decrypt(master, cur_salt->data) == 0)
@@ -385,9 +462,223 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		else
 			cracked[index] = 0;
 	}
+}
+
+#ifdef MMX_COEF_SHA256
+/*
+ * Sets the counter of round in all lanes of a block, at byte offset at
+ * (which is even, and negative for a counter started in the block before).
+ * Counters stay below 2^24, so only their first 4 bytes are ever set: the
+ * upper ones stay zero.
+ */
+static MAYBE_INLINE void put_counter(ARCH_WORD_32 *block, int at,
+	ARCH_WORD_32 round)
+{
+	ARCH_WORD_32 c = JOHNSWAP(round), *w;
+	int k;
+
+	if (!(at & 3)) {
+		w = &block[at / 4 * MMX_COEF_SHA256];
+		for (k = 0; k < MMX_COEF_SHA256; k++)
+			w[k] = c;
+		return;
+	}
+	if (at >= 2) {
+		w = &block[(at - 2) / 4 * MMX_COEF_SHA256];
+		for (k = 0; k < MMX_COEF_SHA256; k++)
+			w[k] = (w[k] & 0xffff0000) | (c >> 16);
+	}
+	if (at < 62) {
+		w = &block[(at + 2) / 4 * MMX_COEF_SHA256];
+		for (k = 0; k < MMX_COEF_SHA256; k++)
+			w[k] = c << 16;
+	}
+}
+
+/*
+ * Derives the keys of MMX_COEF_SHA256 passwords of equal length at once.
+ * The period buffer holds one period of the stream of each of them (with
+ * the counters zeroed), from which whole blocks are hashed in place after
+ * only the counters in them are set.
+ */
+static void sevenzip_kdf_simd(int *index, ARCH_WORD_32 rounds,
+	ARCH_WORD_32 *buf, ARCH_WORD_32 (*master)[8])
+{
+	JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_32 tail[SHA256_BUF_SIZ * MMX_COEF_SHA256];
+	JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_32 state[8 * MMX_COEF_SHA256];
+	unsigned char *bytes = (unsigned char*)buf;
+	ARCH_WORD_32 round, next;
+	unsigned int len = saved_len[index[0]];
+	unsigned int blocks = (len + 8) / period_gcd(len);
+	ARCH_WORD_64 total = (ARCH_WORD_64)rounds * (len + 8), blk;
+	ARCH_WORD_64 start, pos, p;
+	unsigned int b, i, k, rem = total & 63;
+	unsigned int flags = SSEi_MIXED_IN;
+	ARCH_WORD_32 *block;
+
+	memset(buf, 0, blocks * 64 * MMX_COEF_SHA256);
+	for (k = 0; k < MMX_COEF_SHA256; k++) {
+		unsigned char *pw = (unsigned char*)saved_utf16[index[k]];
+
+		for (i = 0; i < blocks * 64; i++)
+			if (i % (len + 8) < len)
+				bytes[GETPOS(i, k)] = pw[i % (len + 8)];
+	}
+
+	/*
+	 * round is the first counter not yet set in full, and pos is where
+	 * it starts in the stream.
+	 */
+	round = 0;
+	pos = len;
+	for (blk = 0, b = 0, start = 0; ; blk++, start += 64) {
+		block = &buf[b * SHA256_BUF_SIZ * MMX_COEF_SHA256];
+		for (p = pos, next = round; p < start + 64 && next < rounds;
+		     p += len + 8, next++)
+			put_counter(block, (int)(p - start), next);
+		if (blk == total / 64)
+			break;
+		while (pos + 4 <= start + 64) {
+			pos += len + 8;
+			round++;
+		}
+
+		SSESHA256body((__m128i*)block, state, state, flags);
+		flags = SSEi_MIXED_IN | SSEi_RELOAD;
+		if (++b == blocks)
+			b = 0;
+	}
+
+	/* Final block(s): the rest of the stream, if any, and the padding */
+	memcpy(tail, block, sizeof(tail));
+	for (i = rem; i < 64; i++)
+		for (k = 0; k < MMX_COEF_SHA256; k++)
+			((unsigned char*)tail)[GETPOS(i, k)] = i == rem ? 0x80 : 0;
+	if (rem >= 56) {
+		SSESHA256body((__m128i*)tail, state, state, flags);
+		flags = SSEi_MIXED_IN | SSEi_RELOAD;
+		memset(tail, 0, sizeof(tail));
+	}
+	for (k = 0; k < MMX_COEF_SHA256; k++) {
+		tail[14 * MMX_COEF_SHA256 + k] = (ARCH_WORD_32)(total >> 29);
+		tail[15 * MMX_COEF_SHA256 + k] = (ARCH_WORD_32)(total << 3);
+	}
+	SSESHA256body((__m128i*)tail, state, state, flags);
+
+	for (k = 0; k < MMX_COEF_SHA256; k++)
+		for (i = 0; i < 8; i++)
+			master[k][i] = JOHNSWAP(state[i * MMX_COEF_SHA256 + k]);
+}
+
+static void crypt_range_simd(int start, int end, int thread, void *arg)
+{
+	ARCH_WORD_32 *buf = &period_buf[thread * PERIOD_BLOCKS *
+	                                SHA256_BUF_SIZ * MMX_COEF_SHA256];
+	int group;
+
+	for (group = start; group < end; group++) {
+		int *index = &mix_order[group * MMX_COEF_SHA256];
+		ARCH_WORD_32 master[MMX_COEF_SHA256][8];
+		int k;
+
+		sevenzip_kdf_simd(index, (ARCH_WORD_32)1 << cur_salt->NumCyclesPower,
+		                  buf, master);
+
+		/* do decryption and checks, once per key */
+		for (k = 0; k < MMX_COEF_SHA256; k++)
+			if (!k || index[k] != index[k - 1])
+				cracked[index[k]] =
+					sevenzip_decrypt((unsigned char*)master[k],
+					                 cur_salt->data) == 0;
+	}
+}
+
+/*
+ * Times the SIMD KDF against the scalar one (which may well be faster,
+ * with SHA extensions or with few lanes) and leaves the choice to
+ * fmt_engine_pick(), unless the user forced one.  Both run on the same keys,
+ * the best of three runs each, so that neither pays for warming up.
+ */
+static void kdf_select(struct fmt_main *self)
+{
+	ARCH_WORD_32 scalar_out[MMX_COEF_SHA256][8], simd_out[MMX_COEF_SHA256][8];
+	int index[MMX_COEF_SHA256];
+	clock_t start, scalar = 0, simd = 0;
+	int i, k, pass;
+
+	if ((kdf_simd_on = fmt_engine_forced(-1)) >= 0)
+		goto out;
+
+	for (k = 0; k < MMX_COEF_SHA256; k++) {
+		index[k] = k;
+		for (i = 0; i < 8; i++)
+			saved_utf16[k][i] = 'A' + k + i;
+		saved_len[k] = 16;
+	}
+
+	for (pass = 0; pass < 3; pass++) {
+		start = clock();
+		for (k = 0; k < MMX_COEF_SHA256; k++)
+			sevenzip_kdf(k, 1 << 14, (unsigned char*)scalar_out[k]);
+		start = clock() - start;
+		if (!pass || start < scalar)
+			scalar = start;
+
+		start = clock();
+		sevenzip_kdf_simd(index, 1 << 14, period_buf, simd_out);
+		start = clock() - start;
+		if (!pass || start < simd)
+			simd = start;
+	}
+
+	kdf_simd_on = fmt_engine_pick(simd, scalar) &&
+	    !memcmp(scalar_out, simd_out, sizeof(scalar_out));
+
+out:
+	if (!kdf_simd_on)
+		self->params.algorithm_name = ALGORITHM_NAME_SCALAR;
+}
+#endif
+
+static int crypt_all(int *pcount, struct db_salt *salt)
+{
+	int count = *pcount;
+#ifdef MMX_COEF_SHA256
+	int index, len, groups = 0;
+
+	if (kdf_simd_on) {
+		if (period_threads < tpool_threads()) {
+			period_threads = tpool_threads();
+			period_buf = mem_calloc_tiny(PERIOD_BLOCKS * 64 *
+				MMX_COEF_SHA256 * period_threads, MEM_ALIGN_SIMD);
+		}
+
+		/* Group the keys by length, padding the last group of each */
+		for (len = 0; len <= PLAINTEXT_LENGTH * 2; len += 2) {
+			int first = groups;
+
+			for (index = 0; index < count; index++)
+				if (saved_len[index] == len)
+					mix_order[groups++] = index;
+			while (groups > first && (groups & (MMX_COEF_SHA256 - 1))) {
+				mix_order[groups] = mix_order[groups - 1];
+				groups++;
+			}
+		}
+
+		/* One group per chunk, as below for keys */
+		tpool_for(groups / MMX_COEF_SHA256, 1, crypt_range_simd, NULL);
+		return count;
+	}
+#endif
+
+	/* One key per chunk: the KDF dominates, so stealing keeps all threads busy */
+	tpool_for(count, 1, crypt_range, NULL);
+
 	return count;
 }
 
+
 static int cmp_all(void *binary, int count)
 {
 	int index;
@@ -410,11 +701,21 @@ static int cmp_exact(char *source, int index)
 static void sevenzip_set_key(char *key, int index)
 {
 	int saved_key_length = strlen(key);
+	int len;
 
 	if (saved_key_length > PLAINTEXT_LENGTH)
 		saved_key_length = PLAINTEXT_LENGTH;
 	memcpy(saved_key[index], key, saved_key_length);
 	saved_key[index][saved_key_length] = 0;
+
+	/* Convert password to utf-16-le format (--encoding aware) */
+	len = enc_to_utf16(saved_utf16[index], PLAINTEXT_LENGTH,
+	                   (UTF8*)saved_key[index], saved_key_length);
+	if (len <= 0) {
+		saved_key[index][-len] = 0; // match truncation
+		len = strlen16(saved_utf16[index]);
+	}
+	saved_len[index] = len * 2;
 }
 
 static char *get_key(int index)
@@ -446,7 +747,7 @@ struct fmt_main fmt_sevenzip = {
 		SALT_ALIGN,
 		MIN_KEYS_PER_CRYPT,
 		MAX_KEYS_PER_CRYPT,
-		FMT_CASE | FMT_8_BIT | FMT_OMP | FMT_NOT_EXACT | FMT_UNICODE | FMT_UTF8,
+		FMT_CASE | FMT_8_BIT | FMT_OMP | FMT_NOT_EXACT | FMT_UNICODE | FMT_UTF8 | FMT_INIT_PARAMS,
 #if FMT_MAIN_VERSION > 11
 		{
 			"iteration count",
@@ -93,16 +93,28 @@ static char keys_mode;
 static int sign_extension_bug;
 static BF_salt saved_salt;
 
-#ifdef _OPENMP
+#if BF_mt > 1
 struct fmt_main fmt_BF;
 #endif
 
 static void init(struct fmt_main *self)
 {
+#if BF_mt > 1
+	int n = BF_Nmin, max;
+#if BF_SIMD
+/*
+ * The SIMD code hasn't beaten the scalar one on any CPU it was timed on, so
+ * it's only timed or used if SIMDEngine asks for that.
+ */
+	n = BF_std_select(fmt_engine_forced(0));
+	if (n == BF_SIMD)
+		fmt_BF.params.algorithm_name = BF_ALGORITHM_NAME_SIMD;
+#endif
 #ifdef _OPENMP
-	int n = BF_Nmin * omp_get_max_threads(), max;
+	n *= omp_get_max_threads();
 	if (n < BF_Nmin)
 		n = BF_Nmin;
+#endif
 	if (n > BF_N)
 		n = BF_N;
 	fmt_BF.params.min_keys_per_crypt = n;
@@ -263,10 +275,10 @@ struct fmt_main fmt_BF = {
 		SALT_ALIGN,
 		MIN_KEYS_PER_CRYPT,
 		MAX_KEYS_PER_CRYPT,
-#if BF_mt > 1
+#if BF_mt > 1 && defined(_OPENMP)
 		FMT_OMP |
 #endif
-		FMT_CASE | FMT_8_BIT,
+		FMT_CASE | FMT_8_BIT | FMT_INIT_PARAMS,
 #if FMT_MAIN_VERSION > 11
 		{
 			"iteration count",
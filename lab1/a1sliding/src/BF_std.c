@@ -33,6 +33,17 @@
 #include "arch.h"
 #include "common.h"
 #include "BF_std.h"
+#if BF_SIMD
+#include <time.h>
+#include <immintrin.h>
+#include "formats.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef JOHN_FAT
+#include "sse-dispatch.h"
+#endif
+#endif
 #include "memdbg.h"
 
 BF_binary BF_out[BF_N];
@@ -685,6 +696,192 @@ extern void (*BF_body)(void);
 
 #endif
 
+#if BF_SIMD
+/*
+ * BF_SIMD instances side by side, one per 32-bit lane.  Each P and S-box
+ * entry holds that entry for all of the instances, so the key setup
+ * stores are plain vector stores and the S-box lookups are gathers from
+ * entry * BF_SIMD + lane.
+ */
+typedef __m256i BF_vword;
+
+struct BF_simd_ctx {
+	BF_vword S[4][0x100];
+	BF_vword P[BF_ROUNDS + 2];
+};
+
+/* Whether BF_std_select() picked the SIMD code */
+static int BF_simd_on;
+
+/*
+ * Same as BF_ROUND with BF_SCALE set to 0: the shifts and the mask leave
+ * each byte of L multiplied by BF_SIMD, ready for adding the lane number.
+ */
+#define BF_V_ROUND(ctx, L, R, N) \
+	u1 = _mm256_and_si256(_mm256_slli_epi32(L, 3), mask); \
+	u2 = _mm256_and_si256(_mm256_srli_epi32(L, 5), mask); \
+	u3 = _mm256_and_si256(_mm256_srli_epi32(L, 13), mask); \
+	u4 = _mm256_and_si256(_mm256_srli_epi32(L, 21), mask); \
+	u1 = _mm256_i32gather_epi32((int *)ctx.S[3], \
+	    _mm256_or_si256(u1, lane), 4); \
+	u2 = _mm256_i32gather_epi32((int *)ctx.S[2], \
+	    _mm256_or_si256(u2, lane), 4); \
+	u3 = _mm256_i32gather_epi32((int *)ctx.S[1], \
+	    _mm256_or_si256(u3, lane), 4); \
+	u4 = _mm256_i32gather_epi32((int *)ctx.S[0], \
+	    _mm256_or_si256(u4, lane), 4); \
+	u3 = _mm256_add_epi32(u3, u4); \
+	u3 = _mm256_xor_si256(u3, u2); \
+	R = _mm256_xor_si256(R, ctx.P[N + 1]); \
+	u3 = _mm256_add_epi32(u3, u1); \
+	R = _mm256_xor_si256(R, u3);
+
+#define BF_V_ENCRYPT(ctx, L, R) \
+	L = _mm256_xor_si256(L, ctx.P[0]); \
+	BF_V_ROUND(ctx, L, R, 0); \
+	BF_V_ROUND(ctx, R, L, 1); \
+	BF_V_ROUND(ctx, L, R, 2); \
+	BF_V_ROUND(ctx, R, L, 3); \
+	BF_V_ROUND(ctx, L, R, 4); \
+	BF_V_ROUND(ctx, R, L, 5); \
+	BF_V_ROUND(ctx, L, R, 6); \
+	BF_V_ROUND(ctx, R, L, 7); \
+	BF_V_ROUND(ctx, L, R, 8); \
+	BF_V_ROUND(ctx, R, L, 9); \
+	BF_V_ROUND(ctx, L, R, 10); \
+	BF_V_ROUND(ctx, R, L, 11); \
+	BF_V_ROUND(ctx, L, R, 12); \
+	BF_V_ROUND(ctx, R, L, 13); \
+	BF_V_ROUND(ctx, L, R, 14); \
+	BF_V_ROUND(ctx, R, L, 15); \
+	u4 = R; \
+	R = L; \
+	L = _mm256_xor_si256(u4, ctx.P[BF_ROUNDS + 1]);
+
+#define BF_V_body() \
+	L = R = _mm256_setzero_si256(); \
+	ptr = ctx.P; \
+	do { \
+		BF_V_ENCRYPT(ctx, L, R); \
+		*ptr = L; \
+		*(ptr + 1) = R; \
+		ptr += 2; \
+	} while (ptr < &ctx.P[BF_ROUNDS + 2]); \
+\
+	ptr = ctx.S[0]; \
+	do { \
+		ptr += 2; \
+		BF_V_ENCRYPT(ctx, L, R); \
+		*(ptr - 2) = L; \
+		*(ptr - 1) = R; \
+	} while (ptr < &ctx.S[3][0xFF]);
+
+/*
+ * Fat builds are compiled for the SSE2 base level, so only this function is
+ * compiled for AVX2, and it's only used on CPUs that have that.
+ */
+#ifdef JOHN_FAT
+#define BF_SIMD_TARGET			__attribute__((target("avx2")))
+#else
+#define BF_SIMD_TARGET
+#endif
+
+/*
+ * Computes all words of BF_out for the keys at index ... index + BF_SIMD - 1.
+ */
+static BF_SIMD_TARGET void BF_simd_crypt(BF_salt *salt, int index)
+{
+	struct BF_simd_ctx ctx;
+	BF_vword exp_key[BF_ROUNDS + 2], salt_w[4];
+	BF_vword L, R, u1, u2, u3, u4;
+	BF_vword mask, lane, key_lane;
+	BF_vword *ptr;
+	BF_word *sptr;
+	BF_word out[6][BF_SIMD];
+	BF_word count;
+	int i, j;
+
+	mask = _mm256_set1_epi32(0xFF * BF_SIMD);
+	lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	key_lane = _mm256_mullo_epi32(lane, _mm256_set1_epi32(BF_ROUNDS + 2));
+
+	for (i = 0; i < BF_ROUNDS + 2; i++) {
+		exp_key[i] = _mm256_i32gather_epi32((int *)&BF_exp_key[index][i],
+		    key_lane, 4);
+		ctx.P[i] = _mm256_i32gather_epi32((int *)&BF_init_key[index][i],
+		    key_lane, 4);
+	}
+
+	ptr = ctx.S[0];
+	sptr = BF_init_state.S[0];
+	do {
+		*ptr++ = _mm256_set1_epi32(*sptr++);
+	} while (ptr <= &ctx.S[3][0xFF]);
+
+	for (i = 0; i < 4; i++)
+		salt_w[i] = _mm256_set1_epi32(salt->salt[i]);
+
+	L = R = _mm256_setzero_si256();
+	for (i = 0; i < BF_ROUNDS + 2; i += 2) {
+		L = _mm256_xor_si256(L, salt_w[i & 2]);
+		R = _mm256_xor_si256(R, salt_w[(i & 2) + 1]);
+		BF_V_ENCRYPT(ctx, L, R);
+		ctx.P[i] = L;
+		ctx.P[i + 1] = R;
+	}
+
+	ptr = ctx.S[0];
+	do {
+		ptr += 4;
+		L = _mm256_xor_si256(L, salt_w[(BF_ROUNDS + 2) & 3]);
+		R = _mm256_xor_si256(R, salt_w[(BF_ROUNDS + 3) & 3]);
+		BF_V_ENCRYPT(ctx, L, R);
+		*(ptr - 4) = L;
+		*(ptr - 3) = R;
+
+		L = _mm256_xor_si256(L, salt_w[(BF_ROUNDS + 4) & 3]);
+		R = _mm256_xor_si256(R, salt_w[(BF_ROUNDS + 5) & 3]);
+		BF_V_ENCRYPT(ctx, L, R);
+		*(ptr - 2) = L;
+		*(ptr - 1) = R;
+	} while (ptr < &ctx.S[3][0xFF]);
+
+	count = 1 << salt->rounds;
+	do {
+		for (i = 0; i < BF_ROUNDS + 2; i++)
+			ctx.P[i] = _mm256_xor_si256(ctx.P[i], exp_key[i]);
+
+		BF_V_body();
+
+		for (i = 0; i < BF_ROUNDS + 2; i++)
+			ctx.P[i] = _mm256_xor_si256(ctx.P[i], salt_w[i & 3]);
+
+		BF_V_body();
+	} while (--count);
+
+	for (i = 0; i < 6; i += 2) {
+		L = _mm256_set1_epi32(BF_magic_w[i]);
+		R = _mm256_set1_epi32(BF_magic_w[i + 1]);
+
+		count = 64;
+		do {
+			BF_V_ENCRYPT(ctx, L, R);
+		} while (--count);
+
+		_mm256_storeu_si256((BF_vword *)out[i], L);
+		_mm256_storeu_si256((BF_vword *)out[i + 1], R);
+	}
+
+	for (j = 0; j < BF_SIMD; j++) {
+		for (i = 0; i < 6; i++)
+			BF_out[index + j][i] = out[i][j];
+
+/* This has to be bug-compatible with the original implementation :-) */
+		BF_out[index + j][5] &= ~(BF_word)0xFF;
+	}
+}
+#endif
+
 void BF_std_set_key(char *key, int index, int sign_extension_bug)
 {
 	char *ptr = key;
@@ -714,6 +911,17 @@ void BF_std_crypt(BF_salt *salt, int n)
 	int t;
 #endif
 
+#if BF_SIMD
+	if (BF_simd_on) {
+#ifdef _OPENMP
+#pragma omp parallel for default(none) private(t) shared(n, salt)
+#endif
+		for (t = 0; t < n; t += BF_SIMD)
+			BF_simd_crypt(salt, t);
+		return;
+	}
+#endif
+
 #if BF_mt > 1 && defined(_OPENMP)
 #pragma omp parallel for default(none) private(t) shared(n, BF_init_state, BF_init_key, BF_exp_key, salt, BF_magic_w, BF_out)
 #endif
@@ -874,6 +1082,77 @@ void BF_std_crypt(BF_salt *salt, int n)
 	}
 }
 
+#if BF_SIMD
+int BF_std_select(int simd)
+{
+	static int done;
+	static BF_binary scalar_out[BF_Nmin * BF_SIMD];
+	BF_salt salt;
+	char key[] = "select?";
+	clock_t start, scalar_time = 0, simd_time = 0;
+	int i, pass, n = BF_Nmin * BF_SIMD;
+#ifdef _OPENMP
+	int threads = omp_get_max_threads();
+#endif
+
+	if (done)
+		return BF_simd_on ? BF_SIMD : BF_Nmin;
+	done = 1;
+
+#ifdef JOHN_FAT
+	if (SSE_level_runtime < SSE_LEVEL_AVX2)
+		return BF_Nmin;
+#endif
+
+	if (simd >= 0) {
+		BF_simd_on = simd;
+		return BF_simd_on ? BF_SIMD : BF_Nmin;
+	}
+
+/*
+ * Time both with a single thread, on the same amount of whole work for
+ * either: with more threads the scalar code would get more of them.
+ * The best of three runs each, so that neither pays for warming up.
+ */
+#ifdef _OPENMP
+	omp_set_num_threads(1);
+#endif
+
+	memset(&salt, 0x5A, sizeof(salt));
+	salt.rounds = 5;
+	for (i = 0; i < n; i++) {
+		key[6] = 'A' + i;
+		BF_std_set_key(key, i, 0);
+	}
+
+	for (pass = 0; pass < 3; pass++) {
+		BF_simd_on = 0;
+		start = clock();
+		BF_std_crypt(&salt, n);
+		start = clock() - start;
+		if (!pass || start < scalar_time)
+			scalar_time = start;
+		memcpy(scalar_out, BF_out, sizeof(scalar_out));
+
+		BF_simd_on = 1;
+		start = clock();
+		BF_std_crypt(&salt, n);
+		start = clock() - start;
+		if (!pass || start < simd_time)
+			simd_time = start;
+	}
+
+	BF_simd_on = fmt_engine_pick(simd_time, scalar_time) &&
+	    !memcmp(scalar_out, BF_out, sizeof(scalar_out));
+
+#ifdef _OPENMP
+	omp_set_num_threads(threads);
+#endif
+
+	return BF_simd_on ? BF_SIMD : BF_Nmin;
+}
+#endif
+
 #if BF_mt == 1
 void BF_std_crypt_exact(int index)
 {
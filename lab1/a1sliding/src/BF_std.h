@@ -43,9 +43,21 @@ typedef BF_word BF_binary[6];
 #define BF_Nmin				1
 #endif
 
-#if defined(_OPENMP) && !BF_ASM
+#ifndef BF_SIMD
+#define BF_SIMD				0
+#endif
+
+/*
+ * The SIMD code needs a multiple of BF_SIMD keys, so it uses the
+ * multi-key layout even without OpenMP.
+ */
+#if (defined(_OPENMP) || BF_SIMD) && !BF_ASM
 #define BF_cpt				3
+#ifdef _OPENMP
 #define BF_mt				256
+#else
+#define BF_mt				BF_SIMD
+#endif
 #define BF_N				(BF_Nmin * BF_mt)
 #else
 #define BF_mt				1
@@ -69,6 +81,7 @@ extern unsigned char BF_atoi64[0x80];
 #else
 #define BF_ALGORITHM_NAME		"Blowfish 32/" ARCH_BITS_STR
 #endif
+#define BF_ALGORITHM_NAME_SIMD		"Blowfish 256/256 AVX2 8x"
 
 /*
  * Sets a key for BF_std_crypt().
@@ -77,10 +90,20 @@ extern void BF_std_set_key(char *key, int index, int sign_extension_bug);
 
 /*
  * Main hashing routine, sets first two words of BF_out
- * (or all words in an OpenMP-enabled build).
+ * (or all words in an OpenMP-enabled or SIMD build).
  */
 extern void BF_std_crypt(BF_salt *salt, int n);
 
+#if BF_SIMD
+/*
+ * Uses the SIMD code from then on if "simd" is 1, or the scalar code if 0.
+ * If -1, times both and leaves the choice to fmt_engine_pick().  Returns the
+ * number of keys BF_std_crypt() should be given at a time per thread:
+ * BF_SIMD or BF_Nmin.
+ */
+extern int BF_std_select(int simd);
+#endif
+
 #if BF_mt == 1
 /*
  * Calculates the rest of BF_out, for exact comparison.
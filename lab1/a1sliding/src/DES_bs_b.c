@@ -11,6 +11,43 @@
 #include "common.h"
 #include "DES_bs.h"
 
+#ifdef DES_BS_VARIANT
+/*
+ * The AVX build of this file in fat builds, see sse-dispatch.h.  It has the
+ * same DES_bs_all layout as the base one, and names ending with
+ * DES_BS_VARIANT.
+ */
+#define DES_BS_VARIANT_NAME2(name, variant)	name ## variant
+#define DES_BS_VARIANT_NAME(name, variant) \
+	DES_BS_VARIANT_NAME2(name, variant)
+#define DES_bs_set_salt_for_thread \
+	DES_BS_VARIANT_NAME(DES_bs_set_salt_for_thread, DES_BS_VARIANT)
+#define DES_bs_set_salt \
+	DES_BS_VARIANT_NAME(DES_bs_set_salt, DES_BS_VARIANT)
+#define DES_bs_crypt_25 \
+	DES_BS_VARIANT_NAME(DES_bs_crypt_25, DES_BS_VARIANT)
+#define DES_bs_crypt \
+	DES_BS_VARIANT_NAME(DES_bs_crypt, DES_BS_VARIANT)
+#define DES_bs_crypt_LM \
+	DES_BS_VARIANT_NAME(DES_bs_crypt_LM, DES_BS_VARIANT)
+#define DES_bs_crypt_plain \
+	DES_BS_VARIANT_NAME(DES_bs_crypt_plain, DES_BS_VARIANT)
+#define DES_bs_generate_plaintext \
+	DES_BS_VARIANT_NAME(DES_bs_generate_plaintext, DES_BS_VARIANT)
+#elif defined(JOHN_FAT)
+#if DES_BS_ASM || DES_BS_DEPTH != 128
+#error Fat builds need the 128-bit C bitslice DES code
+#endif
+#include "sse-dispatch.h"
+
+#define DES_BS_DISPATCH
+
+extern void DES_bs_crypt_25_avx(int keys_count);
+extern void DES_bs_crypt_avx(int count, int keys_count);
+extern int DES_bs_crypt_LM_avx(int *keys_count, struct db_salt *salt);
+extern void DES_bs_crypt_plain_avx(int keys_count);
+#endif
+
 #if DES_BS_ASM && defined(_OPENMP) && defined(__GNUC__)
 #warning Assembly code and OpenMP are both requested - will provide the former, but not the latter (for DES-based hashes).  This may likely be corrected by enabling SIMD intrinsics with the C compiler (try adding -msse2 to OMPFLAGS).
 #endif
@@ -1359,6 +1396,13 @@ void DES_bs_crypt_25(int keys_count)
 	int t, n = (keys_count + (DES_BS_DEPTH - 1)) / DES_BS_DEPTH;
 #endif
 
+#ifdef DES_BS_DISPATCH
+	if (SSE_level_runtime >= SSE_LEVEL_AVX) {
+		DES_bs_crypt_25_avx(keys_count);
+		return;
+	}
+#endif
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) private(t) shared(n, DES_bs_all_p, keys_count)
 #endif
@@ -1491,6 +1535,13 @@ void DES_bs_crypt(int count, int keys_count)
 	int t, n = (keys_count + (DES_BS_DEPTH - 1)) / DES_BS_DEPTH;
 #endif
 
+#ifdef DES_BS_DISPATCH
+	if (SSE_level_runtime >= SSE_LEVEL_AVX) {
+		DES_bs_crypt_avx(count, keys_count);
+		return;
+	}
+#endif
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) private(t) shared(n, DES_bs_all_p, count, keys_count)
 #endif
@@ -1658,6 +1709,11 @@ int DES_bs_crypt_LM(int *pcount, struct db_salt *salt)
 	int t, n = (keys_count + (DES_BS_DEPTH - 1)) / DES_BS_DEPTH;
 #endif
 
+#ifdef DES_BS_DISPATCH
+	if (SSE_level_runtime >= SSE_LEVEL_AVX)
+		return DES_bs_crypt_LM_avx(pcount, salt);
+#endif
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) private(t) shared(n, DES_bs_all_p, keys_count)
 #endif
@@ -1820,6 +1876,13 @@ void DES_bs_crypt_plain(int keys_count)
 	int t, n = (keys_count + (DES_BS_DEPTH - 1)) / DES_BS_DEPTH;
 #endif
 
+#ifdef DES_BS_DISPATCH
+	if (SSE_level_runtime >= SSE_LEVEL_AVX) {
+		DES_bs_crypt_plain_avx(keys_count);
+		return;
+	}
+#endif
+
 
 #ifdef _OPENMP
 #pragma omp parallel for default(none) private(t) shared(n, DES_bs_all_p, keys_count, DES_bs_P)
@@ -15,11 +15,14 @@ john_register_one(&fmt_XSHA512);
 #include "params.h"
 #include "common.h"
 #include "formats.h"
+#include "sha512_sse.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL			"xsha512"
 #define FORMAT_NAME			"Mac OS X 10.7"
-#if ARCH_BITS >= 64
+#ifdef MMX_COEF_SHA512
+#define ALGORITHM_NAME			"SHA512 " SHA512_ALGORITHM_NAME
+#elif ARCH_BITS >= 64
 #define ALGORITHM_NAME			"SHA512 64/" ARCH_BITS_STR " " SHA2_LIB
 #else
 #define ALGORITHM_NAME			"SHA512 32/" ARCH_BITS_STR " " SHA2_LIB
@@ -43,7 +46,10 @@ john_register_one(&fmt_XSHA512);
 #define MAX_KEYS_PER_CRYPT		0x100
 #endif
 
-#if ARCH_BITS >= 64 || defined(__SSE2__)
+#ifdef MMX_COEF_SHA512
+/* The SIMD code puts the salt in front of each key itself */
+#undef PRECOMPUTE_CTX_FOR_SALT
+#elif ARCH_BITS >= 64 || defined(__SSE2__)
 /* 64-bitness happens to correlate with faster memcpy() */
 #define PRECOMPUTE_CTX_FOR_SALT
 #else
@@ -59,7 +65,13 @@ static struct fmt_tests tests[] = {
 
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static int (*saved_key_length);
+#ifdef MMX_COEF_SHA512
+static ARCH_WORD_64 (*crypt_out)[8*MMX_COEF_SHA512];
+#define HASH_WORD(index, i)	((ARCH_WORD_64 *)crypt_out)[SHA512_SSE_OUT(index, i)]
+#else
 static ARCH_WORD_32 (*crypt_out)[16];
+#define HASH_WORD(index, i)	crypt_out[index][i]
+#endif
 
 #ifdef PRECOMPUTE_CTX_FOR_SALT
 static SHA512_CTX ctx_salt;
@@ -71,7 +83,11 @@ static void init(struct fmt_main *self)
 {
 	saved_key = mem_calloc_tiny(sizeof(*saved_key) * MAX_KEYS_PER_CRYPT, MEM_ALIGN_WORD);
 	saved_key_length = mem_calloc_tiny(sizeof(*saved_key_length) * MAX_KEYS_PER_CRYPT, MEM_ALIGN_WORD);
+#ifdef MMX_COEF_SHA512
+	crypt_out = mem_calloc_tiny(sizeof(*crypt_out) * MAX_KEYS_PER_CRYPT / MMX_COEF_SHA512, MEM_ALIGN_SIMD);
+#else
 	crypt_out = mem_calloc_tiny(sizeof(*crypt_out) * MAX_KEYS_PER_CRYPT, MEM_ALIGN_WORD);
+#endif
 }
 
 static int valid(char *ciphertext, struct fmt_main *self)
@@ -129,6 +145,9 @@ static void *get_binary(char *ciphertext)
 		    atoi16[ARCH_INDEX(p[1])];
 		p += 2;
 	}
+#ifdef MMX_COEF_SHA512
+	alter_endianity_to_BE64(out, BINARY_SIZE / 8);
+#endif
 
 	return out;
 }
@@ -157,37 +176,37 @@ static void *salt(char *ciphertext)
 
 static int get_hash_0(int index)
 {
-	return crypt_out[index][0] & 0xF;
+	return HASH_WORD(index, 0) & 0xF;
 }
 
 static int get_hash_1(int index)
 {
-	return crypt_out[index][0] & 0xFF;
+	return HASH_WORD(index, 0) & 0xFF;
 }
 
 static int get_hash_2(int index)
 {
-	return crypt_out[index][0] & 0xFFF;
+	return HASH_WORD(index, 0) & 0xFFF;
 }
 
 static int get_hash_3(int index)
 {
-	return crypt_out[index][0] & 0xFFFF;
+	return HASH_WORD(index, 0) & 0xFFFF;
 }
 
 static int get_hash_4(int index)
 {
-	return crypt_out[index][0] & 0xFFFFF;
+	return HASH_WORD(index, 0) & 0xFFFFF;
 }
 
 static int get_hash_5(int index)
 {
-	return crypt_out[index][0] & 0xFFFFFF;
+	return HASH_WORD(index, 0) & 0xFFFFFF;
 }
 
 static int get_hash_6(int index)
 {
-	return crypt_out[index][0] & 0x7FFFFFF;
+	return HASH_WORD(index, 0) & 0x7FFFFFF;
 }
 
 static int salt_hash(void *salt)
@@ -224,7 +243,26 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
 	int i;
+#ifdef MMX_COEF_SHA512
+	int loops = (count + MMX_COEF_SHA512 - 1) / MMX_COEF_SHA512;
 
+#ifdef _OPENMP
+#pragma omp parallel for default(none) private(i) shared(saved_salt, loops, saved_key, saved_key_length, crypt_out)
+#endif
+	for (i = 0; i < loops; i++) {
+		JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_64 buf[SHA512_BUF_SIZ*MMX_COEF_SHA512];
+		int j;
+
+		for (j = 0; j < MMX_COEF_SHA512; j++) {
+			int k = i * MMX_COEF_SHA512 + j;
+
+			sha512_sse_load(buf, j, &saved_salt, SALT_SIZE,
+			                saved_key[k], saved_key_length[k]);
+		}
+		SSESHA512body((__m128i *)buf, crypt_out[i], NULL,
+		              SSEi_MIXED_IN);
+	}
+#else
 #ifdef _OPENMP
 #ifdef PRECOMPUTE_CTX_FOR_SALT
 #pragma omp parallel for default(none) private(i) shared(ctx_salt, count, saved_key, saved_key_length, crypt_out)
@@ -245,11 +283,21 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		SHA512_Update(&ctx, saved_key[i], saved_key_length[i]);
 		SHA512_Final((unsigned char *)(crypt_out[i]), &ctx);
 	}
+#endif
 	return count;
 }
 
 static int cmp_all(void *binary, int count)
 {
+#ifdef MMX_COEF_SHA512
+	ARCH_WORD_64 b0 = *(ARCH_WORD_64 *)binary;
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (b0 == HASH_WORD(i, 0))
+			return 1;
+	return 0;
+#else
 	ARCH_WORD_32 b0 = *(ARCH_WORD_32 *)binary;
 	int i;
 
@@ -260,11 +308,21 @@ static int cmp_all(void *binary, int count)
 			return 1;
 	}
 	return 0;
+#endif
 }
 
 static int cmp_one(void *binary, int index)
 {
+#ifdef MMX_COEF_SHA512
+	int i;
+
+	for (i = 0; i < BINARY_SIZE / 8; i++)
+		if (((ARCH_WORD_64 *)binary)[i] != HASH_WORD(index, i))
+			return 0;
+	return 1;
+#else
 	return !memcmp(binary, crypt_out[index], BINARY_SIZE);
+#endif
 }
 
 static int cmp_exact(char *source, int index)
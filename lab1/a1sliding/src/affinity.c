@@ -0,0 +1,288 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * CPU affinity and NUMA placement, see affinity.h.
+ *
+ * There's no libnuma dependency: the topology is read from sysfs and memory
+ * placement relies on the kernel allocating pages on the node of the CPU
+ * that first touches them, which is the default policy.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE 1 /* for sched_setaffinity(2) and CPU_SET(3) */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "arch.h"
+#include "params.h"
+#include "misc.h"
+#include "memory.h"
+#include "affinity.h"
+#include "memdbg.h"
+
+int affinity_parse(char *mode)
+{
+	if (!strcasecmp(mode, "none"))
+		return AFFINITY_NONE;
+	if (!strcasecmp(mode, "core"))
+		return AFFINITY_CORE;
+	if (!strcasecmp(mode, "node") || !strcasecmp(mode, "socket"))
+		return AFFINITY_NODE;
+
+	return -1;
+}
+
+#if defined(__linux__) && defined(CPU_SETSIZE)
+
+#define SYSFS_NODE			"/sys/devices/system/node/"
+#define SYSFS_CPU			"/sys/devices/system/cpu/"
+
+/* Enough for any box we'd run on; more nodes than this are treated as one */
+#define AFFINITY_MAX_NODES		64
+
+static int active, per_thread, nthreads;
+static int *thread_cpu;
+static cpu_set_t proc_set;
+
+/*
+ * Reads a sysfs list such as "0-7,16-23" into "set".  Returns the number of
+ * members, or 0 if the file can't be read.
+ */
+static int read_list(char *path, cpu_set_t *set)
+{
+	FILE *file;
+	char line[LINE_BUFFER_SIZE], *p;
+
+	CPU_ZERO(set);
+	if (!(file = fopen(path, "r")))
+		return 0;
+	if (!fgets(line, sizeof(line), file))
+		*line = 0;
+	fclose(file);
+
+	p = line;
+	while (*p >= '0' && *p <= '9') {
+		int first, last;
+
+		first = last = (int)strtol(p, &p, 10);
+		if (*p == '-')
+			last = (int)strtol(p + 1, &p, 10);
+		while (first <= last && first < CPU_SETSIZE)
+			CPU_SET(first++, set);
+		if (*p == ',')
+			p++;
+	}
+
+	return CPU_COUNT(set);
+}
+
+/*
+ * Returns non-zero if "cpu" is the first hardware thread of its core (or if
+ * we can't tell).
+ */
+static int first_sibling(int cpu)
+{
+	char path[PATH_BUFFER_SIZE];
+	cpu_set_t siblings;
+	int i;
+
+	snprintf(path, sizeof(path),
+	    SYSFS_CPU "cpu%d/topology/thread_siblings_list", cpu);
+	if (!read_list(path, &siblings))
+		return 1;
+
+	for (i = 0; i < cpu; i++)
+		if (CPU_ISSET(i, &siblings))
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Formats "set" as a list of ranges, the way sysfs does.
+ */
+static char *list_str(cpu_set_t *set)
+{
+	static char out[256];
+	char *p = out;
+	int cpu = 0;
+
+	*p = 0;
+	while (cpu < CPU_SETSIZE && p < out + sizeof(out) - 24) {
+		int last;
+
+		if (!CPU_ISSET(cpu, set)) {
+			cpu++;
+			continue;
+		}
+		last = cpu;
+		while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set))
+			last++;
+		p += sprintf(p, "%s%d", p == out ? "" : ",", cpu);
+		if (last > cpu)
+			p += sprintf(p, "-%d", last);
+		cpu = last + 1;
+	}
+
+	return out;
+}
+
+char *affinity_init(int mode, int index, int count, int threads,
+	char **error)
+{
+	static char desc[512];
+	cpu_set_t allowed, online, used_nodes;
+	cpu_set_t *nodes;
+	int *node_id, *order;
+	int nnodes = 0, node, cpu, n, t;
+
+	*error = NULL;
+	if (mode == AFFINITY_NONE)
+		return NULL;
+
+	if (count < 1)
+		count = 1;
+	if (threads < 1)
+		threads = 1;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+		*error = strerror(errno);
+		return NULL;
+	}
+
+	nodes = mem_alloc(AFFINITY_MAX_NODES * sizeof(*nodes));
+	node_id = mem_alloc(AFFINITY_MAX_NODES * sizeof(*node_id));
+
+	if (read_list(SYSFS_NODE "online", &online))
+	for (node = 0; node < CPU_SETSIZE && nnodes < AFFINITY_MAX_NODES;
+	    node++) {
+		char path[PATH_BUFFER_SIZE];
+
+		if (!CPU_ISSET(node, &online))
+			continue;
+		snprintf(path, sizeof(path), SYSFS_NODE "node%d/cpulist", node);
+		if (!read_list(path, &nodes[nnodes]))
+			continue;
+		CPU_AND(&nodes[nnodes], &nodes[nnodes], &allowed);
+		if (CPU_COUNT(&nodes[nnodes]))
+			node_id[nnodes++] = node;
+	}
+
+	if (!nnodes) {
+		nodes[0] = allowed;
+		node_id[0] = 0;
+		nnodes = 1;
+	}
+
+	CPU_ZERO(&used_nodes);
+	if (mode == AFFINITY_NODE) {
+		node = (count >= nnodes) ?
+			index * nnodes / count : index % nnodes;
+		proc_set = nodes[node];
+		CPU_SET(node_id[node], &used_nodes);
+		per_thread = 0;
+	} else {
+/*
+ * Order the usable CPUs node by node, and within a node the first hardware
+ * thread of each core before its siblings.  Consecutive processes then take
+ * consecutive slices, so a process's threads stay on one node unless it has
+ * more threads than the node has CPUs.
+ */
+		order = mem_alloc(CPU_SETSIZE * sizeof(*order));
+		n = 0;
+		for (node = 0; node < nnodes; node++) {
+			int pass;
+
+			for (pass = 0; pass < 2; pass++)
+			for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &nodes[node]) &&
+			    first_sibling(cpu) == !pass)
+				order[n++] = cpu;
+		}
+
+		MEM_FREE(thread_cpu);
+		thread_cpu = mem_alloc(threads * sizeof(*thread_cpu));
+		CPU_ZERO(&proc_set);
+		for (t = 0; t < threads; t++) {
+			thread_cpu[t] = order[(index * threads + t) % n];
+			CPU_SET(thread_cpu[t], &proc_set);
+			for (node = 0; node < nnodes; node++)
+			if (CPU_ISSET(thread_cpu[t], &nodes[node]))
+				CPU_SET(node_id[node], &used_nodes);
+		}
+		MEM_FREE(order);
+		per_thread = 1;
+	}
+
+	nthreads = threads;
+	active = 1;
+
+	n = snprintf(desc, sizeof(desc), "%s, process %d of %d, ",
+	    mode == AFFINITY_NODE ? "node" : "core", index + 1, count);
+	n += snprintf(desc + n, sizeof(desc) - n, "%d thread%s on CPU%s %s",
+	    threads, threads > 1 ? "s" : "",
+	    CPU_COUNT(&proc_set) > 1 ? "s" : "", list_str(&proc_set));
+	snprintf(desc + n, sizeof(desc) - n, ", NUMA node%s %s",
+	    CPU_COUNT(&used_nodes) > 1 ? "s" : "", list_str(&used_nodes));
+
+	MEM_FREE(node_id);
+	MEM_FREE(nodes);
+
+	affinity_bind_thread(0);
+#ifdef _OPENMP
+#pragma omp parallel
+	affinity_bind_thread(omp_get_thread_num());
+#endif
+
+	return desc;
+}
+
+void affinity_bind_thread(int thread)
+{
+	cpu_set_t set;
+
+	if (!active)
+		return;
+
+	if (per_thread) {
+		CPU_ZERO(&set);
+		CPU_SET(thread_cpu[thread % nthreads], &set);
+	} else
+		set = proc_set;
+
+	sched_setaffinity(0, sizeof(set), &set);
+}
+
+#else
+
+char *affinity_init(int mode, int index, int count, int threads,
+	char **error)
+{
+	*error = (mode == AFFINITY_NONE) ?
+		NULL : "not supported on this system";
+	return NULL;
+}
+
+void affinity_bind_thread(int thread)
+{
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * CPU affinity and NUMA placement for --fork/MPI processes and their threads.
+ */
+
+#ifndef _JOHN_AFFINITY_H
+#define _JOHN_AFFINITY_H
+
+/*
+ * Placement modes.  "core" pins each thread to a CPU of its own, filling up
+ * one NUMA node before moving on to the next and using the first hardware
+ * thread of every core before its SMT siblings.  "node" only confines each
+ * process (and its threads) to the CPUs of one NUMA node, spreading the
+ * processes evenly over the nodes.
+ */
+#define AFFINITY_NONE			0
+#define AFFINITY_CORE			1
+#define AFFINITY_NODE			2
+
+/*
+ * Parses a mode name ("none", "core" or "node", with "socket" being an alias
+ * for the latter).  Returns -1 for anything else.
+ */
+extern int affinity_parse(char *mode);
+
+/*
+ * Binds the calling process, being number "index" of "count" processes on
+ * this host, and "threads" threads per process.  Any OpenMP threads are bound
+ * right away.  Memory first touched after this call is allocated on the
+ * local NUMA node by the kernel's default policy.
+ *
+ * Returns a description of the placement for the log, or NULL if nothing
+ * was done.  In the latter case, "error" is set to the reason if there was
+ * one.
+ */
+extern char *affinity_init(int mode, int index, int count, int threads,
+	char **error);
+
+/*
+ * Binds the calling thread as thread number "thread" of this process.  This
+ * is a no-op unless affinity_init() has set up a placement.
+ */
+extern void affinity_bind_thread(int thread);
+
+#endif
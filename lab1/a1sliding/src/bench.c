@@ -146,6 +146,8 @@ static void bench_set_keys(struct fmt_main *format,
 		} while (1);
 		fmt_set_key(plaintext, index);
 	}
+
+	format->methods.precompute(format->params.max_keys_per_crypt);
 }
 
 char *benchmark_format(struct fmt_main *format, int salts,
@@ -393,6 +395,7 @@ int benchmark_all(void)
 	const char *s_gpu = "";
 #endif
 	unsigned int total, failed;
+	int many_salts = BENCHMARK_MANY;
 	MEMDBG_HANDLE memHand;
 
 #ifdef _OPENMP
@@ -413,6 +416,10 @@ int benchmark_all(void)
 #endif
 
 #ifndef BENCH_BUILD
+	if ((many_salts = cfg_get_int(SECTION_OPTIONS, NULL,
+	    "BenchmarkManySalts")) < 2)
+		many_salts = BENCHMARK_MANY;
+
 AGAIN:
 #endif
 	total = failed = 0;
@@ -458,11 +465,10 @@ AGAIN:
 #endif
 
 		/* FIXME: Kludge for thin dynamics, and OpenCL formats */
-		/* c3_fmt also added, since it is a somewhat dynamic   */
-		/* format and needs init called to change the name     */
-		if ((format->params.flags & FMT_DYNAMIC) ||
-		    strstr(format->params.label, "-opencl") ||
-			strcmp(format->params.label, "crypt")==0 )
+		/* Formats with FMT_INIT_PARAMS (such as c3_fmt) need */
+		/* init called to change the name                      */
+		if ((format->params.flags & (FMT_DYNAMIC | FMT_INIT_PARAMS)) ||
+		    strstr(format->params.label, "-opencl"))
 			fmt_init(format);
 
 #ifdef _OPENMP
@@ -542,7 +548,7 @@ AGAIN:
 		total++;
 
 		if ((result = benchmark_format(format,
-		    format->params.salt_size ? BENCHMARK_MANY : 1,
+		    format->params.salt_size ? many_salts : 1,
 		    &results_m))) {
 			puts(result);
 			failed++;
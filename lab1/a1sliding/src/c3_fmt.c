@@ -717,7 +717,7 @@ struct fmt_main fmt_crypt = {
 		SALT_ALIGN,
 		MIN_KEYS_PER_CRYPT,
 		MAX_KEYS_PER_CRYPT,
-		FMT_CASE | FMT_8_BIT | FMT_OMP,
+		FMT_CASE | FMT_8_BIT | FMT_OMP | FMT_INIT_PARAMS,
 #if FMT_MAIN_VERSION > 11
 		{
 			/*
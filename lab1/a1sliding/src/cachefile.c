@@ -0,0 +1,114 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Cache keys and files, see cachefile.h.
+ */
+
+#if AC_BUILT
+#include "autoconfig.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#if !AC_BUILT || HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "arch.h"
+#include "misc.h"
+#include "params.h"
+#include "john.h"
+#include "cachefile.h"
+#include "memdbg.h"
+
+void cachefile_hash(uint64_t *hash, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+
+	while (size--) {
+		*hash ^= *p++;
+		*hash *= 0x100000001b3ULL;
+	}
+}
+
+void cachefile_hash_str(uint64_t *hash, const char *s)
+{
+	if (s)
+		cachefile_hash(hash, s, strlen(s) + 1);
+	else
+		cachefile_hash(hash, "\377", 1);
+}
+
+void cachefile_hash_int(uint64_t *hash, uint64_t value)
+{
+	cachefile_hash(hash, &value, sizeof(value));
+}
+
+char *cachefile_parse(char *line, uint64_t *key)
+{
+	unsigned int hi, lo;
+
+	if (strlen(line) < 17 || line[16] != ' ' ||
+	    sscanf(line, "%8x%8x ", &hi, &lo) != 2)
+		return NULL;
+
+	*key = ((uint64_t)hi << 32) | lo;
+
+	return &line[17];
+}
+
+/*
+ * Creates the directory a cache file goes in, such as ~/.john, if that's
+ * what's missing.  Returns non-zero if it did.
+ */
+static int cachefile_mkdir(char *name)
+{
+#if !defined(_WIN32) || defined(__CYGWIN__)
+	char dir[PATH_BUFFER_SIZE];
+	char *p;
+
+	strnzcpy(dir, name, sizeof(dir));
+	if (!(p = strrchr(dir, '/')) || p == dir)
+		return 0;
+	*p = 0;
+
+	return !mkdir(dir, S_IRUSR | S_IWUSR | S_IXUSR);
+#else
+	return 0;
+#endif
+}
+
+void cachefile_append(char *name, uint64_t key, char *rest, long max_size)
+{
+	char line[LINE_BUFFER_SIZE];
+	struct stat st;
+	int fd, flags, length;
+
+	length = snprintf(line, sizeof(line), "%08x%08x %s\n",
+	    (unsigned int)(key >> 32), (unsigned int)key, rest);
+	if (length < 0 || length >= sizeof(line))
+		return;
+
+	flags = O_WRONLY | O_CREAT | O_APPEND;
+	if (!stat(name, &st) && st.st_size > max_size)
+		flags |= O_TRUNC;
+
+	if ((fd = open(name, flags, 0600)) < 0 &&
+	    (errno != ENOENT || !cachefile_mkdir(name) ||
+	    (fd = open(name, flags, 0600)) < 0))
+		return;
+	if (write(fd, line, length) != length && john_main_process)
+		fprintf(stderr, "Warning: Can't write %s\n", name);
+	close(fd);
+}
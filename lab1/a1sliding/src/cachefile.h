@@ -0,0 +1,54 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Keys and files for the caches that remember a result under a key made of
+ * everything it depends on (the self-test cache, the rule count cache), and
+ * the hash the pot file index uses.
+ *
+ * Keys are 64-bit FNV-1a hashes.  A cache file is a text file with one line
+ * per result: the key, in hex, a space and the rest of the line.  Each line
+ * is appended with a single write(), so that concurrent john processes at
+ * worst miss each other's latest results, and the file is started over once
+ * it gets larger than the caller's limit.  Caches only save time, so a cache
+ * file that can't be read or written is no error.
+ */
+
+#ifndef _JOHN_CACHEFILE_H
+#define _JOHN_CACHEFILE_H
+
+#include <stddef.h>
+
+#include "jumbo.h"
+
+/* FNV-1a offset basis, the hash of nothing */
+#define CACHEFILE_HASH_INIT		0xcbf29ce484222325ULL
+
+/*
+ * Add bytes, a NUL terminated string (or NULL) and a 64-bit value to a hash.
+ */
+extern void cachefile_hash(uint64_t *hash, const void *data, size_t size);
+extern void cachefile_hash_str(uint64_t *hash, const char *s);
+extern void cachefile_hash_int(uint64_t *hash, uint64_t value);
+
+/*
+ * Returns the rest of a cache file line and sets "key", or returns NULL if
+ * the line isn't one.
+ */
+extern char *cachefile_parse(char *line, uint64_t *key);
+
+/*
+ * Appends a line for "key" to the cache file "name", starting the file over
+ * first if it's larger than "max_size" bytes.  The file's directory is
+ * created if it's missing (but not its parents).
+ */
+extern void cachefile_append(char *name, uint64_t key, char *rest,
+	long max_size);
+
+#endif
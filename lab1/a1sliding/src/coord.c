@@ -0,0 +1,691 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Work unit coordinator, see coord.h.
+ *
+ * The protocol is line based plain text over one TCP connection per worker.
+ * Only the worker speaks first; the coordinator replies to GET only:
+ *
+ *	HELLO <name>			worker identifies itself
+ *	GET				worker wants a unit; the coordinator
+ *					sends "POT <line>" for every crack from
+ *					other workers not yet relayed, followed
+ *					by "UNIT <n> <units>", "WAIT" (all units
+ *					are out, some may be re-queued) or "END"
+ *	PROGRESS <n> <percent> <guesses>	periodic, from the unit's process
+ *	CRACK <pot line>		a hash was cracked
+ *	DONE <n>			the unit has completed
+ *	FAILED <n>			the unit's process failed, re-queue it
+ */
+
+#if AC_BUILT
+#include "autoconfig.h"
+#endif
+
+#define NEED_OS_FORK
+#define NEED_OS_FLOCK
+#include "os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#if OS_FORK && \
+    (!AC_BUILT || (HAVE_SYS_SOCKET_H && HAVE_NETDB_H && HAVE_UNISTD_H))
+#define COORD_SUPPORTED 1
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/file.h>
+#include <netdb.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "arch.h"
+#include "misc.h"
+#include "params.h"
+#include "path.h"
+#include "memory.h"
+#include "signals.h"
+#include "status.h"
+#include "logger.h"
+#include "recovery.h"
+#include "options.h"
+#include "config.h"
+#include "john.h"
+#ifdef HAVE_MPI
+#include "john-mpi.h"
+#endif
+#include "coord.h"
+#include "memdbg.h"
+
+#ifdef COORD_SUPPORTED
+
+/* Seconds an idle worker waits before asking again after a WAIT */
+#define COORD_WAIT			5
+
+#define COORD_BUFFER_SIZE		(LINE_BUFFER_SIZE + 64)
+
+/* Unit states */
+#define UNIT_PENDING			0
+#define UNIT_ASSIGNED			1
+#define UNIT_DONE			2
+
+struct coord_client {
+	int fd, id, unit, relayed;
+	time_t seen;
+	char name[64];
+	int len;
+	char *buf;
+};
+
+struct coord_crack {
+	int origin;
+	char *line;
+};
+
+/* Worker side */
+static int coord_fd = -1;
+static unsigned int coord_unit;
+
+/* Coordinator side */
+static unsigned char *state;
+static int units, done_count;
+static struct coord_crack *cracks;
+static int crack_count, crack_size;
+static char *units_name;
+
+static void coord_send(int fd, char *format, ...)
+{
+	char line[COORD_BUFFER_SIZE];
+	va_list args;
+	int count;
+
+	va_start(args, format);
+	count = vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+
+	if (count > 0 && count < sizeof(line))
+		write_loop(fd, line, count);
+}
+
+/*
+ * Splits "spec" into its host, port and unit count parts.  The host part is
+ * optional, and the port is whatever follows the last colon.
+ */
+static void coord_parse(char *spec, char **host, char **port, int *count)
+{
+	char *copy = str_alloc_copy(spec), *p;
+
+	*host = NULL;
+	if (count && (p = strchr(copy, '/'))) {
+		*p++ = 0;
+		*count = atoi(p);
+		if (*count < 1) {
+			fprintf(stderr, "Invalid number of work units: %s\n",
+			        p);
+			error();
+		}
+	}
+
+	if ((p = strrchr(copy, ':'))) {
+		*p++ = 0;
+		*host = copy;
+		*port = p;
+	} else
+		*port = copy;
+
+	if (!**port) {
+		fprintf(stderr, "Invalid coordinator address: %s\n", spec);
+		error();
+	}
+}
+
+static int coord_socket(char *host, char *port, int server)
+{
+	struct addrinfo hints, *res, *ai;
+	int fd = -1, ret, one = 1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (server)
+		hints.ai_flags = AI_PASSIVE;
+
+	if ((ret = getaddrinfo(host, port, &hints, &res))) {
+		fprintf(stderr, "%s:%s: %s\n", host ? host : "*", port,
+		        gai_strerror(ret));
+		error();
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		if ((fd = socket(ai->ai_family, ai->ai_socktype,
+		    ai->ai_protocol)) < 0)
+			continue;
+		if (server) {
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR,
+			           &one, sizeof(one));
+			if (!bind(fd, ai->ai_addr, ai->ai_addrlen) &&
+			    !listen(fd, 16))
+				break;
+		} else
+		if (!connect(fd, ai->ai_addr, ai->ai_addrlen))
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+
+	if (fd < 0)
+		pexit("%s %s:%s", server ? "listen" : "connect",
+		      host ? host : "*", port);
+
+	return fd;
+}
+
+/*
+ * Appends one line to the pot file, locked the same way logger.c does it.
+ */
+static void coord_pot_append(char *line)
+{
+	int fd, len = strlen(line);
+
+	if ((fd = open(path_expand(pers_opts.activepot),
+	    O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR)) < 0)
+		pexit("open: %s", path_expand(pers_opts.activepot));
+#if OS_FLOCK
+	while (flock(fd, LOCK_EX)) {
+		if (errno != EINTR)
+			pexit("flock(LOCK_EX)");
+	}
+#endif
+	if (write_loop(fd, line, len) < 0 || write_loop(fd, "\n", 1) < 0)
+		pexit("write");
+#if OS_FLOCK
+	if (flock(fd, LOCK_UN))
+		pexit("flock(LOCK_UN)");
+#endif
+	close(fd);
+}
+
+/*
+ * Reads units completed by an earlier run of the coordinator, if any.
+ */
+static void coord_load_units(void)
+{
+	FILE *file;
+	int unit, count;
+
+	if (!(file = fopen(path_expand(units_name), "r")))
+		return;
+
+	if (fscanf(file, "units %d\n", &count) != 1 || count != units) {
+		fprintf(stderr, "%s was created for a different number of "
+		        "work units\n", path_expand(units_name));
+		error();
+	}
+
+	while (fscanf(file, "%d\n", &unit) == 1)
+	if (unit >= 1 && unit <= units && state[unit] != UNIT_DONE) {
+		state[unit] = UNIT_DONE;
+		done_count++;
+	}
+
+	fclose(file);
+}
+
+static void coord_save_unit(int unit)
+{
+	FILE *file;
+	int new = !done_count;
+
+	if (!(file = fopen(path_expand(units_name), "a")))
+		pexit("fopen: %s", path_expand(units_name));
+	if (new && !ftell(file))
+		fprintf(file, "units %d\n", units);
+	fprintf(file, "%d\n", unit);
+	if (fclose(file))
+		pexit("fclose");
+}
+
+static void coord_requeue(struct coord_client *c, char *why)
+{
+	if (c->unit > 0 && state[c->unit] == UNIT_ASSIGNED) {
+		state[c->unit] = UNIT_PENDING;
+		log_event("- Unit %d re-queued (%s %s)", c->unit, c->name, why);
+		if (options.verbosity > 1)
+			fprintf(stderr, "Unit %d re-queued (%s %s)\n",
+			        c->unit, c->name, why);
+	}
+	c->unit = 0;
+}
+
+static void coord_assign(struct coord_client *c)
+{
+	int unit, busy = 0;
+
+	for (; c->relayed < crack_count; c->relayed++)
+	if (cracks[c->relayed].origin != c->id)
+		coord_send(c->fd, "POT %s\n", cracks[c->relayed].line);
+
+	for (unit = 1; unit <= units; unit++) {
+		if (state[unit] == UNIT_PENDING)
+			break;
+		if (state[unit] == UNIT_ASSIGNED)
+			busy = 1;
+	}
+
+	if (unit <= units) {
+		state[unit] = UNIT_ASSIGNED;
+		c->unit = unit;
+		coord_send(c->fd, "UNIT %d %d\n", unit, units);
+		log_event("- Unit %d given to %s", unit, c->name);
+	} else
+		coord_send(c->fd, busy ? "WAIT\n" : "END\n");
+}
+
+static void coord_server_line(struct coord_client *c, char *line)
+{
+	int unit;
+
+	if (!strncmp(line, "HELLO ", 6))
+		strnzcpy(c->name, line + 6, sizeof(c->name));
+	else
+	if (!strcmp(line, "GET"))
+		coord_assign(c);
+	else
+	if (!strncmp(line, "CRACK ", 6)) {
+		line += 6;
+		coord_pot_append(line);
+		if (crack_count == crack_size) {
+			crack_size = crack_size ? crack_size * 2 : 1024;
+			cracks = realloc(cracks, crack_size * sizeof(*cracks));
+			if (!cracks)
+				pexit("realloc");
+		}
+		cracks[crack_count].origin = c->id;
+		cracks[crack_count].line = mem_alloc(strlen(line) + 1);
+		strcpy(cracks[crack_count++].line, line);
+		log_event("+ Cracked by %s (unit %d)", c->name, c->unit);
+	} else
+	if (sscanf(line, "DONE %d", &unit) == 1) {
+		if (unit >= 1 && unit <= units && state[unit] != UNIT_DONE) {
+			coord_save_unit(unit);
+			state[unit] = UNIT_DONE;
+			done_count++;
+			log_event("- Unit %d done by %s, %d of %d done",
+			          unit, c->name, done_count, units);
+			if (options.verbosity > 2)
+				fprintf(stderr, "Unit %d done by %s, "
+				        "%d of %d done, %d cracked\n",
+				        unit, c->name, done_count, units,
+				        crack_count);
+		}
+		if (c->unit == unit)
+			c->unit = 0;
+	} else
+	if (sscanf(line, "FAILED %d", &unit) == 1) {
+		if (c->unit == unit)
+			coord_requeue(c, "failed");
+	} else
+	if (!strncmp(line, "PROGRESS ", 9)) {
+		if (options.verbosity > 3)
+			log_event("- %s: %s", c->name, line + 9);
+	}
+}
+
+/*
+ * Reads what's available from a worker and processes complete lines.
+ * Returns 0 if the connection is gone.
+ */
+static int coord_server_read(struct coord_client *c)
+{
+	char *line, *end;
+	int count;
+
+	count = read(c->fd, c->buf + c->len, COORD_BUFFER_SIZE - 1 - c->len);
+	if (count <= 0)
+		return count < 0 && errno == EINTR;
+
+	c->seen = time(NULL);
+	c->len += count;
+	c->buf[c->len] = 0;
+
+	line = c->buf;
+	while ((end = strchr(line, '\n'))) {
+		*end = 0;
+		coord_server_line(c, line);
+		line = end + 1;
+	}
+
+	c->len -= line - c->buf;
+	memmove(c->buf, line, c->len);
+
+	/* A line longer than our buffer is dropped */
+	if (c->len == COORD_BUFFER_SIZE - 1)
+		c->len = 0;
+
+	return 1;
+}
+
+void coord_server(char *spec)
+{
+	struct coord_client *clients = NULL;
+	char *host, *port;
+	int listen_fd, nclients = 0, next_id = 1, timeout, i;
+
+	units = COORD_UNITS_DEFAULT;
+	coord_parse(spec, &host, &port, &units);
+
+	if ((timeout = cfg_get_int(SECTION_OPTIONS, NULL,
+	    "CoordinatorTimeout")) <= 0)
+		timeout = COORD_TIMEOUT_DEFAULT;
+
+	log_init(LOG_NAME, NULL, options.session);
+	status_init(NULL, 1);
+	signal(SIGPIPE, SIG_IGN);
+
+	state = mem_calloc(units + 1);
+	units_name = path_session(rec_name, COORD_UNITS_SUFFIX);
+	coord_load_units();
+
+	listen_fd = coord_socket(host, port, 1);
+
+	log_event("Coordinator listening on %s:%s, %d work units (%d done)",
+	          host ? host : "*", port, units, done_count);
+	fprintf(stderr, "Coordinator listening on %s:%s, %d work units "
+	        "(%d done)\n", host ? host : "*", port, units, done_count);
+
+	while (done_count < units && !event_abort) {
+		struct timeval tv;
+		fd_set fds;
+		time_t now;
+		int max = listen_fd;
+
+		FD_ZERO(&fds);
+		FD_SET(listen_fd, &fds);
+		for (i = 0; i < nclients; i++) {
+			FD_SET(clients[i].fd, &fds);
+			if (clients[i].fd > max)
+				max = clients[i].fd;
+		}
+
+		tv.tv_sec = 1;
+		tv.tv_usec = 0;
+		if (select(max + 1, &fds, NULL, NULL, &tv) < 0) {
+			if (errno == EINTR)
+				continue;
+			pexit("select");
+		}
+
+		if (FD_ISSET(listen_fd, &fds)) {
+			int fd = accept(listen_fd, NULL, NULL);
+
+			if (fd >= 0 && fd < FD_SETSIZE) {
+				struct coord_client *c;
+
+				clients = realloc(clients,
+				    (nclients + 1) * sizeof(*clients));
+				if (!clients)
+					pexit("realloc");
+				c = &clients[nclients++];
+				memset(c, 0, sizeof(*c));
+				c->fd = fd;
+				c->id = next_id++;
+				c->seen = time(NULL);
+				c->buf = mem_alloc(COORD_BUFFER_SIZE);
+				sprintf(c->name, "worker %d", c->id);
+			} else
+			if (fd >= 0)
+				close(fd);
+		}
+
+		now = time(NULL);
+		for (i = 0; i < nclients; i++) {
+			struct coord_client *c = &clients[i];
+			char *why = NULL;
+
+			if (FD_ISSET(c->fd, &fds) && !coord_server_read(c))
+				why = "disconnected";
+			else
+			if (c->unit && now - c->seen > timeout)
+				why = "timed out";
+			if (!why)
+				continue;
+
+			coord_requeue(c, why);
+			close(c->fd);
+			MEM_FREE(c->buf);
+			*c = clients[--nclients];
+			i--;
+		}
+	}
+
+/* Workers asking for more will see the connection closed, and stop */
+	for (i = 0; i < nclients; i++) {
+		coord_requeue(&clients[i], "stopped");
+		close(clients[i].fd);
+		MEM_FREE(clients[i].buf);
+	}
+	close(listen_fd);
+	MEM_FREE(clients);
+
+	if (done_count == units) {
+		log_event("All %d work units done, %d cracked", units,
+		          crack_count);
+		fprintf(stderr, "All %d work units done, %d cracked\n", units,
+		        crack_count);
+	} else
+		log_event("Coordinator stopped, %d of %d work units done",
+		          done_count, units);
+
+	for (i = 0; i < crack_count; i++)
+		MEM_FREE(cracks[i].line);
+	MEM_FREE(cracks);
+	MEM_FREE(state);
+}
+
+/*
+ * Returns the next line from the coordinator, or NULL if it has gone away.
+ */
+static char *coord_worker_read(void)
+{
+	static char *buf;
+	static int len, pos;
+	char *line, *end;
+
+	if (!buf)
+		buf = mem_alloc_tiny(COORD_BUFFER_SIZE, MEM_ALIGN_NONE);
+
+	while (1) {
+		if (pos < len && (end = memchr(buf + pos, '\n', len - pos))) {
+			*end = 0;
+			line = buf + pos;
+			pos = end + 1 - buf;
+			return line;
+		}
+
+		len -= pos;
+		memmove(buf, buf + pos, len);
+		pos = 0;
+		if (len == COORD_BUFFER_SIZE - 1)
+			len = 0;
+
+		{
+			int count = read(coord_fd, buf + len,
+			                 COORD_BUFFER_SIZE - 1 - len);
+
+			if (count < 0 && errno == EINTR && !event_abort)
+				continue;
+			if (count <= 0)
+				return NULL;
+			len += count;
+		}
+	}
+}
+
+void coord_worker(char *spec)
+{
+	char *host, *port, *line, name[64];
+	int unit, count, units_done = 0;
+
+#ifdef HAVE_MPI
+	if (mpi_p > 1) {
+		if (john_main_process)
+			fprintf(stderr, "Can't use --worker with MPI\n");
+		error();
+	}
+#endif
+
+	coord_parse(spec, &host, &port, NULL);
+	if (!host) {
+		fprintf(stderr, "--worker needs HOST:PORT\n");
+		error();
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	coord_fd = coord_socket(host, port, 0);
+
+	if (gethostname(name, sizeof(name) - 16))
+		strcpy(name, "worker");
+	name[sizeof(name) - 16] = 0;
+	coord_send(coord_fd, "HELLO %s:%d\n", name, (int)getpid());
+
+	while (!event_abort) {
+		pid_t pid;
+		int status;
+
+		coord_send(coord_fd, "GET\n");
+		while ((line = coord_worker_read()) &&
+		    !strncmp(line, "POT ", 4))
+			coord_pot_append(line + 4);
+
+		if (!line || !strcmp(line, "END"))
+			break;
+		if (!strcmp(line, "WAIT")) {
+			int left = COORD_WAIT;
+
+			while (left && !event_abort)
+				left = sleep(left);
+			continue;
+		}
+		if (sscanf(line, "UNIT %d %d", &unit, &count) != 2 ||
+		    unit < 1 || unit > count) {
+			fprintf(stderr, "Unexpected reply from coordinator: "
+			        "%.100s\n", line);
+			error();
+		}
+
+		fprintf(stderr, "Work unit %d of %d\n", unit, count);
+		fflush(stdout);
+		fflush(stderr);
+
+		switch ((pid = fork())) {
+		case -1:
+			pexit("fork");
+
+		case 0:
+			coord_unit = unit;
+			options.node_min = options.node_max = unit;
+			options.node_count = count;
+/* Drop whatever was cracked since we loaded, by us or relayed to us */
+			event_reload = 1;
+			sig_init_child();
+			return;
+		}
+
+		while (waitpid(pid, &status, 0) < 0)
+		if (errno != EINTR)
+			pexit("waitpid");
+
+		if (WIFEXITED(status) && !WEXITSTATUS(status)) {
+			units_done++;
+/* Self tests were run by the first unit's process */
+			options.flags |= FLG_NOTESTS;
+		} else {
+			coord_send(coord_fd, "FAILED %d\n", unit);
+			break;
+		}
+	}
+
+	close(coord_fd);
+	fprintf(stderr, "%d work unit%s done, %s\n", units_done,
+	        units_done == 1 ? "" : "s",
+	        event_abort ? "aborted" : "no more work");
+	exit(event_abort ? 1 : 0);
+}
+
+void coord_cracked(char *pot_line, int length)
+{
+	if (coord_fd < 0)
+		return;
+
+	coord_send(coord_fd, "CRACK %.*s", length, pot_line);
+}
+
+void coord_progress(void)
+{
+	static unsigned int last;
+	unsigned int now;
+
+	if (coord_fd < 0)
+		return;
+
+	now = status_get_time();
+	if (last && now - last < COORD_PROGRESS_INTERVAL)
+		return;
+	last = now;
+
+	coord_send(coord_fd, "PROGRESS %u %.2f %u\n", coord_unit,
+	           status_get_progress ? status_get_progress() : -1.0,
+	           status.guess_count);
+}
+
+void coord_unit_done(void)
+{
+	if (coord_fd < 0 || event_abort)
+		return;
+
+	coord_send(coord_fd, "DONE %u\n", coord_unit);
+}
+
+#else
+
+void coord_server(char *spec)
+{
+	fprintf(stderr, "--coordinator is not supported on this system\n");
+	error();
+}
+
+void coord_worker(char *spec)
+{
+	fprintf(stderr, "--worker is not supported on this system\n");
+	error();
+}
+
+void coord_cracked(char *pot_line, int length)
+{
+}
+
+void coord_progress(void)
+{
+}
+
+void coord_unit_done(void)
+{
+}
+
+#endif
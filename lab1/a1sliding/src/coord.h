@@ -0,0 +1,62 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Work unit coordinator: one john process (--coordinator) hands out work
+ * units to any number of worker john processes (--worker) over TCP.
+ *
+ * A work unit is simply a node number: with UNITS units, unit N is what
+ * "--node=N/UNITS" would do, so every cracking mode that supports --node
+ * (wordlist, mask, incremental, Markov, ...) can be distributed this way and
+ * a unit can always be re-run from scratch.  Units held by workers that die
+ * or go silent are re-queued.  Workers report the hashes they crack, which
+ * the coordinator adds to its own pot file and relays to the other workers.
+ */
+
+#ifndef _JOHN_COORD_H
+#define _JOHN_COORD_H
+
+/*
+ * Default number of work units, and the suffix of the file in which the
+ * coordinator records completed units (so it can be restarted).
+ */
+#define COORD_UNITS_DEFAULT		1000
+#define COORD_UNITS_SUFFIX		".units"
+
+/*
+ * Seconds between progress reports from a worker, and seconds of silence
+ * after which the coordinator gives up on a worker and re-queues its unit.
+ */
+#define COORD_PROGRESS_INTERVAL		10
+#define COORD_TIMEOUT_DEFAULT		120
+
+/*
+ * Runs the coordinator.  "spec" is [ADDRESS:]PORT[/UNITS].  Returns when all
+ * units are done or when aborted.
+ */
+extern void coord_server(char *spec);
+
+/*
+ * Connects to the coordinator at "spec" (HOST:PORT) and keeps requesting
+ * units.  For each unit, a child process is forked which returns from this
+ * function with options.node_* set for that unit, and continues cracking as
+ * usual.  The parent never returns.
+ */
+extern void coord_worker(char *spec);
+
+/*
+ * Called by a worker's child process: reports a cracked hash (as written to
+ * the pot file, with the newline), reports progress (rate-limited, may be
+ * called often), and reports that the unit is done.
+ */
+extern void coord_cracked(char *pot_line, int length);
+extern void coord_progress(void);
+extern void coord_unit_done(void);
+
+#endif
@@ -54,8 +54,11 @@
 #ifdef HAVE_MPI
 #include "john-mpi.h"
 #endif
+#include "coord.h"
+#include "potidx.h"
 #include "path.h"
 #include "jumbo.h"
+#include "threadpool.h"
 #if HAVE_LIBDL && defined(HAVE_CUDA) || defined(HAVE_OPENCL)
 #include "common-gpu.h"
 #endif
@@ -80,6 +83,16 @@ static int64 *crk_timestamps;
 static char crk_stdout_key[PLAINTEXT_BUFFER_SIZE];
 int64_t crk_pot_pos;
 
+/*
+ * With at least this many keys to look up in a salt's bitmap, the lookups
+ * are spread over the thread pool, see crk_lookup().  Below it, waking the
+ * pool up costs about as much as the lookups themselves.
+ */
+#define CRK_LOOKUP_POOL_MIN		0x1000
+
+/* Bitmap hash of each key, or -1 if it's not in the bitmap */
+static int *crk_lookup_hash;
+
 static void crk_dummy_set_salt(void *salt)
 {
 }
@@ -170,6 +183,8 @@ void crk_init(struct db_main *db, void (*fix_state)(void),
 		size = crk_params.max_keys_per_crypt * sizeof(int64);
 		memset(crk_timestamps = mem_alloc_tiny(size, sizeof(int64)),
 		       -1, size);
+		crk_lookup_hash = mem_alloc_tiny(crk_params.max_keys_per_crypt *
+		    sizeof(*crk_lookup_hash), MEM_ALIGN_WORD);
 	} else
 		crk_stdout_key[0] = 0;
 
@@ -350,6 +365,17 @@ static int crk_process_guess(struct db_salt *salt, struct db_password *pw,
 			crk_guesses->ptr += crk_params.plaintext_length;
 			crk_guesses->count++;
 		}
+
+#ifdef HAVE_MPI
+		/* Tell the other nodes, rather than have them re-read the pot */
+		if (mpi_p > 1 && options.reload_at_crack &&
+		    !(crk_params.flags & FMT_NOT_EXACT)) {
+			char *source = crk_methods.source(pw->source,
+			                                  pw->binary);
+
+			mpi_send_all(JOHN_MPI_CRACKED, source, strlen(source));
+		}
+#endif
 	}
 
 	if (!(crk_params.flags & FMT_NOT_EXACT))
@@ -461,6 +487,113 @@ static int crk_remove_pot_entry(char *ciphertext)
 	return 0;
 }
 
+#ifdef HAVE_MPI
+static int crk_mpi_cracked;
+
+/*
+ * Removes the hashes other nodes told us they cracked.  These are sent as the
+ * same canonical ciphertexts that go to the pot file, which unlike binaries
+ * and salts are self-contained and portable between nodes.
+ */
+static int crk_mpi_sync(void)
+{
+	MPI_Status s;
+	int flag, len, total = crk_db->password_count, others;
+
+	crk_mpi_cracked = 0;
+	ldr_in_pot = 1;
+
+	while (1) {
+		char *ciphertext;
+		int done;
+
+		MPI_Iprobe(MPI_ANY_SOURCE, JOHN_MPI_CRACKED, MPI_COMM_WORLD,
+		           &flag, &s);
+		if (!flag)
+			break;
+		MPI_Get_count(&s, MPI_CHAR, &len);
+		ciphertext = mem_alloc(len + 1);
+		MPI_Recv(ciphertext, len, MPI_CHAR, s.MPI_SOURCE,
+		         JOHN_MPI_CRACKED, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		ciphertext[len] = 0;
+		done = crk_remove_pot_entry(ciphertext);
+		MEM_FREE(ciphertext);
+		if (done)
+			break;
+	}
+
+	ldr_in_pot = 0;
+
+	others = total - crk_db->password_count;
+
+	if (others)
+		log_event("+ MPI sync removed %d hashes; %s",
+		          others, crk_loaded_counts());
+
+	if (others && options.verbosity > 3)
+		fprintf(stderr, "%u: %s\n",
+		        options.node_min, crk_loaded_counts());
+
+	return (!crk_db->salts);
+}
+#endif
+
+/*
+ * Pot sync through the pot file index: rather than reading all that other
+ * processes have appended to the pot file, looks up our remaining hashes.
+ */
+static int crk_reload_pot_index(struct potidx *idx)
+{
+	struct db_salt *salt;
+	struct db_password *pw;
+	char **found;
+	int count = 0, total = crk_db->password_count, others, i;
+
+	found = mem_alloc(total * sizeof(*found));
+
+	if ((salt = crk_db->salts))
+	do {
+		for (pw = salt->list; pw && count < total; pw = pw->next) {
+			char *ciphertext;
+
+			ciphertext = crk_methods.source(pw->source, pw->binary);
+			if (!potidx_lookup(idx, ciphertext, crk_pot_pos))
+				continue;
+			found[count] = mem_alloc(strlen(ciphertext) + 1);
+			strcpy(found[count++], ciphertext);
+		}
+	} while ((salt = salt->next));
+
+	crk_pot_pos = potidx_covered(idx);
+	potidx_close(idx);
+
+	ldr_in_pot = 1;
+	for (i = 0; i < count; i++)
+		if (crk_db->salts && crk_remove_pot_entry(found[i]))
+			break;
+	ldr_in_pot = 0;
+
+	for (i = 0; i < count; i++)
+		MEM_FREE(found[i]);
+	MEM_FREE(found);
+
+	others = total - crk_db->password_count;
+
+	if (others)
+		log_event("+ pot sync (index) removed %d hashes; %s",
+		          others, crk_loaded_counts());
+
+	if (others && options.verbosity > 3) {
+		if (options.node_count)
+			fprintf(stderr, "%u: %s\n",
+			        options.node_min, crk_loaded_counts());
+		else
+			fprintf(stderr, "%s\n", crk_loaded_counts());
+	}
+
+	return (!crk_db->salts);
+}
+
 int crk_reload_pot(void)
 {
 	char line[LINE_BUFFER_SIZE], *fields[10];
@@ -478,6 +611,23 @@ int crk_reload_pot(void)
 	if (crk_params.flags & FMT_NOT_EXACT)
 		return 0;
 
+#ifdef HAVE_MPI
+	/* Cracks from other nodes, there's no need to read the pot */
+	if (crk_mpi_cracked)
+		return crk_mpi_sync();
+#endif
+
+	if (potidx_enabled()) {
+		struct stat st;
+		struct potidx *idx;
+
+		if (!stat(path_expand(pers_opts.activepot), &st) &&
+		    (st.st_size - crk_pot_pos) / POTIDX_SYNC_BYTES >
+		    crk_db->password_count &&
+		    (idx = potidx_open(pers_opts.activepot, crk_db->format)))
+			return crk_reload_pot_index(idx);
+	}
+
 	if ((pot_fd =
 	     open(path_expand(pers_opts.activepot), O_RDONLY
 #if ARCH_BITS == 32
@@ -573,7 +723,12 @@ static void crk_mpi_probe(void)
 		event_reload = 1;
 		MPI_Irecv(buf, 1, MPI_CHAR, MPI_ANY_SOURCE,
 		          JOHN_MPI_RELOAD, MPI_COMM_WORLD, &r);
+		return;
 	}
+
+	MPI_Iprobe(MPI_ANY_SOURCE, JOHN_MPI_CRACKED, MPI_COMM_WORLD, &flag, &s);
+	if (flag)
+		crk_mpi_cracked = event_reload = 1;
 }
 #endif
 
@@ -662,15 +817,37 @@ static int crk_process_event(void)
 		gpu_check_temp();
 #endif
 		crk_poll_files();
+		if (options.flags & FLG_WORKER)
+			coord_progress();
 	}
 
 	return event_abort;
 }
 
+/*
+ * Looks the hashes of keys start to end - 1 up in the salt's bitmap.  This
+ * runs on the thread pool, so only get_hash() is called here: cmp_one() and
+ * cmp_exact() may use static buffers, and are left to the cracking thread.
+ */
+static void crk_lookup(int start, int end, int thread, void *arg)
+{
+	struct db_salt *salt = arg;
+	int index;
+
+	for (index = start; index < end; index++) {
+		int hash = salt->index(index);
+		if (salt->bitmap[hash / (sizeof(*salt->bitmap) * 8)] &
+		    (1U << (hash % (sizeof(*salt->bitmap) * 8))))
+			crk_lookup_hash[index] = hash;
+		else
+			crk_lookup_hash[index] = -1;
+	}
+}
+
 static int crk_password_loop(struct db_salt *salt)
 {
 	struct db_password *pw;
-	int count, match, index;
+	int count, match, index, pooled;
 
 #if !OS_TIMER
 	sig_timer_emu_tick();
@@ -710,9 +887,25 @@ static int crk_password_loop(struct db_salt *salt)
 				}
 			}
 		} while ((pw = pw->next));
-	} else
+		return 0;
+	}
+
+	pooled = match >= CRK_LOOKUP_POOL_MIN &&
+	    match <= crk_params.max_keys_per_crypt && tpool_threads() > 1;
+	if (pooled)
+		tpool_for(match, 0, crk_lookup, salt);
+
+/*
+ * The bitmap is tested again for the pooled lookup's hits, as guesses that
+ * were processed since may have reset their bits.
+ */
 	for (index = 0; index < match; index++) {
-		int hash = salt->index(index);
+		int hash;
+		if (pooled) {
+			if ((hash = crk_lookup_hash[index]) < 0)
+				continue;
+		} else
+			hash = salt->index(index);
 		if (salt->bitmap[hash / (sizeof(*salt->bitmap) * 8)] &
 		    (1U << (hash % (sizeof(*salt->bitmap) * 8)))) {
 			pw = salt->hash[hash >> PASSWORD_HASH_SHR];
@@ -737,6 +930,8 @@ static int crk_salt_loop(void)
 	if (event_reload && crk_reload_pot())
 		return 1;
 
+	crk_methods.precompute(crk_key_index);
+
 	salt = crk_db->salts;
 	do {
 		crk_methods.set_salt(salt->salt);
@@ -102,16 +102,6 @@ john_register_one(&fmt_cryptsha256);
 #include "johnswap.h"
 #include "sse-intrinsics.h"
 
-#ifdef MMX_COEF_SHA256
-// there are problems with SSE OMP builds.  Until found, simply do not allow OMP.
-//#undef _OPENMP
-//#undef FMT_OMP
-//#define FMT_OMP 0
-// Well, I tried by turning of OMP, but the run still failed.  So, I will simply
-// leave OMP on, but turn off SSE in an OMP build, until I get this figured out.
-//#undef MMX_COEF_SHA256
-#endif
-
 #ifdef _OPENMP
 #define OMP_SCALE			8
 #include <omp.h>
@@ -138,7 +128,9 @@ john_register_one(&fmt_cryptsha256);
 // then let the threads go on ALL data, without caring about the length, since each thread will only
 // be working on passwords in a single MMX buffer that all match, at any given moment.
 //
-#undef MMX_COEF_SHA256
+// The lengths that share block counts depend on the salt length as well, so the
+// grouping is done per salt, see block_class().
+//
 #ifdef MMX_COEF_SHA256
 #ifdef _OPENMP
 #define MMX_COEF_SCALE      (128/MMX_COEF_SHA256)
@@ -187,6 +179,7 @@ static struct fmt_tests tests[] = {
 //	{"$5$mTfUlwguIR0Gp2ed$nX5lzmEGAZQ.1.CcncGnSq/lxSF7t1P.YkVlljQfOC2", "01234567890123456789012345678901234"},
 	{"$5$9mx1HkCz7G1xho50$O7V7YgleJKLUhcfk9pgzdh3RapEaWqMtEp9UUBAKIPA", "*U*U*U*U"},
 	{"$5$kc7lRD1fpYg0g.IP$d7CMTcEqJyTXyeq8hTdu/jB/I6DGkoo62NXbHIR7S43", ""},
+	{"$5$8charsal$X3mGe4YLV151RCYM4HBpVdkIuNZM3/CHxF/qnFiKnc6", "U*U*U*U*"},
 	// A 36 byte PW fails with newest code.  It would require 3 block SHA buffering.
 	// We only handle 1 and 2, at the current time.
 	//{"$5$aewWTiO8RzEz5FBF$CZ3I.vdWF4omQXMQOv1g3XarjhH0wwR29Jwzt6/gvV/", "012345678901234567890123456789012345"},
@@ -250,7 +243,7 @@ static int max_crypts;
 
 /* these 2 values are used in setup of the cryptloopstruct, AND to do our SHA256_Init() calls, in the inner loop */
 static const unsigned char padding[128] = { 0x80, 0 /* 0,0,0,0.... */ };
-#ifndef JTR_INC_COMMON_CRYPTO_SHA2
+#if !defined(JTR_INC_COMMON_CRYPTO_SHA2) && !defined(MMX_COEF_SHA256)
 static const ARCH_WORD_32 ctx_init[8] =
 	{0x6A09E667,0xBB67AE85,0x3C6EF372,0xA54FF53A,0x510E527F,0x9B05688C,0x1F83D9AB,0x5BE0CD19};
 #endif
@@ -352,6 +345,7 @@ static void LoadCryptStruct(cryptloopstruct *crypt_struct, int index, int idx, c
 
 	// Adjust cp for idx;
 #ifdef MMX_COEF_SHA256
+	cp += idx*2*64;
 	next_cp = cp + (2*64*BLKS);
 #endif
 
@@ -523,7 +517,7 @@ static void LoadCryptStruct(cryptloopstruct *crypt_struct, int index, int idx, c
 	pstr->cptr[idx][20] = cp + off_pc;
 	memcpy(cp, p_bytes, plen); cp += (plen+BINARY_SIZE);
 	if (!idx) pstr->datlen[21] = dlen_pc;
-	memcpy(cp, padding, tot_psc-2-len_pc);
+	memcpy(cp, padding, tot_pc-2-len_pc);
 	pstr->bufs[idx][21][tot_pc-2] = (len_pc<<3)>>8;
 	pstr->bufs[idx][21][tot_pc-1] = (len_pc<<3)&0xFF;
 
@@ -613,6 +607,24 @@ static void LoadCryptStruct(cryptloopstruct *crypt_struct, int index, int idx, c
 	if (!idx) pstr->datlen[41] = dlen_ppsc;
 }
 
+#ifdef MMX_COEF_SHA256
+/*
+ * Which of the 4 buffer lengths (p+c, p+s+c, p+p+c and p+s+p+c) take 2
+ * SHA-256 blocks, as bits.  All lanes of an SSE crypt must be in the same
+ * class, since they share crypt_struct.datlen[].  Each bit can only go from
+ * 0 to 1 as plen grows, so a salt has at most 5 classes in use.
+ */
+static int block_class(int plen)
+{
+	int slen = cur_salt->len;
+
+	return (plen + BINARY_SIZE > 55) |
+		((plen + slen + BINARY_SIZE > 55) << 1) |
+		((2 * plen + BINARY_SIZE > 55) << 2) |
+		((2 * plen + slen + BINARY_SIZE > 55) << 3);
+}
+#endif
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
@@ -627,23 +639,24 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 //	}
 
 #ifdef MMX_COEF_SHA256
-	// group based upon size splits.
+	// group based upon block counts, see block_class().
 	MixOrder = mem_alloc(sizeof(int)*(count+5*MMX_COEF_SHA256));
 	{
-		const int lens[6] = {0,4,8,12,24,36};
-		int j;
+		int j, first;
 		tot_todo = 0;
-		saved_key_length[count] = 0; // point all 'tail' MMX buffer elements to this location.
-		for (j = 0; j < 5; ++j) {
+		for (j = 0; j < 16; ++j) {
+			first = tot_todo;
 			for (index = 0; index < count; ++index) {
-				if (saved_key_length[index] >= lens[j] && saved_key_length[index] < lens[j+1])
+				if (block_class(saved_key_length[index]) == j)
 					MixOrder[tot_todo++] = index;
 			}
-			while (tot_todo & (MMX_COEF_SHA256-1))
-				MixOrder[tot_todo++] = count;
+			// the 'tail' MMX buffer elements redo the group's last key
+			while (tot_todo > first && (tot_todo & (MMX_COEF_SHA256-1))) {
+				MixOrder[tot_todo] = MixOrder[tot_todo-1];
+				++tot_todo;
+			}
 		}
 	}
-	printf ("tot_todo=%d count+5*MMX_COEF_SHA256=%d\n", tot_todo, count+5*MMX_COEF_SHA256);
 #else
 	// no need to mix. just run them one after the next, in any order.
 	MixOrder = mem_alloc(sizeof(int)*count);
@@ -788,7 +801,7 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 				for (k = 0; k < MMX_COEF_SHA256; ++k) {
 					ARCH_WORD_32 *o = (ARCH_WORD_32 *)crypt_struct.cptr[k][idx];
 					for (j = 0; j < 8; ++j)
-						*o++ = JOHNSWAP(sse_out[(j<<(MMX_COEF_SHA256>>1))+k]);
+						*o++ = JOHNSWAP(sse_out[(j*MMX_COEF_SHA256)+k]);
 				}
 			}
 			if (++idx == 42)
@@ -799,7 +812,7 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 			for (k = 0; k < MMX_COEF_SHA256; ++k) {
 				ARCH_WORD_32 *o = (ARCH_WORD_32 *)crypt_out[MixOrder[index+k]];
 				for (j = 0; j < 8; ++j)
-					*o++ = JOHNSWAP(sse_out[(j<<(MMX_COEF_SHA256>>1))+k]);
+					*o++ = JOHNSWAP(sse_out[(j*MMX_COEF_SHA256)+k]);
 			}
 		}
 #else
@@ -876,6 +889,7 @@ static void *get_salt(char *ciphertext)
 	static struct saltstruct out;
 	int len;
 
+	memset(&out, 0, sizeof(out));
 	out.rounds = ROUNDS_DEFAULT;
 	ciphertext += 3;
 	if (!strncmp(ciphertext, ROUNDS_PREFIX,
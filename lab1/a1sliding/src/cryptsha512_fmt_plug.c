@@ -7,6 +7,11 @@
  * general public under the following terms:  Redistribution and use in source
  * and binary forms, with or without modification, are permitted.
  *
+ * SSE2/AVX2 version: keys are grouped by the number of SHA-512 blocks their
+ * round buffers take (for the current salt), so that all lanes of one
+ * SSESHA512body() call follow the same schedule.  The buffers of the 42
+ * round pattern are built once per key, like in cryptsha256_fmt_plug.c.
+ * Keys too long for 2 blocks are done by the scalar code.
  */
 
 #if FMT_EXTERNS_H
@@ -27,6 +32,8 @@ john_register_one(&fmt_cryptsha512);
 #include "params.h"
 #include "common.h"
 #include "formats.h"
+#include "johnswap.h"
+#include "sse-intrinsics.h"
 // these MUST be defined prior to loading cryptsha512_valid.h
 #define BINARY_SIZE			64
 #define SALT_LENGTH			16
@@ -36,7 +43,9 @@ john_register_one(&fmt_cryptsha512);
 
 #define FORMAT_LABEL			"sha512crypt"
 
-#if ARCH_BITS >= 64
+#ifdef MMX_COEF_SHA512
+#define ALGORITHM_NAME			SHA512_ALGORITHM_NAME
+#elif ARCH_BITS >= 64
 #define ALGORITHM_NAME			"64/" ARCH_BITS_STR " " SHA2_LIB
 #else
 #define ALGORITHM_NAME			"32/" ARCH_BITS_STR " " SHA2_LIB
@@ -48,8 +57,20 @@ john_register_one(&fmt_cryptsha512);
 #define SALT_SIZE			sizeof(struct saltstruct)
 #define SALT_ALIGN			4
 
+#ifdef MMX_COEF_SHA512
+#define MIN_KEYS_PER_CRYPT		MMX_COEF_SHA512
+#define MAX_KEYS_PER_CRYPT		MMX_COEF_SHA512
+// more keys per crypt_all(), so that most groups fill all the lanes
+#ifdef _OPENMP
+#define MMX_COEF_SCALE			(32/MMX_COEF_SHA512)
+#else
+#define MMX_COEF_SCALE			(128/MMX_COEF_SHA512)
+#endif
+#else
 #define MIN_KEYS_PER_CRYPT		1
 #define MAX_KEYS_PER_CRYPT		1
+#define MMX_COEF_SCALE			1
+#endif
 
 static struct fmt_tests tests[] = {
 	{"$6$LKO/Ute40T3FNF95$6S/6T2YuOIHY0N3XpLKABJ3soYcXD9mB7uVbtEZDj/LNscVhZoZ9DEH.sBciDrMsHOWOoASbNLTypH/5X26gN0", "U*U*U*U*"},
@@ -57,6 +78,10 @@ static struct fmt_tests tests[] = {
 	{"$6$LKO/Ute40T3FNF95$YS81pp1uhOHTgKLhSMtQCr2cDiUiN03Ud3gyD4ameviK1Zqz.w3oXsMgO6LrqmIEcG3hiqaUqHi/WEE2zrZqa/", "U*U***U*"},
 	{"$6$OmBOuxFYBZCYAadG$WCckkSZok9xhp4U1shIZEV7CCVwQUwMVea7L3A77th6SaE9jOPupEMJB.z0vIWCDiN9WLh2m9Oszrj5G.gt330", "*U*U*U*U"},
 	{"$6$ojWH1AiTee9x1peC$QVEnTvRVlPRhcLQCk/HnHaZmlGAAjCfrAN0FtOsOnUk5K5Bn/9eLHHiRzrTzaIKjW9NTLNIBUCtNVOowWS2mN.", ""},
+	{"$6$8charsal$ri5sgHAvODWvFLzp/VVEX7SM8tpsIRWV6nuX8H3Z23EQjN7PMchtcEzk0hQ/wDmoQzyRtAzCy21oMH0nVpudu1", "U*U*U*U*"},
+	// 80+ byte keys are done by the scalar code in SSE builds.  Slows down the
+	// benchmark, so uncomment, test your build, then re-comment it.
+//	{"$6$saltsaltsaltsalt$ziixBBrZVFxw4D6wDmnFnvBYWRClrnMTEIqKJDFB.qbYzZ2TEZOljxtPaKt1gMxL1TQQmSfIPBeAq5LuDJ6TV.", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"},
 	{NULL}
 };
 
@@ -72,14 +97,14 @@ static struct saltstruct {
 
 static void init(struct fmt_main *self)
 {
-#ifdef _OPENMP
-	int omp_t;
+	int omp_t = 1;
 
+#ifdef _OPENMP
 	omp_t = omp_get_max_threads();
 	self->params.min_keys_per_crypt = omp_t * MIN_KEYS_PER_CRYPT;
 	omp_t *= OMP_SCALE;
-	self->params.max_keys_per_crypt = omp_t * MAX_KEYS_PER_CRYPT;
 #endif
+	self->params.max_keys_per_crypt = MMX_COEF_SCALE * omp_t * MAX_KEYS_PER_CRYPT;
 	saved_key_length = mem_calloc_tiny(sizeof(*saved_key_length) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	saved_key = mem_calloc_tiny(sizeof(*saved_key) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	crypt_out = mem_calloc_tiny(sizeof(*crypt_out) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
@@ -108,136 +133,317 @@ static char *get_key(int index)
 	return saved_key[index];
 }
 
-static int crypt_all(int *pcount, struct db_salt *salt)
+/*
+ * Everything up to the rounds loop: leaves the first c in crypt_out[index],
+ * and returns the P and S byte sequences.
+ */
+static void crypt_start(int index, char *p_bytes, char *s_bytes)
 {
-	int count = *pcount;
-	int index = 0;
-#ifdef _OPENMP
-#pragma omp parallel for
-	for (index = 0; index < count; index++)
-#endif
-	{
-		// portably align temp_result char * pointer machine word size.
-		union xx {
-			unsigned char c[BINARY_SIZE];
-			ARCH_WORD a[BINARY_SIZE/sizeof(ARCH_WORD)];
-		} u;
-		unsigned char *temp_result = u.c;
-		SHA512_CTX ctx;
-		SHA512_CTX alt_ctx;
-		size_t cnt;
-		char *cp;
-		char p_bytes[PLAINTEXT_LENGTH+1];
-		char s_bytes[PLAINTEXT_LENGTH+1];
-
-		/* Prepare for the real work.  */
-		SHA512_Init(&ctx);
-
-		/* Add the key string.  */
-		SHA512_Update(&ctx, (unsigned char*)saved_key[index], saved_key_length[index]);
-
-		/* The last part is the salt string.  This must be at most 16
-		   characters and it ends at the first `$' character (for
-		   compatibility with existing implementations).  */
-		SHA512_Update(&ctx, cur_salt->salt, cur_salt->len);
-
-
-		/* Compute alternate SHA512 sum with input KEY, SALT, and KEY.  The
-		   final result will be added to the first context.  */
-		SHA512_Init(&alt_ctx);
-
-		/* Add key.  */
+	// portably align temp_result char * pointer machine word size.
+	union xx {
+		unsigned char c[BINARY_SIZE];
+		ARCH_WORD a[BINARY_SIZE/sizeof(ARCH_WORD)];
+	} u;
+	unsigned char *temp_result = u.c;
+	SHA512_CTX ctx;
+	SHA512_CTX alt_ctx;
+	size_t cnt;
+	char *cp;
+
+	/* Prepare for the real work.  */
+	SHA512_Init(&ctx);
+
+	/* Add the key string.  */
+	SHA512_Update(&ctx, (unsigned char*)saved_key[index], saved_key_length[index]);
+
+	/* The last part is the salt string.  This must be at most 16
+	   characters and it ends at the first `$' character (for
+	   compatibility with existing implementations).  */
+	SHA512_Update(&ctx, cur_salt->salt, cur_salt->len);
+
+
+	/* Compute alternate SHA512 sum with input KEY, SALT, and KEY.  The
+	   final result will be added to the first context.  */
+	SHA512_Init(&alt_ctx);
+
+	/* Add key.  */
+	SHA512_Update(&alt_ctx, (unsigned char*)saved_key[index], saved_key_length[index]);
+
+	/* Add salt.  */
+	SHA512_Update(&alt_ctx, cur_salt->salt, cur_salt->len);
+
+	/* Add key again.  */
+	SHA512_Update(&alt_ctx, (unsigned char*)saved_key[index], saved_key_length[index]);
+
+	/* Now get result of this (64 bytes) and add it to the other
+	   context.  */
+	SHA512_Final((unsigned char*)crypt_out[index], &alt_ctx);
+
+	/* Add for any character in the key one byte of the alternate sum.  */
+	for (cnt = saved_key_length[index]; cnt > BINARY_SIZE; cnt -= BINARY_SIZE)
+		SHA512_Update(&ctx, (unsigned char*)crypt_out[index], BINARY_SIZE);
+	SHA512_Update(&ctx, (unsigned char*)crypt_out[index], cnt);
+
+	/* Take the binary representation of the length of the key and for every
+	   1 add the alternate sum, for every 0 the key.  */
+	for (cnt = saved_key_length[index]; cnt > 0; cnt >>= 1)
+		if ((cnt & 1) != 0)
+			SHA512_Update(&ctx, (unsigned char*)crypt_out[index], BINARY_SIZE);
+		else
+			SHA512_Update(&ctx, (unsigned char*)saved_key[index], saved_key_length[index]);
+
+	/* Create intermediate result.  */
+	SHA512_Final((unsigned char*)crypt_out[index], &ctx);
+
+	/* Start computation of P byte sequence.  */
+	SHA512_Init(&alt_ctx);
+
+	/* For every character in the password add the entire password.  */
+	for (cnt = 0; cnt < saved_key_length[index]; ++cnt)
 		SHA512_Update(&alt_ctx, (unsigned char*)saved_key[index], saved_key_length[index]);
 
-		/* Add salt.  */
+	/* Finish the digest.  */
+	SHA512_Final(temp_result, &alt_ctx);
+
+	/* Create byte sequence P.  */
+	cp = p_bytes;
+	for (cnt = saved_key_length[index]; cnt >= BINARY_SIZE; cnt -= BINARY_SIZE)
+		cp = (char *) memcpy (cp, temp_result, BINARY_SIZE) + BINARY_SIZE;
+	memcpy (cp, temp_result, cnt);
+
+	/* Start computation of S byte sequence.  */
+	SHA512_Init(&alt_ctx);
+
+	/* For every character in the password add the entire password.  */
+	for (cnt = 0; cnt < 16 + ((unsigned char*)crypt_out[index])[0]; ++cnt)
 		SHA512_Update(&alt_ctx, cur_salt->salt, cur_salt->len);
 
-		/* Add key again.  */
-		SHA512_Update(&alt_ctx, (unsigned char*)saved_key[index], saved_key_length[index]);
+	/* Finish the digest.  */
+	SHA512_Final(temp_result, &alt_ctx);
 
-		/* Now get result of this (64 bytes) and add it to the other
-		   context.  */
-		SHA512_Final((unsigned char*)crypt_out[index], &alt_ctx);
+	/* Create byte sequence S.  */
+	cp = s_bytes;
+	for (cnt = cur_salt->len; cnt >= BINARY_SIZE; cnt -= BINARY_SIZE)
+		cp = (char *) memcpy (cp, temp_result, BINARY_SIZE) + BINARY_SIZE;
+	memcpy (cp, temp_result, cnt);
+}
 
-		/* Add for any character in the key one byte of the alternate sum.  */
-		for (cnt = saved_key_length[index]; cnt > BINARY_SIZE; cnt -= BINARY_SIZE)
-			SHA512_Update(&ctx, (unsigned char*)crypt_out[index], BINARY_SIZE);
-		SHA512_Update(&ctx, (unsigned char*)crypt_out[index], cnt);
+static void crypt_one(int index)
+{
+	SHA512_CTX ctx;
+	size_t cnt;
+	char p_bytes[PLAINTEXT_LENGTH+1];
+	char s_bytes[PLAINTEXT_LENGTH+1];
+
+	crypt_start(index, p_bytes, s_bytes);
+
+	/* Repeatedly run the collected hash value through SHA512 to
+	   burn CPU cycles.  */
+	for (cnt = 0; cnt < cur_salt->rounds; ++cnt)
+		{
+			/* New context.  */
+			SHA512_Init(&ctx);
+
+			/* Add key or last result.  */
+			if ((cnt & 1) != 0)
+				SHA512_Update(&ctx, p_bytes, saved_key_length[index]);
+			else
+				SHA512_Update(&ctx, (unsigned char*)crypt_out[index], BINARY_SIZE);
+
+			/* Add salt for numbers not divisible by 3.  */
+			if (cnt % 3 != 0)
+				SHA512_Update(&ctx, s_bytes, cur_salt->len);
 
-		/* Take the binary representation of the length of the key and for every
-		   1 add the alternate sum, for every 0 the key.  */
-		for (cnt = saved_key_length[index]; cnt > 0; cnt >>= 1)
+			/* Add key for numbers not divisible by 7.  */
+			if (cnt % 7 != 0)
+				SHA512_Update(&ctx, p_bytes, saved_key_length[index]);
+
+			/* Add key or last result.  */
 			if ((cnt & 1) != 0)
 				SHA512_Update(&ctx, (unsigned char*)crypt_out[index], BINARY_SIZE);
 			else
-				SHA512_Update(&ctx, (unsigned char*)saved_key[index], saved_key_length[index]);
-
-		/* Create intermediate result.  */
-		SHA512_Final((unsigned char*)crypt_out[index], &ctx);
-
-		/* Start computation of P byte sequence.  */
-		SHA512_Init(&alt_ctx);
-
-		/* For every character in the password add the entire password.  */
-		for (cnt = 0; cnt < saved_key_length[index]; ++cnt)
-			SHA512_Update(&alt_ctx, (unsigned char*)saved_key[index], saved_key_length[index]);
-
-		/* Finish the digest.  */
-		SHA512_Final(temp_result, &alt_ctx);
-
-		/* Create byte sequence P.  */
-		cp = p_bytes;
-		for (cnt = saved_key_length[index]; cnt >= BINARY_SIZE; cnt -= BINARY_SIZE)
-			cp = (char *) memcpy (cp, temp_result, BINARY_SIZE) + BINARY_SIZE;
-		memcpy (cp, temp_result, cnt);
-
-		/* Start computation of S byte sequence.  */
-		SHA512_Init(&alt_ctx);
-
-		/* For every character in the password add the entire password.  */
-		for (cnt = 0; cnt < 16 + ((unsigned char*)crypt_out[index])[0]; ++cnt)
-			SHA512_Update(&alt_ctx, cur_salt->salt, cur_salt->len);
-
-		/* Finish the digest.  */
-		SHA512_Final(temp_result, &alt_ctx);
-
-		/* Create byte sequence S.  */
-		cp = s_bytes;
-		for (cnt = cur_salt->len; cnt >= BINARY_SIZE; cnt -= BINARY_SIZE)
-			cp = (char *) memcpy (cp, temp_result, BINARY_SIZE) + BINARY_SIZE;
-		memcpy (cp, temp_result, cnt);
-
-		/* Repeatedly run the collected hash value through SHA512 to
-		   burn CPU cycles.  */
-		for (cnt = 0; cnt < cur_salt->rounds; ++cnt)
-			{
-				/* New context.  */
-				SHA512_Init(&ctx);
-
-				/* Add key or last result.  */
-				if ((cnt & 1) != 0)
-					SHA512_Update(&ctx, p_bytes, saved_key_length[index]);
-				else
-					SHA512_Update(&ctx, (unsigned char*)crypt_out[index], BINARY_SIZE);
-
-				/* Add salt for numbers not divisible by 3.  */
-				if (cnt % 3 != 0)
-					SHA512_Update(&ctx, s_bytes, cur_salt->len);
-
-				/* Add key for numbers not divisible by 7.  */
-				if (cnt % 7 != 0)
-					SHA512_Update(&ctx, p_bytes, saved_key_length[index]);
-
-				/* Add key or last result.  */
-				if ((cnt & 1) != 0)
-					SHA512_Update(&ctx, (unsigned char*)crypt_out[index], BINARY_SIZE);
-				else
-					SHA512_Update(&ctx, p_bytes, saved_key_length[index]);
-
-				/* Create intermediate [SIC] result.  */
-				SHA512_Final((unsigned char*)crypt_out[index], &ctx);
+				SHA512_Update(&ctx, p_bytes, saved_key_length[index]);
+
+			/* Create intermediate [SIC] result.  */
+			SHA512_Final((unsigned char*)crypt_out[index], &ctx);
+		}
+}
+
+#ifdef MMX_COEF_SHA512
+/*
+ * A round hashes c or p, then s (unless cnt % 3 == 0), then p (unless
+ * cnt % 7 == 0), then p or c.  These 3 conditions make up the buffer
+ * 'kind' below, so the rounds cycle through 8 buffers (42 rounds before the
+ * pattern repeats).  A round only has to store its result in the c slot of
+ * the next round's buffer.
+ */
+#define ROUND_KIND(cnt) \
+	(((cnt) & 1) | (((cnt) % 3 != 0) << 1) | (((cnt) % 7 != 0) << 2))
+
+/* Each lane's buffer is 2 blocks, laid out as SSEi_2BUF_INPUT expects */
+#define BUF_SIZE			256
+
+typedef struct {
+	unsigned char buf[8][MMX_COEF_SHA512][BUF_SIZE];
+	int c_off[8][MMX_COEF_SHA512];
+	int blocks[8];
+} cryptloopstruct;
+
+/*
+ * Which of the 4 buffer lengths (p+c, p+s+c, p+p+c and p+s+p+c) take 2
+ * SHA-512 blocks, as bits, or 16 for a key too long for the SSE code.  All
+ * lanes of an SSE crypt must be in the same class, since they share
+ * blocks[].  Each bit can only go from 0 to 1 as plen grows, so a salt has
+ * at most 5 SSE classes in use.
+ */
+static int block_class(int plen)
+{
+	int slen = cur_salt->len;
+
+	if (2 * plen + slen + BINARY_SIZE > BUF_SIZE - 17)
+		return 16;
+	return (plen + BINARY_SIZE > 111) |
+		((plen + slen + BINARY_SIZE > 111) << 1) |
+		((2 * plen + BINARY_SIZE > 111) << 2) |
+		((2 * plen + slen + BINARY_SIZE > 111) << 3);
+}
+
+static void LoadCryptStruct(cryptloopstruct *crypt_struct, int lane, int index, char *p_bytes, char *s_bytes)
+{
+	int kind, len, plen = saved_key_length[index];
+
+	for (kind = 0; kind < 8; ++kind) {
+		unsigned char *cp = crypt_struct->buf[kind][lane];
+
+		len = 0;
+		if (kind & 1) {
+			memcpy(cp, p_bytes, plen);
+			len += plen;
+		} else {
+			crypt_struct->c_off[kind][lane] = 0;
+			memcpy(cp, crypt_out[index], BINARY_SIZE);
+			len += BINARY_SIZE;
+		}
+		if (kind & 2) {
+			memcpy(&cp[len], s_bytes, cur_salt->len);
+			len += cur_salt->len;
+		}
+		if (kind & 4) {
+			memcpy(&cp[len], p_bytes, plen);
+			len += plen;
+		}
+		if (kind & 1) {
+			crypt_struct->c_off[kind][lane] = len;
+			memcpy(&cp[len], crypt_out[index], BINARY_SIZE);
+			len += BINARY_SIZE;
+		} else {
+			memcpy(&cp[len], p_bytes, plen);
+			len += plen;
+		}
+
+		memset(&cp[len], 0, BUF_SIZE - len);
+		cp[len] = 0x80;
+		crypt_struct->blocks[kind] = (len <= 111) ? 1 : 2;
+		cp += crypt_struct->blocks[kind] * 128;
+		cp[-2] = (len << 3) >> 8;
+		cp[-1] = (len << 3) & 0xFF;
+	}
+}
+
+static void crypt_simd(int *MixOrder)
+{
+	JTR_ALIGN(16) cryptloopstruct crypt_struct;
+	JTR_ALIGN(16) ARCH_WORD_64 sse_out[8*MMX_COEF_SHA512];
+	char p_bytes[PLAINTEXT_LENGTH+1];
+	char s_bytes[PLAINTEXT_LENGTH+1];
+	unsigned int cnt;
+	int j, k, kind;
+
+	for (k = 0; k < MMX_COEF_SHA512; ++k) {
+		crypt_start(MixOrder[k], p_bytes, s_bytes);
+		LoadCryptStruct(&crypt_struct, k, MixOrder[k], p_bytes, s_bytes);
+	}
+
+	for (cnt = 0; ; ) {
+		kind = ROUND_KIND(cnt);
+		SSESHA512body((__m128i *)crypt_struct.buf[kind], sse_out, NULL,
+		              SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK);
+		if (crypt_struct.blocks[kind] == 2)
+			SSESHA512body((__m128i *)&crypt_struct.buf[kind][0][128],
+			              sse_out, sse_out,
+			              SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK|SSEi_RELOAD);
+
+		if (++cnt == cur_salt->rounds)
+			break;
+
+		kind = ROUND_KIND(cnt);
+		for (k = 0; k < MMX_COEF_SHA512; ++k) {
+			ARCH_WORD_64 *o = (ARCH_WORD_64 *)
+				&crypt_struct.buf[kind][k][crypt_struct.c_off[kind][k]];
+			for (j = 0; j < 8; ++j)
+				*o++ = JOHNSWAP64(sse_out[j*MMX_COEF_SHA512+k]);
+		}
+	}
+
+	for (k = 0; k < MMX_COEF_SHA512; ++k) {
+		ARCH_WORD_64 *o = (ARCH_WORD_64 *)crypt_out[MixOrder[k]];
+		for (j = 0; j < 8; ++j)
+			*o++ = JOHNSWAP64(sse_out[j*MMX_COEF_SHA512+k]);
+	}
+}
+#endif
+
+static int crypt_all(int *pcount, struct db_salt *salt)
+{
+	int count = *pcount;
+	int index;
+#ifdef MMX_COEF_SHA512
+	int *MixOrder, tot_sse, tot_todo;
+
+	// group the keys by block class, see block_class().  The 'tail' MMX
+	// buffer elements of a group redo its last key.
+	MixOrder = mem_alloc(sizeof(int)*(count+5*MMX_COEF_SHA512));
+	{
+		int j, first;
+		tot_todo = 0;
+		for (j = 0; j < 16; ++j) {
+			first = tot_todo;
+			for (index = 0; index < count; ++index) {
+				if (block_class(saved_key_length[index]) == j)
+					MixOrder[tot_todo++] = index;
 			}
+			while (tot_todo > first && (tot_todo & (MMX_COEF_SHA512-1))) {
+				MixOrder[tot_todo] = MixOrder[tot_todo-1];
+				++tot_todo;
+			}
+		}
+		tot_sse = tot_todo;
+		for (index = 0; index < count; ++index) {
+			if (block_class(saved_key_length[index]) == 16)
+				MixOrder[tot_todo++] = index;
+		}
 	}
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < tot_sse; index += MMX_COEF_SHA512)
+		crypt_simd(&MixOrder[index]);
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = tot_sse; index < tot_todo; index++)
+		crypt_one(MixOrder[index]);
+
+	MEM_FREE(MixOrder);
+#else
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < count; index++)
+		crypt_one(index);
+#endif
 	return count;
 }
 
@@ -251,6 +457,7 @@ static void *get_salt(char *ciphertext)
 	static struct saltstruct out;
 	int len;
 
+	memset(&out, 0, sizeof(out));
 	out.rounds = ROUNDS_DEFAULT;
 	ciphertext += 3;
 	if (!strncmp(ciphertext, ROUNDS_PREFIX,
@@ -278,9 +485,8 @@ static void *get_salt(char *ciphertext)
 static int cmp_all(void *binary, int count)
 {
 	int index = 0;
-#ifdef _OPENMP
+
 	for (; index < count; index++)
-#endif
 		if (!memcmp(binary, crypt_out[index], BINARY_SIZE))
 			return 1;
 	return 0;
@@ -67,6 +67,7 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 
 	if (new_keys || strcmp(last_ssid, hccap.essid)) {
 		wpapsk_gpu(inbuffer, outbuffer, &currentsalt, count);
+		wpapsk_pmk_setup(count);
 		new_keys = 0;
 		strcpy(last_ssid, hccap.essid);
 	}
@@ -27,6 +27,7 @@ john_register_one(&fmt_drupal7);
 #include "misc.h"
 #include "common.h"
 #include "formats.h"
+#include "sha512_sse.h"
 #ifdef _OPENMP
 #include <omp.h>
 #define OMP_SCALE			8
@@ -35,7 +36,9 @@ john_register_one(&fmt_drupal7);
 
 #define FORMAT_LABEL			"Drupal7"
 #define FORMAT_NAME			"$S$"
-#if ARCH_BITS >= 64
+#ifdef MMX_COEF_SHA512
+#define ALGORITHM_NAME			"SHA512 " SHA512_ALGORITHM_NAME
+#elif ARCH_BITS >= 64
 #define ALGORITHM_NAME			"SHA512 64/" ARCH_BITS_STR " " SHA2_LIB
 #else
 #define ALGORITHM_NAME			"SHA512 32/" ARCH_BITS_STR " " SHA2_LIB
@@ -45,22 +48,39 @@ john_register_one(&fmt_drupal7);
 #define BENCHMARK_LENGTH		-1
 
 #define PLAINTEXT_LENGTH		63
+#ifdef MMX_COEF_SHA512
+/*
+ * The 64 byte hash and the key make up one block.  Longer keys are done by
+ * the scalar code.
+ */
+#define SIMD_MAX_LENGTH			(SHA512_SSE_MAX_LENGTH - DIGEST_SIZE)
+#endif
 #define CIPHERTEXT_LENGTH		55
 
 #define DIGEST_SIZE			(512/8)
 
+
 #define BINARY_SIZE			(258/8) // ((258+7)/8)
 #define BINARY_ALIGN			4
 #define SALT_SIZE			8
 #define SALT_ALIGN			4
 
+#ifdef MMX_COEF_SHA512
+#define MIN_KEYS_PER_CRYPT		MMX_COEF_SHA512
+#define MAX_KEYS_PER_CRYPT		MMX_COEF_SHA512
+#else
 #define MIN_KEYS_PER_CRYPT		1
 #define MAX_KEYS_PER_CRYPT		1
+#endif
 
 static struct fmt_tests tests[] = {
 	{"$S$CwkjgAKeSx2imSiN3SyBEg8e0sgE2QOx4a/VIfCHN0BZUNAWCr1X", "virtualabc"},
 	{"$S$CFURCPa.k6FAEbJPgejaW4nijv7rYgGc4dUJtChQtV4KLJTPTC/u", "password"},
 	{"$S$C6x2r.aW5Nkg7st6/u.IKWjTerHXscjPtu4spwhCVZlP89UKcbb/", "NEW_TEMP_PASSWORD"},
+	{"$S$CJ.7x/AbZosIj761AQdEJfxM.PMjr/Yv49rMSUNWdfjdit.z7MWa", "12345678901234567890123456789012345678901234567"},
+	// 48+ byte keys are done by the scalar code in SSE builds.  Slows down the
+	// benchmark, so uncomment, test your build, then re-comment it.
+//	{"$S$C6x2r.aW5Xoqu42RP2jqV/4v0IOg9EABLUr1Pn55tA9VEwxkZMui", "123456789012345678901234567890123456789012345678901234567890123"},
 	{NULL}
 };
 
@@ -145,37 +165,88 @@ static int cmp_exact(char *source, int index)
 	return 1;
 }
 
+static void crypt_scalar(int index)
+{
+	SHA512_CTX ctx;
+	unsigned char tmp[DIGEST_SIZE + PLAINTEXT_LENGTH];
+	int len = EncKeyLen[index];
+	unsigned Lcount = loopCnt - 1;
+
+	SHA512_Init( &ctx );
+	SHA512_Update( &ctx, cursalt, 8 );
+	SHA512_Update( &ctx, EncKey[index], len );
+	memcpy(&tmp[DIGEST_SIZE], (char *)EncKey[index], len);
+	SHA512_Final( tmp, &ctx);
+
+	len += DIGEST_SIZE;
+
+	do {
+		SHA512_Init( &ctx );
+		SHA512_Update( &ctx, tmp, len);
+		SHA512_Final( tmp, &ctx);
+	} while (--Lcount);
+	SHA512_Init( &ctx );
+	SHA512_Update( &ctx, tmp, len);
+	SHA512_Final( (unsigned char *) crypt_key[index], &ctx);
+}
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
 	int index = 0;
+#ifdef MMX_COEF_SHA512
+	int loops = (count + MMX_COEF_SHA512 - 1) / MMX_COEF_SHA512;
+
 #ifdef _OPENMP
 #pragma omp parallel for
-	for (index = 0; index < count; index++)
 #endif
-	{
-		SHA512_CTX ctx;
-		unsigned char tmp[DIGEST_SIZE + PLAINTEXT_LENGTH];
-		int len = EncKeyLen[index];
-		unsigned Lcount = loopCnt - 1;
-
-		SHA512_Init( &ctx );
-		SHA512_Update( &ctx, cursalt, 8 );
-		SHA512_Update( &ctx, EncKey[index], len );
-		memcpy(&tmp[DIGEST_SIZE], (char *)EncKey[index], len);
-		SHA512_Final( tmp, &ctx);
-
-		len += DIGEST_SIZE;
-
-		do {
-			SHA512_Init( &ctx );
-			SHA512_Update( &ctx, tmp, len);
-			SHA512_Final( tmp, &ctx);
-		} while (--Lcount);
-		SHA512_Init( &ctx );
-		SHA512_Update( &ctx, tmp, len);
-		SHA512_Final( (unsigned char *) crypt_key[index], &ctx);
+	for (index = 0; index < loops; index++) {
+		JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_64 first[SHA512_BUF_SIZ*MMX_COEF_SHA512];
+		JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_64 loop[SHA512_BUF_SIZ*MMX_COEF_SHA512];
+		int i, j, longest = 0;
+
+		/*
+		 * salt.key, and hash.key with the key loaded once for all the
+		 * rounds.  The first hash goes straight to the latter.  Lanes
+		 * of keys too long for that get an empty key and are redone
+		 * by the scalar code.
+		 */
+		for (i = 0; i < MMX_COEF_SHA512; i++) {
+			int k = index * MMX_COEF_SHA512 + i;
+			int len = EncKeyLen[k];
+
+			if (len > SIMD_MAX_LENGTH)
+				len = 0;
+			if (EncKeyLen[k] > longest)
+				longest = EncKeyLen[k];
+			sha512_sse_load(first, i, cursalt, 8, EncKey[k], len);
+			sha512_sse_load(loop, i, NULL, DIGEST_SIZE,
+			                EncKey[k], len);
+		}
+		SSESHA512body((__m128i *)first, loop, NULL,
+		              SSEi_MIXED_IN | SSEi_OUTPUT_AS_INP_FMT);
+		sha512_sse_iterate(loop, loopCnt);
+
+		for (i = 0; i < MMX_COEF_SHA512; i++) {
+			ARCH_WORD_64 *out = (ARCH_WORD_64 *)
+				crypt_key[index * MMX_COEF_SHA512 + i];
+
+			for (j = 0; j < DIGEST_SIZE / 8; j++)
+				out[j] = JOHNSWAP64(loop[SHA512_SSE_WORD(i, j)]);
+		}
+
+		if (longest > SIMD_MAX_LENGTH)
+		for (i = 0; i < MMX_COEF_SHA512; i++)
+		if (EncKeyLen[index * MMX_COEF_SHA512 + i] > SIMD_MAX_LENGTH)
+			crypt_scalar(index * MMX_COEF_SHA512 + i);
 	}
+#else
+#ifdef _OPENMP
+#pragma omp parallel for
+	for (index = 0; index < count; index++)
+#endif
+		crypt_scalar(index);
+#endif
 	return count;
 }
 
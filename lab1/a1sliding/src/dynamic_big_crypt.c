@@ -1483,7 +1483,7 @@ static void DoSHA256_crypt_f_sse(void *in, int len[MMX_COEF_SHA256], void *out,
 		for (i = 0; i < MMX_COEF_SHA256; ++i) {
 			if (cnt == loops[i]) {
 				for (j = 0; j < 4; ++j) {
-					((ARCH_WORD_32*)out)[(i<<2)+j] = JOHNSWAP(a[(j<<2)+i]);
+					((ARCH_WORD_32*)out)[(i<<2)+j] = JOHNSWAP(a[j*MMX_COEF_SHA256+i]);
 				}
 			} else if (cnt < loops[i])
 				bMore = 1;
@@ -1510,7 +1510,7 @@ static void DoSHA256_crypt_sse(void *in, int ilen[MMX_COEF_SHA256], void *out[MM
 		for (i = 0; i < MMX_COEF_SHA256; ++i) {
 			if (cnt == loops[i]) {
 				for (j = 0; j < 8; ++j) {
-					y.a[j] =JOHNSWAP(a[(j<<2)+i]);
+					y.a[j] =JOHNSWAP(a[j*MMX_COEF_SHA256+i]);
 				}
 				*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), isSHA256?32:28, tid);
 			} else if (cnt < loops[i])
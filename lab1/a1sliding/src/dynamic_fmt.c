@@ -137,6 +137,11 @@ static int m_ompt;
 static struct fmt_main fmt_Dynamic;
 static struct fmt_main *pFmts;
 static int nFmts;
+/* Formats only loaded when a thin format linked to them, see
+   dynamic_Get_fmt_main() */
+static struct fmt_main **pLinkedFmts;
+static int nLinkedFmts;
+static int itoa16_w2_loaded;
 static int force_md5_ctx;
 static void dynamic_RESET(struct fmt_main *fmt);
 
@@ -7124,7 +7129,7 @@ int dynamic_SETUP(DYNAMIC_Setup *Setup, struct fmt_main *pFmt)
 #ifdef MMX_COEF
 		// no reason to do 128 crypts, causes slow validity checking.  But we do get some gains
 		// by doing more than simple 1 set of MMX_COEF
-		pFmt->params.algorithm_name = "128/128 " SSE_type " 96x4x" STRINGIZE(MD5_SSE_PARA);
+		pFmt->params.algorithm_name = SSE_BITS_STR SSE_type " 96x4x" STRINGIZE(MD5_SSE_PARA);
 		pFmt->params.max_keys_per_crypt = 96*MD5_SSE_PARA;
 #else
 #if ARCH_LITTLE_ENDIAN
@@ -7139,7 +7144,7 @@ int dynamic_SETUP(DYNAMIC_Setup *Setup, struct fmt_main *pFmt)
 #endif
 #endif
 #ifdef MMX_COEF
-		pFmt->params.algorithm_name = "128/128 " SSE_type " 4x4x" STRINGIZE(MD5_SSE_PARA);
+		pFmt->params.algorithm_name = SSE_BITS_STR SSE_type " 4x4x" STRINGIZE(MD5_SSE_PARA);
 		pFmt->params.max_keys_per_crypt = 16*MD5_SSE_PARA;
 #endif
 #else
@@ -7493,7 +7498,8 @@ int dynamic_Register_formats(struct fmt_main **ptr)
 	if (options.format && strstr(options.format, "*"))
 		wildcard = 1;
 
-	Dynamic_Load_itoa16_w2();
+	if (!itoa16_w2_loaded++)
+		Dynamic_Load_itoa16_w2();
 	if (!wildcard && options.format &&
 	    !strncmp(options.format, "dynamic_", 8))
 		sscanf(options.format, "dynamic_%d", &single);
@@ -7548,6 +7554,29 @@ static struct fmt_main *dynamic_Get_fmt_main(int which)
 		if (!strcmp(pPriv->dynamic_WHICH_TYPE_SIG, label))
 			return &pFmts[i];
 	}
+	for (i = 0; i < nLinkedFmts; ++i) {
+		private_subformat_data *pPriv = pLinkedFmts[i]->private.data;
+		if (!strcmp(pPriv->dynamic_WHICH_TYPE_SIG, label))
+			return pLinkedFmts[i];
+	}
+
+	// The dynamic formats weren't all registered (john only does that when
+	// they may be used), so load this one now, for the thin format.  This
+	// happens before the thin format's init(), which sets curdat again.
+	if (dynamic_IS_VALID(which) == 1) {
+		struct fmt_main *pFmt;
+
+		if (!itoa16_w2_loaded++)
+			Dynamic_Load_itoa16_w2();
+		pFmt = mem_alloc_tiny(sizeof(*pFmt), MEM_ALIGN_WORD);
+		if (!LoadOneFormat(which, pFmt))
+			return NULL;
+		pLinkedFmts = realloc(pLinkedFmts,
+		    sizeof(*pLinkedFmts) * (nLinkedFmts + 1));
+		if (!pLinkedFmts)
+			pexit("realloc");
+		return (pLinkedFmts[nLinkedFmts++] = pFmt);
+	}
 	return NULL;
 }
 
@@ -4,6 +4,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "params.h"
@@ -14,6 +15,9 @@
 #include "unicode.h"
 #ifndef BENCH_BUILD
 #include "options.h"
+#include "config.h"
+#include "john.h"
+#include "testcache.h"
 #else
 #if ARCH_INT_GT_32
 typedef unsigned short ARCH_WORD_32;
@@ -50,6 +54,8 @@ static size_t fmt_strnlen(const char *s, size_t max)
 void fmt_register(struct fmt_main *format)
 {
 	format->private.initialized = 0;
+	format->private.signatures = 0;
+	format->private.disabled = 0;
 	format->next = NULL;
 	*fmt_tail = format;
 	fmt_tail = &format->next;
@@ -61,6 +67,8 @@ void fmt_init(struct fmt_main *format)
 		format->methods.init(format);
 		format->private.initialized = 1;
 	}
+	if (!format->methods.precompute)
+		format->methods.precompute = fmt_default_precompute;
 #ifndef BENCH_BUILD
 	if (options.flags & FLG_KEEP_GUESSING)
 		format->params.flags |= FMT_NOT_EXACT;
@@ -136,7 +144,7 @@ static char *longcand(int index, int ml)
 }
 
 static char *fmt_self_test_body(struct fmt_main *format,
-    void *binary_copy, void *salt_copy)
+    void *binary_copy, void *salt_copy, int cached)
 {
 	static char s_size[100];
 	struct fmt_tests *current;
@@ -169,7 +177,7 @@ static char *fmt_self_test_body(struct fmt_main *format,
 #endif
 
 #ifndef BENCH_BUILD
-	if (options.flags & FLG_NOTESTS) {
+	if ((options.flags & FLG_NOTESTS) || cached) {
 		fmt_init(format);
 		dyna_salt_init(format);
 		format->methods.reset(NULL);
@@ -488,7 +496,11 @@ static char *fmt_self_test_body(struct fmt_main *format,
 #endif
 		{
 			int count = index + 1;
-			int match = format->methods.crypt_all(&count, NULL);
+			int match;
+/* Test crypt_all() both with and without the keys precomputed */
+			if (index & 1)
+				format->methods.precompute(count);
+			match = format->methods.crypt_all(&count, NULL);
 /* If salt is NULL, the return value must always match *count the way it is
  * after the crypt_all() call. */
 			if (match != count)
@@ -597,11 +609,164 @@ static void *alloc_binary(void **alloc, size_t size, size_t align)
 	return p;
 }
 
+/*
+ * Returns the length of the "$tag$" at the start of the ciphertext, or 0.
+ */
+int fmt_signature_length(char *ciphertext)
+{
+	char *p;
+
+	if (*ciphertext != '$')
+		return 0;
+
+	for (p = ciphertext + 1; *p && *p != '$'; p++)
+		if (p - ciphertext >= FMT_SIGNATURE_LENGTH - 1)
+			return 0;
+
+	if (*p != '$' || p == ciphertext + 1)
+		return 0;
+
+	return p - ciphertext + 1;
+}
+
+static void fmt_signature_init(struct fmt_main *format)
+{
+	struct fmt_tests *current;
+	int count, length, index, fields_only;
+
+	format->private.signatures = -1;
+
+	if (!(current = format->params.tests) || !current->ciphertext)
+		return;
+
+	count = fields_only = 0;
+	do {
+		char *fields[10], *ciphertext, tag[FMT_SIGNATURE_LENGTH + 1];
+		int valid;
+
+/*
+ * Most test vectors are tagged already, and prepare() may be as costly as a
+ * valid() (some formats' are), so only call it for those that aren't.  Those
+ * only given as fields are there to test prepare() building a tagged one, and
+ * a format whose valid() takes its hashes untagged gets no signatures anyway.
+ */
+		ciphertext = current->ciphertext;
+		if (!*ciphertext && current->fields[1]) {
+			fields_only = 1;
+			continue;
+		}
+		if (!(length = fmt_signature_length(ciphertext))) {
+			memcpy(fields, current->fields, sizeof(fields));
+			if (!fields[1])
+				fields[1] = current->ciphertext;
+			if (!(ciphertext = format->methods.prepare(fields, format))
+			    || !(length = fmt_signature_length(ciphertext)))
+				return;
+		}
+
+		for (index = 0; index < count; index++)
+		if (length == format->private.signature_length[index] &&
+		    !strncasecmp(ciphertext, format->private.signature[index],
+		    length))
+			break;
+		if (index < count)
+			continue;
+
+		strnzcpy(tag, ciphertext, length + 1);
+		ciphertext = strcpy(mem_alloc(strlen(ciphertext) + 1),
+		    ciphertext);
+
+/* Formats that also take their hashes without the tag have no signature */
+		valid = format->methods.valid(ciphertext + length, format);
+		MEM_FREE(ciphertext);
+		if (valid)
+			return;
+
+		if (count == FMT_SIGNATURES)
+			return;
+		format->private.signature[count] = str_alloc_copy(tag);
+		format->private.signature_length[count++] = length;
+	} while ((++current)->ciphertext);
+
+	if (!count)
+		return;
+
+/* Thin formats also take the "$dynamic_N$" form of their hashes */
+	if ((format->params.flags & FMT_DYNAMIC) &&
+	    strncmp(format->private.signature[0], "$dynamic_", 9)) {
+		if (count == FMT_SIGNATURES)
+			return;
+		format->private.signature[count] = "$dynamic_";
+		format->private.signature_length[count++] = 9;
+	}
+
+	format->private.signatures = count;
+}
+
+int fmt_signature_match(struct fmt_main *format, char *ciphertext)
+{
+	int index;
+
+	if (!format->private.signatures) {
+/* Nothing to go by, so don't work the signatures out just yet */
+		if (!fmt_signature_length(ciphertext))
+			return 1;
+		fmt_signature_init(format);
+	}
+
+	for (index = 0; index < format->private.signatures; index++)
+	if (!strncasecmp(ciphertext, format->private.signature[index],
+	    format->private.signature_length[index]))
+		return 1;
+
+	return format->private.signatures < 0;
+}
+
+int fmt_engine_forced(int dflt)
+{
+	static int engine = -3;
+	char *value;
+
+	if (engine != -3)
+		return engine == -2 ? dflt : engine;
+
+	value = getenv("JOHN_SIMD_ENGINE");
+#ifndef BENCH_BUILD
+	if (!value)
+		value = cfg_get_param(SECTION_OPTIONS, NULL, "SIMDEngine");
+#endif
+
+	if (!value || !*value)
+		engine = -2;
+	else if (!strcasecmp(value, "auto"))
+		engine = -1;
+	else if (!strcasecmp(value, "simd"))
+		engine = 1;
+	else if (!strcasecmp(value, "scalar"))
+		engine = 0;
+	else {
+#ifndef BENCH_BUILD
+		if (john_main_process)
+#endif
+			fprintf(stderr, "Invalid SIMD engine: %s "
+			        "(use auto, simd or scalar)\n", value);
+		error();
+	}
+
+	return engine == -2 ? dflt : engine;
+}
+
+int fmt_engine_pick(clock_t simd, clock_t scalar)
+{
+	return (double)simd * 100 < (double)scalar * (100 - FMT_ENGINE_MARGIN);
+}
+
 char *fmt_self_test(struct fmt_main *format)
 {
 	char *retval;
 	void *binary_alloc, *salt_alloc;
 	void *binary_copy, *salt_copy;
+	int cached = 0;
 
 	binary_copy = alloc_binary(&binary_alloc,
 	    format->params.binary_size?format->params.binary_size:1, format->params.binary_align);
@@ -612,7 +777,14 @@ char *fmt_self_test(struct fmt_main *format)
 	 * while self-test is running. */
 	bench_running = 1;
 
-	retval = fmt_self_test_body(format, binary_copy, salt_copy);
+#ifndef BENCH_BUILD
+	cached = testcache_lookup(format);
+#endif
+	retval = fmt_self_test_body(format, binary_copy, salt_copy, cached);
+#ifndef BENCH_BUILD
+	if (!retval)
+		testcache_store(format);
+#endif
 
 	bench_running = 0;
 
@@ -737,6 +909,10 @@ void fmt_default_clear_keys(void)
 {
 }
 
+void fmt_default_precompute(int count)
+{
+}
+
 int fmt_default_get_hash(int index)
 {
 	return 0;
@@ -12,6 +12,8 @@
 #ifndef _JOHN_FORMATS_H
 #define _JOHN_FORMATS_H
 
+#include <time.h>
+
 #include "params.h"
 #include "misc.h"
 
@@ -79,6 +81,11 @@ struct db_salt;
 #define FMT_BS				0x00010000
 /* The split() method unifies the case of characters in hash encodings */
 #define FMT_SPLIT_UNIFIES_CASE		0x00020000
+/*
+ * init() sets the algorithm name, benchmark comment or test vectors (eg. after
+ * picking SIMD or scalar code), so it has to be called before they're used
+ */
+#define FMT_INIT_PARAMS			0x00040000
 /* Is this format a dynamic_x format (or a 'thin' format using dynamic code)? */
 #define FMT_DYNAMIC				0x00100000
 #ifdef _OPENMP
@@ -292,14 +299,36 @@ struct fmt_methods {
 
 /* Compares an ASCII ciphertext against a particular crypt_all() output */
 	int (*cmp_exact)(char *source, int index);
+
+/* Does the part of crypt_all()'s work that only depends on the keys, for the
+ * first count keys, so that it's done once rather than for every salt.  When
+ * cracking and benchmarking, this is called after a batch of keys has been
+ * set and before the salts are gone through.  crypt_all() must still work if
+ * it wasn't called, as during self-test, by doing that work itself when the
+ * keys have changed.  Formats may leave this out (NULL), fmt_init() then sets
+ * it to fmt_default_precompute(). */
+	void (*precompute)(int count);
 };
 
+/*
+ * Maximum number and length of the ciphertext signatures (tags such as
+ * "$2a$" or "$dynamic_0$") kept for a format, see fmt_signature_match().
+ */
+#define FMT_SIGNATURES			4
+#define FMT_SIGNATURE_LENGTH		32
+
 /*
  * Private fields for formats management.
  */
 struct fmt_private {
 	int initialized;
 	void *data;
+/* Number of signatures, 0 if not yet known, or -1 if there are none */
+	int signatures;
+	char *signature[FMT_SIGNATURES];
+	int signature_length[FMT_SIGNATURES];
+/* Set by the loader: 1 if disabled in john.conf, -1 if not, 0 if unknown */
+	int disabled;
 };
 
 /*
@@ -332,6 +361,38 @@ extern void fmt_init(struct fmt_main *format);
  */
 extern void fmt_done(struct fmt_main *format);
 
+/*
+ * Returns the length of the "$tag$" at the start of the ciphertext, or 0.
+ */
+extern int fmt_signature_length(char *ciphertext);
+
+/*
+ * Returns zero if "ciphertext", as returned by the format's prepare(), can't
+ * be valid for the format judging by its signatures, in which case there's
+ * no need to call valid().  The signatures are the "$tag$" prefixes of the
+ * format's test vectors, worked out on first use, and only kept if all of
+ * the test vectors have one and valid() rejects them with it removed.
+ * Formats without signatures match anything.
+ */
+extern int fmt_signature_match(struct fmt_main *format, char *ciphertext);
+
+/*
+ * For formats that have both SIMD and scalar code and pick one in init():
+ * returns 1 or 0 if the JOHN_SIMD_ENGINE environment variable, or else the
+ * SIMDEngine option, is "simd" or "scalar", -1 if it's "auto" and the format
+ * should time both and let fmt_engine_pick() choose, or the format's own
+ * default "dflt" (one of those) if neither is set.
+ */
+extern int fmt_engine_forced(int dflt);
+
+/*
+ * Returns 1 if the SIMD code is to be used given the best times of both,
+ * which is only if it was more than FMT_ENGINE_MARGIN percent faster, so
+ * that code that runs about as fast either way always gets the scalar one.
+ */
+#define FMT_ENGINE_MARGIN		10
+extern int fmt_engine_pick(clock_t simd, clock_t scalar);
+
 /*
  * Tests the format's methods for correct operation. Returns NULL on
  * success, method name on error.
@@ -354,6 +415,7 @@ extern int fmt_default_binary_hash(void *binary);
 extern int fmt_default_salt_hash(void *salt);
 extern void fmt_default_set_salt(void *salt);
 extern void fmt_default_clear_keys(void);
+extern void fmt_default_precompute(int count);
 extern int fmt_default_get_hash(int index);
 /* this is a salt_hash default specifically for dyna_salt type formats */
 extern int fmt_default_dyna_salt_hash(void *salt);
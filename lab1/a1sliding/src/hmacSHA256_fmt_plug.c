@@ -61,6 +61,10 @@ static char (*saved_plain)[PLAINTEXT_LENGTH + 1];
 static ARCH_WORD_32 (*crypt_key)[BINARY_SIZE / sizeof(ARCH_WORD_32)];
 static unsigned char (*opad)[PAD_SIZE];
 static unsigned char (*ipad)[PAD_SIZE];
+/* The hash contexts after the pads, see precompute() */
+static SHA256_CTX *ipad_ctx, *opad_ctx;
+/* Keys with their contexts up to date */
+static int precomputed;
 static unsigned char cursalt[SALT_SIZE+1];
 
 
@@ -77,6 +81,8 @@ static void init(struct fmt_main *self)
 	crypt_key = mem_calloc_tiny(sizeof(*crypt_key) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	opad = mem_calloc_tiny(sizeof(*opad) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	ipad = mem_calloc_tiny(sizeof(*opad) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	ipad_ctx = mem_calloc_tiny(sizeof(*ipad_ctx) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	opad_ctx = mem_calloc_tiny(sizeof(*opad_ctx) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 }
 
 
@@ -130,6 +136,8 @@ static void set_key(char *key, int index)
 	int i;
 
 	len = strlen(key);
+	if (precomputed > index)
+		precomputed = index;
 	memcpy(saved_plain[index], key, len);
 	saved_plain[index][len] = 0;
 
@@ -186,10 +194,34 @@ static int cmp_one(void *binary, int index)
 	return !memcmp(binary, crypt_key[index], BINARY_SIZE);
 }
 
+/*
+ * The first block of either hash is a pad, which only depends on the key.
+ * Hash it once per key rather than for every salt.
+ */
+static void precompute(int count)
+{
+	int index;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = precomputed; index < count; index++) {
+		SHA256_Init( &ipad_ctx[index] );
+		SHA256_Update( &ipad_ctx[index], ipad[index], PAD_SIZE );
+		SHA256_Init( &opad_ctx[index] );
+		SHA256_Update( &opad_ctx[index], opad[index], PAD_SIZE );
+	}
+	if (count > precomputed)
+		precomputed = count;
+}
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
 	int index = 0;
+
+	precompute(count);
+
 #ifdef _OPENMP
 #pragma omp parallel for
 	for (index = 0; index < count; index++)
@@ -197,13 +229,11 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 	{
 		SHA256_CTX ctx;
 
-		SHA256_Init( &ctx );
-		SHA256_Update( &ctx, ipad[index], PAD_SIZE );
+		memcpy(&ctx, &ipad_ctx[index], sizeof(ctx));
 		SHA256_Update( &ctx, cursalt, strlen( (char*) cursalt) );
 		SHA256_Final( (unsigned char*) crypt_key[index], &ctx);
 
-		SHA256_Init( &ctx );
-		SHA256_Update( &ctx, opad[index], PAD_SIZE );
+		memcpy(&ctx, &opad_ctx[index], sizeof(ctx));
 		SHA256_Update( &ctx, crypt_key[index], BINARY_SIZE);
 		SHA256_Final( (unsigned char*) crypt_key[index], &ctx);
 	}
@@ -296,7 +326,8 @@ struct fmt_main fmt_hmacSHA256 = {
 		},
 		cmp_all,
 		cmp_one,
-		cmp_exact
+		cmp_exact,
+		precompute
 	}
 };
 
@@ -6,6 +6,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
@@ -30,6 +31,9 @@
 #include "options.h"
 #include "unicode.h"
 #include "mask.h"
+#ifdef HAVE_MPI
+#include "john-mpi.h"
+#endif
 #include "memdbg.h"
 
 extern struct fmt_main fmt_LM;
@@ -68,13 +72,42 @@ static int counts[CHARSET_LENGTH][CHARSET_LENGTH];
 static unsigned int real_count, real_minc, real_min, real_max, real_size;
 static unsigned char real_chars[CHARSET_SIZE];
 
+/*
+ * With MPI, entries may be handed out by node 1 as nodes ask for them instead
+ * of being split statically.  "owned" lists the entries we've been handed
+ * that are past the one recorded in rec_entry, in ascending order; as these
+ * aren't known to anyone else, they're saved along with our state (compat
+ * value 3 rather than 2).
+ */
+static int dispense, rec_dispense, restored;
+static int *owned, owned_count, owned_size;
+static int chunk;
+
+static void add_owned(int item)
+{
+	if (owned_count == owned_size) {
+		owned_size = owned_size ? owned_size * 2 : 16;
+		owned = realloc(owned, owned_size * sizeof(*owned));
+		if (!owned)
+			pexit("realloc");
+	}
+	owned[owned_count++] = item;
+}
+
 static void save_state(FILE *file)
 {
 	unsigned int pos;
+	int i;
 
-	fprintf(file, "%u\n2\n%u\n", rec_entry, rec_length + 1);
+	fprintf(file, "%u\n%d\n%u\n", rec_entry, dispense ? 3 : 2,
+	    rec_length + 1);
 	for (pos = 0; pos <= rec_length; pos++)
 		fprintf(file, "%u\n", (unsigned int)rec_numbers[pos]);
+	if (dispense) {
+		fprintf(file, "%d\n", owned_count);
+		for (i = 0; i < owned_count; i++)
+			fprintf(file, "%d\n", owned[i]);
+	}
 }
 
 static int restore_state(FILE *file)
@@ -87,7 +120,7 @@ static int restore_state(FILE *file)
 	if (fscanf(file, "%u\n%u\n%u\n", &rec_entry, &compat, &rec_length) != 3)
 		return 1;
 	rec_length--; /* zero-based */
-	if (compat != 2 || rec_length >= CHARSET_LENGTH)
+	if ((compat != 2 && compat != 3) || rec_length >= CHARSET_LENGTH)
 		return 1;
 	for (pos = 0; pos <= rec_length; pos++) {
 		unsigned int number;
@@ -98,6 +131,22 @@ static int restore_state(FILE *file)
 		rec_numbers[pos] = number;
 	}
 
+	restored = 1;
+	rec_dispense = (compat == 3);
+	if (rec_dispense) {
+		int count, item;
+
+		if (fscanf(file, "%d\n", &count) != 1 || count < 0)
+			return 1;
+		while (count--) {
+			if (fscanf(file, "%d\n", &item) != 1 ||
+			    item <= (int)rec_entry ||
+			    (owned_count && item <= owned[owned_count - 1]))
+				return 1;
+			add_owned(item);
+		}
+	}
+
 	return 0;
 }
 
@@ -106,8 +155,37 @@ static void fix_state(void)
 	rec_entry = entry;
 	rec_length = length;
 	memcpy(rec_numbers, numbers, length);
+
+	if (owned_count && owned[0] <= (int)entry) {
+		int i = 0, j = 0;
+
+		while (i < owned_count && owned[i] <= (int)entry)
+			i++;
+		while (i < owned_count)
+			owned[j++] = owned[i++];
+		owned_count = j;
+	}
 }
 
+#ifdef HAVE_MPI
+/*
+ * Returns the first entry at or after "item" that is ours, asking node 1 for
+ * another one if needed.
+ */
+static int next_owned(int item)
+{
+	int i;
+
+	for (i = 0; i < owned_count; i++)
+		if (owned[i] >= item)
+			return owned[i];
+
+	item = mpi_dispenser_next();
+	add_owned(item);
+	return item;
+}
+#endif
+
 static void inc_format_error(char *charset)
 {
 	log_event("! Incorrect charset file format: %.100s", charset);
@@ -657,6 +735,7 @@ void do_incremental_crack(struct db_main *db, char *mode)
 
 	rec_entry = 0;
 	memset(rec_numbers, 0, sizeof(rec_numbers));
+	restored = rec_dispense = owned_count = 0;
 
 	status_init(get_progress, 0);
 
@@ -697,6 +776,39 @@ void do_incremental_crack(struct db_main *db, char *mode)
 
 	memcpy(numbers, rec_numbers, sizeof(numbers));
 
+	dispense = 0;
+	chunk = -1;
+#ifdef HAVE_MPI
+	if (restored ? rec_dispense :
+	    (mpi_p > 1 && options.node_count == (unsigned int)mpi_p &&
+	    cfg_get_bool(SECTION_OPTIONS, SUBSECTION_MPI,
+	    "MPIDynamicIncremental", 1))) {
+		int start = 0;
+
+/*
+ * Whatever anyone had been handed before is either done or listed in their
+ * session file, so carry on past the highest such entry.
+ */
+		if (restored) {
+			chunk = rec_entry;
+			start = (owned_count ? owned[owned_count - 1] :
+			    (int)rec_entry) + 1;
+		}
+		dispense = mpi_dispenser_init(start);
+	}
+#endif
+	if (rec_dispense && !dispense) {
+		log_event("! Session needs MPI dynamic work distribution");
+		if (john_main_process)
+			fprintf(stderr, "This session was started with "
+			    "entries handed out by MPI node 1 and can only be "
+			    "resumed with\nmpirun using the same number of "
+			    "processes\n");
+		error();
+	}
+	if (dispense)
+		log_event("- Entries handed out dynamically by node 1");
+
 	crk_init(db, fix_state, NULL);
 
 	last_count = last_length = -1;
@@ -704,6 +816,13 @@ void do_incremental_crack(struct db_main *db, char *mode)
 	entry--;
 	while (ptr < &header->order[sizeof(header->order) - 1]) {
 		int skip = 0;
+#ifdef HAVE_MPI
+		if (dispense) {
+			if ((int)(entry + 1) > chunk)
+				chunk = next_owned(entry + 1);
+			skip = (int)(entry + 1) != chunk;
+		} else
+#endif
 		if (options.node_count) {
 			int for_node = entry % options.node_count + 1;
 			skip = for_node < options.node_min ||
@@ -796,6 +915,8 @@ void do_incremental_crack(struct db_main *db, char *mode)
 		MEM_FREE(chars[pos]);
 	MEM_FREE(char2);
 	MEM_FREE(header);
+	MEM_FREE(owned);
+	owned_count = owned_size = 0;
 
 	fclose(file);
 }
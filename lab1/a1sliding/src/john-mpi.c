@@ -20,6 +20,107 @@ int mpi_p, mpi_id;
 char mpi_name[MPI_MAX_PROCESSOR_NAME + 1];
 MPI_Request **mpi_req;
 
+/* Messages sent by mpi_send_all() that may not have been delivered yet */
+struct mpi_msg {
+	struct mpi_msg *next;
+	int count;
+	MPI_Request *req;
+	char data[1];
+};
+
+static struct mpi_msg *mpi_outbox;
+
+#if MPI_VERSION >= 3
+static MPI_Win mpi_win = MPI_WIN_NULL;
+static int *mpi_counter;
+#endif
+
+/* Frees the messages that have been delivered */
+static void mpi_flush_outbox(void)
+{
+	struct mpi_msg **current = &mpi_outbox;
+
+	while (*current) {
+		struct mpi_msg *msg = *current;
+		int done;
+
+		MPI_Testall(msg->count, msg->req, &done, MPI_STATUSES_IGNORE);
+		if (!done) {
+			current = &msg->next;
+			continue;
+		}
+
+		*current = msg->next;
+		MEM_FREE(msg->req);
+		MEM_FREE(msg);
+	}
+}
+
+void mpi_send_all(int tag, const void *data, int len)
+{
+	struct mpi_msg *msg;
+	int i;
+
+	if (mpi_p < 2)
+		return;
+
+	mpi_flush_outbox();
+
+	msg = mem_alloc(sizeof(*msg) + len);
+	msg->req = mem_alloc(sizeof(MPI_Request) * (mpi_p - 1));
+	msg->count = 0;
+	memcpy(msg->data, data, len);
+
+	for (i = 0; i < mpi_p; i++) {
+		if (i == mpi_id)
+			continue;
+		MPI_Isend(msg->data, len, MPI_CHAR, i, tag, MPI_COMM_WORLD,
+		          &msg->req[msg->count++]);
+	}
+
+	msg->next = mpi_outbox;
+	mpi_outbox = msg;
+}
+
+int mpi_dispenser_init(int start)
+{
+#if MPI_VERSION >= 3
+	if (mpi_p < 2 || mpi_win != MPI_WIN_NULL)
+		return 0;
+
+	MPI_Win_allocate(mpi_id ? 0 : sizeof(int), sizeof(int), MPI_INFO_NULL,
+	                 MPI_COMM_WORLD, &mpi_counter, &mpi_win);
+	if (!mpi_id)
+		*mpi_counter = 0;
+	MPI_Allreduce(MPI_IN_PLACE, &start, 1, MPI_INT, MPI_MAX,
+	              MPI_COMM_WORLD);
+	if (!mpi_id && start > 0)
+		*mpi_counter = start;
+
+	/* Nobody may fetch before node 1 has set the counter */
+	MPI_Barrier(MPI_COMM_WORLD);
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, mpi_win);
+
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+int mpi_dispenser_next(void)
+{
+#if MPI_VERSION >= 3
+	int one = 1, item;
+
+	MPI_Fetch_and_op(&one, &item, MPI_INT, 0, 0, MPI_SUM, mpi_win);
+	MPI_Win_flush(0, mpi_win);
+
+	return item;
+#else
+	return -1;
+#endif
+}
+
 void mpi_teardown(void)
 {
 	static int finalized = 0;
@@ -28,6 +129,12 @@ void mpi_teardown(void)
 		return;
 
 	if (mpi_p > 1) {
+#if MPI_VERSION >= 3
+		if (mpi_win != MPI_WIN_NULL) {
+			MPI_Win_unlock_all(mpi_win);
+			MPI_Win_free(&mpi_win);
+		}
+#endif
 		/* Some MPI platforms hang on 100% CPU while waiting */
 		if (nice(20) == -1)
 			perror("nice");
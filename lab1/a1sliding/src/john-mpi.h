@@ -4,6 +4,7 @@
 #include <mpi.h>
 
 #define JOHN_MPI_RELOAD	1
+#define JOHN_MPI_CRACKED	2
 
 extern int mpi_p, mpi_id;
 extern char mpi_name[MPI_MAX_PROCESSOR_NAME + 1];
@@ -15,4 +16,23 @@ extern void mpi_teardown(void);
 /* MPI initialization stuff, registers atexit() as well */
 extern void mpi_setup(int argc, char **argv);
 
+/*
+ * Sends "len" bytes of "data" to all other nodes, tagged "tag", without
+ * waiting for them to be received.  The data is copied, so the caller may
+ * reuse its buffer right away.
+ */
+extern void mpi_send_all(int tag, const void *data, int len);
+
+/*
+ * Work dispenser: a counter kept by node 1 (rank 0) that hands out work item
+ * numbers in increasing order, each to the first node that asks for it.
+ * Initialization is collective; the counter starts at the highest "start"
+ * given by any node.  Returns 0 if the MPI library lacks the (MPI-3) one-sided
+ * atomics this needs, in which case the caller should split work statically.
+ */
+extern int mpi_dispenser_init(int start);
+
+/* Returns the next work item number for this node */
+extern int mpi_dispenser_next(void);
+
 #endif
@@ -47,6 +47,10 @@
 #endif
 #include <stdlib.h>
 #include <sys/stat.h>
+#if HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#include <time.h>
 #if OS_FORK
 #include <sys/wait.h>
 #include <signal.h>
@@ -70,6 +74,8 @@ static int john_omp_threads_new;
 #include "signals.h"
 #include "common.h"
 #include "idle.h"
+#include "affinity.h"
+#include "coord.h"
 #include "formats.h"
 #include "dyna_salt.h"
 #include "loader.h"
@@ -103,6 +109,7 @@ static int john_omp_threads_new;
 #if HAVE_CUDA
 #include "cuda_common.h"
 #endif
+#include "sse-dispatch.h"
 #ifdef NO_JOHN_BLD
 #define JOHN_BLD "unk-build-type"
 #else
@@ -173,6 +180,8 @@ int john_child_count = 0;
 int *john_child_pids = NULL;
 #endif
 static int children_ok = 1;
+static int john_process_index;
+static int john_affinity = AFFINITY_NONE;
 
 static struct db_main database;
 static struct fmt_main dummy_format;
@@ -254,10 +263,56 @@ static void john_register_one(struct fmt_main *format)
 	fmt_register(format);
 }
 
+/*
+ * Startup time spent in each stage, for --verbosity=5.
+ */
+static double john_time_start, john_time_config, john_time_dynamic;
+static double john_time_register, john_time_load;
+static int john_dynamic_count;
+
+static double john_time(void)
+{
+#if HAVE_GETTIMEOFDAY
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+ * Returns non-zero if the dynamic formats may be used in this run.  Building
+ * them takes most of the startup time, and with --stdout or a --format that
+ * can't select any of them they would only be thrown away.  A thin format's
+ * dynamic format is then loaded on its own when the thin format links to it.
+ */
+static int john_dynamic_wanted(void)
+{
+	if ((options.flags & FLG_STDOUT) && !(options.flags & FLG_PASSWD))
+		return 0;
+
+	if (!options.format || strchr(options.format, '*'))
+		return 1;
+
+	if (!strncmp(options.format, "dynamic", 7) ||
+	    !strcmp(options.format, "cpu"))
+		return 1;
+#ifdef _OPENMP
+	if (!strcmp(options.format, "omp") ||
+	    !strcmp(options.format, "cpu+omp"))
+		return 1;
+#endif
+
+	return 0;
+}
+
 static void john_register_all(void)
 {
 	int i, cnt;
 	struct fmt_main *selfs;
+	double start;
 
 	if (options.format) strlwr(options.format);
 
@@ -265,7 +320,12 @@ static void john_register_all(void)
 	// to dynamic.
 	// Since gen(27) and gen(28) are MD5 and MD5a formats, we build the
 	// generic format first
-	cnt = dynamic_Register_formats(&selfs);
+	start = john_time();
+	cnt = 0;
+	if (john_dynamic_wanted())
+		cnt = dynamic_Register_formats(&selfs);
+	john_time_dynamic = john_time() - start;
+	john_dynamic_count = cnt;
 
 	john_register_one(&fmt_DES);
 	john_register_one(&fmt_BSDI);
@@ -303,6 +363,8 @@ static void john_register_all(void)
 		fprintf(stderr, "Unknown ciphertext format name requested\n");
 		error();
 	}
+
+	john_time_register = john_time() - start - john_time_dynamic;
 }
 
 static void john_log_format(void)
@@ -509,6 +571,7 @@ static void john_fork(void)
 
 		case 0:
 			sig_preinit();
+			john_process_index = i;
 			options.node_min += i;
 			options.node_max = options.node_min;
 #if HAVE_OPENCL
@@ -765,6 +828,17 @@ static void john_load_conf(void)
 		options.flags |= FLG_SCALAR;
 #endif
 
+	if (!options.affinity)
+		options.affinity =
+			cfg_get_param(SECTION_OPTIONS, NULL, "CPUAffinity");
+	if (options.affinity &&
+	    (john_affinity = affinity_parse(options.affinity)) < 0) {
+		if (john_main_process)
+			fprintf(stderr, "Invalid CPU affinity mode: %s "
+			        "(use none, core or node)\n", options.affinity);
+		error();
+	}
+
 	options.loader.log_passwords = options.secure ||
 		cfg_get_bool(SECTION_OPTIONS, NULL, "LogCrackedPasswords", 0);
 
@@ -1136,6 +1210,17 @@ static void john_load(void)
 #endif
 #endif
 	}
+
+#if OS_FORK
+	if (options.flags & FLG_WORKER) {
+		/*
+		 * Each work unit is cracked by a child process that returns
+		 * from here with the node numbers set for that unit.
+		 */
+		log_flush();
+		coord_worker(options.worker);
+	}
+#endif
 }
 
 #if CPU_DETECT
@@ -1165,6 +1250,54 @@ static void CPU_detect_or_fallback(char **argv, int make_check)
 #define CPU_detect_or_fallback(argv, make_check)
 #endif
 
+/*
+ * Pins this process and its threads to CPUs as requested with --affinity or
+ * the CPUAffinity setting.  This is done after any --fork, so buffers that
+ * are first touched from here on end up on the local NUMA node; the bitmaps
+ * and hash tables built before the split are rebuilt for the same reason.
+ */
+static void john_set_affinity(void)
+{
+	int index = john_process_index, count = 1, threads = 1;
+	char *desc, *error;
+
+	if (john_affinity == AFFINITY_NONE)
+		return;
+
+#if OS_FORK
+	if (options.fork)
+		count = options.fork;
+#endif
+#if HAVE_MPI
+	if (mpi_p > 1) {
+		char *rank = getenv("OMPI_COMM_WORLD_LOCAL_RANK");
+		char *size = getenv("OMPI_COMM_WORLD_LOCAL_SIZE");
+
+		if (!rank || !size) {
+			rank = getenv("MPI_LOCALRANKID");
+			size = getenv("MPI_LOCALNRANKS");
+		}
+		index = (rank && size) ? atoi(rank) : mpi_id;
+		count = (rank && size) ? atoi(size) : mpi_p;
+	}
+#endif
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	if ((desc = affinity_init(john_affinity, index, count, threads,
+	    &error))) {
+		log_event("- CPU affinity: %s", desc);
+		if (count > 1 && database.loaded)
+			ldr_rebuild_hash(&database);
+	} else if (error) {
+		log_event("- CPU affinity not set: %s", error);
+		if (john_main_process)
+			fprintf(stderr, "Warning: CPU affinity not set: %s\n",
+			        error);
+	}
+}
+
 static void john_init(char *name, int argc, char **argv)
 {
 	int show_usage = 0;
@@ -1172,7 +1305,12 @@ static void john_init(char *name, int argc, char **argv)
 	if (make_check)
 		argv[1] = "--test=0";
 
+	john_time_start = john_time();
+
 	CPU_detect_or_fallback(argv, make_check);
+#ifdef JOHN_FAT
+	SSE_dispatch_init();
+#endif
 
 #ifdef _OPENMP
 	john_omp_init();
@@ -1226,6 +1364,8 @@ static void john_init(char *name, int argc, char **argv)
 #if HAVE_OPENCL || HAVE_CUDA
 	gpu_device_list[0] = gpu_device_list[1] = -1;
 #endif
+	john_time_config = john_time() - john_time_start;
+
 	/* Process configuration options that depend on cfg_init() */
 	john_load_conf();
 
@@ -1237,8 +1377,23 @@ static void john_init(char *name, int argc, char **argv)
 	common_init();
 	sig_init();
 
+	if (john_main_process && options.verbosity > 4)
+		fprintf(stderr, "Startup: %.3fs options and config, %.3fs "
+		    "building %d dynamic formats, %.3fs registering formats\n",
+		    john_time_config, john_time_dynamic, john_dynamic_count,
+		    john_time_register);
+
+	john_time_load = john_time();
 	john_load();
 
+	if (john_main_process && options.verbosity > 4)
+		fprintf(stderr, "Startup: %.3fs loading, %.3fs in total\n",
+		    john_time() - john_time_load,
+		    john_time() - john_time_start);
+
+	if (options.flags & (FLG_CRACKING_CHK | FLG_TEST_CHK))
+		john_set_affinity();
+
 	/* Init the Unicode system */
 	if (pers_opts.internal_enc) {
 		if (pers_opts.internal_enc != pers_opts.input_enc &&
@@ -1278,12 +1433,20 @@ static void john_run(void)
 {
 	struct stat trigger_stat;
 
-	if (options.flags & FLG_TEST_CHK)
+	if (options.flags & FLG_TEST_CHK) {
+#ifdef JOHN_FAT
+		if (john_main_process)
+			fprintf(stderr, "Using %s SIMD code (chosen at run "
+			    "time)\n", SSE_type_runtime);
+#endif
 		exit_status = benchmark_all() ? 1 : 0;
-	else
+	} else
 	if (options.flags & FLG_MAKECHR_CHK)
 		do_makechars(&database, options.charset);
 	else
+	if (options.flags & FLG_COORD_CHK)
+		coord_server(options.coordinator);
+	else
 	if (options.flags & FLG_CRACKING_CHK) {
 		int remaining = database.password_count;
 
@@ -1383,6 +1546,9 @@ static void john_run(void)
 
 		status_print();
 
+		if (options.flags & FLG_WORKER)
+			coord_unit_done();
+
 #if OS_FORK
 		if (options.fork && john_main_process)
 			john_wait();
@@ -33,6 +33,25 @@ john_register_one(&fmt_KeePass);
 #include <omp.h>
 #define OMP_SCALE               1
 #endif
+
+/*
+ * The key transform is AES-256 in ECB mode, the same key (the transform
+ * seed) for all candidates.  With AES-NI, the blocks of several candidates
+ * go through the rounds together, so that each AESENC doesn't wait for the
+ * one before it.  The check for AES-NI is done at run time, older CPUs use
+ * the AES code that was there before.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || \
+    (defined(__i386__) && defined(__SSE2__))) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__AES__))
+#define KEEPASS_AESNI		1
+#include <cpuid.h>
+#include <wmmintrin.h>
+#define AESNI_TARGET		__attribute__((target("aes")))
+/* Candidates per group, two blocks each: 16 blocks fill the XMM registers */
+#define AESNI_KEYS		8
+#define ALGORITHM_NAME_AESNI	"SHA256 AES 128/128 AES-NI 8x " SHA2_LIB
+#endif
 #include "memdbg.h"
 
 #define FORMAT_LABEL		"KeePass"
@@ -47,7 +66,11 @@ john_register_one(&fmt_KeePass);
 // salt align of 4 was crashing on sparc.  Probably due to the long long value.
 #define SALT_ALIGN		sizeof(long long)
 #define MIN_KEYS_PER_CRYPT	1
+#ifdef KEEPASS_AESNI
+#define MAX_KEYS_PER_CRYPT	AESNI_KEYS
+#else
 #define MAX_KEYS_PER_CRYPT	1
+#endif
 
 static struct fmt_tests KeePass_tests[] = {
 	{"$keepass$*1*50000*124*60eed105dac456cfc37d89d950ca846e*72ffef7c0bc3698b8eca65184774f6cd91a9356d338e5140e47e319a87f5e46a*8725bdfd3580cf054a1564dc724aaffe*8e58cc08af2462ddffe2ee39735ad14b15e8cb96dc05ef70d8e64d475eca7bf5*1*752*71d7e65fb3e20b288da8cd582b5c2bc3b63162eef6894e5e92eea73f711fe86e7a7285d5ac9d5ffd07798b83673b06f34180b7f5f3d05222ebf909c67e6580c646bcb64ad039fcdc6f33178fe475739a562dc78012f6be3104da9af69e0e12c2c9c5cd7134bb99d5278f2738a40155acbe941ff2f88db18daf772c7b5fc1855ff9e93ceb35a1db2c30cabe97a96c58b07c16912b2e095e530cc8c24041e7d4876b842f2e7c6df41d08da8c5c4f2402dd3241c3367b6e6e06cd0fa369934e78a6aab1479756a15264af09e3c8e1037f07a58f70f4bf634737ff58725414db10d7b2f61a7ed69878bc0de8bb99f3795bf9980d87992848cd9b9abe0fa6205a117ab1dd5165cf11ffa10b765e8723251ea0907bbc5f3eef8cf1f08bb89e193842b40c95922f38c44d0c3197033a5c7c926a33687aa71c482c48381baa4a34a46b8a4f78715f42eccbc8df80ee3b43335d92bdeb3bb0667cf6da83a018e4c0cd5803004bf6c300b9bee029246d16bd817ff235fcc22bb8c729929499afbf90bf787e98479db5ff571d3d727059d34c1f14454ff5f0a1d2d025437c2d8db4a7be7b901c067b929a0028fe8bb74fa96cb84831ccd89138329708d12c76bd4f5f371e43d0a2d234e5db2b3d6d5164e773594ab201dc9498078b48d4303dd8a89bf81c76d1424084ebf8d96107cb2623fb1cb67617257a5c7c6e56a8614271256b9dd80c76b6d668de4ebe17574ad617f5b1133f45a6d8621e127fcc99d8e788c535da9f557d91903b4e388108f02e9539a681d42e61f8e2f8b06654d4dec308690902a5c76f55b3d79b7c9a0ce994494bc60eff79ff41debc3f2684f40fc912f09035aae022148238ba6f5cfb92f54a5fb28cbb417ff01f39cc464e95929fba5e19be0251bef59879303063e6392c3a49032af3d03d5c9027868d5d6a187698dd75dfc295d2789a0e6cf391a380cc625b0a49f3084f45558ac273b0bbe62a8614db194983b2e207cef7deb1fa6a0bd39b0215d72bf646b599f187ee0009b7b458bb4930a1aea55222099446a0250a975447ff52", "openwall"},
@@ -83,14 +106,89 @@ static struct custom_salt {
 	int algorithm; // 1 for Twofish
 } *cur_salt;
 
-static void transform_key(char *masterkey, struct custom_salt *csp, unsigned char *final_key)
+/* The transform seed's key schedule, set up once per salt */
+static AES_KEY transf_akey;
+#ifdef KEEPASS_AESNI
+static __m128i transf_aesni[15];
+/* Whether the CPU has AES-NI */
+static int aesni_on;
+
+static int cpu_aesni(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & 0x2000000);
+}
+
+/* One step of the AES-256 key expansion, from Intel's AES-NI white paper */
+#define AESNI_EXPAND(t, u, assist) \
+	u = assist; \
+	t = _mm_xor_si128(t, _mm_slli_si128(t, 4)); \
+	t = _mm_xor_si128(t, _mm_slli_si128(t, 4)); \
+	t = _mm_xor_si128(t, _mm_slli_si128(t, 4)); \
+	t = _mm_xor_si128(t, u);
+
+static AESNI_TARGET void aesni_set_key(unsigned char *key, __m128i *ks)
+{
+	__m128i t1 = _mm_loadu_si128((__m128i *)key);
+	__m128i t3 = _mm_loadu_si128((__m128i *)(key + 16));
+	__m128i t2;
+
+	ks[0] = t1;
+	ks[1] = t3;
+#define AESNI_EXPAND2(i, rcon) \
+	AESNI_EXPAND(t1, t2, _mm_shuffle_epi32( \
+		_mm_aeskeygenassist_si128(t3, rcon), 0xff)); \
+	ks[i] = t1; \
+	if (i < 14) { \
+		AESNI_EXPAND(t3, t2, _mm_shuffle_epi32( \
+			_mm_aeskeygenassist_si128(t1, 0), 0xaa)); \
+		ks[i + 1] = t3; \
+	}
+	AESNI_EXPAND2(2, 0x01);
+	AESNI_EXPAND2(4, 0x02);
+	AESNI_EXPAND2(6, 0x04);
+	AESNI_EXPAND2(8, 0x08);
+	AESNI_EXPAND2(10, 0x10);
+	AESNI_EXPAND2(12, 0x20);
+	AESNI_EXPAND2(14, 0x40);
+#undef AESNI_EXPAND2
+}
+
+/*
+ * Encrypts both halves of AESNI_KEYS hashes rounds times, all of their
+ * 2 * AESNI_KEYS blocks interleaved.
+ */
+static AESNI_TARGET void transform_aesni(unsigned char (*hash)[32],
+	uint32_t rounds)
+{
+	__m128i b[2 * AESNI_KEYS];
+	int i, r;
+
+	for (i = 0; i < 2 * AESNI_KEYS; i++)
+		b[i] = _mm_loadu_si128((__m128i *)&hash[i >> 1][(i & 1) * 16]);
+
+	while (rounds--) {
+		for (i = 0; i < 2 * AESNI_KEYS; i++)
+			b[i] = _mm_xor_si128(b[i], transf_aesni[0]);
+		for (r = 1; r < 14; r++)
+			for (i = 0; i < 2 * AESNI_KEYS; i++)
+				b[i] = _mm_aesenc_si128(b[i], transf_aesni[r]);
+		for (i = 0; i < 2 * AESNI_KEYS; i++)
+			b[i] = _mm_aesenclast_si128(b[i], transf_aesni[14]);
+	}
+
+	for (i = 0; i < 2 * AESNI_KEYS; i++)
+		_mm_storeu_si128((__m128i *)&hash[i >> 1][(i & 1) * 16], b[i]);
+}
+#endif
+
+/* Hashes the masterkey (and keyfile) into the key to transform */
+static void transform_key_pre(char *masterkey, struct custom_salt *csp, unsigned char *hash)
 {
-        // First, hash the masterkey
 	SHA256_CTX ctx;
-	unsigned char hash[32];
 	unsigned char temphash[32];
-	int i;
-	AES_KEY akey;
+
 	SHA256_Init(&ctx);
 	SHA256_Update(&ctx, masterkey, strlen(masterkey));
 	SHA256_Final(hash, &ctx);
@@ -99,10 +197,6 @@ static void transform_key(char *masterkey, struct custom_salt *csp, unsigned cha
 		SHA256_Update(&ctx, hash, 32);
 		SHA256_Final(hash, &ctx);
 	}
-	memset(&akey, 0, sizeof(AES_KEY));
-	if(AES_set_encrypt_key(csp->transf_randomseed, 256, &akey) < 0) {
-		fprintf(stderr, "AES_set_encrypt_key failed!\n");
-	}
 	/* keyfile handling (only tested for KeePass 1.x files) */
 	if (cur_salt->have_keyfile) {
 		SHA256_CTX composite_ctx;  // for keyfile handling
@@ -124,24 +218,44 @@ static void transform_key(char *masterkey, struct custom_salt *csp, unsigned cha
 		SHA256_Update(&composite_ctx, temphash, 32);
 		SHA256_Final(hash, &composite_ctx);
 	}
+}
+
+/* Encrypts the created hashes, count of them */
+static void transform_key_rounds(unsigned char (*hash)[32], int count, struct custom_salt *csp)
+{
+	int i, index;
 
-        // Next, encrypt the created hash
-	i = csp->key_transf_rounds >> 2;
-	while (i--) {
-		AES_encrypt(hash, hash, &akey);
-		AES_encrypt(hash, hash, &akey);
-		AES_encrypt(hash, hash, &akey);
-		AES_encrypt(hash, hash, &akey);
-		AES_encrypt(hash+16, hash+16, &akey);
-		AES_encrypt(hash+16, hash+16, &akey);
-		AES_encrypt(hash+16, hash+16, &akey);
-		AES_encrypt(hash+16, hash+16, &akey);
+#ifdef KEEPASS_AESNI
+	if (aesni_on) {
+		transform_aesni(hash, csp->key_transf_rounds);
+		return;
 	}
-	i = csp->key_transf_rounds & 3;
-	while (i--) {
-		AES_encrypt(hash, hash, &akey);
-		AES_encrypt(hash+16, hash+16, &akey);
+#endif
+	for (index = 0; index < count; index++) {
+		i = csp->key_transf_rounds >> 2;
+		while (i--) {
+			AES_encrypt(hash[index], hash[index], &transf_akey);
+			AES_encrypt(hash[index], hash[index], &transf_akey);
+			AES_encrypt(hash[index], hash[index], &transf_akey);
+			AES_encrypt(hash[index], hash[index], &transf_akey);
+			AES_encrypt(hash[index]+16, hash[index]+16, &transf_akey);
+			AES_encrypt(hash[index]+16, hash[index]+16, &transf_akey);
+			AES_encrypt(hash[index]+16, hash[index]+16, &transf_akey);
+			AES_encrypt(hash[index]+16, hash[index]+16, &transf_akey);
+		}
+		i = csp->key_transf_rounds & 3;
+		while (i--) {
+			AES_encrypt(hash[index], hash[index], &transf_akey);
+			AES_encrypt(hash[index]+16, hash[index]+16, &transf_akey);
+		}
 	}
+}
+
+/* Hashes the transformed key into the final one */
+static void transform_key_post(unsigned char *hash, struct custom_salt *csp, unsigned char *final_key)
+{
+	SHA256_CTX ctx;
+
         // Finally, hash it again...
 	SHA256_Init(&ctx);
 	SHA256_Update(&ctx, hash, 32);
@@ -175,6 +289,10 @@ static void init(struct fmt_main *self)
 	cracked = mem_calloc_tiny(cracked_size, MEM_ALIGN_WORD);
 
 	Twofish_initialise();
+#ifdef KEEPASS_AESNI
+	if ((aesni_on = cpu_aesni()))
+		self->params.algorithm_name = ALGORITHM_NAME_AESNI;
+#endif
 }
 
 static int ishex(char *q)
@@ -379,52 +497,76 @@ static void *get_salt(char *ciphertext)
 static void set_salt(void *salt)
 {
 	cur_salt = (struct custom_salt *)salt;
+
+	memset(&transf_akey, 0, sizeof(AES_KEY));
+	if(AES_set_encrypt_key(cur_salt->transf_randomseed, 256, &transf_akey) < 0) {
+		fprintf(stderr, "AES_set_encrypt_key failed!\n");
+	}
+#ifdef KEEPASS_AESNI
+	if (aesni_on)
+		aesni_set_key(cur_salt->transf_randomseed, transf_aesni);
+#endif
 }
 
-static int crypt_all(int *pcount, struct db_salt *salt)
+/* Checks the transformed key of index against the database */
+static void check_key(int index, unsigned char *hash)
 {
-	int count = *pcount;
-	int index = 0;
-
-	if (any_cracked) {
-		memset(cracked, 0, cracked_size);
-		any_cracked = 0;
+	unsigned char final_key[32];
+	unsigned char decrypted_content[LINE_BUFFER_SIZE];
+	SHA256_CTX ctx;
+	unsigned char iv[16];
+	unsigned char out[32];
+	int pad_byte;
+	int datasize;
+	AES_KEY akey;
+	Twofish_key tkey;
+
+	// derive and set decryption key
+	transform_key_post(hash, cur_salt, final_key);
+	if (cur_salt->algorithm == 0) {
+		/* AES decrypt cur_salt->contents with final_key */
+		memcpy(iv, cur_salt->enc_iv, 16);
+		memset(&akey, 0, sizeof(AES_KEY));
+		if(AES_set_decrypt_key(final_key, 256, &akey) < 0) {
+			fprintf(stderr, "AES_set_decrypt_key failed in crypt!\n");
+		}
+	} else if (cur_salt->algorithm == 1) {
+		memcpy(iv, cur_salt->enc_iv, 16);
+		memset(&tkey, 0, sizeof(Twofish_key));
+		Twofish_prepare_key(final_key, 32, &tkey);
 	}
 
+	if (cur_salt->version == 1 && cur_salt->algorithm == 0) {
+		AES_cbc_encrypt(cur_salt->contents, decrypted_content, cur_salt->contentsize, &akey, iv, AES_DECRYPT);
+		pad_byte = decrypted_content[cur_salt->contentsize-1];
+		datasize = cur_salt->contentsize - pad_byte;
+		SHA256_Init(&ctx);
+		SHA256_Update(&ctx, decrypted_content, datasize);
+		SHA256_Final(out, &ctx);
+		if(!memcmp(out, cur_salt->contents_hash, 32)) {
+			cracked[index] = 1;
 #ifdef _OPENMP
-#pragma omp parallel for
-	for (index = 0; index < count; index++)
+#pragma omp atomic
 #endif
-	{
-		unsigned char final_key[32];
-		unsigned char decrypted_content[LINE_BUFFER_SIZE];
-		SHA256_CTX ctx;
-		unsigned char iv[16];
-		unsigned char out[32];
-		int pad_byte;
-		int datasize;
-		AES_KEY akey;
-		Twofish_key tkey;
-
-		// derive and set decryption key
-		transform_key(saved_key[index], cur_salt, final_key);
-		if (cur_salt->algorithm == 0) {
-			/* AES decrypt cur_salt->contents with final_key */
-			memcpy(iv, cur_salt->enc_iv, 16);
-			memset(&akey, 0, sizeof(AES_KEY));
-			if(AES_set_decrypt_key(final_key, 256, &akey) < 0) {
-				fprintf(stderr, "AES_set_decrypt_key failed in crypt!\n");
-			}
-		} else if (cur_salt->algorithm == 1) {
-			memcpy(iv, cur_salt->enc_iv, 16);
-			memset(&tkey, 0, sizeof(Twofish_key));
-			Twofish_prepare_key(final_key, 32, &tkey);
+			any_cracked |= 1;
+		}
+	}
+	else if (cur_salt->version == 2 && cur_salt->algorithm == 0) {
+		AES_cbc_encrypt(cur_salt->contents, decrypted_content, 32, &akey, iv, AES_DECRYPT);
+		if(!memcmp(decrypted_content, cur_salt->expected_bytes, 32)) {
+			cracked[index] = 1;
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+			any_cracked |= 1;
 		}
 
-		if (cur_salt->version == 1 && cur_salt->algorithm == 0) {
-			AES_cbc_encrypt(cur_salt->contents, decrypted_content, cur_salt->contentsize, &akey, iv, AES_DECRYPT);
-			pad_byte = decrypted_content[cur_salt->contentsize-1];
-			datasize = cur_salt->contentsize - pad_byte;
+	}
+	else if (cur_salt->version == 1 && cur_salt->algorithm == 1) { /* KeePass 1.x with Twofish */
+		int crypto_size;
+		crypto_size = Twofish_Decrypt(&tkey, cur_salt->contents, decrypted_content, cur_salt->contentsize, iv);
+		datasize = crypto_size;  // awesome, right?
+		if (datasize <= cur_salt->contentsize && datasize > 0) {
 			SHA256_Init(&ctx);
 			SHA256_Update(&ctx, decrypted_content, datasize);
 			SHA256_Final(out, &ctx);
@@ -436,36 +578,37 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 				any_cracked |= 1;
 			}
 		}
-		else if (cur_salt->version == 2 && cur_salt->algorithm == 0) {
-			AES_cbc_encrypt(cur_salt->contents, decrypted_content, 32, &akey, iv, AES_DECRYPT);
-			if(!memcmp(decrypted_content, cur_salt->expected_bytes, 32)) {
-				cracked[index] = 1;
-#ifdef _OPENMP
-#pragma omp atomic
-#endif
-				any_cracked |= 1;
-			}
+	} else {  // KeePass version 2 with Twofish is TODO
+		abort();
+	}
+}
+
+static int crypt_all(int *pcount, struct db_salt *salt)
+{
+	int count = *pcount;
+	int index = 0;
+
+	if (any_cracked) {
+		memset(cracked, 0, cracked_size);
+		any_cracked = 0;
+	}
 
-		}
-		else if (cur_salt->version == 1 && cur_salt->algorithm == 1) { /* KeePass 1.x with Twofish */
-			int crypto_size;
-			crypto_size = Twofish_Decrypt(&tkey, cur_salt->contents, decrypted_content, cur_salt->contentsize, iv);
-			datasize = crypto_size;  // awesome, right?
-			if (datasize <= cur_salt->contentsize && datasize > 0) {
-				SHA256_Init(&ctx);
-				SHA256_Update(&ctx, decrypted_content, datasize);
-				SHA256_Final(out, &ctx);
-				if(!memcmp(out, cur_salt->contents_hash, 32)) {
-					cracked[index] = 1;
 #ifdef _OPENMP
-#pragma omp atomic
+#pragma omp parallel for
 #endif
-					any_cracked |= 1;
-				}
-			}
-		} else {  // KeePass version 2 with Twofish is TODO
-			abort();
-		}
+	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
+	{
+		unsigned char hash[MAX_KEYS_PER_CRYPT][32];
+		int i, n = count - index;
+
+		if (n > MAX_KEYS_PER_CRYPT)
+			n = MAX_KEYS_PER_CRYPT;
+		memset(hash, 0, sizeof(hash));
+		for (i = 0; i < n; i++)
+			transform_key_pre(saved_key[index + i], cur_salt, hash[i]);
+		transform_key_rounds(hash, n, cur_salt);
+		for (i = 0; i < n; i++)
+			check_key(index + i, hash[i]);
 	}
 	return count;
 }
@@ -534,7 +677,7 @@ struct fmt_main fmt_KeePass = {
 		SALT_ALIGN,
 		MIN_KEYS_PER_CRYPT,
 		MAX_KEYS_PER_CRYPT,
-		FMT_CASE | FMT_8_BIT | FMT_OMP,
+		FMT_CASE | FMT_8_BIT | FMT_OMP | FMT_INIT_PARAMS,
 #if FMT_MAIN_VERSION > 11
 		{
 			"iteration count",
@@ -38,6 +38,7 @@
 #include "unicode.h"
 #include "dynamic.h"
 #include "config.h"
+#include "sse-dispatch.h"
 
 #if HAVE_LIBGMP
 #if HAVE_GMP_GMP_H
@@ -147,6 +148,9 @@ static void listconf_list_build_info(void)
 	puts("Build: " JOHN_BLD);
 	printf("Arch: %d-bit %s\n", ARCH_BITS,
 	       ARCH_LITTLE_ENDIAN ? "LE" : "BE");
+#ifdef JOHN_FAT
+	printf("SIMD: %s (fat build, chosen at run time)\n", SSE_type_runtime);
+#endif
 #if JOHN_SYSTEMWIDE
 	puts("System-wide exec: " JOHN_SYSTEMWIDE_EXEC);
 	puts("System-wide home: " JOHN_SYSTEMWIDE_HOME);
@@ -43,6 +43,8 @@
 #include "john.h"
 #include "cracker.h"
 #include "config.h"
+#include "potidx.h"
+#include "showjoin.h"
 #include "logger.h" /* Beware: log_init() happens after most functions here */
 #include "memdbg.h"
 
@@ -61,6 +63,7 @@ int ldr_in_pot = 0;
  */
 #define RF_ALLOW_MISSING		1
 #define RF_ALLOW_DIR			2
+#define RF_NO_WARN			4
 
 /*
  * Fast "Strlen" for fields[f]
@@ -69,6 +72,7 @@ int ldr_in_pot = 0;
 
 static char *no_username = "?";
 static int pristine_gecos;
+static int ldr_signatures;
 
 /* There should be legislation against adding a BOM to UTF-8 */
 static char *skip_bom(char *string)
@@ -86,7 +90,7 @@ static void read_file(struct db_main *db, char *name, int flags,
 	char line_buf[LINE_BUFFER_SIZE], *line;
 	int warn = cfg_get_bool(SECTION_OPTIONS, NULL, "WarnEncoding", 0);
 
-	if (!john_main_process)
+	if (!john_main_process || (flags & RF_NO_WARN))
 		warn = 0;
 
 	if (flags & RF_ALLOW_DIR) {
@@ -147,6 +151,9 @@ void ldr_init_database(struct db_main *db, struct db_options *options)
 {
 	db->loaded = 0;
 
+	ldr_signatures = cfg_get_bool(SECTION_OPTIONS, NULL,
+	    "FormatSignatures", 1);
+
 	db->options = mem_alloc_copy(options,
 	    sizeof(struct db_options), MEM_ALIGN_WORD);
 
@@ -324,6 +331,139 @@ static void ldr_set_encoding(struct fmt_main *format)
 	initUnicode(UNICODE_UNICODE);
 }
 
+/*
+ * Checks john.conf's list of disabled formats once per format, since this is
+ * needed for every line that auto-detection or the warnings look at.
+ */
+static int ldr_format_disabled(struct fmt_main *format)
+{
+	if (!format->private.disabled)
+		format->private.disabled =
+		    cfg_get_bool(SECTION_DISABLED, SUBSECTION_FORMATS,
+		    format->params.label, 0) ? 1 : -1;
+
+	return format->private.disabled > 0;
+}
+
+/*
+ * The passes of auto-detection when the formats are narrowed by signatures:
+ * first the formats with a signature that the line's ciphertext matches,
+ * then the rest.
+ */
+#define LDR_PASS_ALL			0
+#define LDR_PASS_SIGNATURE		1
+#define LDR_PASS_REST			2
+
+/*
+ * Finds the first format in the list that takes the line, among those of the
+ * given pass.  The formats that could make it ambiguous are looked for among
+ * those of the same pass.  "tagged" is the line's ciphertext as loaded,
+ * before any prepare().
+ */
+static int ldr_detect_pass(char *fields[10], char **ciphertext,
+	char *source, struct fmt_main **format, char *tagged, int pass)
+{
+	struct fmt_main *alt;
+	int retval;
+
+	retval = -1;
+	if ((alt = fmt_list))
+	do {
+		char *prepared;
+		int valid;
+
+		/* Format disabled in john.conf, unless forced */
+		if (fmt_list->next && ldr_format_disabled(alt))
+			continue;
+
+		if (pass != LDR_PASS_ALL &&
+		    (pass == LDR_PASS_SIGNATURE) !=
+		    (fmt_signature_match(alt, tagged) &&
+		    alt->private.signatures > 0))
+			continue;
+
+#ifdef HAVE_CRYPT
+/*
+ * Only probe for support by the current system's crypt(3) if this is forced
+ * from the command-line or/and if the hash encoding string looks like one of
+ * those that are only supported in that way.  Avoid the probe in other cases
+ * because it may be slow and undesirable (false detection is possible).
+ */
+		if (alt == &fmt_crypt &&
+		    fmt_list != &fmt_crypt /* not forced */ &&
+#ifdef __sun
+		    strncmp(*ciphertext, "$md5$", 5) &&
+		    strncmp(*ciphertext, "$md5,", 5) &&
+#endif
+		    strncmp(*ciphertext, "$5$", 3) &&
+		    strncmp(*ciphertext, "$6$", 3))
+			continue;
+#endif
+
+		prepared = alt->methods.prepare(fields, alt);
+		if (!prepared)
+			continue;
+		valid = alt->methods.valid(prepared, alt);
+		if (!valid)
+			continue;
+
+		if (retval < 0) {
+			retval = valid;
+			*ciphertext = prepared;
+			ldr_set_encoding(alt);
+#ifdef HAVE_OPENCL
+			if (options.gpu_devices->count && options.fork &&
+			    strstr(alt->params.label, "-opencl"))
+				*format = alt;
+			else
+#endif
+			fmt_init(*format = alt);
+#ifdef LDR_WARN_AMBIGUOUS
+			if (!source) /* not --show */
+				continue;
+#endif
+			break;
+		}
+#ifdef LDR_WARN_AMBIGUOUS
+		if (john_main_process)
+		fprintf(stderr,
+		    "Warning: detected hash type \"%s\", but the string is "
+		    "also recognized as \"%s\"\n"
+		    "Use the \"--format=%s\" option to force loading these "
+		    "as that type instead\n",
+		    (*format)->params.label, alt->params.label,
+		    alt->params.label);
+#endif
+	} while ((alt = alt->next));
+
+	return retval;
+}
+
+/*
+ * Finds the format for a line.  If "narrow" is set and the line's ciphertext
+ * is tagged, the formats with a matching signature are tried first, without
+ * calling the prepare() or valid() of any other, and the rest only if none of
+ * those takes it.
+ */
+static int ldr_detect_format(char *fields[10], char **ciphertext,
+	char *source, struct fmt_main **format, int narrow)
+{
+	char *tagged = *ciphertext;
+	int retval;
+
+	if (!narrow || !fmt_signature_length(tagged))
+		return ldr_detect_pass(fields, ciphertext, source, format,
+		    tagged, LDR_PASS_ALL);
+
+	retval = ldr_detect_pass(fields, ciphertext, source, format,
+	    tagged, LDR_PASS_SIGNATURE);
+	if (retval < 0)
+		retval = ldr_detect_pass(fields, ciphertext, source, format,
+		    tagged, LDR_PASS_REST);
+
+	return retval;
+}
+
 static int ldr_split_line(char **login, char **ciphertext,
 	char **gecos, char **home,
 	char *source, struct fmt_main **format,
@@ -331,7 +471,7 @@ static int ldr_split_line(char **login, char **ciphertext,
 {
 	struct fmt_main *alt;
 	char *fields[10], *uid, *gid, *shell;
-	int i, retval;
+	int i;
 
 	fields[0] = *login = ldr_get_field(&line, db_opts->field_sep_char);
 	fields[1] = *ciphertext = ldr_get_field(&line, db_opts->field_sep_char);
@@ -468,8 +608,7 @@ static int ldr_split_line(char **login, char **ciphertext,
 			if (alt->params.flags & FMT_WARNED)
 				continue;
 			/* Format disabled in john.conf */
-			if (cfg_get_bool(SECTION_DISABLED, SUBSECTION_FORMATS,
-			                 alt->params.label, 0))
+			if (ldr_format_disabled(alt))
 				continue;
 #ifdef HAVE_CRYPT
 			if (alt == &fmt_crypt &&
@@ -482,6 +621,9 @@ static int ldr_split_line(char **login, char **ciphertext,
 				continue;
 #endif
 			prepared = alt->methods.prepare(fields, alt);
+			if (ldr_signatures && prepared &&
+			    !fmt_signature_match(alt, prepared))
+				continue;
 			if (alt->methods.valid(prepared, alt)) {
 				alt->params.flags |= FMT_WARNED;
 				if (john_main_process)
@@ -500,73 +642,8 @@ static int ldr_split_line(char **login, char **ciphertext,
 		return 0;
 	}
 
-	retval = -1;
-	if ((alt = fmt_list))
-	do {
-		char *prepared;
-		int valid;
-
-		/* Format disabled in john.conf, unless forced */
-		if (fmt_list->next &&
-		    cfg_get_bool(SECTION_DISABLED, SUBSECTION_FORMATS,
-		                 alt->params.label, 0))
-			continue;
-
-#ifdef HAVE_CRYPT
-/*
- * Only probe for support by the current system's crypt(3) if this is forced
- * from the command-line or/and if the hash encoding string looks like one of
- * those that are only supported in that way.  Avoid the probe in other cases
- * because it may be slow and undesirable (false detection is possible).
- */
-		if (alt == &fmt_crypt &&
-		    fmt_list != &fmt_crypt /* not forced */ &&
-#ifdef __sun
-		    strncmp(*ciphertext, "$md5$", 5) &&
-		    strncmp(*ciphertext, "$md5,", 5) &&
-#endif
-		    strncmp(*ciphertext, "$5$", 3) &&
-		    strncmp(*ciphertext, "$6$", 3))
-			continue;
-#endif
-
-		prepared = alt->methods.prepare(fields, alt);
-		if (!prepared)
-			continue;
-		valid = alt->methods.valid(prepared, alt);
-		if (!valid)
-			continue;
-
-		if (retval < 0) {
-			retval = valid;
-			*ciphertext = prepared;
-			ldr_set_encoding(alt);
-#ifdef HAVE_OPENCL
-			if (options.gpu_devices->count && options.fork &&
-			    strstr(alt->params.label, "-opencl"))
-				*format = alt;
-			else
-#endif
-			fmt_init(*format = alt);
-#ifdef LDR_WARN_AMBIGUOUS
-			if (!source) /* not --show */
-				continue;
-#endif
-			break;
-		}
-#ifdef LDR_WARN_AMBIGUOUS
-		if (john_main_process)
-		fprintf(stderr,
-		    "Warning: detected hash type \"%s\", but the string is "
-		    "also recognized as \"%s\"\n"
-		    "Use the \"--format=%s\" option to force loading these "
-		    "as that type instead\n",
-		    (*format)->params.label, alt->params.label,
-		    alt->params.label);
-#endif
-	} while ((alt = alt->next));
-
-	return retval;
+	return ldr_detect_format(fields, ciphertext, source, format,
+	    ldr_signatures);
 }
 
 static char* ldr_conv(char *word)
@@ -864,9 +941,44 @@ static void ldr_load_pot_line(struct db_main *db, char *line)
 	} while ((current = current->next_hash));
 }
 
+/*
+ * Marks the loaded hashes found in the pot file for removal, looking each of
+ * them up in the index instead of reading the entire pot file.
+ */
+static int ldr_load_pot_index(struct db_main *db, char *name)
+{
+	struct fmt_main *format = db->format;
+	struct potidx *idx;
+	struct db_salt *salt;
+	struct db_password *current;
+	int i;
+
+	if (options.regen_lost_salts || !(idx = potidx_open(name, format)))
+		return 0;
+
+	for (i = 0; i < SALT_HASH_SIZE; i++)
+	for (salt = db->salt_hash[i]; salt; salt = salt->next)
+	for (current = salt->list; current; current = current->next) {
+		if (!current->binary) /* already marked for removal */
+			continue;
+		if (potidx_lookup(idx, format->methods.source(current->source,
+		    current->binary), 0))
+			current->binary = NULL; /* mark for removal */
+	}
+
+	if (name == pers_opts.activepot)
+		crk_pot_pos = potidx_covered(idx);
+
+	potidx_close(idx);
+
+	return 1;
+}
+
 void ldr_load_pot_file(struct db_main *db, char *name)
 {
 	if (db->format && !(db->format->params.flags & FMT_NOT_EXACT)) {
+		if (ldr_load_pot_index(db, name))
+			return;
 #ifdef HAVE_CRYPT
 		ldr_in_pot = 1;
 #endif
@@ -1414,6 +1526,16 @@ void ldr_fix_database(struct db_main *db)
 	}
 }
 
+void ldr_rebuild_hash(struct db_main *db)
+{
+	struct db_salt *current;
+
+	if ((current = db->salts))
+	do {
+		ldr_init_hash_for_salt(db, current);
+	} while ((current = current->next));
+}
+
 static int ldr_cracked_hash(char *ciphertext)
 {
 	unsigned int hash = 0;
@@ -1434,6 +1556,18 @@ static int ldr_cracked_hash(char *ciphertext)
 	return hash;
 }
 
+/*
+ * When plain --show is used for one format with the pot file index, the pot
+ * file isn't read at all and each hash is looked up in the format's index
+ * instead.  The index is opened once the format is initialized, for each
+ * password file.  With a pot file too big to be loaded, its entries are
+ * joined with the hashes through temporary files, see showjoin.h.
+ */
+static struct potidx *show_idx;
+static char *show_idx_name;
+static int show_idx_pending;
+static int show_join;
+
 static void ldr_show_pot_line(struct db_main *db, char *line)
 {
 	char *ciphertext, *pos;
@@ -1475,6 +1609,11 @@ static void ldr_show_pot_line(struct db_main *db, char *line)
 			return;
 		}
 
+		if (show_join) {
+			showjoin_add_pot(ciphertext, line);
+			return;
+		}
+
 		hash = ldr_cracked_hash(ciphertext);
 
 		last = db->cracked_hash[hash];
@@ -1488,8 +1627,37 @@ static void ldr_show_pot_line(struct db_main *db, char *line)
 	}
 }
 
+/*
+ * Opens the index for the format of the first hash, or reads the pot file
+ * after all if that fails.
+ */
+static void ldr_show_open_index(struct db_main *db, struct fmt_main *format)
+{
+	show_idx_pending = 0;
+	if ((show_idx = potidx_open(show_idx_name, format)))
+		return;
+
+#ifdef HAVE_CRYPT
+	ldr_in_pot = 1;
+#endif
+	read_file(db, show_idx_name, RF_ALLOW_MISSING, ldr_show_pot_line);
+#ifdef HAVE_CRYPT
+	ldr_in_pot = 0;
+#endif
+}
+
 void ldr_show_pot_file(struct db_main *db, char *name)
 {
+	if (!(db->options->flags & DB_PLAINTEXTS) &&
+	    !(options.flags & FLG_LOOPBACK_CHK)) {
+		if (!fmt_list->next && potidx_enabled()) {
+			show_idx_name = str_alloc_copy(name);
+			show_idx_pending = 1;
+			return;
+		}
+		show_join = showjoin_open(name);
+	}
+
 #ifdef HAVE_CRYPT
 	ldr_in_pot = 1;
 #endif
@@ -1499,6 +1667,52 @@ void ldr_show_pot_file(struct db_main *db, char *name)
 #endif
 }
 
+static void ldr_show_store_utf8(struct fmt_main *format)
+{
+	if (format->params.flags & FMT_UNICODE)
+		pers_opts.store_utf8 = cfg_get_bool(SECTION_OPTIONS,
+		    NULL, "UnicodeStoreUTF8", 0);
+	else
+		pers_opts.store_utf8 = cfg_get_bool(SECTION_OPTIONS,
+		    NULL, "CPstoreUTF8", 0);
+}
+
+/*
+ * First pass over a password file when the pot file is joined rather than
+ * loaded: queues the pieces that ldr_show_pw_line() is going to look up.
+ */
+static void ldr_show_probe_line(struct db_main *db, char *line)
+{
+	char source[LINE_BUFFER_SIZE];
+	struct fmt_main *format;
+	char *login, *ciphertext, *gecos, *home;
+	int index, count;
+
+	showjoin_next_line();
+
+	format = NULL;
+	count = ldr_split_line(&login, &ciphertext, &gecos, &home,
+		source, &format, db->options, line);
+	if (!count) return;
+
+	if (!fmt_list->next && !format) return;
+
+	if (!format) {
+		if (*ciphertext)
+			showjoin_add_probe(0, 0,
+			    fmt_default_split(ciphertext, 0, NULL));
+		return;
+	}
+
+	ldr_show_store_utf8(format);
+
+	if (*ciphertext)
+	for (index = 0; index < count; index++)
+		showjoin_add_probe(index,
+		    format->params.flags & FMT_SPLIT_UNIFIES_CASE,
+		    format->methods.split(ciphertext, index, format));
+}
+
 static void ldr_show_pw_line(struct db_main *db, char *line)
 {
 	int show, loop;
@@ -1509,12 +1723,14 @@ static void ldr_show_pw_line(struct db_main *db, char *line)
 	char *login, *ciphertext, *gecos, *home;
 	char *piece;
 	int pass, found, chars;
-	int hash;
 	struct db_cracked *current;
 	char utf8login[LINE_BUFFER_SIZE + 1];
 	char utf8source[LINE_BUFFER_SIZE + 1];
 	char joined[PLAINTEXT_BUFFER_SIZE + 1] = "";
 
+	if (show_join)
+		showjoin_next_line();
+
 	format = NULL;
 	count = ldr_split_line(&login, &ciphertext, &gecos, &home,
 		source, &format, db->options, line);
@@ -1529,14 +1745,11 @@ static void ldr_show_pw_line(struct db_main *db, char *line)
 		show = 0;
 
 	if (format) {
+		if (show_idx_pending)
+			ldr_show_open_index(db, format);
 		split = format->methods.split;
 		unify = format->params.flags & FMT_SPLIT_UNIFIES_CASE;
-		if (format->params.flags & FMT_UNICODE)
-			pers_opts.store_utf8 = cfg_get_bool(SECTION_OPTIONS,
-			    NULL, "UnicodeStoreUTF8", 0);
-		else
-			pers_opts.store_utf8 = cfg_get_bool(SECTION_OPTIONS,
-			    NULL, "CPstoreUTF8", 0);
+		ldr_show_store_utf8(format);
 	} else {
 		split = fmt_default_split;
 		count = 1;
@@ -1563,9 +1776,18 @@ static void ldr_show_pw_line(struct db_main *db, char *line)
 		if (unify)
 			piece = strcpy(mem_alloc(strlen(piece) + 1), piece);
 
-		hash = ldr_cracked_hash(piece);
+		if (show_idx || show_join) {
+			static struct db_cracked from_index;
 
-		if ((current = db->cracked_hash[hash]))
+			current = NULL;
+			if ((from_index.plaintext = show_idx ?
+			    potidx_lookup(show_idx, piece, 0) :
+			    showjoin_lookup(index, piece, format))) {
+				from_index.ciphertext = piece;
+				current = &from_index;
+			}
+		} else
+		if ((current = db->cracked_hash[ldr_cracked_hash(piece)]))
 		do {
 			char *pot = current->ciphertext;
 			if (!strcmp(pot, piece))
@@ -1638,5 +1860,20 @@ static void ldr_show_pw_line(struct db_main *db, char *line)
 
 void ldr_show_pw_file(struct db_main *db, char *name)
 {
+	if (show_join) {
+		read_file(db, name, RF_ALLOW_DIR | RF_NO_WARN,
+		    ldr_show_probe_line);
+		showjoin_run();
+	}
+
 	read_file(db, name, RF_ALLOW_DIR, ldr_show_pw_line);
+
+	if (show_join)
+		showjoin_finish();
+
+	if (show_idx) {
+		potidx_close(show_idx);
+		show_idx = NULL;
+		show_idx_pending = 1;
+	}
 }
@@ -264,6 +264,13 @@ extern void ldr_load_pot_file(struct db_main *db, char *name);
  */
 extern void ldr_fix_database(struct db_main *db);
 
+/*
+ * Re-allocates and re-initializes the bitmaps and hash tables of a fixed
+ * database, so that a process placed on a NUMA node after the database was
+ * loaded (such as a --fork child) gets copies in its local memory.
+ */
+extern void ldr_rebuild_hash(struct db_main *db);
+
 /*
  * Loads cracked passwords into the database.
  */
@@ -36,6 +36,12 @@
 #include <string.h>
 #include <signal.h>
 
+#if defined(_OPENMP) && !defined(_MSC_VER) && (!AC_BUILT || HAVE_PTHREAD)
+#define LOG_WRITER 1
+#include <pthread.h>
+#include <sys/time.h>
+#endif
+
 #include "arch.h"
 #include "misc.h"
 #include "params.h"
@@ -52,6 +58,8 @@
 #endif
 #include "cracker.h"
 #include "signals.h"
+#include "coord.h"
+#include "potidx.h"
 #include "memdbg.h"
 
 static int cfg_beep;
@@ -98,65 +106,344 @@ static void log_file_init(struct log_file *f, char *name, int size)
 	f->size = size;
 }
 
-static void log_file_flush(struct log_file *f)
+/*
+ * Appends "count" bytes to the file under its lock.  Returns NULL on success,
+ * or the name of the call that failed (with errno set).  The writer thread
+ * passes "pos", where the pot file's offsets before and after the write are
+ * stored for the cracking thread to update crk_pot_pos with.
+ */
+static char *log_file_append(struct log_file *f, char *buffer, int count,
+	long int *pos)
 {
-	int count;
-	long int pos_b4 = 0;
-
-	if (f->fd < 0) return;
-
-	count = f->ptr - f->buffer;
-	if (count <= 0) return;
+	long int pos_b4 = 0, pos_after;
 
 #if OS_FLOCK
 	while (flock(f->fd, LOCK_EX)) {
 		if (errno != EINTR)
-			pexit("flock(LOCK_EX)");
+			return "flock(LOCK_EX)";
 	}
 #endif
 	if (f == &pot)
 		pos_b4 = (long int)lseek(f->fd, 0, SEEK_END);
 
-	if (write_loop(f->fd, f->buffer, count) < 0) pexit("write");
-	f->ptr = f->buffer;
+	if (write_loop(f->fd, buffer, count) < 0)
+		return "write";
 
-	if (f == &pot && pos_b4 == crk_pot_pos)
-		crk_pot_pos = (long int)lseek(f->fd, 0, SEEK_CUR);
+	if (f == &pot) {
+		pos_after = (long int)lseek(f->fd, 0, SEEK_CUR);
+		if (pos) {
+			pos[0] = pos_b4;
+			pos[1] = pos_after;
+		} else if (pos_b4 == crk_pot_pos)
+			crk_pot_pos = pos_after;
+	}
+/* The writer thread must not call format methods, so the next open does it */
+	if (f == &pot && !pos)
+		potidx_update(f->name);
 #if OS_FLOCK
 	if (flock(f->fd, LOCK_UN))
-		pexit("flock(LOCK_UN)");
+		return "flock(LOCK_UN)";
 #endif
 #ifdef SIGUSR2
 	/* We don't really send a sync trigger "at crack" but
 	   after it's actually written to the pot file. That is, now. */
 	if (f == &pot && !event_abort && options.reload_at_crack) {
-#ifdef HAVE_MPI
-		if (mpi_p > 1) {
-			int i;
-
-			for (i = 0; i < mpi_p; i++) {
-				if (i == mpi_id)
-					continue;
-				if (mpi_req[i] == NULL)
-					mpi_req[i] = mem_alloc_tiny(
-						sizeof(MPI_Request),
-						MEM_ALIGN_WORD);
-				else
-					if (*mpi_req[i] != MPI_REQUEST_NULL)
-						continue;
-				MPI_Isend("r", 1, MPI_CHAR, i, JOHN_MPI_RELOAD,
-				          MPI_COMM_WORLD, mpi_req[i]);
-			}
-		} else
-#endif
+		/* MPI nodes are sent the cracked hashes by cracker.c instead */
 		if (options.fork)
-			raise(SIGUSR2);
+			kill(getpid(), SIGUSR2);
 	}
 #else
 #ifndef _MSC_VER
 #warning SIGUSR2
 #endif
 #endif
+
+	return NULL;
+}
+
+#ifdef LOG_WRITER
+/*
+ * Background writer.  Full (or, at a log_flush(), partial) file buffers are
+ * passed to a writer thread through a single producer, single consumer ring
+ * of chunks, so the cracking thread never waits for the file locks or the
+ * disk unless the ring is full.  The writer appends everything queued for a
+ * file under one lock, and fsync()s the pot file at most once per
+ * "LogWriterLatency" milliseconds, which is also the longest a queued chunk
+ * waits to be written (group commit).  log_flush() and log_done() wait for
+ * the writer to catch up and fsync(), so every guess is on disk by then.
+ *
+ * Written chunks go back to the cracking thread, which frees their buffers
+ * (memory.c isn't thread-safe) and moves crk_pot_pos past its own lines the
+ * way a synchronous write does, see log_writer_reclaim().
+ */
+#define LOG_QUEUE_SIZE			64
+
+struct log_chunk {
+	struct log_file *f;
+	char *buffer;
+	int count;
+	long int pos[2];	/* Pot file offsets, see log_file_append() */
+};
+
+static struct {
+	struct log_chunk ring[LOG_QUEUE_SIZE];
+	volatile unsigned int head, tail;	/* Consumer and producer */
+	unsigned int reclaimed;			/* Written chunks taken back */
+	volatile unsigned int sync_req, sync_done;
+	volatile int sync_log, quit, error;
+	char *volatile error_call;
+	int enabled, running, latency;
+	pid_t owner;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t work, done;
+} writer;
+
+static void log_writer_sync(struct log_file *f)
+{
+#if HAVE_WINDOWS_H==0
+	if (f->fd >= 0 && fsync(f->fd) && !writer.error) {
+		writer.error = errno;
+		writer.error_call = "fsync";
+	}
+#endif
+}
+
+static void *log_writer_thread(void *arg)
+{
+	struct timeval last_sync, now;
+	int pot_dirty = 0;
+
+	gettimeofday(&last_sync, NULL);
+
+	pthread_mutex_lock(&writer.lock);
+	while (1) {
+		unsigned int sync_req;
+		long elapsed;
+
+		if (writer.head == writer.tail && !writer.quit &&
+		    writer.sync_done == writer.sync_req) {
+			struct timespec until;
+
+			gettimeofday(&now, NULL);
+			until.tv_sec = now.tv_sec + writer.latency / 1000;
+			until.tv_nsec = (now.tv_usec +
+			    (writer.latency % 1000) * 1000L) * 1000L;
+			if (until.tv_nsec >= 1000000000L) {
+				until.tv_sec++;
+				until.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&writer.work, &writer.lock,
+			                       &until);
+		}
+		sync_req = writer.sync_req;
+		pthread_mutex_unlock(&writer.lock);
+
+		while (writer.head != writer.tail) {
+			struct log_chunk *chunk =
+			    &writer.ring[writer.head % LOG_QUEUE_SIZE];
+			char *call;
+
+			__sync_synchronize();
+			if (!writer.error &&
+			    (call = log_file_append(chunk->f, chunk->buffer,
+			    chunk->count, chunk->pos))) {
+				writer.error = errno;
+				writer.error_call = call;
+			}
+			if (chunk->f == &pot)
+				pot_dirty = 1;
+			__sync_synchronize();
+			writer.head++;
+		}
+
+		gettimeofday(&now, NULL);
+		elapsed = (now.tv_sec - last_sync.tv_sec) * 1000L +
+			(now.tv_usec - last_sync.tv_usec) / 1000;
+		if (pot_dirty && (elapsed >= writer.latency ||
+		    sync_req != writer.sync_done)) {
+			log_writer_sync(&pot);
+			pot_dirty = 0;
+			last_sync = now;
+		}
+
+		pthread_mutex_lock(&writer.lock);
+		if (sync_req != writer.sync_done) {
+			if (writer.sync_log)
+				log_writer_sync(&log);
+			writer.sync_done = sync_req;
+			pthread_cond_broadcast(&writer.done);
+		}
+		if (writer.quit && writer.head == writer.tail &&
+		    writer.sync_done == writer.sync_req)
+			break;
+	}
+	pthread_mutex_unlock(&writer.lock);
+
+	return NULL;
+}
+
+static void log_writer_check(void)
+{
+	if (writer.error) {
+		errno = writer.error;
+		writer.enabled = 0;
+		pexit("%s", writer.error_call);
+	}
+}
+
+static void log_writer_start(void)
+{
+	sigset_t all, old;
+	int ret;
+
+/*
+ * Either first use, or we're a child of fork() and the thread we think we
+ * have is the parent's.  Everything queued was written by the parent before
+ * it forked (see log_flush()).
+ */
+	writer.head = writer.tail = writer.reclaimed = 0;
+	writer.sync_req = writer.sync_done = 0;
+	writer.quit = writer.error = 0;
+	writer.owner = getpid();
+	pthread_mutex_init(&writer.lock, NULL);
+	pthread_cond_init(&writer.work, NULL);
+	pthread_cond_init(&writer.done, NULL);
+
+	/* Signals are for the cracking thread */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	ret = pthread_create(&writer.thread, NULL, log_writer_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (ret) {
+		writer.enabled = 0;
+		return;
+	}
+	writer.running = 1;
+}
+
+/*
+ * Takes back the chunks the writer is done with: frees their buffers and, if
+ * nobody else wrote to the pot file before one of ours, moves crk_pot_pos past
+ * it so that the next pot sync doesn't read our own lines back.
+ */
+static void log_writer_reclaim(void)
+{
+	while (writer.reclaimed != writer.head) {
+		struct log_chunk *chunk =
+		    &writer.ring[writer.reclaimed % LOG_QUEUE_SIZE];
+
+		__sync_synchronize();
+		if (chunk->f == &pot && chunk->pos[0] == crk_pot_pos)
+			crk_pot_pos = chunk->pos[1];
+		MEM_FREE(chunk->buffer);
+		writer.reclaimed++;
+	}
+}
+
+/*
+ * Queues the file's buffer for the writer and gives the file a new one.
+ */
+static void log_writer_submit(struct log_file *f, int count)
+{
+	struct log_chunk *chunk;
+
+	log_writer_reclaim();
+	while (writer.tail - writer.reclaimed == LOG_QUEUE_SIZE) {
+		pthread_mutex_lock(&writer.lock);
+		pthread_cond_signal(&writer.work);
+		pthread_mutex_unlock(&writer.lock);
+		log_writer_check();
+		usleep(1000);
+		log_writer_reclaim();
+	}
+
+	chunk = &writer.ring[writer.tail % LOG_QUEUE_SIZE];
+	chunk->f = f;
+	chunk->buffer = f->buffer;
+	chunk->count = count;
+	chunk->pos[0] = chunk->pos[1] = -1;
+	__sync_synchronize();
+	writer.tail++;
+
+/* No lock: a lost wake-up only delays this by up to the latency */
+	if (writer.tail - writer.head > LOG_QUEUE_SIZE / 2)
+		pthread_cond_signal(&writer.work);
+
+	f->ptr = f->buffer = mem_alloc(f->size + LINE_BUFFER_SIZE);
+}
+
+/*
+ * Waits for the writer to write everything queued so far and to fsync() the
+ * pot file, and the log file too if "sync_log" is set.
+ */
+static void log_writer_wait(int sync_log)
+{
+	unsigned int req;
+
+	pthread_mutex_lock(&writer.lock);
+	req = ++writer.sync_req;
+	writer.sync_log = sync_log;
+	pthread_cond_signal(&writer.work);
+	while ((int)(writer.sync_done - req) < 0)
+		pthread_cond_wait(&writer.done, &writer.lock);
+	pthread_mutex_unlock(&writer.lock);
+
+	log_writer_check();
+	log_writer_reclaim();
+}
+
+static void log_writer_stop(void)
+{
+	if (!writer.running || writer.owner != getpid())
+		return;
+
+	pthread_mutex_lock(&writer.lock);
+	writer.quit = 1;
+	pthread_cond_signal(&writer.work);
+	pthread_mutex_unlock(&writer.lock);
+	pthread_join(writer.thread, NULL);
+	writer.running = 0;
+
+	log_writer_check();
+	log_writer_reclaim();
+}
+
+/*
+ * Returns non-zero if the writer thread is to be used, starting it if needed.
+ */
+static int log_writer_active(void)
+{
+	if (!writer.enabled)
+		return 0;
+	if (!writer.running || writer.owner != getpid())
+		log_writer_start();
+
+	return writer.enabled;
+}
+#endif
+
+static void log_file_flush(struct log_file *f)
+{
+	int count;
+	char *call;
+
+	if (f->fd < 0) return;
+
+	count = f->ptr - f->buffer;
+	if (count <= 0) return;
+
+#ifdef LOG_WRITER
+	if (log_writer_active()) {
+		log_writer_submit(f, count);
+		return;
+	}
+#endif
+
+	if ((call = log_file_append(f, f->buffer, count, NULL)))
+		pexit("%s", call);
+	f->ptr = f->buffer;
 }
 
 static int log_file_write(struct log_file *f)
@@ -175,6 +462,12 @@ static void log_file_fsync(struct log_file *f)
 	if (f->fd < 0) return;
 
 	log_file_flush(f);
+#ifdef LOG_WRITER
+	if (log_writer_active()) {
+		log_writer_wait(f == &log);
+		return;
+	}
+#endif
 #if HAVE_WINDOWS_H==0
 	if (fsync(f->fd)) pexit("fsync");
 #endif
@@ -188,6 +481,11 @@ static void log_file_done(struct log_file *f, int do_sync)
 		log_file_fsync(f);
 	else
 		log_file_flush(f);
+#ifdef LOG_WRITER
+	/* Not closing the file under the writer's feet */
+	if (writer.running && writer.owner == getpid())
+		log_writer_wait(0);
+#endif
 	if (close(f->fd)) pexit("close");
 	f->fd = -1;
 
@@ -225,6 +523,15 @@ void log_init(char *log_name, char *pot_name, char *session)
 {
 	in_logger = 1;
 
+#ifdef LOG_WRITER
+	writer.enabled = cfg_get_bool(SECTION_OPTIONS, NULL,
+	                              "LogWriterThread", 0);
+	if ((writer.latency = cfg_get_int(SECTION_OPTIONS, NULL,
+	    "LogWriterLatency")) <= 0)
+		writer.latency = LOG_WRITER_LATENCY;
+	potidx_enabled();
+#endif
+
 	if (log_name && log.fd < 0) {
 		if (session)
 			log_name = path_session(session, LOG_SUFFIX);
@@ -312,7 +619,11 @@ void log_guess(char *login, char *ciphertext, char *rep_plain, char *store_plain
 				count1 = (int)sprintf(pot.ptr,
 				                      "%s%c%s\n", ciphertext,
 				                      field_sep, store_plain);
-			if (count1 > 0) pot.ptr += count1;
+			if (count1 > 0) {
+				if (options.flags & FLG_WORKER)
+					coord_cracked(pot.ptr, count1);
+				pot.ptr += count1;
+			}
 		}
 	}
 
@@ -432,6 +743,9 @@ void log_done(void)
 
 	log_file_done(&log, !options.fork);
 	log_file_done(&pot, 1);
+#ifdef LOG_WRITER
+	log_writer_stop();
+#endif
 
 	in_logger = 0;
 }
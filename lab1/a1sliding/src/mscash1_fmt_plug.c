@@ -519,16 +519,21 @@ static void nt_hash(int count)
 	}
 }
 
-static int crypt_all(int *pcount, struct db_salt *salt)
+static void precompute(int count)
 {
-	int count = *pcount;
-	int i;
-
 	if(new_key)
 	{
 		new_key=0;
 		nt_hash(count);
 	}
+}
+
+static int crypt_all(int *pcount, struct db_salt *salt)
+{
+	int count = *pcount;
+	int i;
+
+	precompute(count);
 
 #if MS_NUM_KEYS > 1 && defined(_OPENMP)
 #pragma omp parallel for default(none) private(i) shared(count, last, crypt_out, salt_buffer, output1x)
@@ -981,7 +986,8 @@ struct fmt_main fmt_mscash = {
 		},
 		cmp_all,
 		cmp_one,
-		cmp_exact
+		cmp_exact,
+		precompute
 	}
 };
 
@@ -43,11 +43,14 @@ static int omp_t = 1;
 #include "options.h"
 #include "unicode.h"
 #include "sha2.h"
+#include "sha512_sse.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL			"mssql12"
 #define FORMAT_NAME			"MS SQL 2012/2014"
-#if ARCH_BITS >= 64
+#ifdef MMX_COEF_SHA512
+#define ALGORITHM_NAME                  "SHA512 " SHA512_ALGORITHM_NAME
+#elif ARCH_BITS >= 64
 #define ALGORITHM_NAME                  "SHA512 64/" ARCH_BITS_STR " " SHA2_LIB
 #else
 #define ALGORITHM_NAME                  "SHA512 32/" ARCH_BITS_STR " " SHA2_LIB
@@ -65,7 +68,11 @@ static int omp_t = 1;
 #define SALT_ALIGN			4
 
 #define MIN_KEYS_PER_CRYPT		1
+#ifdef MMX_COEF_SHA512
+#define MAX_KEYS_PER_CRYPT		MMX_COEF_SHA512
+#else
 #define MAX_KEYS_PER_CRYPT		1
+#endif
 
 #undef MIN
 #define MIN(a, b)		(((a) > (b)) ? (b) : (a))
@@ -89,7 +96,13 @@ static struct fmt_tests tests[] = {
 
 static unsigned char cursalt[SALT_SIZE];
 static char (*saved_key)[(PLAINTEXT_LENGTH + 1) * 2 + SALT_SIZE];
+#ifdef MMX_COEF_SHA512
+static ARCH_WORD_64 (*crypt_out)[8*MMX_COEF_SHA512];
+#define HASH_WORD(index, i)	((ARCH_WORD_64 *)crypt_out)[SHA512_SSE_OUT(index, i)]
+#else
 static ARCH_WORD_32 (*crypt_out)[BINARY_SIZE / 4];
+#define HASH_WORD(index, i)	crypt_out[index][i]
+#endif
 static int *key_length;
 
 static int valid(char *ciphertext, struct fmt_main *self)
@@ -141,7 +154,11 @@ static void init(struct fmt_main *self)
 #endif
 	saved_key = mem_calloc_tiny(sizeof(*saved_key) *
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+#ifdef MMX_COEF_SHA512
+	crypt_out = mem_calloc_tiny(sizeof(*crypt_out) * self->params.max_keys_per_crypt / MMX_COEF_SHA512, MEM_ALIGN_SIMD);
+#else
 	crypt_out = mem_calloc_tiny(sizeof(*crypt_out) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+#endif
 	key_length = mem_calloc_tiny(sizeof(*key_length) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	if (pers_opts.target_enc == UTF_8)
 		self->params.plaintext_length = MIN(125, PLAINTEXT_LENGTH * 3);
@@ -184,11 +201,17 @@ static char *get_key(int index) {
 
 static int cmp_all(void *binary, int count) {
 	int index = 0;
+#ifdef MMX_COEF_SHA512
+	for (; index < count; index++)
+		if (((ARCH_WORD_64 *)binary)[0] == HASH_WORD(index, 0))
+			return 1;
+#else
 #ifdef _OPENMP
 	for (; index < count; index++)
 #endif
 		if (!memcmp(binary, crypt_out[index], BINARY_SIZE))
 			return 1;
+#endif
 	return 0;
 }
 
@@ -198,14 +221,42 @@ static int cmp_exact(char *source, int count) {
 
 static int cmp_one(void * binary, int index)
 {
+#ifdef MMX_COEF_SHA512
+	int i;
+
+	for (i = 0; i < BINARY_SIZE / 8; i++)
+		if (((ARCH_WORD_64 *)binary)[i] != HASH_WORD(index, i))
+			return 0;
+	return 1;
+#else
 	return !memcmp(binary, crypt_out[index], BINARY_SIZE);
+#endif
 }
 
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
 	int index = 0;
+#ifdef MMX_COEF_SHA512
+	int loops = (count + MMX_COEF_SHA512 - 1) / MMX_COEF_SHA512;
 
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < loops; index++) {
+		JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_64 buf[SHA512_BUF_SIZ*MMX_COEF_SHA512];
+		int i;
+
+		for (i = 0; i < MMX_COEF_SHA512; i++) {
+			int k = index * MMX_COEF_SHA512 + i;
+
+			sha512_sse_load(buf, i, saved_key[k], key_length[k],
+			                cursalt, SALT_SIZE);
+		}
+		SSESHA512body((__m128i *)buf, crypt_out[index], NULL,
+		              SSEi_MIXED_IN);
+	}
+#else
 #ifdef _OPENMP
 #pragma omp parallel for
 	for (index = 0; index < count; index++)
@@ -217,6 +268,7 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		SHA512_Update(&ctx, saved_key[index], key_length[index]+SALT_SIZE );
 		SHA512_Final((unsigned char *)crypt_out[index], &ctx);
 	}
+#endif
 	return count;
 }
 
@@ -231,16 +283,19 @@ static void * binary(char *ciphertext)
 	{
 		realcipher[i] = atoi16[ARCH_INDEX(ciphertext[i*2+14])]*16 + atoi16[ARCH_INDEX(ciphertext[i*2+15])];
 	}
+#ifdef MMX_COEF_SHA512
+	alter_endianity_to_BE64(realcipher, BINARY_SIZE / 8);
+#endif
 	return (void *)realcipher;
 }
 
-static int get_hash_0(int index) { return crypt_out[index][0] & 0xf; }
-static int get_hash_1(int index) { return crypt_out[index][0] & 0xff; }
-static int get_hash_2(int index) { return crypt_out[index][0] & 0xfff; }
-static int get_hash_3(int index) { return crypt_out[index][0] & 0xffff; }
-static int get_hash_4(int index) { return crypt_out[index][0] & 0xfffff; }
-static int get_hash_5(int index) { return crypt_out[index][0] & 0xffffff; }
-static int get_hash_6(int index) { return crypt_out[index][0] & 0x7ffffff; }
+static int get_hash_0(int index) { return HASH_WORD(index, 0) & 0xf; }
+static int get_hash_1(int index) { return HASH_WORD(index, 0) & 0xff; }
+static int get_hash_2(int index) { return HASH_WORD(index, 0) & 0xfff; }
+static int get_hash_3(int index) { return HASH_WORD(index, 0) & 0xffff; }
+static int get_hash_4(int index) { return HASH_WORD(index, 0) & 0xfffff; }
+static int get_hash_5(int index) { return HASH_WORD(index, 0) & 0xffffff; }
+static int get_hash_6(int index) { return HASH_WORD(index, 0) & 0x7ffffff; }
 
 static int salt_hash(void *salt)
 {
@@ -28,11 +28,27 @@ john_register_one(&fmt_office);
 #include "sha.h"
 #include "sha2.h"
 #include "johnswap.h"
+#include "sse-intrinsics.h"
+#include "sha512_sse.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL		"Office"
 #define FORMAT_NAME		"2007/2010 (SHA-1) / 2013 (SHA-512), with AES"
+#ifdef SHA1_SSE_PARA
+#define ALGORITHM_SHA1		"SHA1 " SHA1_ALGORITHM_NAME
+#else
+#define ALGORITHM_SHA1		"SHA1 32/" ARCH_BITS_STR
+#endif
+#ifdef MMX_COEF_SHA512
+#define ALGORITHM_SHA512	"SHA512 " SHA512_ALGORITHM_NAME
+#else
+#define ALGORITHM_SHA512	"SHA512 32/" ARCH_BITS_STR " " SHA2_LIB
+#endif
+#if defined(SHA1_SSE_PARA) || defined(MMX_COEF_SHA512)
+#define ALGORITHM_NAME		ALGORITHM_SHA1 ", " ALGORITHM_SHA512
+#else
 #define ALGORITHM_NAME		"32/" ARCH_BITS_STR " " SHA2_LIB
+#endif
 #define BENCHMARK_COMMENT	""
 #define BENCHMARK_LENGTH	-1
 #define PLAINTEXT_LENGTH	32
@@ -40,8 +56,29 @@ john_register_one(&fmt_office);
 #define SALT_SIZE		sizeof(*cur_salt)
 #define BINARY_ALIGN	1
 #define SALT_ALIGN	sizeof(int)
-#define MIN_KEYS_PER_CRYPT	1
-#define MAX_KEYS_PER_CRYPT	1
+
+/*
+ * The spin loops hash SHA1_NBKEYS (SHA-1) or SHA512_NBKEYS (SHA-512)
+ * passwords at a time, and crypt_all() goes NBKEYS at a time for both.
+ */
+#ifdef SHA1_SSE_PARA
+#define SHA1_NBKEYS		(MMX_COEF * SHA1_SSE_PARA)
+#else
+#define SHA1_NBKEYS		1
+#endif
+#ifdef MMX_COEF_SHA512
+#define SHA512_NBKEYS		MMX_COEF_SHA512
+#else
+#define SHA512_NBKEYS		1
+#endif
+#if SHA1_NBKEYS > SHA512_NBKEYS
+#define NBKEYS			SHA1_NBKEYS
+#else
+#define NBKEYS			SHA512_NBKEYS
+#endif
+
+#define MIN_KEYS_PER_CRYPT	NBKEYS
+#define MAX_KEYS_PER_CRYPT	NBKEYS
 
 #undef MIN
 #define MIN(a, b)		(((a) > (b)) ? (b) : (a))
@@ -138,14 +175,18 @@ static unsigned char *DeriveKey(unsigned char *hashValue, unsigned char *X1)
 	return NULL;
 }
 
-static unsigned char* GeneratePasswordHashUsingSHA1(UTF16 *passwordBuf, int passwordBufSize, unsigned char *final)
+/*
+ * The spin loops, SHA-1 for 2007/2010 and SHA-512 for 2013: hashBuf gets
+ * H(spinCount) of the password.  The SIMD versions below do the same for
+ * a group of passwords.
+ */
+#ifndef SHA1_SSE_PARA
+static void SpinSHA1(UTF16 *passwordBuf, int passwordBufSize, int spinCount, unsigned char *hashBuf)
 {
-	unsigned char hashBuf[20], *key;
 	/* H(0) = H(salt, password)
 	 * hashBuf = SHA1Hash(salt, password);
 	 * create input buffer for SHA1 from salt and unicode version of password */
 	unsigned int inputBuf[(0x14 + 0x04 + 4) / sizeof(int)];
-	unsigned char X1[20];
 	int i;
 	SHA_CTX ctx;
 
@@ -161,7 +202,7 @@ static unsigned char* GeneratePasswordHashUsingSHA1(UTF16 *passwordBuf, int pass
 	// Create a byte array of the integer and put at the front of the input buffer
 	// 1.3.6 says that little-endian byte ordering is expected
 	memcpy(&inputBuf[1], hashBuf, 20);
-	for (i = 0; i < MS_OFFICE_2007_ITERATIONS; i++) {
+	for (i = 0; i < spinCount; i++) {
 #if ARCH_LITTLE_ENDIAN
 		*inputBuf = i;
 #else
@@ -172,8 +213,154 @@ static unsigned char* GeneratePasswordHashUsingSHA1(UTF16 *passwordBuf, int pass
 		SHA1_Update(&ctx, inputBuf, 0x14 + 0x04);
 		SHA1_Final((unsigned char*)&inputBuf[1], &ctx);
 	}
+	memcpy(hashBuf, &inputBuf[1], 20);
+}
+#endif
+
+#ifndef MMX_COEF_SHA512
+static void SpinSHA512(UTF16 *passwordBuf, int passwordBufSize, int spinCount, unsigned char *hashBuf)
+{
+	unsigned int inputBuf[128 / sizeof(int)];
+	int i;
+	SHA512_CTX ctx;
+
+	SHA512_Init(&ctx);
+	SHA512_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
+	SHA512_Update(&ctx, passwordBuf, passwordBufSize);
+	SHA512_Final(hashBuf, &ctx);
+
+	// Create a byte array of the integer and put at the front of the input buffer
+	// 1.3.6 says that little-endian byte ordering is expected
+	memcpy(&inputBuf[1], hashBuf, 64);
+	for (i = 0; i < spinCount; i++) {
+#if ARCH_LITTLE_ENDIAN
+		*inputBuf = i;
+#else
+		*inputBuf = JOHNSWAP(i);
+#endif
+		// 'append' the previously generated hash to the input buffer
+		SHA512_Init(&ctx);
+		SHA512_Update(&ctx, inputBuf, 64 + 0x04);
+		SHA512_Final((unsigned char*)&inputBuf[1], &ctx);
+	}
+	memcpy(hashBuf, &inputBuf[1], 64);
+}
+#endif
+
+#ifdef SHA1_SSE_PARA
+/* Word i of the block of index, in a group of SHA1_NBKEYS blocks */
+#define SHA1_WORD(index, i) \
+	( ((index)&(MMX_COEF-1)) + (index)/MMX_COEF*SHA_BUF_SIZ*MMX_COEF + \
+	  (i)*MMX_COEF )
+
+/*
+ * SpinSHA1() for the SHA1_NBKEYS passwords from index on.  The block of
+ * each one is i followed by H(n-1), and SSESHA1body() writes H(n) right
+ * back over H(n-1), so only i changes from one call to the next.
+ */
+static void SpinSHA1_SSE(int index, int spinCount, unsigned char (*hashBuf)[64])
+{
+	JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_32 buf[SHA_BUF_SIZ * SHA1_NBKEYS];
+	ARCH_WORD_32 h[5];
+	int i, j;
+	SHA_CTX ctx;
+
+	for (j = 0; j < SHA1_NBKEYS; j++) {
+		SHA1_Init(&ctx);
+		SHA1_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
+		SHA1_Update(&ctx, saved_key[index + j], saved_len[index + j]);
+		SHA1_Final((unsigned char*)h, &ctx);
+
+		for (i = 0; i < 5; i++)
+			buf[SHA1_WORD(j, i + 1)] = JOHNSWAP(h[i]);
+		buf[SHA1_WORD(j, 6)] = 0x80000000;
+		for (i = 7; i < 15; i++)
+			buf[SHA1_WORD(j, i)] = 0;
+		buf[SHA1_WORD(j, 15)] = (0x14 + 0x04) << 3;
+	}
+
+	for (i = 0; i < spinCount; i++) {
+		ARCH_WORD_32 n = JOHNSWAP(i);
+
+		for (j = 0; j < SHA1_NBKEYS; j++)
+			buf[SHA1_WORD(j, 0)] = n;
+		SSESHA1body((__m128i*)buf, &buf[SHA1_WORD(0, 1)], NULL,
+		            SSEi_MIXED_IN | SSEi_OUTPUT_AS_INP_FMT);
+	}
+
+	for (j = 0; j < SHA1_NBKEYS; j++) {
+		for (i = 0; i < 5; i++)
+			h[i] = JOHNSWAP(buf[SHA1_WORD(j, i + 1)]);
+		memcpy(hashBuf[j], h, 20);
+	}
+}
+#endif
+
+#ifdef MMX_COEF_SHA512
+/*
+ * SpinSHA512() for the MMX_COEF_SHA512 passwords from index on.  H(n-1)
+ * starts 4 bytes into the block, half way into a word, so SSESHA512body()
+ * writes H(n) over the first 8 words instead, and they are shifted back
+ * by half a word, with i put in front, before the next call.
+ */
+static void SpinSHA512_SSE(int index, int spinCount, unsigned char (*hashBuf)[64])
+{
+	JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_64 buf[SHA512_BUF_SIZ * MMX_COEF_SHA512];
+	ARCH_WORD_64 h[8];
+	int i, j, k;
+	SHA512_CTX ctx;
+
+	for (j = 0; j < MMX_COEF_SHA512; j++) {
+		SHA512_Init(&ctx);
+		SHA512_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
+		SHA512_Update(&ctx, saved_key[index + j], saved_len[index + j]);
+		SHA512_Final((unsigned char*)h, &ctx);
+
+		for (i = 0; i < 8; i++)
+			buf[SHA512_SSE_WORD(j, i)] = JOHNSWAP64(h[i]);
+		for (i = 9; i < 15; i++)
+			buf[SHA512_SSE_WORD(j, i)] = 0;
+		buf[SHA512_SSE_WORD(j, 15)] = (64 + 0x04) << 3;
+	}
+
+	for (i = 0; i < spinCount; i++) {
+		ARCH_WORD_64 n = (ARCH_WORD_64)JOHNSWAP(i) << 32;
+
+		for (j = 0; j < MMX_COEF_SHA512; j++)
+			buf[SHA512_SSE_WORD(j, 8)] =
+				buf[SHA512_SSE_WORD(j, 7)] << 32 | 0x80000000;
+		for (k = 7; k > 0; k--)
+			for (j = 0; j < MMX_COEF_SHA512; j++)
+				buf[SHA512_SSE_WORD(j, k)] =
+					buf[SHA512_SSE_WORD(j, k - 1)] << 32 |
+					buf[SHA512_SSE_WORD(j, k)] >> 32;
+		for (j = 0; j < MMX_COEF_SHA512; j++)
+			buf[SHA512_SSE_WORD(j, 0)] =
+				n | buf[SHA512_SSE_WORD(j, 0)] >> 32;
+
+		SSESHA512body((__m128i*)buf, buf, NULL,
+		              SSEi_MIXED_IN | SSEi_OUTPUT_AS_INP_FMT);
+	}
+
+	for (j = 0; j < MMX_COEF_SHA512; j++) {
+		for (i = 0; i < 8; i++)
+			h[i] = JOHNSWAP64(buf[SHA512_SSE_WORD(j, i)]);
+		memcpy(hashBuf[j], h, 64);
+	}
+}
+#endif
+
+/* hashBuf is H(n) from SpinSHA1() */
+static unsigned char* GeneratePasswordHashUsingSHA1(unsigned char *hashBuf, unsigned char *final)
+{
+	unsigned char *key;
+	unsigned int inputBuf[(0x14 + 0x04 + 4) / sizeof(int)];
+	unsigned char X1[20];
+	SHA_CTX ctx;
+
 	// Finally, append "block" (0) to H(n)
 	// hashBuf = SHA1Hash(hashBuf, 0);
+	memcpy(&inputBuf[1], hashBuf, 20);
 	memset(&inputBuf[6], 0, 4);
 	SHA1_Init(&ctx);
 	SHA1_Update(&ctx, &inputBuf[1], 0x14 + 0x04);
@@ -217,38 +404,14 @@ static int PasswordVerifier(unsigned char * key)
 	return !memcmp(checkHash, decryptedVerifierHash, 16);
 }
 
-static void GenerateAgileEncryptionKey(UTF16 *passwordBuf, int passwordBufSize, int hashSize, unsigned char *hashBuf)
+/* spinHash is H(n) from SpinSHA1() */
+static void GenerateAgileEncryptionKey(unsigned char *spinHash, int hashSize, unsigned char *hashBuf)
 {
-	/* H(0) = H(salt, password)
-	 * hashBuf = SHA1Hash(salt, password);
-	 * create input buffer for SHA1 from salt and unicode version of password */
 	unsigned int inputBuf[(28 + 4) / sizeof(int)];
 	int i;
 	SHA_CTX ctx;
 
-	SHA1_Init(&ctx);
-	SHA1_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
-	SHA1_Update(&ctx, passwordBuf, passwordBufSize);
-	SHA1_Final(hashBuf, &ctx);
-
-	/* Generate each hash in turn
-	 * H(n) = H(i, H(n-1))
-	 * hashBuf = SHA1Hash(i, hashBuf); */
-
-	// Create a byte array of the integer and put at the front of the input buffer
-	// 1.3.6 says that little-endian byte ordering is expected
-	memcpy(&inputBuf[1], hashBuf, 20);
-	for (i = 0; i < cur_salt->spinCount; i++) {
-#if ARCH_LITTLE_ENDIAN
-		*inputBuf = i;
-#else
-		*inputBuf = JOHNSWAP(i);
-#endif
-		// 'append' the previously generated hash to the input buffer
-		SHA1_Init(&ctx);
-		SHA1_Update(&ctx, inputBuf, 0x14 + 0x04);
-		SHA1_Final((unsigned char*)&inputBuf[1], &ctx);
-	}
+	memcpy(&inputBuf[1], spinHash, 20);
 	// Finally, append "block" (0) to H(n)
 	memcpy(&inputBuf[6], encryptedVerifierHashInputBlockKey, 8);
 	SHA1_Init(&ctx);
@@ -270,31 +433,13 @@ static void GenerateAgileEncryptionKey(UTF16 *passwordBuf, int passwordBufSize,
 	}
 }
 
-static void GenerateAgileEncryptionKey512(UTF16 *passwordBuf, int passwordBufSize, unsigned char *hashBuf)
+/* spinHash is H(n) from SpinSHA512() */
+static void GenerateAgileEncryptionKey512(unsigned char *spinHash, unsigned char *hashBuf)
 {
 	unsigned int inputBuf[128 / sizeof(int)];
-	int i;
 	SHA512_CTX ctx;
 
-	SHA512_Init(&ctx);
-	SHA512_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
-	SHA512_Update(&ctx, passwordBuf, passwordBufSize);
-	SHA512_Final(hashBuf, &ctx);
-
-	// Create a byte array of the integer and put at the front of the input buffer
-	// 1.3.6 says that little-endian byte ordering is expected
-	memcpy(&inputBuf[1], hashBuf, 64);
-	for (i = 0; i < cur_salt->spinCount; i++) {
-#if ARCH_LITTLE_ENDIAN
-		*inputBuf = i;
-#else
-		*inputBuf = JOHNSWAP(i);
-#endif
-		// 'append' the previously generated hash to the input buffer
-		SHA512_Init(&ctx);
-		SHA512_Update(&ctx, inputBuf, 64 + 0x04);
-		SHA512_Final((unsigned char*)&inputBuf[1], &ctx);
-	}
+	memcpy(&inputBuf[1], spinHash, 64);
 	// Finally, append "block" (0) to H(n)
 	memcpy(&inputBuf[68/4], encryptedVerifierHashInputBlockKey, 8);
 	SHA512_Init(&ctx);
@@ -450,45 +595,76 @@ static void set_salt(void *salt)
 	cur_salt = (struct custom_salt *)salt;
 }
 
+/* Checks the password that spinHash, H(n) of the spin loop, comes from */
+static int check_key(unsigned char *spinHash)
+{
+	if(cur_salt->version == 2007) {
+		unsigned char encryptionKey[256];
+		GeneratePasswordHashUsingSHA1(spinHash, encryptionKey);
+		return PasswordVerifier(encryptionKey);
+	}
+	else if (cur_salt->version == 2010) {
+		unsigned char verifierKeys[64], decryptedVerifierHashInputBytes[16], decryptedVerifierHashBytes[32];
+		unsigned char hash[20];
+		SHA_CTX ctx;
+		GenerateAgileEncryptionKey(spinHash, cur_salt->keySize >> 3, verifierKeys);
+		DecryptUsingSymmetricKeyAlgorithm(verifierKeys, cur_salt->encryptedVerifier, decryptedVerifierHashInputBytes, 16);
+		DecryptUsingSymmetricKeyAlgorithm(&verifierKeys[32], cur_salt->encryptedVerifierHash, decryptedVerifierHashBytes, 32);
+		SHA1_Init(&ctx);
+		SHA1_Update(&ctx, decryptedVerifierHashInputBytes, 16);
+		SHA1_Final(hash, &ctx);
+		return !memcmp(hash, decryptedVerifierHashBytes, 20);
+	}
+	else if (cur_salt->version == 2013) {
+		unsigned char verifierKeys[128], decryptedVerifierHashInputBytes[16], decryptedVerifierHashBytes[32];
+		unsigned char hash[64];
+		SHA512_CTX ctx;
+		GenerateAgileEncryptionKey512(spinHash, verifierKeys);
+		DecryptUsingSymmetricKeyAlgorithm(verifierKeys, cur_salt->encryptedVerifier, decryptedVerifierHashInputBytes, 16);
+		DecryptUsingSymmetricKeyAlgorithm(&verifierKeys[64], cur_salt->encryptedVerifierHash, decryptedVerifierHashBytes, 32);
+		SHA512_Init(&ctx);
+		SHA512_Update(&ctx, decryptedVerifierHashInputBytes, 16);
+		SHA512_Final(hash, &ctx);
+		return !memcmp(hash, decryptedVerifierHashBytes, 20);
+	}
+	return 0;
+}
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
-	int index = 0;
+	int index;
 
 #ifdef _OPENMP
 #pragma omp parallel for
-	for (index = 0; index < count; index++)
 #endif
+	for (index = 0; index < count; index += NBKEYS)
 	{
-		if(cur_salt->version == 2007) {
-			unsigned char encryptionKey[256];
-			GeneratePasswordHashUsingSHA1(saved_key[index], saved_len[index], encryptionKey);
-			cracked[index] = PasswordVerifier(encryptionKey);
-		}
-		else if (cur_salt->version == 2010) {
-			unsigned char verifierKeys[64], decryptedVerifierHashInputBytes[16], decryptedVerifierHashBytes[32];
-			unsigned char hash[20];
-			SHA_CTX ctx;
-			GenerateAgileEncryptionKey(saved_key[index], saved_len[index], cur_salt->keySize >> 3, verifierKeys);
-			DecryptUsingSymmetricKeyAlgorithm(verifierKeys, cur_salt->encryptedVerifier, decryptedVerifierHashInputBytes, 16);
-			DecryptUsingSymmetricKeyAlgorithm(&verifierKeys[32], cur_salt->encryptedVerifierHash, decryptedVerifierHashBytes, 32);
-			SHA1_Init(&ctx);
-			SHA1_Update(&ctx, decryptedVerifierHashInputBytes, 16);
-			SHA1_Final(hash, &ctx);
-			cracked[index] = !memcmp(hash, decryptedVerifierHashBytes, 20);
-		}
-		else if (cur_salt->version == 2013) {
-			unsigned char verifierKeys[128], decryptedVerifierHashInputBytes[16], decryptedVerifierHashBytes[32];
-			unsigned char hash[64];
-			SHA512_CTX ctx;
-			GenerateAgileEncryptionKey512(saved_key[index], saved_len[index], verifierKeys);
-			DecryptUsingSymmetricKeyAlgorithm(verifierKeys, cur_salt->encryptedVerifier, decryptedVerifierHashInputBytes, 16);
-			DecryptUsingSymmetricKeyAlgorithm(&verifierKeys[64], cur_salt->encryptedVerifierHash, decryptedVerifierHashBytes, 32);
-			SHA512_Init(&ctx);
-			SHA512_Update(&ctx, decryptedVerifierHashInputBytes, 16);
-			SHA512_Final(hash, &ctx);
-			cracked[index] = !memcmp(hash, decryptedVerifierHashBytes, 20);
+		unsigned char spinHash[NBKEYS][64];
+		int i;
+
+		if (cur_salt->version == 2013) {
+#ifdef MMX_COEF_SHA512
+			for (i = 0; i < NBKEYS; i += SHA512_NBKEYS)
+				SpinSHA512_SSE(index + i, cur_salt->spinCount, &spinHash[i]);
+#else
+			for (i = 0; i < NBKEYS; i++)
+				SpinSHA512(saved_key[index + i], saved_len[index + i], cur_salt->spinCount, spinHash[i]);
+#endif
+		} else {
+			int spinCount = (cur_salt->version == 2007) ?
+				MS_OFFICE_2007_ITERATIONS : cur_salt->spinCount;
+#ifdef SHA1_SSE_PARA
+			for (i = 0; i < NBKEYS; i += SHA1_NBKEYS)
+				SpinSHA1_SSE(index + i, spinCount, &spinHash[i]);
+#else
+			for (i = 0; i < NBKEYS; i++)
+				SpinSHA1(saved_key[index + i], saved_len[index + i], spinCount, spinHash[i]);
+#endif
 		}
+
+		for (i = 0; i < NBKEYS; i++)
+			cracked[index + i] = check_key(spinHash[i]);
 	}
 	return count;
 }
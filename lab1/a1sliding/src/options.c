@@ -148,7 +148,8 @@ static struct opt_entry opt_list[] = {
 		OPT_FMT_STR_ALLOC, &show_uncracked_str},
 	{"test", FLG_TEST_SET, FLG_TEST_CHK,
 		0, ~FLG_TEST_SET & ~FLG_FORMAT & ~FLG_SAVEMEM & ~FLG_DYNFMT &
-		~OPT_REQ_PARAM & ~FLG_NOLOG, "%u", &benchmark_time},
+		~OPT_REQ_PARAM & ~FLG_NOLOG & ~FLG_FORCE_TESTS, "%u",
+		&benchmark_time},
 	{"users", FLG_NONE, 0, FLG_PASSWD, OPT_REQ_PARAM,
 		OPT_FMT_ADD_LIST_MULTI, &options.loader.users},
 	{"groups", FLG_NONE, 0, FLG_PASSWD, OPT_REQ_PARAM,
@@ -165,7 +166,17 @@ static struct opt_entry opt_list[] = {
 	{"fork", FLG_FORK, FLG_FORK,
 		FLG_CRACKING_CHK, FLG_STDIN_CHK | FLG_STDOUT | FLG_PIPE_CHK | OPT_REQ_PARAM,
 		"%u", &options.fork},
-#endif
+	{"coordinator", FLG_COORD_SET, FLG_COORD_CHK,
+		0, ~FLG_COORD_SET & ~OPT_REQ_PARAM & ~FLG_SESSION &
+		~FLG_NOLOG & ~FLG_LOG_STDERR & ~FLG_VERBOSITY,
+		OPT_FMT_STR_ALLOC, &options.coordinator},
+	{"worker", FLG_WORKER, FLG_WORKER,
+		FLG_CRACKING_CHK, FLG_NODE | FLG_FORK | FLG_STDOUT |
+		FLG_STDIN_CHK | FLG_PIPE_CHK | OPT_REQ_PARAM,
+		OPT_FMT_STR_ALLOC, &options.worker},
+#endif
+	{"affinity", FLG_ZERO, 0, 0, OPT_REQ_PARAM,
+		OPT_FMT_STR_ALLOC, &options.affinity},
 	{"pot", FLG_ZERO, 0, 0, OPT_REQ_PARAM,
 		OPT_FMT_STR_ALLOC, &pers_opts.activepot},
 	{"format", FLG_FORMAT, FLG_FORMAT,
@@ -224,6 +235,7 @@ static struct opt_entry opt_list[] = {
 		OPT_FMT_ADD_LIST_MULTI, &options.gpu_devices},
 #endif
 	{"skip-self-tests", FLG_NOTESTS, FLG_NOTESTS},
+	{"force-self-test", FLG_FORCE_TESTS, FLG_FORCE_TESTS, 0, FLG_NOTESTS},
 #if FMT_MAIN_VERSION > 11
 	{"costs", FLG_ZERO, 0, FLG_PASSWD, OPT_REQ_PARAM,
                 OPT_FMT_STR_ALLOC, &costs_str},
@@ -419,8 +431,16 @@ void opt_print_hidden_usage(void)
 	puts("--regen-lost-salts=N      regenerate lost salts (see doc/OPTIONS)");
 	puts("--mkv-stats=FILE          \"Markov\" stats file (see doc/MARKOV)");
 	puts("--reject-printable        reject printable binaries");
+	puts("--affinity=MODE           pin processes and threads to CPUs (none, core or");
+	puts("                          node), see doc/OPTIONS");
+#if OS_FORK
+	puts("--coordinator=SPEC        hand out work units to --worker processes over");
+	puts("                          TCP, SPEC is [ADDR:]PORT[/UNITS], see doc/OPTIONS");
+	puts("--worker=HOST:PORT        crack work units handed out by a coordinator");
+#endif
 	puts("--verbosity=N             change verbosity (1-5, default 3)");
 	puts("--skip-self-tests         skip self tests");
+	puts("--force-self-test         run self tests even if cached as passed");
 	puts("--stress-test[=TIME]      loop self tests forever");
 	puts("--input-encoding=NAME     input encoding (alias for --encoding)");
 	puts("--internal-encoding=NAME  encoding used in rules/masks (see doc/ENCODING)");
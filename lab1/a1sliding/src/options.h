@@ -158,6 +158,13 @@
 #define FLG_LOOPTEST			0x0002000000000000ULL
 /* Mask mode is stacked */
 #define FLG_MASK_STACKED                0x0004000000000000ULL
+/* Work unit coordinator and its workers, see coord.h */
+#define FLG_COORD_CHK			0x0008000000000000ULL
+#define FLG_COORD_SET \
+	(FLG_COORD_CHK | FLG_ACTION | FLG_CRACKING_SUP)
+#define FLG_WORKER			0x0010000000000000ULL
+/* Don't trust the self-test cache, see testcache.h */
+#define FLG_FORCE_TESTS			0x0020000000000000ULL
 /* Stacking modes */
 #define FLG_STACKING	\
 	(FLG_MASK_CHK | FLG_REGEX_CHK)
@@ -207,6 +214,12 @@ struct options_main {
 	char *node_str;
 	unsigned int node_min, node_max, node_count, fork;
 
+/* CPU affinity mode, see affinity.h */
+	char *affinity;
+
+/* Work unit coordinator to run ([ADDRESS:]PORT[/UNITS]) or to work for */
+	char *coordinator, *worker;
+
 /* Configuration file name */
 	char *config;
 
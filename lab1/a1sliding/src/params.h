@@ -111,6 +111,13 @@
 #define RECOVERY_V4			"REC4"
 #define RECOVERY_V			RECOVERY_V4
 
+/*
+ * Binary crash recovery file ("checkpoint") format version string.  Such
+ * files are written instead of RECOVERY_V ones when enabled in john.conf,
+ * see recovery.c for the layout.
+ */
+#define RECOVERY_V5			"REC5"
+
 /*
  * Charset file format version string.
  */
@@ -157,6 +164,7 @@
 #endif
 #define LOG_SUFFIX			".log"
 #define RECOVERY_SUFFIX			".rec"
+#define RECOVERY_TMP_SUFFIX		".tmp"
 #define WORDLIST_NAME			"$JOHN/password.lst"
 
 /*
@@ -234,6 +242,14 @@ extern int password_hash_thresholds[PASSWORD_HASH_SIZES];
 #define CRACKED_HASH_LOG		16
 #define CRACKED_HASH_SIZE		(1 << CRACKED_HASH_LOG)
 
+/*
+ * Plain --show joins the pot file with the password files through temporary
+ * bucket files instead of loading it when it would take more than this many
+ * megabytes of memory (see showjoin.h), using up to this many buckets.
+ */
+#define SHOW_JOIN_MEMORY		1024
+#define SHOW_JOIN_BUCKETS		128
+
 /*
  * Buffered keys hash size, used for "single crack" mode.
  */
@@ -315,6 +331,14 @@ extern int password_hash_thresholds[PASSWORD_HASH_SIZES];
  */
 #define RULE_WORD_SIZE			0x80
 
+/*
+ * Rule sets that preprocess to at least this many rules have their count
+ * cached once checked (the "RulesCache" file in john.conf), and that file is
+ * started over when it grows past this many bytes.
+ */
+#define RULES_CACHE_MIN			0x4000
+#define RULES_CACHE_MAX_SIZE		0x10000
+
 /*
  * Buffer size for plaintext passwords.
  */
@@ -341,6 +365,13 @@ extern int password_hash_thresholds[PASSWORD_HASH_SIZES];
 #define POT_BUFFER_SIZE			0x8000
 #define LOG_BUFFER_SIZE			0x8000
 
+/*
+ * Default for how long (in milliseconds) the background log writer may hold
+ * on to queued buffers, and the shortest interval between its pot file
+ * fsync()s, see logger.c.
+ */
+#define LOG_WRITER_LATENCY		250
+
 /*
  * Buffer size for path names.
  */
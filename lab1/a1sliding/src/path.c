@@ -11,6 +11,7 @@
 #if AC_BUILT
 #include "autoconfig.h"
 #endif
+#include <stdlib.h>
 #include <string.h>
 
 #include "misc.h"
@@ -22,6 +23,8 @@ static char *john_home_path = NULL;
 static int john_home_length;
 static char *john_home_pathex = NULL;
 static int john_home_lengthex;
+static char *user_home_path = NULL;
+static int user_home_length;
 
 #if JOHN_SYSTEMWIDE
 #if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER
@@ -31,9 +34,6 @@ static int john_home_lengthex;
 #include <pwd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-
-static char *user_home_path = NULL;
-static int user_home_length;
 #endif
 
 #include "memdbg.h"
@@ -46,7 +46,7 @@ void path_init(char **argv)
 	char *private;
 #endif
 #else
-	char *pos;
+	char *pos, *home;
 #endif
 
 #if JOHN_SYSTEMWIDE
@@ -100,6 +100,15 @@ void path_init(char **argv)
 			}
 		}
 	}
+
+/* "~/" is only used by a few options' defaults here, so $HOME will do */
+	if (user_home_path || !(home = getenv("HOME")) || !*home) return;
+	user_home_length = strlen(home) + 1;
+	if (user_home_length >= PATH_BUFFER_SIZE) return;
+
+	user_home_path = mem_alloc(PATH_BUFFER_SIZE);
+	memcpy(user_home_path, home, user_home_length - 1);
+	user_home_path[user_home_length - 1] = '/';
 #endif
 }
 
@@ -156,7 +165,6 @@ char *path_expand(char *name)
 		return name + 6;
 	}
 
-#if JOHN_SYSTEMWIDE
 	if (!strncmp(name, "~/", 2)) {
 		if (user_home_path &&
 		    user_home_length + strlen(name) - 2 < PATH_BUFFER_SIZE) {
@@ -166,7 +174,6 @@ char *path_expand(char *name)
 		}
 		return name + 2;
 	}
-#endif
 
 	return name;
 }
@@ -198,9 +205,7 @@ char *path_session(char *session, char *suffix)
 void path_done(void)
 {
 	MEM_FREE(john_home_path);
-#if JOHN_SYSTEMWIDE
 	MEM_FREE(user_home_path);
-#endif
 	if (john_home_pathex)
 		MEM_FREE(john_home_pathex);
 }
@@ -17,7 +17,9 @@
 #define JOHN_PBKDF2_HMAC_RIPEMD160_H
 
 #include <string.h>
+#include "arch.h"
 #include "sph_ripemd.h"
+#include "sse-intrinsics.h"
 
 #if (AC_BUILT && HAVE_RIPEMD160) && 0
 // actually, built in sph_ripemd160 may be faster than oSSL build :(
@@ -90,21 +92,20 @@ static void _pbkdf2_ripemd160(const unsigned char *S, int SL, int R, ARCH_WORD_3
 		}
 	}
 }
-static void pbkdf2_ripemd160(const unsigned char *K, int KL, const unsigned char *S, int SL, int R, unsigned char *out, int outlen, int skip_bytes)
+// pbkdf2_ripemd160() with the ipad/opad contexts already loaded, for callers
+// that run a key against several salts.
+static void pbkdf2_ripemd160_loaded(const sph_ripemd160_context *ipad, const sph_ripemd160_context *opad, const unsigned char *S, int SL, int R, unsigned char *out, int outlen, int skip_bytes)
 {
 	union {
 		ARCH_WORD_32 x32[RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32)];
 		unsigned char out[RIPEMD160_DIGEST_LENGTH];
 	} tmp;
 	int loop, loops, i, accum=0;
-	sph_ripemd160_context ipad, opad;
-
-	_pbkdf2_ripemd160_load_hmac(K, KL, &ipad, &opad);
 
 	loops = (skip_bytes + outlen + (RIPEMD160_DIGEST_LENGTH-1)) / RIPEMD160_DIGEST_LENGTH;
 	loop = skip_bytes / RIPEMD160_DIGEST_LENGTH + 1;
 	while (loop <= loops) {
-		_pbkdf2_ripemd160(S,SL,R,tmp.x32,loop,&ipad,&opad);
+		_pbkdf2_ripemd160(S,SL,R,tmp.x32,loop,ipad,opad);
 		for (i = skip_bytes%RIPEMD160_DIGEST_LENGTH; i < RIPEMD160_DIGEST_LENGTH && accum < outlen; i++) {
 #if ARCH_LITTLE_ENDIAN
 			out[accum++] = ((uint8_t*)tmp.out)[i];
@@ -116,5 +117,111 @@ static void pbkdf2_ripemd160(const unsigned char *K, int KL, const unsigned char
 		skip_bytes = 0;
 	}
 }
+static void pbkdf2_ripemd160(const unsigned char *K, int KL, const unsigned char *S, int SL, int R, unsigned char *out, int outlen, int skip_bytes)
+{
+	sph_ripemd160_context ipad, opad;
+
+	_pbkdf2_ripemd160_load_hmac(K, KL, &ipad, &opad);
+	pbkdf2_ripemd160_loaded(&ipad, &opad, S, SL, R, out, outlen, skip_bytes);
+}
+
+
+#ifdef MMX_COEF_RIPEMD160
+
+#define SSE_GROUP_SZ_RIPEMD160 MMX_COEF_RIPEMD160
+
+// This is the SSE version of pbkdf2_ripemd160_loaded(), hashing
+// SSE_GROUP_SZ_RIPEMD160 keys at once.  It is laid out just like
+// pbkdf2_sha512_sse(), except that RIPEMD-160 is little endian, so the words
+// never need swapping on x86.
+static void pbkdf2_ripemd160_sse_loaded(const sph_ripemd160_context ipad[SSE_GROUP_SZ_RIPEMD160], const sph_ripemd160_context opad[SSE_GROUP_SZ_RIPEMD160], const unsigned char *S, int SL, int R, unsigned char *out[SSE_GROUP_SZ_RIPEMD160], int outlen, int skip_bytes)
+{
+	unsigned char tmp_hash[RIPEMD160_DIGEST_LENGTH];
+	ARCH_WORD_32 *i1, *i2, *o1;
+	int i, j;
+	ARCH_WORD_32 dgst[SSE_GROUP_SZ_RIPEMD160][RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32)];
+	int loops, accum=0;
+	unsigned char loop;
+	sph_ripemd160_context ctx;
+
+	JTR_ALIGN(16) ARCH_WORD_32 sse_hash1[RIPEMD160_BUF_SIZ*SSE_GROUP_SZ_RIPEMD160];
+	JTR_ALIGN(16) ARCH_WORD_32 sse_crypt1[RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32)*SSE_GROUP_SZ_RIPEMD160];
+	JTR_ALIGN(16) ARCH_WORD_32 sse_crypt2[RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32)*SSE_GROUP_SZ_RIPEMD160];
+	i1 = sse_crypt1;
+	i2 = sse_crypt2;
+	o1 = sse_hash1;
+
+	// The second block of both halves of the HMAC is the 20 byte hash of the
+	// previous one, the 0x80 and the length (64+20 bytes), so everything after
+	// the hash is set just once.
+	for (i = RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32)*MMX_COEF_RIPEMD160; i < RIPEMD160_BUF_SIZ*MMX_COEF_RIPEMD160; ++i)
+		o1[i] = 0;
+	for (i = 0; i < MMX_COEF_RIPEMD160; ++i) {
+		o1[(RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32))*MMX_COEF_RIPEMD160 + i] = 0x80;
+		o1[14*MMX_COEF_RIPEMD160 + i] = (RIPEMD160_CBLOCK+RIPEMD160_DIGEST_LENGTH)<<3;
+	}
+
+	for (j = 0; j < SSE_GROUP_SZ_RIPEMD160; ++j) {
+		for (i = 0; i < RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32); ++i) {
+			i1[i*MMX_COEF_RIPEMD160 + j] = ipad[j].val[i];
+			i2[i*MMX_COEF_RIPEMD160 + j] = opad[j].val[i];
+		}
+	}
+
+	loops = (skip_bytes + outlen + (RIPEMD160_DIGEST_LENGTH-1)) / RIPEMD160_DIGEST_LENGTH;
+	loop = skip_bytes / RIPEMD160_DIGEST_LENGTH + 1;
+	while (loop <= loops) {
+		for (j = 0; j < SSE_GROUP_SZ_RIPEMD160; ++j) {
+			memcpy(&ctx, &ipad[j], sizeof(ctx));
+			sph_ripemd160(&ctx, S, SL);
+			// this 4 byte BE 'loop' appended to the salt
+			sph_ripemd160(&ctx, "\x0\x0\x0", 3);
+			sph_ripemd160(&ctx, &loop, 1);
+			sph_ripemd160_close(&ctx, tmp_hash);
+
+			memcpy(&ctx, &opad[j], sizeof(ctx));
+			sph_ripemd160(&ctx, tmp_hash, RIPEMD160_DIGEST_LENGTH);
+			sph_ripemd160_close(&ctx, tmp_hash);
+
+			memcpy(dgst[j], tmp_hash, RIPEMD160_DIGEST_LENGTH);
+			for (i = 0; i < RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32); ++i)
+				o1[i*MMX_COEF_RIPEMD160 + j] = dgst[j][i];
+		}
+
+		for (i = 1; i < R; i++) {
+			SSERIPEMD160body((__m128i*)o1, o1, i1, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
+			SSERIPEMD160body((__m128i*)o1, o1, i2, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
+			for (j = 0; j < RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32); j++) {
+				int k;
+				for (k = 0; k < SSE_GROUP_SZ_RIPEMD160; k++)
+					dgst[k][j] ^= o1[j*MMX_COEF_RIPEMD160 + k];
+			}
+		}
+
+		for (i = skip_bytes%RIPEMD160_DIGEST_LENGTH; i < RIPEMD160_DIGEST_LENGTH && accum < outlen; ++i) {
+			for (j = 0; j < SSE_GROUP_SZ_RIPEMD160; ++j)
+				out[j][accum] = ((unsigned char*)(dgst[j]))[i];
+			++accum;
+		}
+		++loop;
+		skip_bytes = 0;
+	}
+}
+
+// Callers that load the ipad/opad contexts themselves define PBKDF2_HMAC_RIPEMD160_SSE_LOADED,
+// and only use pbkdf2_ripemd160_sse_loaded().
+#ifndef PBKDF2_HMAC_RIPEMD160_SSE_LOADED
+static void pbkdf2_ripemd160_sse(const unsigned char *K[SSE_GROUP_SZ_RIPEMD160], int KL[SSE_GROUP_SZ_RIPEMD160], const unsigned char *S, int SL, int R, unsigned char *out[SSE_GROUP_SZ_RIPEMD160], int outlen, int skip_bytes)
+{
+	sph_ripemd160_context ipad[SSE_GROUP_SZ_RIPEMD160], opad[SSE_GROUP_SZ_RIPEMD160];
+	int j;
+
+	for (j = 0; j < SSE_GROUP_SZ_RIPEMD160; ++j)
+		_pbkdf2_ripemd160_load_hmac(K[j], KL[j], &ipad[j], &opad[j]);
+	pbkdf2_ripemd160_sse_loaded(ipad, opad, S, SL, R, out, outlen, skip_bytes);
+}
+#endif
+
+#endif /* MMX_COEF_RIPEMD160 */
 
 #endif
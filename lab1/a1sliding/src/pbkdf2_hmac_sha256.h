@@ -300,7 +300,7 @@ static void pbkdf2_sha256_sse(const unsigned char *K[MMX_COEF_SHA256], int KL[MM
 			for (k = 0; k < SSE_GROUP_SZ_SHA256; k++) {
 				ARCH_WORD_32 *p = &o1[(k/MMX_COEF_SHA256)*MMX_COEF_SHA256*SHA256_BUF_SIZ + (k&(MMX_COEF_SHA256-1))];
 				for(j = 0; j < (SHA256_DIGEST_LENGTH/sizeof(ARCH_WORD_32)); j++)
-					dgst[k][j] ^= p[(j<<(MMX_COEF_SHA256>>1))];
+					dgst[k][j] ^= p[(j*MMX_COEF_SHA256)];
 			}
 		}
 
@@ -113,22 +113,21 @@ static void _pbkdf2_sha512(const unsigned char *S, int SL, int R, ARCH_WORD_64 *
 
 }
 
-static void pbkdf2_sha512(const unsigned char *K, int KL, unsigned char *S, int SL, int R, unsigned char *out, int outlen, int skip_bytes)
+// pbkdf2_sha512() with the ipad/opad contexts already loaded, for callers
+// that run a key against several salts.
+static void pbkdf2_sha512_loaded(const SHA512_CTX *ipad, const SHA512_CTX *opad, unsigned char *S, int SL, int R, unsigned char *out, int outlen, int skip_bytes)
 {
 	union {
 		ARCH_WORD_64 x64[SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64)];
 		unsigned char out[SHA512_DIGEST_LENGTH];
 	} tmp;
 	int loop, loops, i, accum=0;
-	SHA512_CTX ipad, opad;
-
-	_pbkdf2_sha512_load_hmac(K, KL, &ipad, &opad);
 
 	loops = (skip_bytes + outlen + (SHA512_DIGEST_LENGTH-1)) / SHA512_DIGEST_LENGTH;
 	loop = skip_bytes / SHA512_DIGEST_LENGTH + 1;
 
 	while (loop <= loops) {
-		_pbkdf2_sha512(S,SL,R,tmp.x64,loop,&ipad,&opad);
+		_pbkdf2_sha512(S,SL,R,tmp.x64,loop,ipad,opad);
 		for (i = skip_bytes%SHA512_DIGEST_LENGTH; i < SHA512_DIGEST_LENGTH && accum < outlen; i++) {
 #if ARCH_LITTLE_ENDIAN
 			out[accum++] = ((uint8_t*)tmp.out)[i];
@@ -141,6 +140,14 @@ static void pbkdf2_sha512(const unsigned char *K, int KL, unsigned char *S, int
 	}
 }
 
+static void pbkdf2_sha512(const unsigned char *K, int KL, unsigned char *S, int SL, int R, unsigned char *out, int outlen, int skip_bytes)
+{
+	SHA512_CTX ipad, opad;
+
+	_pbkdf2_sha512_load_hmac(K, KL, &ipad, &opad);
+	pbkdf2_sha512_loaded(&ipad, &opad, S, SL, R, out, outlen, skip_bytes);
+}
+
 #endif
 
 #ifdef MMX_COEF_SHA512
@@ -170,6 +177,7 @@ extern void sha512_final  (void *output, sha512_ctx *ctx);
 #define SSE_GROUP_SZ_SHA512 MMX_COEF_SHA512
 #endif
 
+#ifndef PBKDF2_HMAC_SHA512_SSE_LOADED
 static void _pbkdf2_sha512_sse_load_hmac(const unsigned char *K[SSE_GROUP_SZ_SHA512], int KL[SSE_GROUP_SZ_SHA512], SHA512_CTX pIpad[SSE_GROUP_SZ_SHA512], SHA512_CTX pOpad[SSE_GROUP_SZ_SHA512])
 {
 	unsigned char ipad[SHA512_CBLOCK], opad[SHA512_CBLOCK], k0[SHA512_DIGEST_LENGTH];
@@ -199,8 +207,11 @@ static void _pbkdf2_sha512_sse_load_hmac(const unsigned char *K[SSE_GROUP_SZ_SHA
 		SHA512_Update(&(pOpad[j]), opad, SHA512_CBLOCK);
 	}
 }
+#endif
 
-static void pbkdf2_sha512_sse(const unsigned char *K[MMX_COEF_SHA512], int KL[MMX_COEF_SHA512], unsigned char *S, int SL, int R, unsigned char *out[MMX_COEF_SHA512], int outlen, int skip_bytes)
+// pbkdf2_sha512_sse() with the ipad/opad contexts already loaded, for callers
+// that run a key against several salts.
+static void pbkdf2_sha512_sse_loaded(const SHA512_CTX ipad[SSE_GROUP_SZ_SHA512], const SHA512_CTX opad[SSE_GROUP_SZ_SHA512], unsigned char *S, int SL, int R, unsigned char *out[SSE_GROUP_SZ_SHA512], int outlen, int skip_bytes)
 {
 	unsigned char tmp_hash[SHA512_DIGEST_LENGTH];
 	ARCH_WORD_64 *i1, *i2, *o1, *ptmp;
@@ -208,7 +219,7 @@ static void pbkdf2_sha512_sse(const unsigned char *K[MMX_COEF_SHA512], int KL[MM
 	ARCH_WORD_64 dgst[SSE_GROUP_SZ_SHA512][SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64)];
 	int loops, accum=0;
 	unsigned char loop;
-	SHA512_CTX ipad[SSE_GROUP_SZ_SHA512], opad[SSE_GROUP_SZ_SHA512], ctx;
+	SHA512_CTX ctx;
 
 	// sse_hash1 would need to be 'adjusted' for SHA512_PARA
 	JTR_ALIGN(16) unsigned char sse_hash1[SHA512_BUF_SIZ*sizeof(ARCH_WORD_64)*SSE_GROUP_SZ_SHA512];
@@ -235,7 +246,6 @@ static void pbkdf2_sha512_sse(const unsigned char *K[MMX_COEF_SHA512], int KL[MM
 	// Load up the IPAD and OPAD values, saving off the first half of the crypt.  We then push the ipad/opad all
 	// the way to the end, and that ends up being the first iteration of the pbkdf2.  From that point on, we use
 	// the 2 first halves, to load the sha512 2nd part of each crypt, in each loop.
-	_pbkdf2_sha512_sse_load_hmac(K, KL, ipad, opad);
 	for (j = 0; j < SSE_GROUP_SZ_SHA512; ++j) {
 		ptmp = &i1[(j/MMX_COEF_SHA512)*MMX_COEF_SHA512*(SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64))+(j&(MMX_COEF_SHA512-1))];
 		for (i = 0; i < (SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64)); ++i) {
@@ -318,4 +328,16 @@ static void pbkdf2_sha512_sse(const unsigned char *K[MMX_COEF_SHA512], int KL[MM
 	}
 }
 
+// Callers that load the ipad/opad contexts themselves define PBKDF2_HMAC_SHA512_SSE_LOADED,
+// and only use pbkdf2_sha512_sse_loaded().
+#ifndef PBKDF2_HMAC_SHA512_SSE_LOADED
+static void pbkdf2_sha512_sse(const unsigned char *K[MMX_COEF_SHA512], int KL[MMX_COEF_SHA512], unsigned char *S, int SL, int R, unsigned char *out[MMX_COEF_SHA512], int outlen, int skip_bytes)
+{
+	SHA512_CTX ipad[SSE_GROUP_SZ_SHA512], opad[SSE_GROUP_SZ_SHA512];
+
+	_pbkdf2_sha512_sse_load_hmac(K, KL, ipad, opad);
+	pbkdf2_sha512_sse_loaded(ipad, opad, S, SL, R, out, outlen, skip_bytes);
+}
+#endif
+
 #endif
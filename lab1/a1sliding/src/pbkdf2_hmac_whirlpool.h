@@ -29,7 +29,9 @@
 #define JOHN_PBKDF2_HMAC_WHIRLPOOL_H
 
 #include <string.h>
+#include "arch.h"
 #include "sph_whirlpool.h"
+#include "sse-intrinsics.h"
 #if (AC_BUILT && HAVE_WHIRLPOOL) ||	\
    (!AC_BUILT && OPENSSL_VERSION_NUMBER >= 0x10000000 && !HAVE_NO_SSL_WHIRLPOOL)
 #include "openssl/whrlpool.h"
@@ -106,21 +108,20 @@ static void _pbkdf2_whirlpool(const unsigned char *S, int SL, int R, ARCH_WORD_3
 		}
 	}
 }
-static void pbkdf2_whirlpool(const unsigned char *K, int KL, const unsigned char *S, int SL, int R, unsigned char *out, int outlen, int skip_bytes)
+// pbkdf2_whirlpool() with the ipad/opad contexts already loaded, for callers
+// that run a key against several salts.
+static void pbkdf2_whirlpool_loaded(const WHIRLPOOL_CTX *ipad, const WHIRLPOOL_CTX *opad, const unsigned char *S, int SL, int R, unsigned char *out, int outlen, int skip_bytes)
 {
 	union {
 		ARCH_WORD_32 x32[WHIRLPOOL_DIGEST_LENGTH/sizeof(ARCH_WORD_32)];
 		unsigned char out[WHIRLPOOL_DIGEST_LENGTH];
 	} tmp;
 	int loop, loops, i, accum=0;
-	WHIRLPOOL_CTX ipad, opad;
-
-	_pbkdf2_whirlpool_load_hmac(K, KL, &ipad, &opad);
 
 	loops = (skip_bytes + outlen + (WHIRLPOOL_DIGEST_LENGTH-1)) / WHIRLPOOL_DIGEST_LENGTH;
 	loop = skip_bytes / WHIRLPOOL_DIGEST_LENGTH + 1;
 	while (loop <= loops) {
-		_pbkdf2_whirlpool(S,SL,R,tmp.x32,loop,&ipad,&opad);
+		_pbkdf2_whirlpool(S,SL,R,tmp.x32,loop,ipad,opad);
 		for (i = skip_bytes%WHIRLPOOL_DIGEST_LENGTH; i < WHIRLPOOL_DIGEST_LENGTH && accum < outlen; i++) {
 #if ARCH_LITTLE_ENDIAN
 			out[accum++] = ((uint8_t*)tmp.out)[i];
@@ -132,5 +133,140 @@ static void pbkdf2_whirlpool(const unsigned char *K, int KL, const unsigned char
 		skip_bytes = 0;
 	}
 }
+static void pbkdf2_whirlpool(const unsigned char *K, int KL, const unsigned char *S, int SL, int R, unsigned char *out, int outlen, int skip_bytes)
+{
+	WHIRLPOOL_CTX ipad, opad;
+
+	_pbkdf2_whirlpool_load_hmac(K, KL, &ipad, &opad);
+	pbkdf2_whirlpool_loaded(&ipad, &opad, S, SL, R, out, outlen, skip_bytes);
+}
+
+#ifdef MMX_COEF_WHIRLPOOL
+
+#define SSE_GROUP_SZ_WHIRLPOOL MMX_COEF_WHIRLPOOL
+
+// Byte i of the (sliced) buffer of key j for SSEWHIRLPOOLbody()
+#define WHIRLPOOL_SSE_BYTE(i, j) ((i)*MMX_COEF_WHIRLPOOL + (j))
+
+#ifndef PBKDF2_HMAC_WHIRLPOOL_SSE_LOADED
+// The SSE code needs the states of the loaded ipad/opad, so these are always
+// sph_whirlpool contexts, even when the above uses oSSL.
+static void _pbkdf2_whirlpool_sse_load_hmac(const unsigned char *K[SSE_GROUP_SZ_WHIRLPOOL], int KL[SSE_GROUP_SZ_WHIRLPOOL], sph_whirlpool_context pIpad[SSE_GROUP_SZ_WHIRLPOOL], sph_whirlpool_context pOpad[SSE_GROUP_SZ_WHIRLPOOL])
+{
+	unsigned char ipad[WHIRLPOOL_CBLOCK], opad[WHIRLPOOL_CBLOCK], k0[WHIRLPOOL_DIGEST_LENGTH];
+	int i, j;
+
+	for (j = 0; j < SSE_GROUP_SZ_WHIRLPOOL; ++j) {
+		const unsigned char *key = K[j];
+		int len = KL[j];
+
+		memset(ipad, 0x36, WHIRLPOOL_CBLOCK);
+		memset(opad, 0x5C, WHIRLPOOL_CBLOCK);
+
+		if (len > WHIRLPOOL_CBLOCK) {
+			sph_whirlpool_context ctx;
+			sph_whirlpool_init(&ctx);
+			sph_whirlpool(&ctx, key, len);
+			sph_whirlpool_close(&ctx, k0);
+			len = WHIRLPOOL_DIGEST_LENGTH;
+			key = k0;
+		}
+		for(i = 0; i < len; i++) {
+			ipad[i] ^= key[i];
+			opad[i] ^= key[i];
+		}
+		sph_whirlpool_init(&(pIpad[j]));
+		sph_whirlpool(&(pIpad[j]), ipad, WHIRLPOOL_CBLOCK);
+		sph_whirlpool_init(&(pOpad[j]));
+		sph_whirlpool(&(pOpad[j]), opad, WHIRLPOOL_CBLOCK);
+	}
+}
+#endif
+
+// This is the SSE version of pbkdf2_whirlpool_loaded(), hashing
+// SSE_GROUP_SZ_WHIRLPOOL keys at once.  It is laid out like
+// pbkdf2_sha512_sse(), but the buffers are byte sliced, and the known 2nd
+// limb of each HMAC half is a buffer too.
+static void pbkdf2_whirlpool_sse_loaded(const sph_whirlpool_context ipad[SSE_GROUP_SZ_WHIRLPOOL], const sph_whirlpool_context opad[SSE_GROUP_SZ_WHIRLPOOL], const unsigned char *S, int SL, int R, unsigned char *out[SSE_GROUP_SZ_WHIRLPOOL], int outlen, int skip_bytes)
+{
+	unsigned char tmp_hash[WHIRLPOOL_DIGEST_LENGTH];
+	int i, j;
+	int loops, accum=0;
+	unsigned char loop;
+	sph_whirlpool_context ctx;
+
+	JTR_ALIGN(32) unsigned char i1[WHIRLPOOL_DIGEST_LENGTH*SSE_GROUP_SZ_WHIRLPOOL];
+	JTR_ALIGN(32) unsigned char i2[WHIRLPOOL_DIGEST_LENGTH*SSE_GROUP_SZ_WHIRLPOOL];
+	JTR_ALIGN(32) unsigned char o1[WHIRLPOOL_DIGEST_LENGTH*SSE_GROUP_SZ_WHIRLPOOL];
+	JTR_ALIGN(32) unsigned char o2[WHIRLPOOL_DIGEST_LENGTH*SSE_GROUP_SZ_WHIRLPOOL];
+	JTR_ALIGN(32) unsigned char limb2[WHIRLPOOL_CBLOCK*SSE_GROUP_SZ_WHIRLPOOL];
+	JTR_ALIGN(32) unsigned char dgst[WHIRLPOOL_DIGEST_LENGTH*SSE_GROUP_SZ_WHIRLPOOL];
+
+	// the 0x80, and the BE length of the 128 bytes hashed in bits
+	memset(limb2, 0, sizeof(limb2));
+	for (j = 0; j < SSE_GROUP_SZ_WHIRLPOOL; ++j) {
+		limb2[WHIRLPOOL_SSE_BYTE(0, j)] = 0x80;
+		limb2[WHIRLPOOL_SSE_BYTE(62, j)] = 0x04;
+	}
+
+	for (j = 0; j < SSE_GROUP_SZ_WHIRLPOOL; ++j) {
+		for (i = 0; i < WHIRLPOOL_DIGEST_LENGTH; ++i) {
+			i1[WHIRLPOOL_SSE_BYTE(i, j)] = (unsigned char)(ipad[j].state[i>>3] >> ((i&7)<<3));
+			i2[WHIRLPOOL_SSE_BYTE(i, j)] = (unsigned char)(opad[j].state[i>>3] >> ((i&7)<<3));
+		}
+	}
+
+	loops = (skip_bytes + outlen + (WHIRLPOOL_DIGEST_LENGTH-1)) / WHIRLPOOL_DIGEST_LENGTH;
+	loop = skip_bytes / WHIRLPOOL_DIGEST_LENGTH + 1;
+	while (loop <= loops) {
+		for (j = 0; j < SSE_GROUP_SZ_WHIRLPOOL; ++j) {
+			memcpy(&ctx, &ipad[j], sizeof(ctx));
+			sph_whirlpool(&ctx, S, SL);
+			// this 4 byte BE 'loop' appended to the salt
+			sph_whirlpool(&ctx, "\x0\x0\x0", 3);
+			sph_whirlpool(&ctx, &loop, 1);
+			sph_whirlpool_close(&ctx, tmp_hash);
+
+			memcpy(&ctx, &opad[j], sizeof(ctx));
+			sph_whirlpool(&ctx, tmp_hash, WHIRLPOOL_DIGEST_LENGTH);
+			sph_whirlpool_close(&ctx, tmp_hash);
+
+			for (i = 0; i < WHIRLPOOL_DIGEST_LENGTH; ++i)
+				o1[WHIRLPOOL_SSE_BYTE(i, j)] = tmp_hash[i];
+		}
+		memcpy(dgst, o1, sizeof(dgst));
+
+		for (i = 1; i < R; i++) {
+			SSEWHIRLPOOLbody(o1, o2, i1);
+			SSEWHIRLPOOLbody(limb2, o2, o2);
+			SSEWHIRLPOOLbody(o2, o1, i2);
+			SSEWHIRLPOOLbody(limb2, o1, o1);
+			for (j = 0; j < sizeof(dgst); j++)
+				dgst[j] ^= o1[j];
+		}
+
+		for (i = skip_bytes%WHIRLPOOL_DIGEST_LENGTH; i < WHIRLPOOL_DIGEST_LENGTH && accum < outlen; ++i) {
+			for (j = 0; j < SSE_GROUP_SZ_WHIRLPOOL; ++j)
+				out[j][accum] = dgst[WHIRLPOOL_SSE_BYTE(i, j)];
+			++accum;
+		}
+		++loop;
+		skip_bytes = 0;
+	}
+}
+
+// Callers that load the ipad/opad contexts themselves define PBKDF2_HMAC_WHIRLPOOL_SSE_LOADED,
+// and only use pbkdf2_whirlpool_sse_loaded().
+#ifndef PBKDF2_HMAC_WHIRLPOOL_SSE_LOADED
+static void pbkdf2_whirlpool_sse(const unsigned char *K[SSE_GROUP_SZ_WHIRLPOOL], int KL[SSE_GROUP_SZ_WHIRLPOOL], const unsigned char *S, int SL, int R, unsigned char *out[SSE_GROUP_SZ_WHIRLPOOL], int outlen, int skip_bytes)
+{
+	sph_whirlpool_context ipad[SSE_GROUP_SZ_WHIRLPOOL], opad[SSE_GROUP_SZ_WHIRLPOOL];
+
+	_pbkdf2_whirlpool_sse_load_hmac(K, KL, ipad, opad);
+	pbkdf2_whirlpool_sse_loaded(ipad, opad, S, SL, R, out, outlen, skip_bytes);
+}
+#endif
+
+#endif /* MMX_COEF_WHIRLPOOL */
 
 #endif
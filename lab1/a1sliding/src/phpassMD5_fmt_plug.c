@@ -24,11 +24,19 @@
  * programatically allowed to have different looping counts.
  * This format should handle all valid loop values.
  *
- * This format is now a 'shell'.  It simply is used to filter out
- * the $H$??????? hashes, and convert them into $dynamic_17$??????
- * and setup and forward the 'work' to the $dynamic_17$ to do the 'real'
- * work.
+ * This format used to be a 'shell' that converted the $H$ and $P$
+ * hashes into $dynamic_17$ ones and forwarded the work to the dynamic
+ * engine.  It now does the work itself.  The hashes are still split()
+ * into the $dynamic_17$ syntax, so pot files written by the shell (or
+ * by dynamic_17) keep matching.
  *
+ * With SIMD, each key lives in its lane of an interleaved MD5 block at
+ * byte offset 16, padded and with its length set once by set_key().
+ * The first MD5(salt.key) writes its result over bytes 0..15 of that
+ * block (SSEi_OUTPUT_AS_INP_FMT), and so does each of the 2^N
+ * MD5(hash.key) after it, so the loop is nothing but SSEmd5body()
+ * calls on the same buffer.  Each lane has its own length and padding,
+ * so keys of any (short enough) length can share a block.
  */
 
 #if FMT_EXTERNS_H
@@ -39,28 +47,52 @@ john_register_one(&fmt_phpassmd5);
 
 #include <string.h>
 
+#include "arch.h"
+#include "md5.h"
 #include "common.h"
 #include "formats.h"
-#include "dynamic.h"
+#include "sse-intrinsics.h"
+
+#ifdef _OPENMP
+#define OMP_SCALE			4
+#include <omp.h>
+#endif
 #include "memdbg.h"
 
 #define FORMAT_LABEL			"phpass"
 #define FORMAT_NAME			""
+#define ALGORITHM_NAME			"MD5 " MD5_ALGORITHM_NAME
 
-#define ALGORITHM_NAME			"?" /* filled in by md5-gen */
 #define BENCHMARK_COMMENT		" ($P$9)"
 #define BENCHMARK_LENGTH		-1
 
-#define PLAINTEXT_LENGTH		38
 #define CIPHERTEXT_LENGTH		34
+#define DYNA_CIPHERTEXT_LENGTH		(TAG_LENGTH + 22 + 1 + 1 + 8)
+
+#define FORMAT_TAG			"$dynamic_17$"
+#define TAG_LENGTH			(sizeof(FORMAT_TAG) - 1)
 
-#define BINARY_SIZE				16
-#define SALT_SIZE				8
-#define DYNA_SALT_SIZE			(sizeof(char*))
-#define SALT_ALIGN				MEM_ALIGN_WORD
-#define BINARY_ALIGN			MEM_ALIGN_WORD
+#define BINARY_SIZE			16
+#define BINARY_ALIGN			4
+#define SALT_SIZE			sizeof(struct phpass_salt)
+#define SALT_ALIGN			4
+
+#ifdef MD5_SSE_PARA
+#define NBKEYS				(MMX_COEF * MD5_SSE_PARA)
+/* 16 bytes of hash, the key, and the 0x80 must fit in one block */
+#define PLAINTEXT_LENGTH		39
+#define MIN_KEYS_PER_CRYPT		NBKEYS
+#define MAX_KEYS_PER_CRYPT		NBKEYS
+/* Word 0 of index's lane, and byte i of the lane */
+#define WORDPOS(index)			( ((index)&(MMX_COEF-1)) + (index)/MMX_COEF*16*MMX_COEF )
+#define GETPOS(i, index)		( ((index)&(MMX_COEF-1))*4 + ((i)&(0xffffffff-3))*MMX_COEF + ((i)&3) + (index)/MMX_COEF*16*4*MMX_COEF )
+#else
+#define PLAINTEXT_LENGTH		125
+#define MIN_KEYS_PER_CRYPT		1
+#define MAX_KEYS_PER_CRYPT		1
+#endif
 
-static struct fmt_tests phpassmd5_tests[] = {
+static struct fmt_tests tests[] = {
 	{"$H$9aaaaaSXBjgypwqm.JsMssPLiS8YQ00", "test1"},
 	{"$H$9PE8jEklgZhgLmZl5.HYJAzfGCQtzi1", "123456"},
 	{"$H$9pdx7dbOW3Nnt32sikrjAxYFjX8XoK1", "123456"},
@@ -77,116 +109,375 @@ static struct fmt_tests phpassmd5_tests[] = {
 	{"$P$8DkV/nqeaQNTdp4NvWjCkgN48AK69X.", "test12345"}, // 1024
 	{"$P$B12345678L6Lpt4BxNotVIMILOa9u81", "JohnRipper"}, // 8192 (WordPress)
 	{"$P$91234567xogA.H64Lkk8Cx8vlWBVzH0", "thisisalongertst"},
+	{"$P$9Ab7/Qz.csc0br.58vUo1WnkW7nlzw0", "123456789012345678901234567890123456789"},
+	{"$dynamic_17$jgypwqm.JsMssPLiS8YQ00$9aaaaaSXB", "test1"},
 	{NULL}
 };
 
 /* (256+256+512+1024+8192)/5 = 2048 */
 
-static char Conv_Buf[80];
-static struct fmt_main *pDynamic_17;
-static void phpassmd5_init(struct fmt_main *self);
-static void get_ptr();
+struct phpass_salt {
+	ARCH_WORD_32 salt[2];
+	unsigned int count;
+};
+
+static struct phpass_salt *cur_salt;
+
+#ifdef MD5_SSE_PARA
+static ARCH_WORD_32 (*saved_key)[16*NBKEYS];
+#else
+static int (*saved_len);
+static char (*saved_key)[PLAINTEXT_LENGTH + 1];
+static ARCH_WORD_32 (*crypt_key)[BINARY_SIZE / 4];
+#endif
+
+static void init(struct fmt_main *self)
+{
+#ifdef _OPENMP
+	int omp_t = omp_get_max_threads();
+	self->params.min_keys_per_crypt *= omp_t;
+	omp_t *= OMP_SCALE;
+	self->params.max_keys_per_crypt *= omp_t;
+#endif
+#ifdef MD5_SSE_PARA
+	saved_key = mem_calloc_tiny(sizeof(*saved_key) *
+		self->params.max_keys_per_crypt / NBKEYS, MEM_ALIGN_SIMD);
+#else
+	saved_len = mem_calloc_tiny(sizeof(*saved_len) *
+		self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	saved_key = mem_calloc_tiny(sizeof(*saved_key) *
+		self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	crypt_key = mem_calloc_tiny(sizeof(*crypt_key) *
+		self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+#endif
+}
+
+static int valid(char *ciphertext, struct fmt_main *self)
+{
+	unsigned count_log2;
+	char *p = ciphertext;
+	int i;
+
+	// Handle both the phpass signature, and the phpBB v3 signature (same
+	// formula), as well as the $dynamic_17$ syntax of the former thin format.
+	// NOTE we are only dealing with the 'portable' encryption method
+	if (!strncmp(p, FORMAT_TAG, TAG_LENGTH)) {
+		if (strlen(p) != DYNA_CIPHERTEXT_LENGTH ||
+		    p[TAG_LENGTH + 22] != '$')
+			return 0;
+		for (i = TAG_LENGTH; i < TAG_LENGTH + 22; i++)
+			if (atoi64[ARCH_INDEX(p[i])] == 0x7F)
+				return 0;
+		p += TAG_LENGTH + 22 + 1;
+		count_log2 = atoi64[ARCH_INDEX(*p)];
+		while (*++p)
+			if (atoi64[ARCH_INDEX(*p)] == 0x7F)
+				return 0;
+	} else {
+		if (strlen(p) != CIPHERTEXT_LENGTH)
+			return 0;
+		if (strncmp(p, "$P$", 3) != 0 && strncmp(p, "$H$", 3) != 0)
+			return 0;
+		for (i = 3; i < CIPHERTEXT_LENGTH; ++i)
+			if (atoi64[ARCH_INDEX(p[i])] == 0x7F)
+				return 0;
+		count_log2 = atoi64[ARCH_INDEX(p[3])];
+	}
+	if (count_log2 < 7 || count_log2 > 31)
+		return 0;
+
+	return 1;
+}
 
 /* this function converts a 'native' phpass signature string into a $dynamic_17$ syntax string */
-static char *Convert(char *Buf, char *ciphertext)
+static char *split(char *ciphertext, int index, struct fmt_main *self)
 {
-	if (text_in_dynamic_format_already(pDynamic_17, ciphertext))
+	static char out[DYNA_CIPHERTEXT_LENGTH + 1];
+
+	if (!strncmp(ciphertext, FORMAT_TAG, TAG_LENGTH))
 		return ciphertext;
 
-	snprintf(Buf, sizeof(Conv_Buf), "$dynamic_17$%s%10.10s",
-	        &ciphertext[3+8+1], &ciphertext[2]);
-	return Buf;
+	snprintf(out, sizeof(out), FORMAT_TAG "%s%10.10s",
+	         &ciphertext[3+1+8], &ciphertext[2]);
+	return out;
 }
 
-static char *our_split(char *ciphertext, int index, struct fmt_main *self)
+//code from historical JtR phpass patch
+static void *binary(char *ciphertext)
 {
-	get_ptr();
-	return  pDynamic_17->methods.split(Convert(Conv_Buf, ciphertext), index, self);
+	static union {
+		unsigned char c[BINARY_SIZE];
+		ARCH_WORD_32 w[BINARY_SIZE / 4];
+	} out;
+	unsigned char *b = out.c;
+	int i, bidx = 0;
+	unsigned sixbits;
+	char *pos = &ciphertext[TAG_LENGTH];
+
+	for (i = 0; i < 5; i++) {
+		sixbits = atoi64[ARCH_INDEX(*pos++)];
+		b[bidx] = sixbits;
+		sixbits = atoi64[ARCH_INDEX(*pos++)];
+		b[bidx++] |= (sixbits << 6);
+		sixbits >>= 2;
+		b[bidx] = sixbits;
+		sixbits = atoi64[ARCH_INDEX(*pos++)];
+		b[bidx++] |= (sixbits << 4);
+		sixbits >>= 4;
+		b[bidx] = sixbits;
+		sixbits = atoi64[ARCH_INDEX(*pos++)];
+		b[bidx++] |= (sixbits << 2);
+	}
+	sixbits = atoi64[ARCH_INDEX(*pos++)];
+	b[bidx] = sixbits;
+	sixbits = atoi64[ARCH_INDEX(*pos++)];
+	b[bidx] |= (sixbits << 6);
+	return out.c;
 }
 
-static int phpassmd5_valid(char *ciphertext, struct fmt_main *self)
+static void *get_salt(char *ciphertext)
 {
-		int i;
-		unsigned count_log2;
+	static struct phpass_salt out;
+	char *p = &ciphertext[TAG_LENGTH + 22 + 1];
 
-		if (!ciphertext || strlen(ciphertext) < CIPHERTEXT_LENGTH)
-				return 0;
-		get_ptr();
-		if (strlen(ciphertext) != CIPHERTEXT_LENGTH) {
-			return pDynamic_17->methods.valid(ciphertext, pDynamic_17);
-		}
-		// Handle both the phpass signature, and the phpBB v3 signature (same formula)
-		// NOTE we are only dealing with the 'portable' encryption method
-		if (strncmp(ciphertext, "$P$", 3) != 0 && strncmp(ciphertext, "$H$", 3) != 0)
-				return 0;
-		for (i = 3; i < 34; ++i)
-				if (atoi64[ARCH_INDEX(ciphertext[i])] == 0x7F)
-						return 0;
+	memset(&out, 0, sizeof(out));
+	out.count = 1U << atoi64[ARCH_INDEX(*p)];
+	memcpy(out.salt, p + 1, 8);
+	return &out;
+}
 
-		count_log2 = atoi64[ARCH_INDEX(ciphertext[3])];
-		if (count_log2 < 7 || count_log2 > 31)
-				return 0;
+#if FMT_MAIN_VERSION > 11
+static unsigned int iteration_count(void *salt)
+{
+	return ((struct phpass_salt *)salt)->count;
+}
+#endif
+
+static int salt_hash(void *salt)
+{
+	struct phpass_salt *s = salt;
 
-		return pDynamic_17->methods.valid(Convert(Conv_Buf, ciphertext), pDynamic_17);
+	return (s->salt[0] ^ (s->salt[1] >> 5) ^ s->count) &
+		(SALT_HASH_SIZE - 1);
 }
 
-static void * our_salt(char *ciphertext)
+static void set_salt(void *salt)
 {
-	get_ptr();
-	return pDynamic_17->methods.salt(Convert(Conv_Buf, ciphertext));
+	cur_salt = salt;
 }
-static void * our_binary(char *ciphertext)
+
+#ifdef MD5_SSE_PARA
+static void set_key(char *key, int index)
 {
-	get_ptr();
-	return pDynamic_17->methods.binary(Convert(Conv_Buf, ciphertext));
+	ARCH_WORD_32 *keybuf = &((ARCH_WORD_32 *)saved_key)[WORDPOS(index)];
+	unsigned char *p = (unsigned char *)saved_key;
+	int len = strlen(key);
+	int i;
+
+	for (i = 4; i < 14; i++)
+		keybuf[i*MMX_COEF] = 0;
+	for (i = 0; i < len; i++)
+		p[GETPOS(16 + i, index)] = key[i];
+	p[GETPOS(16 + len, index)] = 0x80;
+	keybuf[14*MMX_COEF] = (16 + len) << 3;
 }
 
-struct fmt_main fmt_phpassmd5 =
+static char *get_key(int index)
 {
-	{
-		// setup the labeling and stuff. NOTE the max and min crypts are set to 1
-		// here, but will be reset within our init() function.
-		FORMAT_LABEL, FORMAT_NAME, ALGORITHM_NAME, BENCHMARK_COMMENT, BENCHMARK_LENGTH,
-		PLAINTEXT_LENGTH, BINARY_SIZE, BINARY_ALIGN, DYNA_SALT_SIZE, SALT_ALIGN, 1, 1, FMT_CASE | FMT_8_BIT | FMT_DYNAMIC,
-#if FMT_MAIN_VERSION > 11
-		{ NULL },
+	static char out[PLAINTEXT_LENGTH + 1];
+	unsigned char *p = (unsigned char *)saved_key;
+	int len = (((ARCH_WORD_32 *)saved_key)[WORDPOS(index) + 14*MMX_COEF] >> 3) - 16;
+	int i;
+
+	for (i = 0; i < len; i++)
+		out[i] = p[GETPOS(16 + i, index)];
+	out[i] = 0;
+	return out;
+}
+#else
+static void set_key(char *key, int index)
+{
+	saved_len[index] = strlen(key);
+	memcpy(saved_key[index], key, saved_len[index] + 1);
+}
+
+static char *get_key(int index)
+{
+	return saved_key[index];
+}
 #endif
-		phpassmd5_tests
-	},
-	{
-		/*  All we setup here, is the pointer to valid, and the pointer to init */
-		/*  within the call to init, we will properly set this full object      */
-		phpassmd5_init,
-		fmt_default_done,
-		fmt_default_reset,
-		fmt_default_prepare,
-		phpassmd5_valid,
-		our_split
+
+static int crypt_all(int *pcount, struct db_salt *salt)
+{
+	int count = *pcount;
+	int index;
+#ifdef MD5_SSE_PARA
+	int loops = (count + NBKEYS - 1) / NBKEYS;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < loops; index++) {
+		JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_32 first[16*NBKEYS];
+		ARCH_WORD_32 *key = saved_key[index];
+		unsigned int i, j, k;
+
+		/*
+		 * salt.key is the key block with the key moved from byte 16
+		 * down to byte 8, which is just a shift by two words.
+		 */
+		for (j = 0; j < MD5_SSE_PARA; j++) {
+			ARCH_WORD_32 *in = &key[j*16*MMX_COEF];
+			ARCH_WORD_32 *out = &first[j*16*MMX_COEF];
+
+			for (k = 0; k < MMX_COEF; k++) {
+				out[k] = cur_salt->salt[0];
+				out[MMX_COEF + k] = cur_salt->salt[1];
+				for (i = 2; i < 12; i++)
+					out[i*MMX_COEF + k] = in[(i + 2)*MMX_COEF + k];
+				out[12*MMX_COEF + k] = 0;
+				out[13*MMX_COEF + k] = 0;
+				out[14*MMX_COEF + k] = in[14*MMX_COEF + k] - (8 << 3);
+				out[15*MMX_COEF + k] = 0;
+			}
+		}
+		SSEmd5body((__m128i *)first, key, NULL,
+		           SSEi_MIXED_IN | SSEi_OUTPUT_AS_INP_FMT);
+
+		for (i = cur_salt->count; i; i--)
+			SSEmd5body((__m128i *)key, key, NULL,
+			           SSEi_MIXED_IN | SSEi_OUTPUT_AS_INP_FMT);
 	}
-};
+#else
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < count; index++) {
+		MD5_CTX ctx;
+		unsigned int i;
+
+		MD5_Init(&ctx);
+		MD5_Update(&ctx, cur_salt->salt, 8);
+		MD5_Update(&ctx, saved_key[index], saved_len[index]);
+		MD5_Final((unsigned char *)crypt_key[index], &ctx);
 
-static void link_funcs() {
-	fmt_phpassmd5.methods.salt   = our_salt;
-	fmt_phpassmd5.methods.binary = our_binary;
-	fmt_phpassmd5.methods.split = our_split;
+		for (i = cur_salt->count; i; i--) {
+			MD5_Init(&ctx);
+			MD5_Update(&ctx, crypt_key[index], 16);
+			MD5_Update(&ctx, saved_key[index], saved_len[index]);
+			MD5_Final((unsigned char *)crypt_key[index], &ctx);
+		}
+	}
+#endif
+	return count;
 }
 
-static void phpassmd5_init(struct fmt_main *self)
+#ifdef MD5_SSE_PARA
+#define HASH_WORD(index, i)	((ARCH_WORD_32 *)saved_key)[WORDPOS(index) + (i)*MMX_COEF]
+#else
+#define HASH_WORD(index, i)	crypt_key[index][i]
+#endif
+
+static int get_hash_0(int index) { return HASH_WORD(index, 0) & 0xf; }
+static int get_hash_1(int index) { return HASH_WORD(index, 0) & 0xff; }
+static int get_hash_2(int index) { return HASH_WORD(index, 0) & 0xfff; }
+static int get_hash_3(int index) { return HASH_WORD(index, 0) & 0xffff; }
+static int get_hash_4(int index) { return HASH_WORD(index, 0) & 0xfffff; }
+static int get_hash_5(int index) { return HASH_WORD(index, 0) & 0xffffff; }
+static int get_hash_6(int index) { return HASH_WORD(index, 0) & 0x7ffffff; }
+
+static int cmp_all(void *binary, int count)
 {
-	get_ptr();
-	if (self->private.initialized == 0) {
-		pDynamic_17 = dynamic_THIN_FORMAT_LINK(&fmt_phpassmd5, Convert(Conv_Buf, phpassmd5_tests[0].ciphertext), "phpass", 1);
-		link_funcs();
-		fmt_phpassmd5.params.algorithm_name = pDynamic_17->params.algorithm_name;
-		self->private.initialized = 1;
-	}
+	int index;
+
+	for (index = 0; index < count; index++)
+		if (((ARCH_WORD_32 *)binary)[0] == HASH_WORD(index, 0))
+			return 1;
+	return 0;
 }
 
-static void get_ptr() {
-	if (!pDynamic_17) {
-		pDynamic_17 = dynamic_THIN_FORMAT_LINK(&fmt_phpassmd5, Convert(Conv_Buf, phpassmd5_tests[0].ciphertext), "phpass", 0);
-		link_funcs();
-	}
+static int cmp_one(void *binary, int index)
+{
+	int i;
+
+	for (i = 0; i < BINARY_SIZE / 4; i++)
+		if (((ARCH_WORD_32 *)binary)[i] != HASH_WORD(index, i))
+			return 0;
+	return 1;
+}
+
+static int cmp_exact(char *source, int index)
+{
+	return 1;
 }
 
+struct fmt_main fmt_phpassmd5 = {
+	{
+		FORMAT_LABEL,
+		FORMAT_NAME,
+		ALGORITHM_NAME,
+		BENCHMARK_COMMENT,
+		BENCHMARK_LENGTH,
+		PLAINTEXT_LENGTH,
+		BINARY_SIZE,
+		BINARY_ALIGN,
+		SALT_SIZE,
+		SALT_ALIGN,
+		MIN_KEYS_PER_CRYPT,
+		MAX_KEYS_PER_CRYPT,
+#ifdef _OPENMP
+		FMT_OMP |
+#endif
+		FMT_CASE | FMT_8_BIT,
+#if FMT_MAIN_VERSION > 11
+		{
+			"iteration count",
+		},
+#endif
+		tests
+	}, {
+		init,
+		fmt_default_done,
+		fmt_default_reset,
+		fmt_default_prepare,
+		valid,
+		split,
+		binary,
+		get_salt,
+#if FMT_MAIN_VERSION > 11
+		{
+			iteration_count,
+		},
+#endif
+		fmt_default_source,
+		{
+			fmt_default_binary_hash_0,
+			fmt_default_binary_hash_1,
+			fmt_default_binary_hash_2,
+			fmt_default_binary_hash_3,
+			fmt_default_binary_hash_4,
+			fmt_default_binary_hash_5,
+			fmt_default_binary_hash_6
+		},
+		salt_hash,
+		set_salt,
+		set_key,
+		get_key,
+		fmt_default_clear_keys,
+		crypt_all,
+		{
+			get_hash_0,
+			get_hash_1,
+			get_hash_2,
+			get_hash_3,
+			get_hash_4,
+			get_hash_5,
+			get_hash_6
+		},
+		cmp_all,
+		cmp_one,
+		cmp_exact
+	}
+};
+
 #endif /* plugin stanza */
@@ -36,6 +36,7 @@ john_register_one(&fmt_pkzip);
 #ifdef _OPENMP
 #include <omp.h>
 #endif
+#include "threadpool.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL			"PKZIP"
@@ -1285,27 +1286,18 @@ MAYBE_INLINE static int check_inflate_CODE1(u8 *next, int left) {
  * not mean we have found the password.  Just that all hashes quick check checksums
  * for this password 'work'.
  */
-static int crypt_all(int *pcount, struct db_salt *_salt)
-{
-	int _count = *pcount;
-	int idx;
 #if (ZIP_DEBUG==2)
-	static int CNT, FAILED, FAILED2;
-	++CNT;
+static int CNT, FAILED, FAILED2;
 #endif
 
-	// pkzip kinda sucks a little for multi-threading, since there is different amount of work to be
-	// done, depenging upon the password.  Thus, we pack in OMP_MOD passwords into each thread, and
-	// hopefully some of the differnces will even themselves out in the end.  If we have 2 threads
-	// then thread 1 gets 0 to 127 password, and thread 2 gets 128-256.  Once they 'get' their data,
-	// there should be no mutexing of the runtime data, thus the threads should run fast.
-	// Also, since we have 'multiple' files in a .zip file (and multiple checksums), we bail as at the
-	// first time we fail to match checksum.  So, there may be some threads which check more checksums.
-	// Again, hopefully globbing many tests into a threads working set will flatten out these differences.
-#ifdef _OPENMP
-#pragma omp parallel for private(idx)
+static void crypt_range(int start, int end, int thread, void *arg)
+{
+#if (ZIP_DEBUG==2)
+	int _count = *(int*)arg;
 #endif
-	for (idx = 0; idx < _count; ++idx) {
+	int idx;
+
+	for (idx = start; idx < end; ++idx) {
 		int cur_hash_count = salt->cnt;
 		int cur_hash_idx = -1;
 		MY_WORD key0, key1, key2;
@@ -1610,6 +1602,22 @@ Failed_Bailout: ;
 		/* We load the wrong checksum value for the gethash */
 		chk[idx] = 0;
 	}
+}
+
+static int crypt_all(int *pcount, struct db_salt *_salt)
+{
+	int _count = *pcount;
+#if (ZIP_DEBUG==2)
+	++CNT;
+#endif
+
+	// pkzip kinda sucks a little for multi-threading, since there is different amount of work to be
+	// done, depenging upon the password.  Since we have 'multiple' files in a .zip file (and multiple
+	// checksums), we bail as at the first time we fail to match checksum, so some passwords cost a
+	// lot more than others.  The passwords are handed to the thread pool in chunks, and a thread that
+	// is done with its own chunks steals from the others, so these differences even themselves out.
+	// Once they 'get' their data, there should be no mutexing of the runtime data.
+	tpool_for(_count, 0, crypt_range, &_count);
 
 	/* clear the 'dirty' flag.  Then on multiple different salt calls, we will not have to */
 	/* encrypt the passwords again. They will have already been loaded in the K12[] array. */
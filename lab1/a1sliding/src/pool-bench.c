@@ -0,0 +1,146 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Benchmark comparing "#pragma omp parallel for" with the persistent thread
+ * pool (threadpool.c) over a range of thread counts.
+ *
+ * Usage: pool-bench [MAX_THREADS [ITEMS_PER_THREAD [ITERATIONS]]]
+ *
+ * Every "call" mimics one crypt_all() for one salt: ITEMS_PER_THREAD work
+ * items per thread, each costing ITERATIONS rounds of integer mixing.  The
+ * "skewed" workload makes one item in 16 cost 32 times as much, which is
+ * what archive formats (7z, RAR, PKZIP) see when most candidates are
+ * rejected early and a few go on to a full decompression check.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arch.h"
+#include "common.h"
+#include "memory.h"
+#include "threadpool.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "memdbg.h"
+
+#define DEFAULT_MAX_THREADS		128
+#define DEFAULT_ITEMS_PER_THREAD	64
+#define DEFAULT_ITERATIONS		2000
+#define BENCH_SECONDS			0.5
+
+static ARCH_WORD_32 *results;
+static int iterations, skewed;
+
+static ARCH_WORD_32 work_item(int index)
+{
+	ARCH_WORD_32 x = index * 0x9E3779B9U;
+	int i, n = iterations;
+
+	if (skewed && !(index & 15))
+		n *= 32;
+	for (i = 0; i < n; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+	}
+	return x;
+}
+
+static void pool_fn(int start, int end, int thread, void *arg)
+{
+	int index;
+
+	for (index = start; index < end; index++)
+		results[index] = work_item(index);
+}
+
+#ifdef _OPENMP
+static double run(int method, int count)
+{
+	double start = omp_get_wtime(), now;
+	unsigned int calls = 0;
+	int index;
+
+	do {
+		switch (method) {
+		case 0:
+#pragma omp parallel for
+			for (index = 0; index < count; index++)
+				results[index] = work_item(index);
+			break;
+		case 1:
+#pragma omp parallel for schedule(dynamic)
+			for (index = 0; index < count; index++)
+				results[index] = work_item(index);
+			break;
+		default:
+			tpool_for(count, 0, pool_fn, NULL);
+		}
+		calls++;
+	} while ((now = omp_get_wtime()) - start < BENCH_SECONDS);
+
+	return calls / (now - start);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+#ifdef _OPENMP
+	int max_threads = DEFAULT_MAX_THREADS;
+	int items = DEFAULT_ITEMS_PER_THREAD;
+	int threads;
+
+	iterations = DEFAULT_ITERATIONS;
+	if (argc > 1)
+		max_threads = atoi(argv[1]);
+	if (argc > 2)
+		items = atoi(argv[2]);
+	if (argc > 3)
+		iterations = atoi(argv[3]);
+	if (max_threads < 1 || items < 1 || iterations < 1) {
+		fprintf(stderr, "Usage: %s [MAX_THREADS [ITEMS_PER_THREAD "
+		        "[ITERATIONS]]]\n", argv[0]);
+		return 1;
+	}
+
+	results = mem_alloc(sizeof(*results) * max_threads * items);
+
+	printf("%d items per thread, %d iterations per item, "
+	       "%d CPUs online\n", items, iterations, omp_get_num_procs());
+	for (skewed = 0; skewed < 2; skewed++) {
+		printf("\n%s workload, calls/s:\n"
+		       "threads    omp static   omp dynamic          pool"
+		       "   pool/static\n",
+		       skewed ? "Skewed" : "Uniform");
+		for (threads = 1; threads <= max_threads; threads <<= 1) {
+			double c[3];
+			int method;
+
+			omp_set_num_threads(threads);
+			tpool_init(threads);
+			for (method = 0; method < 3; method++)
+				c[method] = run(method, threads * items);
+			printf("%7d %13.1f %13.1f %13.1f %12.2fx\n",
+			       threads, c[0], c[1], c[2], c[2] / c[0]);
+			fflush(stdout);
+		}
+	}
+
+	tpool_done();
+	MEM_FREE(results);
+	return 0;
+#else
+	fprintf(stderr, "%s: this build has no OpenMP support, nothing to "
+	        "compare\n", argv[0]);
+	return 1;
+#endif
+}
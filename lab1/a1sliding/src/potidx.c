@@ -0,0 +1,541 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Pot file index, see potidx.h.
+ *
+ * The file is a header followed by a power of two number of slots, each
+ * holding a 64-bit FNV-1a hash of a canonical ciphertext (0 meaning an empty
+ * slot) and the offset of its pot line.  Collisions are resolved by linear probing, and
+ * the table is doubled into a new file, renamed over the old one, when it
+ * gets 3/4 full.  Whoever changes the index holds the pot file's lock, so
+ * readers that have it mapped only ever see complete entries being added, or
+ * keep the old file if it was replaced.
+ */
+
+#if AC_BUILT
+#include "autoconfig.h"
+#endif
+
+#define NEED_OS_FLOCK
+#include "os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#if !AC_BUILT || HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if OS_FLOCK
+#include <sys/file.h>
+#endif
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include "arch.h"
+#include "misc.h"
+#include "params.h"
+#include "path.h"
+#include "memory.h"
+#include "options.h"
+#include "config.h"
+#include "potidx.h"
+#include "cachefile.h"
+#include "memdbg.h"
+
+#if HAVE_MMAP && OS_FLOCK
+
+#define POTIDX_MAGIC			"JtRpidx2"
+
+/* Initial number of slots */
+#define POTIDX_MIN_SIZE			0x10000
+
+/*
+ * Bytes read from the pot file to verify a hit; longer lines are re-read in
+ * full.
+ */
+#define POTIDX_PEEK			1024
+
+struct potidx_header {
+	char magic[8];
+	uint64_t size;		/* Number of slots */
+	uint64_t count;		/* Slots in use */
+	uint64_t covered;	/* Bytes of the pot file indexed */
+	uint32_t field_sep;
+	uint32_t unused;
+	uint64_t canon;		/* Key of the format label and john version */
+	uint64_t reserved[2];
+};
+
+struct potidx_entry {
+	uint64_t key, offset;
+};
+
+struct potidx {
+	struct fmt_main *format;
+	char *name;
+	int pot_fd, fd;
+	size_t map_size;
+	struct potidx_header *header;
+	struct potidx_entry *table;
+	char *line, *ciphertext;
+};
+
+/* The format of the last index opened, for potidx_update() */
+static struct fmt_main *potidx_format;
+
+static uint64_t potidx_key(char *ciphertext, size_t length)
+{
+	uint64_t hash = CACHEFILE_HASH_INIT;
+
+	cachefile_hash(&hash, ciphertext, length);
+
+	return hash ? hash : 1;
+}
+
+/*
+ * The keys change when the format's split() may, that is with its label and
+ * the version of john.
+ */
+static uint64_t potidx_canon_key(struct fmt_main *format)
+{
+	uint64_t hash = CACHEFILE_HASH_INIT;
+
+	cachefile_hash_str(&hash, format->params.label);
+	cachefile_hash_str(&hash, JOHN_VERSION);
+
+	return hash;
+}
+
+/*
+ * Returns the pot file ciphertext field the way the loader has it, or NULL
+ * if it isn't for our format.
+ */
+static char *potidx_canon(struct potidx *idx, char *ciphertext)
+{
+	struct fmt_main *format = idx->format;
+
+	if (format->methods.valid(ciphertext, format) != 1)
+		return NULL;
+
+	return format->methods.split(ciphertext, 0, format);
+}
+
+static void potidx_put(struct potidx_entry *table, uint64_t size,
+	uint64_t key, uint64_t offset)
+{
+	uint64_t i = key & (size - 1);
+
+	while (table[i].key)
+		i = (i + 1) & (size - 1);
+
+	table[i].offset = offset;
+	table[i].key = key;
+}
+
+static void potidx_unmap(struct potidx *idx)
+{
+	if (idx->header)
+		munmap(idx->header, idx->map_size);
+	idx->header = NULL;
+	idx->table = NULL;
+	if (idx->fd >= 0)
+		close(idx->fd);
+	idx->fd = -1;
+}
+
+/*
+ * Maps the already opened index file, returning 0 if it isn't valid.
+ */
+static int potidx_map(struct potidx *idx)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(idx->fd, &st) || st.st_size < sizeof(struct potidx_header))
+		return 0;
+	if ((uint64_t)st.st_size != (size_t)st.st_size)
+		return 0;
+
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	           idx->fd, 0);
+	if (map == MAP_FAILED)
+		return 0;
+
+	idx->header = map;
+	idx->map_size = st.st_size;
+	idx->table = (struct potidx_entry *)(idx->header + 1);
+
+	if (memcmp(idx->header->magic, POTIDX_MAGIC, 8) ||
+	    !idx->header->size ||
+	    (idx->header->size & (idx->header->size - 1)) ||
+	    idx->map_size != sizeof(struct potidx_header) +
+	    idx->header->size * sizeof(struct potidx_entry)) {
+		munmap(map, st.st_size);
+		idx->header = NULL;
+		idx->table = NULL;
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Writes a new index file with "size" slots, holding what the current one
+ * has (if any), and renames it over the current one.
+ */
+static int potidx_create(struct potidx *idx, uint64_t size)
+{
+	struct potidx old = *idx;
+	char *tmp_name;
+	uint64_t i;
+
+	tmp_name = mem_alloc(strlen(idx->name) + 5);
+	sprintf(tmp_name, "%s.tmp", idx->name);
+
+	idx->header = NULL;
+	if ((idx->fd = open(tmp_name, O_RDWR | O_CREAT | O_TRUNC,
+	    S_IRUSR | S_IWUSR)) < 0 ||
+	    ftruncate(idx->fd, sizeof(struct potidx_header) +
+	    size * sizeof(struct potidx_entry))) {
+		if (idx->fd >= 0)
+			close(idx->fd);
+		*idx = old;
+		MEM_FREE(tmp_name);
+		return 0;
+	}
+
+	idx->map_size = 0;
+	if (!(idx->header = mmap(NULL, sizeof(struct potidx_header) +
+	    size * sizeof(struct potidx_entry), PROT_READ | PROT_WRITE,
+	    MAP_SHARED, idx->fd, 0)) || idx->header == MAP_FAILED) {
+		close(idx->fd);
+		unlink(tmp_name);
+		*idx = old;
+		MEM_FREE(tmp_name);
+		return 0;
+	}
+	idx->map_size = sizeof(struct potidx_header) +
+		size * sizeof(struct potidx_entry);
+	idx->table = (struct potidx_entry *)(idx->header + 1);
+
+	memcpy(idx->header->magic, POTIDX_MAGIC, 8);
+	idx->header->size = size;
+	idx->header->field_sep = (unsigned char)options.loader.field_sep_char;
+	idx->header->canon = potidx_canon_key(idx->format);
+
+	if (old.header) {
+		for (i = 0; i < old.header->size; i++)
+		if (old.table[i].key)
+			potidx_put(idx->table, size, old.table[i].key,
+			           old.table[i].offset);
+		idx->header->count = old.header->count;
+		idx->header->covered = old.header->covered;
+		potidx_unmap(&old);
+	}
+
+	if (rename(tmp_name, idx->name)) {
+		unlink(tmp_name);
+		MEM_FREE(tmp_name);
+		return 0;
+	}
+
+	MEM_FREE(tmp_name);
+	return 1;
+}
+
+static int potidx_insert(struct potidx *idx, uint64_t key, uint64_t offset)
+{
+	struct potidx_header *header = idx->header;
+
+	if ((header->count + 1) * 4 > header->size * 3 &&
+	    !potidx_create(idx, header->size * 2))
+		return 0;
+
+	potidx_put(idx->table, idx->header->size, key, offset);
+	idx->header->count++;
+
+	return 1;
+}
+
+/*
+ * Indexes the pot file from where we left off to its last complete line.
+ * Starts over if the pot file is shorter than what we've indexed, which
+ * means it was replaced or edited.
+ */
+static int potidx_sync(struct potidx *idx)
+{
+	struct stat st;
+	FILE *file;
+	char *line = idx->line;
+	int64_t pos;
+	int fd;
+
+	if (fstat(idx->pot_fd, &st))
+		return 0;
+
+	if (idx->header->covered > (uint64_t)st.st_size ||
+	    idx->header->field_sep !=
+	    (unsigned char)options.loader.field_sep_char ||
+	    idx->header->canon != potidx_canon_key(idx->format)) {
+		potidx_unmap(idx);
+		if (!potidx_create(idx, POTIDX_MIN_SIZE))
+			return 0;
+	}
+
+	if (idx->header->covered == (uint64_t)st.st_size)
+		return 1;
+
+	if ((fd = dup(idx->pot_fd)) < 0)
+		return 0;
+	if (!(file = fdopen(fd, "rb"))) {
+		close(fd);
+		return 0;
+	}
+
+	pos = idx->header->covered;
+	if (jtr_fseek64(file, pos, SEEK_SET)) {
+		fclose(file);
+		return 0;
+	}
+
+	while (fgets(line, LINE_BUFFER_SIZE, file)) {
+		size_t length = strlen(line);
+		char *p;
+
+		if (!length || line[length - 1] != '\n') {
+			int c;
+
+			if (feof(file))
+				break;
+/* Not written by us, and too long for anything reading the pot file */
+			while ((c = getc(file)) != EOF && c != '\n')
+				;
+			if (c == EOF)
+				break;
+		} else
+		if ((p = memchr(line, options.loader.field_sep_char, length))) {
+			char *ciphertext;
+
+			*p = 0;
+			if ((ciphertext = potidx_canon(idx, line)) &&
+			    !potidx_insert(idx, potidx_key(ciphertext,
+			    strlen(ciphertext)), pos))
+				break;
+		}
+
+		pos = jtr_ftell64(file);
+	}
+
+	if (idx->header)
+		idx->header->covered = pos;
+
+	fclose(file);
+
+	return idx->header != NULL;
+}
+
+static struct potidx *potidx_open_locked(char *name,
+	struct fmt_main *format, int lock)
+{
+	struct potidx *idx;
+	char *pot_name;
+
+	if (!potidx_enabled() || !format)
+		return NULL;
+
+	pot_name = path_expand(name);
+
+	idx = mem_calloc(sizeof(*idx));
+	idx->format = format;
+	idx->fd = -1;
+	if ((idx->pot_fd = open(pot_name, O_RDONLY)) < 0) {
+		MEM_FREE(idx);
+		return NULL;
+	}
+
+	if (lock)
+	while (flock(idx->pot_fd, LOCK_EX)) {
+		if (errno != EINTR)
+			pexit("flock(LOCK_EX)");
+	}
+
+	idx->name = mem_alloc(strlen(pot_name) +
+	    strlen(format->params.label) + 1 + sizeof(POTIDX_SUFFIX));
+	sprintf(idx->name, "%s.%s" POTIDX_SUFFIX, pot_name,
+	    format->params.label);
+	idx->line = mem_alloc(LINE_BUFFER_SIZE);
+	idx->ciphertext = mem_alloc(LINE_BUFFER_SIZE);
+
+	if ((idx->fd = open(idx->name, O_RDWR)) >= 0 && !potidx_map(idx)) {
+		close(idx->fd);
+		idx->fd = -1;
+	}
+	if ((idx->fd < 0 && !potidx_create(idx, POTIDX_MIN_SIZE)) ||
+	    !potidx_sync(idx)) {
+		potidx_close(idx);
+		return NULL;
+	}
+
+	if (lock && flock(idx->pot_fd, LOCK_UN))
+		pexit("flock(LOCK_UN)");
+
+	return idx;
+}
+
+struct potidx *potidx_open(char *name, struct fmt_main *format)
+{
+	potidx_format = format;
+
+	return potidx_open_locked(name, format, 1);
+}
+
+void potidx_update(char *name)
+{
+	struct potidx *idx;
+
+	if ((idx = potidx_open_locked(name, potidx_format, 0)))
+		potidx_close(idx);
+}
+
+/*
+ * Returns the plaintext if the pot line at "offset" is for "ciphertext".
+ */
+static char *potidx_check(struct potidx *idx, uint64_t offset,
+	char *ciphertext, size_t length)
+{
+	char *line = idx->line, *p, *canon;
+	size_t want = length + 1 + POTIDX_PEEK;
+	ssize_t count;
+
+	while (1) {
+		if (want > LINE_BUFFER_SIZE - 1)
+			want = LINE_BUFFER_SIZE - 1;
+		if ((count = pread(idx->pot_fd, line, want, offset)) < 0)
+			return NULL;
+		line[count] = 0;
+
+		if ((p = strchr(line, '\n'))) {
+			*p = 0;
+			if (p > line && p[-1] == '\r')
+				p[-1] = 0;
+			break;
+		}
+		if (count < want || want == LINE_BUFFER_SIZE - 1)
+			break;
+		want = LINE_BUFFER_SIZE - 1;
+	}
+
+	if (!(p = strchr(line, options.loader.field_sep_char)))
+		return NULL;
+	*p++ = 0;
+
+/* Lines we wrote ourselves are canonical already */
+	if (!strcmp(line, ciphertext))
+		return p;
+	if ((canon = potidx_canon(idx, line)) && !strcmp(canon, ciphertext))
+		return p;
+
+	return NULL;
+}
+
+char *potidx_lookup(struct potidx *idx, char *ciphertext, int64_t from)
+{
+	size_t length;
+	uint64_t key, mask, i;
+	char *plaintext = NULL;
+
+/*
+ * It may be in split()'s buffer, which checking a non-canonical line reuses,
+ * so we work on a copy and put it back if need be.
+ */
+	if ((length = strlen(ciphertext)) >= LINE_BUFFER_SIZE)
+		return NULL;
+	memcpy(idx->ciphertext, ciphertext, length + 1);
+
+	key = potidx_key(idx->ciphertext, length);
+	mask = idx->header->size - 1;
+	i = key & mask;
+
+	while (idx->table[i].key) {
+		if (idx->table[i].key == key &&
+		    idx->table[i].offset >= (uint64_t)from &&
+		    (plaintext = potidx_check(idx, idx->table[i].offset,
+		    idx->ciphertext, length)))
+			break;
+		i = (i + 1) & mask;
+	}
+
+	if (strcmp(ciphertext, idx->ciphertext))
+		strcpy(ciphertext, idx->ciphertext);
+
+	return plaintext;
+}
+
+int64_t potidx_covered(struct potidx *idx)
+{
+	return idx->header->covered;
+}
+
+void potidx_close(struct potidx *idx)
+{
+	potidx_unmap(idx);
+	close(idx->pot_fd);
+	MEM_FREE(idx->line);
+	MEM_FREE(idx->ciphertext);
+	MEM_FREE(idx->name);
+	MEM_FREE(idx);
+}
+
+int potidx_enabled(void)
+{
+	static int enabled = -1;
+
+	if (enabled < 0)
+		enabled = cfg_get_bool(SECTION_OPTIONS, NULL, "PotIndex", 0);
+
+	return enabled;
+}
+
+#else
+
+int potidx_enabled(void)
+{
+	return 0;
+}
+
+struct potidx *potidx_open(char *name, struct fmt_main *format)
+{
+	return NULL;
+}
+
+char *potidx_lookup(struct potidx *idx, char *ciphertext, int64_t from)
+{
+	return NULL;
+}
+
+int64_t potidx_covered(struct potidx *idx)
+{
+	return 0;
+}
+
+void potidx_close(struct potidx *idx)
+{
+}
+
+void potidx_update(char *name)
+{
+}
+
+#endif
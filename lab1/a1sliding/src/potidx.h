@@ -0,0 +1,83 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Pot file index: optional companion files (the pot file's name followed by
+ * a format label and POTIDX_SUFFIX) each holding an open addressing hash
+ * table that maps the canonical ciphertext of every pot line that is valid
+ * for that format, as the format's split() makes it, to the line's offset.
+ * This lets the loader, --show and pot sync look up the hashes they have
+ * instead of parsing the entire pot file, and finds the same lines as a full
+ * read would, including those written by other programs in another form.
+ *
+ * The pot file stays the only source of truth: every hit is verified against
+ * the line it points to, and an index is brought up to date from the pot file
+ * (or rebuilt, if the pot file shrank) whenever it is opened.  The index of a
+ * format is built by the first run that uses it, which takes about as long
+ * as reading the pot file would.
+ *
+ * This is enabled with "PotIndex = Y" in john.conf.
+ */
+
+#ifndef _JOHN_POTIDX_H
+#define _JOHN_POTIDX_H
+
+#include "jumbo.h"
+#include "formats.h"
+
+#define POTIDX_SUFFIX			".idx"
+
+/*
+ * Pot sync looks up the remaining hashes in the index instead of reading the
+ * new part of the pot file when the latter is larger than this many bytes per
+ * remaining hash.
+ */
+#define POTIDX_SYNC_BYTES		64
+
+struct potidx;
+
+/*
+ * Returns non-zero if the index is enabled in john.conf and supported on
+ * this system.
+ */
+extern int potidx_enabled(void);
+
+/*
+ * Opens the index of "format", which must have been initialized, for the pot
+ * file "name", creating or updating it as needed.  The pot file is locked
+ * while doing so, but not after return.  Returns NULL if the index is
+ * disabled or can't be used, in which case the pot file should be read as
+ * usual.
+ */
+extern struct potidx *potidx_open(char *name, struct fmt_main *format);
+
+/*
+ * Looks up "ciphertext" (as returned by the format's split() or source()) among
+ * the pot lines starting at offset "from" or later.  Returns the plaintext
+ * field of the first match (in a buffer that is overwritten by the next
+ * call), or NULL.
+ */
+extern char *potidx_lookup(struct potidx *idx, char *ciphertext, int64_t from);
+
+/*
+ * Returns the offset up to which the pot file has been indexed, which is
+ * where a subsequent read of new lines would start.
+ */
+extern int64_t potidx_covered(struct potidx *idx);
+
+extern void potidx_close(struct potidx *idx);
+
+/*
+ * Brings the index of the format last opened up to date after lines were
+ * appended to the pot file.  The caller must hold the pot file's lock, and
+ * must not run concurrently with the format's methods.
+ */
+extern void potidx_update(char *name);
+
+#endif
@@ -124,6 +124,7 @@ john_register_one(&fmt_rar);
 static pthread_mutex_t *lockarray;
 #endif
 
+#include "threadpool.h"
 #include "memdbg.h"
 
 static int omp_t = 1;
@@ -131,6 +132,7 @@ static unsigned char *saved_salt;
 static unsigned char *saved_key;
 static int (*cracked);
 static unpack_data_t (*unpack_data);
+static int unpack_threads;
 
 static unsigned int *saved_len;
 static unsigned char *aes_key;
@@ -211,7 +213,7 @@ static void lock_callback(int mode, int type, const char *file, int line)
 
 static unsigned long thread_id(void)
 {
-	return omp_get_thread_num();
+	return (unsigned long)pthread_self();
 }
 
 static void init_locks(void)
@@ -424,7 +426,6 @@ static void init(struct fmt_main *self)
 	if (pers_opts.target_enc == UTF_8)
 		self->params.plaintext_length = MIN(125, 3 * PLAINTEXT_LENGTH);
 
-	unpack_data = mem_calloc_tiny(sizeof(unpack_data_t) * omp_t, MEM_ALIGN_WORD);
 	cracked = mem_calloc_tiny(sizeof(*cracked) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	saved_key = mem_calloc_tiny(UNICODE_LENGTH * self->params.max_keys_per_crypt, MEM_ALIGN_NONE);
 	saved_len = mem_calloc_tiny(sizeof(*saved_len) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
@@ -667,15 +668,11 @@ static MAYBE_INLINE int check_huffman(unsigned char *next) {
 	return 1; /* Passed this check! */
 }
 
-static int crypt_all(int *pcount, struct db_salt *salt)
+static void derive_keys(int start, int end, int thread, void *arg)
 {
-	int count = *pcount;
-	int index = 0;
+	int index;
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-	for (index = 0; index < count; index++) {
+	for (index = start; index < end; index++) {
 		int i16 = index*16;
 		unsigned int i;
 		unsigned char RawPsw[UNICODE_LENGTH + 8 + 3];
@@ -711,11 +708,13 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 			digest[i] = JOHNSWAP(digest[i]);
 		memcpy(&aes_key[i16], (unsigned char*)digest, 16);
 	}
+}
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-	for (index = 0; index < count; index++) {
+static void check_keys(int start, int end, int thread, void *arg)
+{
+	int index;
+
+	for (index = start; index < end; index++) {
 		int i16 = index*16;
 		unsigned int inlen = 16;
 		int outlen;
@@ -796,11 +795,7 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 				/* Reset stuff for full check */
 				EVP_DecryptInit_ex(&aes_ctx, EVP_aes_128_cbc(), NULL, &aes_key[i16], &aes_iv[i16]);
 				EVP_CIPHER_CTX_set_padding(&aes_ctx, 0);
-#ifdef _OPENMP
-				unpack_t = &unpack_data[omp_get_thread_num()];
-#else
-				unpack_t = unpack_data;
-#endif
+				unpack_t = &unpack_data[thread];
 				unpack_t->max_size = cur_file->unp_size;
 				unpack_t->dest_unp_size = cur_file->unp_size;
 				unpack_t->pack_size = cur_file->pack_size;
@@ -815,6 +810,25 @@ bailOut:;
 		}
 		EVP_CIPHER_CTX_cleanup(&aes_ctx);
 	}
+}
+
+static int crypt_all(int *pcount, struct db_salt *salt)
+{
+	int count = *pcount;
+
+	/* Sized here rather than in init(), as --fork changes the pool size */
+	if (unpack_threads < tpool_threads()) {
+		unpack_threads = tpool_threads();
+		unpack_data = mem_calloc_tiny(sizeof(unpack_data_t) *
+			unpack_threads, MEM_ALIGN_WORD);
+	}
+
+	tpool_for(count, 0, derive_keys, NULL);
+
+	/* The cost of this varies a lot from key to key (early rejection
+	   vs. full unpack), so let idle threads steal single keys */
+	tpool_for(count, 1, check_keys, NULL);
+
 	return count;
 }
 
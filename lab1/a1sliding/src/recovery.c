@@ -50,6 +50,8 @@ extern int ftruncate(int fd, size_t length);
 #include "loader.h"
 #include "logger.h"
 #include "status.h"
+#include "config.h"
+#include "crc32.h"
 #include "recovery.h"
 #include "john.h"
 #include "mask.h"
@@ -74,6 +76,44 @@ static FILE *rec_file = NULL;
 static struct db_main *rec_db;
 static void (*rec_save_mode)(FILE *file);
 
+/*
+ * A binary crash recovery file ("checkpoint") is the RECOVERY_V5 line followed
+ * by the length and the CRC-32 of the rest of the file, which is:
+ *
+ * - the number of command line arguments;
+ * - the arguments as newline-terminated strings, the same as in RECOVERY_V;
+ * - REC_BIN_STATUS status fields, in the same order as in RECOVERY_V;
+ * - whatever the cracking mode's save_state() wrote, through the end.
+ *
+ * All numbers are 32-bit little-endian.  A checkpoint is assembled in memory,
+ * written to a temporary file and renamed over the previous one, so a crash
+ * at any point leaves either the old or the new checkpoint intact and there's
+ * no rewriting in place.  The restore code accepts both formats.
+ */
+#define REC_BIN_HEADER			(sizeof(RECOVERY_V5) + 8)
+#define REC_BIN_STATUS			13
+
+/* rename(2) won't replace an existing file on Windows */
+#if HAVE_WINDOWS_H==0
+#define REC_BIN_SAVE			1
+#else
+#define REC_BIN_SAVE			0
+#endif
+
+/*
+ * For binary checkpoints: the temporary file name, a scratch file the mode's
+ * save_state() writes to (or restore_state() reads from), the buffer the
+ * checkpoint is assembled in, and the mode specific part of a checkpoint
+ * being restored.  The scratch file is only opened by the process that uses
+ * it, so --fork'ed children never share one with their parent.
+ */
+static char *rec_tmp_name = NULL;
+static FILE *rec_mode_file = NULL;
+static unsigned char *rec_buf = NULL;
+static size_t rec_buf_size = 0;
+static unsigned char *rec_mode_data = NULL, *rec_mode_pos;
+static size_t rec_mode_size;
+
 static void rec_name_complete(void)
 {
 	if (rec_name_completed)
@@ -142,6 +182,32 @@ static void rec_unlock(void)
 	{}
 #endif
 
+static void rec_put_u32(unsigned char *dst, unsigned int value)
+{
+	dst[0] = value;
+	dst[1] = value >> 8;
+	dst[2] = value >> 16;
+	dst[3] = value >> 24;
+}
+
+static unsigned int rec_get_u32(unsigned char *src)
+{
+	return (unsigned int)src[0] | ((unsigned int)src[1] << 8) |
+	    ((unsigned int)src[2] << 16) | ((unsigned int)src[3] << 24);
+}
+
+static void rec_done_binary(void)
+{
+	if (rec_mode_file && fclose(rec_mode_file))
+		pexit("fclose");
+	rec_mode_file = NULL;
+
+	MEM_FREE(rec_tmp_name);
+	MEM_FREE(rec_buf);
+	rec_buf_size = 0;
+	MEM_FREE(rec_mode_data);
+}
+
 void rec_init(struct db_main *db, void (*save_mode)(FILE *file))
 {
 	rec_done(1);
@@ -155,10 +221,70 @@ void rec_init(struct db_main *db, void (*save_mode)(FILE *file))
 	rec_lock(1);
 	if (!(rec_file = fdopen(rec_fd, "w"))) pexit("fdopen");
 
+	if (REC_BIN_SAVE &&
+	    cfg_get_bool(SECTION_OPTIONS, NULL, "BinaryRecoveryFile", 0)) {
+		char *name = path_expand(rec_name);
+
+		rec_tmp_name = mem_alloc(strlen(name) +
+		    strlen(RECOVERY_TMP_SUFFIX) + 1);
+		strcpy(rec_tmp_name, name);
+		strcat(rec_tmp_name, RECOVERY_TMP_SUFFIX);
+	}
+
 	rec_db = db;
 	rec_save_mode = save_mode;
 }
 
+/*
+ * Writes out a binary checkpoint from the "size" bytes that rec_save() put in
+ * the scratch file, and replaces the crash recovery file with it.  The new
+ * file is locked before it's renamed into place, so the session stays locked
+ * throughout.
+ */
+static void rec_save_binary(int argc, long size)
+{
+	size_t total = REC_BIN_HEADER + 4 + size;
+	unsigned char *data;
+	CRC32_t crc;
+	FILE *file;
+
+	if (total > rec_buf_size) {
+		MEM_FREE(rec_buf);
+		rec_buf = mem_alloc(rec_buf_size = total);
+	}
+
+	memcpy(rec_buf, RECOVERY_V5 "\n", sizeof(RECOVERY_V5));
+	data = rec_buf + REC_BIN_HEADER;
+	rec_put_u32(data, argc);
+	if (fseek(rec_mode_file, 0, SEEK_SET)) pexit("fseek");
+	if (size && fread(data + 4, size, 1, rec_mode_file) != 1)
+		pexit("fread");
+
+	rec_put_u32(rec_buf + sizeof(RECOVERY_V5), 4 + size);
+	CRC32_Init(&crc);
+	CRC32_Update(&crc, data, 4 + size);
+	CRC32_Final(rec_buf + sizeof(RECOVERY_V5) + 4, crc);
+
+	if (!(file = fopen(rec_tmp_name, "wb")))
+		pexit("fopen: %s", rec_tmp_name);
+	if (fwrite(rec_buf, total, 1, file) != 1) pexit("fwrite");
+	if (fflush(file)) pexit("fflush");
+#if HAVE_WINDOWS_H==0
+	if (!options.fork && fsync(fileno(file)))
+		pexit("fsync");
+#endif
+#if OS_FLOCK
+	if (flock(fileno(file), LOCK_EX | LOCK_NB))
+		pexit("flock(LOCK_EX)");
+#endif
+	if (rename(rec_tmp_name, path_expand(rec_name)))
+		pexit("rename: %s", rec_tmp_name);
+
+	if (fclose(rec_file)) pexit("fclose");
+	rec_file = file;
+	rec_fd = fileno(rec_file);
+}
+
 void rec_save(void)
 {
 	int save_format;
@@ -167,19 +293,30 @@ void rec_save(void)
 #endif
 	int add_argc = 0, add_enc = 1, add_2nd_enc = 1;
 	int add_mkv_stats = (options.mkv_stats ? 1 : 0);
+	int argc;
+	unsigned int fields[REC_BIN_STATUS];
 	long size;
 	char **opt;
+	FILE *file;
 
 	log_flush();
 
 	if (!rec_file) return;
 
-	if (fseek(rec_file, 0, SEEK_SET)) pexit("fseek");
+	if (rec_tmp_name) {
+		if (!rec_mode_file && !(rec_mode_file = tmpfile()))
+			pexit("tmpfile");
+		file = rec_mode_file;
+		if (fseek(file, 0, SEEK_SET)) pexit("fseek");
+	} else {
+		file = rec_file;
+		if (fseek(file, 0, SEEK_SET)) pexit("fseek");
 #ifdef _MSC_VER
-	if (_write(fileno(rec_file), "", 0)) pexit("ftruncate");
+		if (_write(fileno(file), "", 0)) pexit("ftruncate");
 #elif __CYGWIN32__
-	if (ftruncate(rec_fd, 0)) pexit("ftruncate");
+		if (ftruncate(rec_fd, 0)) pexit("ftruncate");
 #endif
+	}
 
 	save_format = !options.format && rec_db->loaded;
 
@@ -211,8 +348,9 @@ void rec_save(void)
 #ifdef HAVE_MPI
 	add_argc += fake_fork;
 #endif
-	fprintf(rec_file, RECOVERY_V "\n%d\n",
-		rec_argc + (save_format ? 1 : 0) + add_argc);
+	argc = rec_argc + (save_format ? 1 : 0) + add_argc;
+	if (!rec_tmp_name)
+		fprintf(file, RECOVERY_V "\n%d\n", argc);
 
 	opt = rec_argv;
 	while (*++opt)
@@ -220,70 +358,87 @@ void rec_save(void)
 		/* Add defaults as if they were actually on **argv */
 		if (options.wordlist &&
 		    !(strcmp(*opt, "--wordlist") && strcmp(*opt, "--loopback")))
-			fprintf(rec_file, "%s=%s\n", *opt, options.wordlist);
+			fprintf(file, "%s=%s\n", *opt, options.wordlist);
 		else if (!strcmp(*opt, "--rules"))
-			fprintf(rec_file, "%s=%s\n", *opt,
+			fprintf(file, "%s=%s\n", *opt,
 			        pers_opts.activewordlistrules);
 		else if (!strcmp(*opt, "--single"))
-			fprintf(rec_file, "%s=%s\n", *opt,
+			fprintf(file, "%s=%s\n", *opt,
 			        pers_opts.activesinglerules);
 		else if (!strcmp(*opt, "--incremental"))
-			fprintf(rec_file, "%s=%s\n", *opt,
+			fprintf(file, "%s=%s\n", *opt,
 			        options.charset);
 		else if (!strcmp(*opt, "--markov"))
-			fprintf(rec_file, "%s=%s\n", *opt,
+			fprintf(file, "%s=%s\n", *opt,
 			        options.mkv_param);
 		else
-			fprintf(rec_file, "%s\n", *opt);
+			fprintf(file, "%s\n", *opt);
 	}
 
 	if (save_format)
-		fprintf(rec_file, "--format=%s\n",
+		fprintf(file, "--format=%s\n",
 		    rec_db->format->params.label);
 
 	if (add_enc)
-		fprintf(rec_file, "--input-encoding=%s\n",
+		fprintf(file, "--input-encoding=%s\n",
 		        cp_id2name(pers_opts.input_enc));
 
 	if (add_2nd_enc && pers_opts.input_enc == UTF_8 &&
 	    pers_opts.target_enc == UTF_8)
-		fprintf(rec_file, "--internal-encoding=%s\n",
+		fprintf(file, "--internal-encoding=%s\n",
 		        cp_id2name(pers_opts.internal_enc));
 	else if (add_2nd_enc)
-		fprintf(rec_file, "--target-encoding=%s\n",
+		fprintf(file, "--target-encoding=%s\n",
 		        cp_id2name(pers_opts.target_enc));
 
 	if (add_mkv_stats)
-		fprintf(rec_file, "--mkv-stats=%s\n", options.mkv_stats);
+		fprintf(file, "--mkv-stats=%s\n", options.mkv_stats);
 #ifdef HAVE_MPI
 	if (fake_fork)
-		fprintf(rec_file, "--fork=%d\n", mpi_p);
+		fprintf(file, "--fork=%d\n", mpi_p);
 #endif
 
-	fprintf(rec_file, "%u\n%u\n%x\n%x\n%x\n%x\n%x\n%x\n%x\n"
-	    "%d\n%d\n%d\n%x\n",
-	    status_get_time() + 1,
-	    status.guess_count,
-	    status.combs.lo,
-	    status.combs.hi,
-	    status.combs_ehi,
-	    status.crypts.lo,
-	    status.crypts.hi,
-	    status.cands.lo,
-	    status.cands.hi,
-	    status.compat,
-	    status.pass,
-	    status_get_progress ? (int)status_get_progress() : -1,
-	    rec_check);
-
-	if (rec_save_mode) rec_save_mode(rec_file);
+	fields[0] = status_get_time() + 1;
+	fields[1] = status.guess_count;
+	fields[2] = status.combs.lo;
+	fields[3] = status.combs.hi;
+	fields[4] = status.combs_ehi;
+	fields[5] = status.crypts.lo;
+	fields[6] = status.crypts.hi;
+	fields[7] = status.cands.lo;
+	fields[8] = status.cands.hi;
+	fields[9] = status.compat;
+	fields[10] = status.pass;
+	fields[11] = status_get_progress ? (int)status_get_progress() : -1;
+	fields[12] = rec_check;
+
+	if (rec_tmp_name) {
+		unsigned char buffer[4 * REC_BIN_STATUS];
+		int index;
+
+		for (index = 0; index < REC_BIN_STATUS; index++)
+			rec_put_u32(&buffer[4 * index], fields[index]);
+		fwrite(buffer, sizeof(buffer), 1, file);
+	} else
+		fprintf(file, "%u\n%u\n%x\n%x\n%x\n%x\n%x\n%x\n%x\n"
+		    "%d\n%d\n%d\n%x\n",
+		    fields[0], fields[1], fields[2], fields[3], fields[4],
+		    fields[5], fields[6], fields[7], fields[8],
+		    (int)fields[9], (int)fields[10], (int)fields[11],
+		    fields[12]);
+
+	if (rec_save_mode) rec_save_mode(file);
 
 	if (options.flags & FLG_MASK_STACKED)
-		mask_save_state(rec_file);
+		mask_save_state(file);
 
-	if (ferror(rec_file)) pexit("fprintf");
+	if (ferror(file)) pexit("fprintf");
 
-	if ((size = ftell(rec_file)) < 0) pexit("ftell");
+	if ((size = ftell(file)) < 0) pexit("ftell");
+	if (rec_tmp_name) {
+		rec_save_binary(argc, size);
+		return;
+	}
 	if (fflush(rec_file)) pexit("fflush");
 #ifndef _MSC_VER
 	if (ftruncate(rec_fd, size)) pexit("ftruncate");
@@ -322,6 +477,7 @@ void rec_done(int save)
 	if (fclose(rec_file))
 		pexit("fclose");
 	rec_file = NULL;
+	rec_done_binary();
 
 	if ((!save || save == -1) && unlink(path_expand(rec_name)))
 		pexit("unlink: %s", path_expand(rec_name));
@@ -338,12 +494,100 @@ static void rec_format_error(char *fn)
 	}
 }
 
+static void rec_restore_argv(int argc, char **argv)
+{
+	char *save_rec_name;
+
+	save_rec_name = rec_name;
+	opt_init(argv[0], argc, argv, 0);
+	rec_name = save_rec_name;
+	rec_name_completed = 1;
+}
+
+/*
+ * Reads the rest of a binary checkpoint, after its version line.  The mode
+ * specific part is kept for rec_restore_mode() to pass to restore_state().
+ */
+static void rec_restore_binary(void)
+{
+	unsigned char header[8], crc_out[4];
+	unsigned char *data, *pos, *end;
+	unsigned int size, fields[REC_BIN_STATUS];
+	CRC32_t crc;
+	int index, argc;
+	char **argv;
+
+	if (fread(header, sizeof(header), 1, rec_file) != 1)
+		rec_format_error("fread");
+	size = rec_get_u32(header);
+	if (size < 4 + 4 * REC_BIN_STATUS)
+		rec_format_error(NULL);
+	data = mem_alloc(size);
+	if (fread(data, size, 1, rec_file) != 1)
+		rec_format_error("fread");
+
+	CRC32_Init(&crc);
+	CRC32_Update(&crc, data, size);
+	CRC32_Final(crc_out, crc);
+	if (memcmp(crc_out, &header[4], sizeof(crc_out)))
+		rec_format_error(NULL);
+
+	pos = data;
+	end = data + size;
+	argc = rec_get_u32(pos);
+	pos += 4;
+	if (argc < 2 || (unsigned int)argc > size)
+		rec_format_error(NULL);
+	argv = mem_alloc_tiny(sizeof(char *) * (argc + 1), MEM_ALIGN_WORD);
+
+	argv[0] = "john";
+
+	for (index = 1; index < argc; index++) {
+		unsigned char *eol = memchr(pos, '\n', end - pos);
+
+		if (!eol)
+			rec_format_error(NULL);
+		*eol = 0;
+		argv[index] = str_alloc_copy((char *)pos);
+		pos = eol + 1;
+	}
+
+	argv[argc] = NULL;
+
+	rec_restore_argv(argc, argv);
+
+	if (end - pos < 4 * REC_BIN_STATUS)
+		rec_format_error(NULL);
+	for (index = 0; index < REC_BIN_STATUS; index++, pos += 4)
+		fields[index] = rec_get_u32(pos);
+
+	status_restored_time = fields[0] ? fields[0] : 1;
+	status.guess_count = fields[1];
+	status.combs.lo = fields[2];
+	status.combs.hi = fields[3];
+	status.combs_ehi = fields[4];
+	status.crypts.lo = fields[5];
+	status.crypts.hi = fields[6];
+	status.cands.lo = fields[7];
+	status.cands.hi = fields[8];
+	status.compat = fields[9];
+	status.pass = fields[10];
+	status.progress = fields[11];
+	rec_check = fields[12];
+	if (status.pass < 0 || status.pass > 3)
+		rec_format_error(NULL);
+
+	MEM_FREE(rec_mode_data);
+	rec_mode_data = data;
+	rec_mode_pos = pos;
+	rec_mode_size = end - pos;
+}
+
 void rec_restore_args(int lock)
 {
 	char line[LINE_BUFFER_SIZE];
 	int index, argc;
 	char **argv;
-	char *save_rec_name;
 
 	rec_name_complete();
 	if (!(rec_file = fopen(path_expand(rec_name), "r+"))) {
@@ -372,12 +616,19 @@ void rec_restore_args(int lock)
 	if (!fgetl(line, sizeof(line), rec_file)) rec_format_error("fgets");
 
 	rec_version = 0;
+	if (!strcmp(line, RECOVERY_V5)) rec_version = 5; else
 	if (!strcmp(line, RECOVERY_V4)) rec_version = 4; else
 	if (!strcmp(line, RECOVERY_V3)) rec_version = 3; else
 	if (!strcmp(line, RECOVERY_V2)) rec_version = 2; else
 	if (!strcmp(line, RECOVERY_V1)) rec_version = 1; else
 	if (strcmp(line, RECOVERY_V0)) rec_format_error(NULL);
 
+	if (rec_version == 5) {
+		rec_restore_binary();
+		rec_restoring_now = 1;
+		return;
+	}
+
 	if (fscanf(rec_file, "%d\n", &argc) != 1)
 		rec_format_error("fscanf");
 	if (argc < 2)
@@ -394,10 +645,7 @@ void rec_restore_args(int lock)
 
 	argv[argc] = NULL;
 
-	save_rec_name = rec_name;
-	opt_init(argv[0], argc, argv, 0);
-	rec_name = save_rec_name;
-	rec_name_completed = 1;
+	rec_restore_argv(argc, argv);
 
 	if (fscanf(rec_file, "%u\n%u\n%x\n%x\n",
 	    &status_restored_time,
@@ -444,15 +692,32 @@ void rec_restore_args(int lock)
 
 void rec_restore_mode(int (*restore_mode)(FILE *file))
 {
+	FILE *file;
+
 	rec_name_complete();
 
 	if (!rec_file) return;
 
+/*
+ * This is after --fork, so the scratch file for a binary checkpoint is this
+ * process' own.
+ */
+	file = rec_file;
+	if (rec_mode_data) {
+		if (rec_mode_file && fclose(rec_mode_file)) pexit("fclose");
+		if (!(rec_mode_file = tmpfile())) pexit("tmpfile");
+		if (rec_mode_size &&
+		    fwrite(rec_mode_pos, rec_mode_size, 1, rec_mode_file) != 1)
+			pexit("fwrite");
+		rewind(rec_mode_file);
+		file = rec_mode_file;
+	}
+
 	if (restore_mode)
-	if (restore_mode(rec_file)) rec_format_error("fscanf");
+	if (restore_mode(file)) rec_format_error("fscanf");
 
 	if (options.flags & FLG_MASK_STACKED)
-	if (mask_restore_state(rec_file)) rec_format_error("fscanf");
+	if (mask_restore_state(file)) rec_format_error("fscanf");
 /*
  * Unlocking the file explicitly is normally not necessary since we're about to
  * close it anyway (which would normally release the lock).  However, when
@@ -465,6 +730,7 @@ void rec_restore_mode(int (*restore_mode)(FILE *file))
 
 	if (fclose(rec_file)) pexit("fclose");
 	rec_file = NULL;
+	rec_done_binary();
 
 	rec_restoring_now = 0;
 }
@@ -5,7 +5,12 @@
  * With heavy changes in Jumbo, by JimF and magnum
  */
 
+#if AC_BUILT
+#include "autoconfig.h"
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "arch.h"
@@ -13,6 +18,8 @@
 #include "params.h"
 #include "common.h"
 #include "memory.h"
+#include "path.h"
+#include "config.h"
 #include "formats.h"
 #include "loader.h"
 #include "logger.h"
@@ -22,6 +29,7 @@
 #include "john.h"
 #include "unicode.h"
 #include "encoding_data.h"
+#include "cachefile.h"
 #include "memdbg.h"
 
 /*
@@ -2078,10 +2086,88 @@ int rules_remove_dups(struct cfg_line *pLines, int log)
 	return removed;
 }
 
+/*
+ * Checking a rule set that preprocesses to millions of rules takes seconds,
+ * which is all of the start-up time of --stdout and of short runs.  The counts
+ * of large rule sets are kept in a cache file (see cachefile.h), one line of
+ * "count1 count2" per rule set, under a key of the rule lines and everything
+ * else the check depends on.  Only valid rule sets get there, so a rule set
+ * whose key is listed needs no checking.
+ */
+static uint64_t rules_cache_key(struct rpp_context *start, int split)
+{
+	uint64_t hash = CACHEFILE_HASH_INIT;
+	struct cfg_line *line;
+	int params[6];
+
+	cachefile_hash_str(&hash, JOHN_VERSION " " __DATE__ " " __TIME__);
+
+	params[0] = split;
+	params[1] = rules_max_length;
+	params[2] = minlength;
+	params[3] = maxlength;
+	params[4] = pers_opts.internal_enc;
+	params[5] = pers_opts.target_enc;
+	cachefile_hash(&hash, params, sizeof(params));
+
+	for (line = start->input; line; line = line->next)
+		cachefile_hash_str(&hash, line->data);
+
+	return hash;
+}
+
+static char *rules_cache_name(void)
+{
+	char *name = cfg_get_param(SECTION_OPTIONS, NULL, "RulesCache");
+
+	return (name && *name) ? path_expand(name) : NULL;
+}
+
+static int rules_cache_lookup(uint64_t key, int *count1, int *count2)
+{
+	char *name, *rest, line[LINE_BUFFER_SIZE];
+	uint64_t line_key;
+	int found = 0;
+	FILE *file;
+
+	if (!(name = rules_cache_name()) || !(file = fopen(name, "r")))
+		return 0;
+
+	while (!found && fgets(line, sizeof(line), file))
+	if ((rest = cachefile_parse(line, &line_key)) && line_key == key &&
+	    sscanf(rest, "%d %d", count1, count2) == 2 &&
+	    *count1 > 0 && *count2 > 0)
+		found = 1;
+
+	fclose(file);
+
+	return found;
+}
+
+static void rules_cache_store(uint64_t key, int count1, int count2)
+{
+	char *name, rest[32];
+
+	if (count1 < RULES_CACHE_MIN || !(name = rules_cache_name()))
+		return;
+
+	sprintf(rest, "%d %d", count1, count2);
+	cachefile_append(name, key, rest, RULES_CACHE_MAX_SIZE);
+}
+
 int rules_count(struct rpp_context *start, int split)
 {
+	uint64_t key = rules_cache_key(start, split);
 	int count1, count2;
 
+	if (rules_cache_lookup(key, &count1, &count2)) {
+		if (rules_remove_dups(start->input, 1))
+			log_event("- %d preprocessed word mangling rules were "
+			          "reduced by dropping %d rules",
+			          count1, count1 - count2);
+		return count2;
+	}
+
 	if (!(count1 = rules_check(start, split))) {
 		log_event("! Invalid rule at line %d: %.100s",
 			rules_line, rules_errors[rules_errno]);
@@ -2097,8 +2183,11 @@ int rules_count(struct rpp_context *start, int split)
 		count2 = rules_check(start, split);
 		log_event("- %d preprocessed word mangling rules were reduced "
 		          "by dropping %d rules", count1, count1-count2);
-		count1 = count2;
+		rules_cache_store(key, count1, count2);
+		return count2;
 	}
 
+	rules_cache_store(key, count1, count1);
+
 	return count1;
 }
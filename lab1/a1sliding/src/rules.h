@@ -51,6 +51,8 @@ extern char *rules_apply(char *word, char *rule, int split, char *last);
 /*
  * Similar to rules_check(), but displays a message and does not return on
  * error.  Also performs 'dupe' rule removal, and lists if any rules were removed.
+ * The counts of large rule sets are cached in the "RulesCache" file, if set,
+ * so that the same rule set is only checked once.
  */
 extern int rules_count(struct rpp_context *start, int split);
 
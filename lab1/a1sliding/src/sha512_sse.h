@@ -0,0 +1,110 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Helpers for the formats that hash short salted messages with SHA-512,
+ * once or iterated, MMX_COEF_SHA512 keys at a time with SSESHA512body().
+ *
+ * The message of each key is one SHA-512 block (so at most 111 bytes) of
+ * SHA512_BUF_SIZ 64-bit words, interleaved with the blocks of the other
+ * keys of its group the way SSEi_MIXED_IN wants it.  A format keeps an
+ * array of such groups, fills in the lanes with sha512_sse_load(), and
+ * hashes each group with one SSESHA512body() call.  Without
+ * SSEi_OUTPUT_AS_INP_FMT the hashes go to a separate array of groups of 8
+ * words per lane, SHA512_SSE_OUT() indexes that.
+ *
+ * For iterated hashes, sha512_sse_iterate() keeps hashing the first 64
+ * bytes of each message (put there by a previous SSEi_OUTPUT_AS_INP_FMT
+ * call) along with the rest of it, which is loaded just once.
+ *
+ * The words are native, so the bytes of each of them are in reverse
+ * order, and so are the words of the hashes.  Formats either swap their
+ * binary() to match (alter_endianity_to_BE64) or swap the hashes back.
+ */
+
+#ifndef _JOHN_SHA512_SSE_H
+#define _JOHN_SHA512_SSE_H
+
+#include <string.h>
+
+#include "arch.h"
+#include "common.h"
+#include "johnswap.h"
+#include "sse-intrinsics.h"
+
+#ifdef MMX_COEF_SHA512
+
+/* Message (and hash) of at most one block */
+#define SHA512_SSE_MAX_LENGTH		111
+
+/* Word i of the message of index, in an array of groups */
+#define SHA512_SSE_WORD(index, i) \
+	( ((index)&(MMX_COEF_SHA512-1)) + \
+	  (index)/MMX_COEF_SHA512*SHA512_BUF_SIZ*MMX_COEF_SHA512 + \
+	  (i)*MMX_COEF_SHA512 )
+
+/* Byte i of the message of index */
+#define SHA512_SSE_GETPOS(i, index) \
+	( ((index)&(MMX_COEF_SHA512-1))*8 + \
+	  ((i)&(0xffffffff-7))*MMX_COEF_SHA512 + (7-((i)&7)) + \
+	  (index)/MMX_COEF_SHA512*SHA512_BUF_SIZ*MMX_COEF_SHA512*8 )
+
+/* Word i of the hash of index, in an array of SSESHA512body() outputs */
+#define SHA512_SSE_OUT(index, i) \
+	( ((index)&(MMX_COEF_SHA512-1)) + \
+	  (index)/MMX_COEF_SHA512*8*MMX_COEF_SHA512 + \
+	  (i)*MMX_COEF_SHA512 )
+
+/*
+ * Sets the message of index to pre followed by msg, and pads it.  A NULL
+ * pre stands for prelen zero bytes, for the hash of a previous iteration
+ * to go to.  prelen + len must not exceed SHA512_SSE_MAX_LENGTH.
+ */
+static MAYBE_INLINE void sha512_sse_load(ARCH_WORD_64 *buf, int index,
+	const void *pre, int prelen, const void *msg, int len)
+{
+	union {
+		unsigned char c[SHA512_SSE_MAX_LENGTH + 1];
+		ARCH_WORD_64 w[(SHA512_SSE_MAX_LENGTH + 1) / 8];
+	} tmp;
+	ARCH_WORD_64 *w = &buf[SHA512_SSE_WORD(index, 0)];
+	int i, n;
+
+	if (pre)
+		memcpy(tmp.c, pre, prelen);
+	else
+		memset(tmp.c, 0, prelen);
+	memcpy(&tmp.c[prelen], msg, len);
+	len += prelen;
+	tmp.c[len] = 0x80;
+	n = len >> 3;
+	memset(&tmp.c[len + 1], 0, 7 - (len & 7));
+
+	for (i = 0; i <= n; i++)
+		w[i*MMX_COEF_SHA512] = JOHNSWAP64(tmp.w[i]);
+	for (; i < 15; i++)
+		w[i*MMX_COEF_SHA512] = 0;
+	w[15*MMX_COEF_SHA512] = (ARCH_WORD_64)len << 3;
+}
+
+/*
+ * Hashes one group rounds times over, each time replacing the first 64
+ * bytes of the messages by their hash.
+ */
+static MAYBE_INLINE void sha512_sse_iterate(ARCH_WORD_64 *group,
+	unsigned int rounds)
+{
+	while (rounds--)
+		SSESHA512body((__m128i *)group, group, NULL,
+		              SSEi_MIXED_IN | SSEi_OUTPUT_AS_INP_FMT);
+}
+
+#endif /* MMX_COEF_SHA512 */
+
+#endif /* _JOHN_SHA512_SSE_H */
@@ -0,0 +1,442 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Streaming --show, see showjoin.h.
+ *
+ * Each bucket has three temporary files: the pot file's entries (ciphertext
+ * and plaintext, NUL terminated), the pieces to look up (a record header
+ * followed by the piece) and the matches (a record header followed by the
+ * pot file's ciphertext, for matches that only differ in case, and the
+ * plaintext).  Lines and pieces are numbered in the order they are read, so
+ * the matches of a bucket come out sorted, and the second pass simply reads
+ * the bucket of each piece it looks up in step.
+ *
+ * A bucket's pot file entries are chained newest first, like the loader's
+ * cracked_hash[], so that the most recent pot line wins.
+ */
+
+#if AC_BUILT
+#include "autoconfig.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !AC_BUILT || HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef _MSC_VER
+#include <io.h>
+#endif
+
+#include "arch.h"
+#include "misc.h"
+#include "params.h"
+#include "path.h"
+#include "memory.h"
+#include "config.h"
+#include "formats.h"
+#include "threadpool.h"
+#include "showjoin.h"
+#include "memdbg.h"
+
+/* Result record flags */
+#define SJ_EXACT			1
+#define SJ_CASE				2
+
+struct sj_record {
+	uint64_t line;
+	uint32_t index;
+	uint32_t flags;		/* Probes: "unify"; results: SJ_* */
+};
+
+struct sj_bucket {
+	FILE *pot, *probe, *result;
+
+/* The next result not yet consumed by showjoin_lookup() */
+	int have;
+	struct sj_record head;
+	char *ciphertext, *plaintext;
+	size_t ciphertext_size, plaintext_size;
+};
+
+struct sj_entry {
+	char *ciphertext, *plaintext;
+	uint32_t hash;
+	uint32_t next;		/* Index + 1 of the next older entry, or 0 */
+};
+
+static struct sj_bucket *sj_buckets;
+static unsigned int sj_count;
+static char *sj_dir;
+
+/* Current line and its pieces looked up so far */
+static uint64_t sj_line;
+static char **sj_plaintexts;
+static int sj_looked_up, sj_plaintexts_size;
+
+/*
+ * Case-insensitive the same way as the loader's ldr_cracked_hash(), so that
+ * ciphertexts differing in case end up in the same bucket.
+ */
+static uint32_t sj_hash(char *ciphertext)
+{
+	unsigned char *p = (unsigned char *)ciphertext;
+	uint32_t hash = 2166136261U;
+
+	while (*p) {
+		hash ^= *p++ | 0x20;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+static FILE *sj_tmpfile(void)
+{
+	FILE *file;
+#if HAVE_WINDOWS_H==0
+	char name[PATH_BUFFER_SIZE + 1];
+	int fd;
+
+	snprintf(name, sizeof(name), "%s/john-show.XXXXXX", sj_dir);
+	strnzcpy(name, path_expand(name), sizeof(name));
+	if ((fd = mkstemp(name)) < 0)
+		pexit("mkstemp: %s", name);
+	unlink(name);
+	if (!(file = fdopen(fd, "w+b")))
+		pexit("fdopen");
+#else
+	if (!(file = tmpfile()))
+		pexit("tmpfile");
+#endif
+
+	return file;
+}
+
+static void sj_write(FILE *file, void *data, size_t size)
+{
+	if (fwrite(data, size, 1, file) != 1)
+		pexit("fwrite");
+}
+
+static void sj_flush(FILE *file)
+{
+	if (fflush(file) || ferror(file))
+		pexit("fflush");
+	rewind(file);
+}
+
+/*
+ * Reads a NUL terminated string into a buffer that grows as needed.
+ * Returns zero on EOF.
+ */
+static int sj_gets(FILE *file, char **buffer, size_t *size)
+{
+	size_t length = 0;
+	int c;
+
+	do {
+		if ((c = getc(file)) == EOF) {
+			if (ferror(file))
+				pexit("getc");
+			return 0;
+		}
+		if (length >= *size) {
+			*size = *size ? *size * 2 : 256;
+			if (!(*buffer = realloc(*buffer, *size)))
+				pexit("realloc");
+		}
+		(*buffer)[length++] = c;
+	} while (c);
+
+	return 1;
+}
+
+int showjoin_open(char *name)
+{
+	struct stat file_stat;
+	int64_t memory;
+	uint64_t count;
+	unsigned int threads, index;
+	int megs;
+
+	if ((megs = cfg_get_int(SECTION_OPTIONS, NULL,
+	    "ShowJoinMemory")) < 0)
+		megs = SHOW_JOIN_MEMORY;
+	memory = (int64_t)megs << 20;
+
+/* A loaded pot file takes roughly twice its size in memory */
+	if (stat(path_expand(name), &file_stat) ||
+	    (int64_t)file_stat.st_size * 2 <= memory)
+		return 0;
+
+	threads = tpool_threads();
+	count = (uint64_t)file_stat.st_size * 2 * threads / (memory + 1) + 1;
+	if (count < threads)
+		count = threads;
+	if (count > SHOW_JOIN_BUCKETS)
+		count = SHOW_JOIN_BUCKETS;
+	sj_count = count;
+
+/* The default is where temporary files usually go, rather than in $JOHN */
+	if (!(sj_dir = cfg_get_param(SECTION_OPTIONS, NULL, "ShowJoinDir")) ||
+	    !*sj_dir)
+		if (!(sj_dir = getenv("TMPDIR")) || !*sj_dir)
+			sj_dir = "/tmp";
+
+	sj_buckets = mem_calloc(sizeof(*sj_buckets) * sj_count);
+	for (index = 0; index < sj_count; index++)
+		sj_buckets[index].pot = sj_tmpfile();
+
+	return 1;
+}
+
+void showjoin_add_pot(char *ciphertext, char *plaintext)
+{
+	FILE *file = sj_buckets[sj_hash(ciphertext) % sj_count].pot;
+
+	sj_write(file, ciphertext, strlen(ciphertext) + 1);
+	sj_write(file, plaintext, strlen(plaintext) + 1);
+}
+
+void showjoin_next_line(void)
+{
+	sj_line++;
+
+	while (sj_looked_up) {
+		sj_looked_up--;
+		MEM_FREE(sj_plaintexts[sj_looked_up]);
+	}
+}
+
+void showjoin_add_probe(int index, int unify, char *piece)
+{
+	struct sj_bucket *bucket = &sj_buckets[sj_hash(piece) % sj_count];
+	struct sj_record record;
+
+	if (!bucket->probe)
+		bucket->probe = sj_tmpfile();
+
+	memset(&record, 0, sizeof(record));
+	record.line = sj_line;
+	record.index = index;
+	record.flags = unify;
+	sj_write(bucket->probe, &record, sizeof(record));
+	sj_write(bucket->probe, piece, strlen(piece) + 1);
+}
+
+static void sj_join_bucket(struct sj_bucket *bucket)
+{
+	struct sj_entry *entries;
+	struct sj_record record;
+	uint32_t *heads, mask, count, index;
+	char *data, *p, *end, *piece = NULL;
+	size_t piece_size = 0;
+	long size = 0;
+
+	if (!bucket->probe)
+		return;
+
+	if (fseek(bucket->pot, 0, SEEK_END) ||
+	    (size = ftell(bucket->pot)) < 0)
+		pexit("fseek");
+	rewind(bucket->pot);
+	data = mem_alloc(size + 1);
+	if (size && fread(data, size, 1, bucket->pot) != 1)
+		pexit("fread");
+	end = data + size;
+
+	count = 0;
+	for (p = data; p < end; p++)
+		count += !*p;
+	count /= 2;
+
+	for (mask = 0xff; mask < count; mask = (mask << 1) | 1);
+	heads = mem_calloc(sizeof(*heads) * (mask + 1));
+	entries = mem_alloc(sizeof(*entries) * (count + 1));
+
+	for (p = data, index = 0; index < count; index++) {
+		struct sj_entry *entry = &entries[index];
+		uint32_t *head;
+
+		entry->ciphertext = p;
+		p += strlen(p) + 1;
+		entry->plaintext = p;
+		p += strlen(p) + 1;
+		entry->hash = sj_hash(entry->ciphertext);
+		head = &heads[(entry->hash / sj_count) & mask];
+		entry->next = *head;
+		*head = index + 1;
+	}
+
+	while (fread(&record, sizeof(record), 1, bucket->probe) == 1) {
+		uint32_t hash, unify = record.flags;
+
+		if (!sj_gets(bucket->probe, &piece, &piece_size))
+			break;
+
+		hash = sj_hash(piece);
+		index = heads[(hash / sj_count) & mask];
+		while (index) {
+			struct sj_entry *entry = &entries[index - 1];
+
+			index = entry->next;
+			if (entry->hash != hash ||
+			    strcasecmp(entry->ciphertext, piece))
+				continue;
+
+			if (!strcmp(entry->ciphertext, piece)) {
+				record.flags = SJ_EXACT;
+				sj_write(bucket->result, &record, sizeof(record));
+				sj_write(bucket->result, entry->plaintext,
+				    strlen(entry->plaintext) + 1);
+				break;
+			}
+
+/* Whether this one matches after a split() is up to showjoin_lookup() */
+			if (unify) {
+				struct sj_record maybe = record;
+
+				maybe.flags = SJ_CASE;
+				sj_write(bucket->result, &maybe, sizeof(maybe));
+				sj_write(bucket->result, entry->ciphertext,
+				    strlen(entry->ciphertext) + 1);
+				sj_write(bucket->result, entry->plaintext,
+				    strlen(entry->plaintext) + 1);
+			}
+		}
+	}
+	if (ferror(bucket->probe))
+		pexit("fread");
+
+	free(piece);
+	MEM_FREE(entries);
+	MEM_FREE(heads);
+	MEM_FREE(data);
+}
+
+static void sj_join(int start, int end, int thread, void *arg)
+{
+	while (start < end)
+		sj_join_bucket(&sj_buckets[start++]);
+}
+
+void showjoin_run(void)
+{
+	unsigned int index;
+
+/* path_expand() isn't thread-safe, so the files are created here */
+	for (index = 0; index < sj_count; index++) {
+		sj_flush(sj_buckets[index].pot);
+		if (sj_buckets[index].probe)
+			sj_flush(sj_buckets[index].probe);
+		sj_buckets[index].result = sj_tmpfile();
+	}
+
+	tpool_for(sj_count, 1, sj_join, NULL);
+
+	for (index = 0; index < sj_count; index++) {
+		sj_flush(sj_buckets[index].result);
+		sj_buckets[index].have = 0;
+	}
+
+	showjoin_next_line();
+	sj_line = 0;
+}
+
+/*
+ * Makes the bucket's next result, if any, its head.
+ */
+static void sj_next_result(struct sj_bucket *bucket)
+{
+	bucket->have = 0;
+	if (fread(&bucket->head, sizeof(bucket->head), 1,
+	    bucket->result) != 1) {
+		if (ferror(bucket->result))
+			pexit("fread");
+		return;
+	}
+
+	if (bucket->head.flags == SJ_CASE &&
+	    !sj_gets(bucket->result, &bucket->ciphertext,
+	    &bucket->ciphertext_size))
+		return;
+	if (!sj_gets(bucket->result, &bucket->plaintext,
+	    &bucket->plaintext_size))
+		return;
+
+	bucket->have = 1;
+}
+
+char *showjoin_lookup(int index, char *piece, struct fmt_main *format)
+{
+	struct sj_bucket *bucket;
+	char *plaintext = NULL;
+
+	if (index < sj_looked_up)
+		return sj_plaintexts[index];
+
+	if (index >= sj_plaintexts_size) {
+		sj_plaintexts_size = index + 16;
+		sj_plaintexts = realloc(sj_plaintexts,
+		    sizeof(*sj_plaintexts) * sj_plaintexts_size);
+		if (!sj_plaintexts)
+			pexit("realloc");
+	}
+	while (sj_looked_up < index)
+		sj_plaintexts[sj_looked_up++] = NULL;
+
+	bucket = &sj_buckets[sj_hash(piece) % sj_count];
+	if (!bucket->have)
+		sj_next_result(bucket);
+
+/* Skip what the second pass doesn't ask for, if anything */
+	while (bucket->have && (bucket->head.line < sj_line ||
+	    (bucket->head.line == sj_line &&
+	    bucket->head.index < (uint32_t)index)))
+		sj_next_result(bucket);
+
+	while (bucket->have && bucket->head.line == sj_line &&
+	    bucket->head.index == (uint32_t)index) {
+		if (!plaintext && (bucket->head.flags == SJ_EXACT ||
+		    (format && format->methods.valid(bucket->ciphertext,
+		    format) == 1 && !strcmp(format->methods.split(
+		    bucket->ciphertext, 0, format), piece))))
+			plaintext = strcpy(mem_alloc(strlen(bucket->plaintext) +
+			    1), bucket->plaintext);
+		sj_next_result(bucket);
+	}
+
+	sj_plaintexts[sj_looked_up++] = plaintext;
+
+	return plaintext;
+}
+
+void showjoin_finish(void)
+{
+	unsigned int index;
+
+	showjoin_next_line();
+	sj_line = 0;
+
+	for (index = 0; index < sj_count; index++) {
+		struct sj_bucket *bucket = &sj_buckets[index];
+
+		if (bucket->probe && fclose(bucket->probe))
+			pexit("fclose");
+		if (bucket->result && fclose(bucket->result))
+			pexit("fclose");
+		bucket->probe = bucket->result = NULL;
+		bucket->have = 0;
+	}
+}
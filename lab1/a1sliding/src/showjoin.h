@@ -0,0 +1,73 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Streaming --show for pot files too big to be loaded into memory.
+ *
+ * Instead of loading the entire pot file, the loader partitions the pot
+ * file's entries into temporary bucket files by a case-insensitive hash of
+ * their ciphertext.  For each password file, it then reads the file once to
+ * partition the hashes to look up in the same way, joins the buckets (one
+ * per thread at a time, on the thread pool), and reads the file once more to
+ * print the results in their original order, exactly as if the pot file had
+ * been loaded.
+ *
+ * This is used for plain --show when the pot file is larger than
+ * "ShowJoinMemory" in john.conf and the pot file index isn't in use.
+ */
+
+#ifndef _JOHN_SHOWJOIN_H
+#define _JOHN_SHOWJOIN_H
+
+#include "formats.h"
+
+/*
+ * Returns non-zero and gets ready to accept the pot file's entries if the
+ * pot file "name" should be joined rather than loaded.
+ */
+extern int showjoin_open(char *name);
+
+/*
+ * Adds a pot file entry, after the loader's usual processing.
+ */
+extern void showjoin_add_pot(char *ciphertext, char *plaintext);
+
+/*
+ * Starts the next line of a password file.  This must be called for every
+ * line in both passes over the file, so that the lines are numbered alike.
+ */
+extern void showjoin_next_line(void);
+
+/*
+ * First pass: queues the ciphertext piece number "index" of the current line
+ * to be looked up.  "unify" is the format's FMT_SPLIT_UNIFIES_CASE, which
+ * lets pot file entries that only differ in case match after a split().
+ */
+extern void showjoin_add_probe(int index, int unify, char *piece);
+
+/*
+ * Joins the queued pieces with the pot file's entries and gets ready for the
+ * second pass over the password file.
+ */
+extern void showjoin_run(void);
+
+/*
+ * Second pass: returns the plaintext for the ciphertext piece number "index"
+ * of the current line, or NULL if it's not in the pot file.  "piece" must not
+ * be in a buffer of the format's split().
+ */
+extern char *showjoin_lookup(int index, char *piece, struct fmt_main *format);
+
+/*
+ * Frees what's left from the passes over a password file.  The pot file's
+ * entries are kept for the next password file.
+ */
+extern void showjoin_finish(void);
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Run time choice of the SIMD code in fat builds (JOHN_FAT).
+ *
+ * A fat build is compiled for the SSE2 base level, and has some of its SIMD
+ * code compiled again for AVX and AVX2: the MD4, MD5, SHA-1 and SHA-2 bodies
+ * (sse-intrinsics.c), bitslice DES (DES_bs_b.c) and the bcrypt gather code
+ * (BF_std.c).  The lane layouts are the same at every
+ * level, so the formats and the algorithm names are those of the base.
+ */
+
+#ifndef _JOHN_SSE_DISPATCH_H
+#define _JOHN_SSE_DISPATCH_H
+
+#ifdef JOHN_FAT
+
+#define SSE_LEVEL_BASE			0
+#define SSE_LEVEL_AVX			1
+#define SSE_LEVEL_AVX2			2
+
+/*
+ * Picks the best level that the CPU and OS support, up to the one named by
+ * the JOHN_SIMD_MAX environment variable if set.  Called once at startup,
+ * before any format is initialized.
+ */
+extern void SSE_dispatch_init(void);
+
+/*
+ * The picked level and its name.
+ */
+extern int SSE_level_runtime;
+extern const char *SSE_type_runtime;
+
+#endif
+
+#endif
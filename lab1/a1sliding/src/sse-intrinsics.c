@@ -43,7 +43,9 @@
 #include "arch.h"
 #include <string.h>
 #include <emmintrin.h>
-#ifdef __XOP__
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined __XOP__
 #include <x86intrin.h>
 #elif defined __SSE4_1__
 #include <smmintrin.h>
@@ -58,6 +60,7 @@
 #include "johnswap.h"
 #include "sse-intrinsics-load-flags.h"
 #include "aligned.h"
+#include "sse-dispatch.h"
 
 #include "memdbg.h"
 
@@ -155,7 +158,30 @@ _inline __m128i _mm_set1_epi64x(long long a)
   }
 #endif
 
-#ifdef __SSE4_1__
+#ifdef __AVX2__
+#define GATHER_4x(x, y, z)                      \
+{                                               \
+    x = _mm256_set_epi32 (y[z+(7<<6)], y[z+(6<<6)], \
+                          y[z+(5<<6)], y[z+(4<<6)], \
+                          y[z+(3<<6)], y[z+(2<<6)], \
+                          y[z+(1<<6)], y[z]);   \
+}
+#define GATHER_2x(x, y, z)                      \
+{                                               \
+    x = _mm256_set_epi32 (y[z+(7<<5)], y[z+(6<<5)], \
+                          y[z+(5<<5)], y[z+(4<<5)], \
+                          y[z+(3<<5)], y[z+(2<<5)], \
+                          y[z+(1<<5)], y[z]);   \
+}
+#define GATHER(x, y, z)                         \
+{                                               \
+    x = _mm256_set_epi32 (y[z+(7<<4)], y[z+(6<<4)], \
+                          y[z+(5<<4)], y[z+(4<<4)], \
+                          y[z+(3<<4)], y[z+(2<<4)], \
+                          y[z+(1<<4)], y[z]);   \
+}
+#define GATHER64(x,y,z)		{x = _mm256_set_epi64x (y[3][z], y[2][z], y[1][z], y[0][z]);}
+#elif defined(__SSE4_1__)
 #define GATHER_4x(x, y, z)                      \
 {                                               \
     x = _mm_cvtsi32_si128 (   y[z]   );         \
@@ -178,88 +204,351 @@ _inline __m128i _mm_set1_epi64x(long long a)
     x = _mm_insert_epi32  (x, y[z+(3<<4)], 3);  \
 }
 #endif
+#ifndef GATHER64
 #define GATHER64(x,y,z)		{x = _mm_set_epi64x (y[1][z], y[0][z]);}
+#endif
 
 
 #ifndef MMX_COEF
 #define MMX_COEF 4
 #endif
 
+/*
+ * The vector type and operations the bodies below are written with.  With
+ * AVX2, MD4, MD5 and SHA-1 keep their MMX_COEF wide interleaved layout and a
+ * 256-bit vector holds the same word of two consecutive MMX_COEF blocks (so
+ * their PARA must be even), while SHA-256 and SHA-512 are MMX_COEF_SHA256 (8)
+ * and MMX_COEF_SHA512 (4) keys wide.
+ */
+#ifdef __AVX2__
+typedef __m256i vtype;
+
+#define VBLOCKS				2
+
+#define vadd_epi32			_mm256_add_epi32
+#define vadd_epi64			_mm256_add_epi64
+#define vand				_mm256_and_si256
+#define vandnot				_mm256_andnot_si256
+#define vor				_mm256_or_si256
+#define vxor				_mm256_xor_si256
+#define vslli_epi32			_mm256_slli_epi32
+#define vsrli_epi32			_mm256_srli_epi32
+#define vslli_epi64			_mm256_slli_epi64
+#define vsrli_epi64			_mm256_srli_epi64
+#define vset1_epi32			_mm256_set1_epi32
+#define vset1_epi64x			_mm256_set1_epi64x
+#define vload(p)			_mm256_loadu_si256((vtype *)(p))
+#define vstore(p, v)			_mm256_storeu_si256((vtype *)(p), v)
+
+#define vcmov(y,z,x)			(vxor(z, vand(x, vxor(y, z))))
+
+#define vslli_epi32a(a, s)		\
+	((s) == 1 ? vadd_epi32((a), (a)) : vslli_epi32((a), (s)))
+
+#define vroti_epi32(a, s)						\
+	((s) < 0 ?							\
+		vor(vsrli_epi32((a), -(s)), vslli_epi32a((a), 32+(s)))	\
+	:								\
+		vor(vslli_epi32a((a), (s)), vsrli_epi32((a), 32-(s))))
+
+#define vroti_epi64(a, s)						\
+	((s) < 0 ?							\
+		vor(vsrli_epi64((a), -(s)), vslli_epi64((a), 64+(s)))	\
+	:								\
+		vor(vslli_epi64((a), (s)), vsrli_epi64((a), 64-(s))))
+
+/* Byte shuffles are within each 128-bit half, so the masks are repeated */
+#define vroti16_epi32(a, s)						\
+	(_mm256_shuffle_epi8((a), _mm256_set_epi32(			\
+		0x0d0c0f0e, 0x09080b0a, 0x05040706, 0x01000302,		\
+		0x0d0c0f0e, 0x09080b0a, 0x05040706, 0x01000302)))
+
+#define vswap_endian(n)							\
+	(n = _mm256_shuffle_epi8(n, _mm256_set_epi32(			\
+		0x0c0d0e0f, 0x08090a0b, 0x04050607, 0x00010203,		\
+		0x0c0d0e0f, 0x08090a0b, 0x04050607, 0x00010203)))
+#define vswap_endian64(n)						\
+	(n = _mm256_shuffle_epi8(n, _mm256_set_epi64x(			\
+		0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL,		\
+		0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL)))
+
+/* The vector of the same 4 words of two MMX_COEF blocks, lo and hi */
+#define vload_blocks(lo, hi)						\
+	_mm256_inserti128_si256(_mm256_castsi128_si256(			\
+		_mm_load_si128((__m128i *)(lo))),			\
+		_mm_load_si128((__m128i *)(hi)), 1)
+#define vstore_blocks(lo, hi, v)					\
+{									\
+	_mm_store_si128((__m128i *)(lo), _mm256_castsi256_si128(v));	\
+	_mm_store_si128((__m128i *)(hi), _mm256_extracti128_si256(v, 1)); \
+}
+#else
+typedef __m128i vtype;
+
+#define VBLOCKS				1
+
+#define vadd_epi32			_mm_add_epi32
+#define vadd_epi64			_mm_add_epi64
+#define vand				_mm_and_si128
+#define vandnot				_mm_andnot_si128
+#define vor				_mm_or_si128
+#define vxor				_mm_xor_si128
+#define vslli_epi32			_mm_slli_epi32
+#define vsrli_epi32			_mm_srli_epi32
+#define vslli_epi64			_mm_slli_epi64
+#define vsrli_epi64			_mm_srli_epi64
+#define vset1_epi32			_mm_set1_epi32
+#define vset1_epi64x			_mm_set1_epi64x
+#define vload(p)			_mm_load_si128((vtype *)(p))
+#define vstore(p, v)			_mm_store_si128((vtype *)(p), v)
+
+#define vcmov				_mm_cmov_si128
+#define vroti_epi32			_mm_roti_epi32
+#define vroti_epi64			_mm_roti_epi64
+#define vroti16_epi32			_mm_roti16_epi32
+#define vswap_endian			SWAP_ENDIAN
+#define vswap_endian64			SWAP_ENDIAN64
+
+#define vload_blocks(lo, hi)		_mm_load_si128((__m128i *)(lo))
+#define vstore_blocks(lo, hi, v)	_mm_store_si128((__m128i *)(lo), v)
+#endif
+
+/*
+ * Loads or stores vector i of a buffer made of MMX_COEF wide blocks, each
+ * stride words long.  The words are at offset off within each block.
+ */
+#define VLOAD_BLOCKS(p, i, stride, off)					\
+	vload_blocks(&(p)[(i)*VBLOCKS*(stride)+(off)],			\
+	             &(p)[((i)*VBLOCKS+1)*(stride)+(off)])
+#define VSTORE_BLOCKS(p, i, stride, off, v)				\
+	vstore_blocks(&(p)[(i)*VBLOCKS*(stride)+(off)],			\
+	              &(p)[((i)*VBLOCKS+1)*(stride)+(off)], v)
+
+#if VBLOCKS > 1
+/*
+ * Pairs up the 16 words of each two MMX_COEF blocks of interleaved input,
+ * for count vectors.
+ */
+static MAYBE_INLINE void vload_input(vtype *w, __m128i *data, int count)
+{
+	int i, j;
+
+	for (i = 0; i < count; i++)
+		for (j = 0; j < 16; j++)
+			w[i*16+j] = VLOAD_BLOCKS(data, i, 16, j);
+}
+#endif
+
+#ifdef SSE_VARIANT
+/*
+ * One of the extra ISA levels of a fat build: just the bodies, under names
+ * ending with SSE_VARIANT (such as SSEmd5body_avx2).  Their interface and
+ * buffer layouts are the same at every level.  The SHA-2 lanes are 128 bits
+ * wide at every level, which the 256-bit vectors of the AVX2 level can't do,
+ * so that level uses the AVX build of those.  RIPEMD-160 gained nothing from
+ * AVX, so it's only built for the base level.
+ */
+#define SSE_VARIANT_NAME2(name, variant)	name ## variant
+#define SSE_VARIANT_NAME(name, variant)	SSE_VARIANT_NAME2(name, variant)
+#define SSEmd5body			SSE_VARIANT_NAME(SSEmd5body, SSE_VARIANT)
+#define SSEmd4body			SSE_VARIANT_NAME(SSEmd4body, SSE_VARIANT)
+#define SSESHA1body			SSE_VARIANT_NAME(SSESHA1body, SSE_VARIANT)
+#define SSESHA256body			SSE_VARIANT_NAME(SSESHA256body, SSE_VARIANT)
+#define SSESHA512body			SSE_VARIANT_NAME(SSESHA512body, SSE_VARIANT)
+#ifdef __AVX2__
+#define SSE_VARIANT_NO_SHA2
+#endif
+#elif defined(JOHN_FAT)
+/*
+ * The base level of a fat build.  SSE_dispatch_init() points the bodies
+ * below at the best extra level the CPU and OS support, if any.
+ */
+#if !defined(__GNUC__) || !defined(__x86_64__)
+#error Fat builds are for gcc on x86-64 only
+#endif
+#if !defined(MD5_SSE_PARA) || !defined(MD4_SSE_PARA) || !defined(SHA1_SSE_PARA)
+#error Fat builds need the MD4, MD5 and SHA-1 SIMD code
+#endif
+#if MMX_COEF_SHA256 != 4 || MMX_COEF_SHA512 != 2 || MMX_COEF_RIPEMD160 != 4
+#error Fat builds need the 128-bit SHA-2 and RIPEMD-160 lane layout
+#endif
+#include <stdlib.h>
+#include <cpuid.h>
+
+#define SSE_DISPATCH
+
+typedef void (*SSE_body)(__m128i *data, ARCH_WORD_32 *out,
+    ARCH_WORD_32 *reload_state, unsigned SSEi_flags);
+typedef void (*SSE_body64)(__m128i *data, ARCH_WORD_64 *out,
+    ARCH_WORD_64 *reload_state, unsigned SSEi_flags);
+
+#define SSE_VARIANT_DECLARE(name, variant)				\
+	void name ## variant(__m128i *data, ARCH_WORD_32 *out,		\
+	    ARCH_WORD_32 *reload_state, unsigned SSEi_flags);
+
+SSE_VARIANT_DECLARE(SSEmd5body, _avx)
+SSE_VARIANT_DECLARE(SSEmd4body, _avx)
+SSE_VARIANT_DECLARE(SSESHA1body, _avx)
+SSE_VARIANT_DECLARE(SSESHA256body, _avx)
+SSE_VARIANT_DECLARE(SSEmd5body, _avx2)
+SSE_VARIANT_DECLARE(SSEmd4body, _avx2)
+SSE_VARIANT_DECLARE(SSESHA1body, _avx2)
+void SSESHA512body_avx(__m128i *data, ARCH_WORD_64 *out,
+    ARCH_WORD_64 *reload_state, unsigned SSEi_flags);
+
+#if defined(__AVX__)
+const char *SSE_type_runtime = "AVX";
+#elif defined(__SSE4_1__)
+const char *SSE_type_runtime = "SSE4.1";
+#elif defined(__SSSE3__)
+const char *SSE_type_runtime = "SSSE3";
+#else
+const char *SSE_type_runtime = "SSE2";
+#endif
+int SSE_level_runtime = SSE_LEVEL_BASE;
+
+static SSE_body SSEmd5body_level, SSEmd4body_level, SSESHA1body_level;
+static SSE_body SSESHA256body_level;
+static SSE_body64 SSESHA512body_level;
+
+/* AVX needs the OS to save the YMM registers, too */
+static int SSE_cpu_avx(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+	    (ecx & 0x18000000) != 0x18000000) /* OSXSAVE and AVX */
+		return 0;
+
+	__asm__ __volatile__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	return (eax & 6) == 6;
+}
+
+static int SSE_cpu_avx2(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!SSE_cpu_avx() || __get_cpuid_max(0, NULL) < 7)
+		return 0;
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return ebx & 0x20;
+}
+
+void SSE_dispatch_init(void)
+{
+	char *max = getenv("JOHN_SIMD_MAX");
+	int avx2 = 1, avx = 1;
+
+	if (max && *max) {
+		avx2 = !strcasecmp(max, "AVX2");
+		avx = avx2 || !strcasecmp(max, "AVX");
+	}
+
+	if (avx2 && SSE_cpu_avx2()) {
+		SSEmd5body_level = SSEmd5body_avx2;
+		SSEmd4body_level = SSEmd4body_avx2;
+		SSESHA1body_level = SSESHA1body_avx2;
+		SSE_level_runtime = SSE_LEVEL_AVX2;
+		SSE_type_runtime = "AVX2";
+	} else if (avx && SSE_cpu_avx()) {
+		SSEmd5body_level = SSEmd5body_avx;
+		SSEmd4body_level = SSEmd4body_avx;
+		SSESHA1body_level = SSESHA1body_avx;
+		SSE_level_runtime = SSE_LEVEL_AVX;
+		SSE_type_runtime = "AVX";
+	} else
+		return;
+
+	SSESHA256body_level = SSESHA256body_avx;
+	SSESHA512body_level = SSESHA512body_avx;
+}
+#endif
+
 #ifdef MD5_SSE_PARA
 #define MD5_SSE_NUM_KEYS	(MMX_COEF*MD5_SSE_PARA)
 #define MD5_PARA_DO(x)	for((x)=0;(x)<MD5_SSE_PARA;(x)++)
+#define MD5_VPARA	(MD5_SSE_PARA/VBLOCKS)
+#define MD5_VPARA_DO(x)	for((x)=0;(x)<MD5_VPARA;(x)++)
 
 #define MD5_F(x,y,z) \
-	MD5_PARA_DO(i) tmp[i] = _mm_cmov_si128((y[i]),(z[i]),(x[i]));
+	MD5_VPARA_DO(i) tmp[i] = vcmov((y[i]),(z[i]),(x[i]));
 
 #define MD5_G(x,y,z) \
-	MD5_PARA_DO(i) tmp[i] = _mm_cmov_si128((x[i]),(y[i]),(z[i]));
+	MD5_VPARA_DO(i) tmp[i] = vcmov((x[i]),(y[i]),(z[i]));
 
 #define MD5_H(x,y,z) \
-	MD5_PARA_DO(i) tmp[i] = _mm_xor_si128((y[i]),(z[i])); \
-	MD5_PARA_DO(i) tmp[i] = _mm_xor_si128((tmp[i]),(x[i]));
+	MD5_VPARA_DO(i) tmp[i] = vxor((y[i]),(z[i])); \
+	MD5_VPARA_DO(i) tmp[i] = vxor((tmp[i]),(x[i]));
 
 #define MD5_I(x,y,z) \
-	MD5_PARA_DO(i) tmp[i] = _mm_andnot_si128((z[i]), mask); \
-	MD5_PARA_DO(i) tmp[i] = _mm_or_si128((tmp[i]),(x[i])); \
-	MD5_PARA_DO(i) tmp[i] = _mm_xor_si128((tmp[i]),(y[i]));
+	MD5_VPARA_DO(i) tmp[i] = vandnot((z[i]), mask); \
+	MD5_VPARA_DO(i) tmp[i] = vor((tmp[i]),(x[i])); \
+	MD5_VPARA_DO(i) tmp[i] = vxor((tmp[i]),(y[i]));
 
 #define MD5_STEP(f, a, b, c, d, x, t, s) \
-	MD5_PARA_DO(i) a[i] = _mm_add_epi32( a[i], _mm_set_epi32(t,t,t,t) ); \
+	MD5_VPARA_DO(i) a[i] = vadd_epi32( a[i], vset1_epi32(t) ); \
 	f((b),(c),(d)) \
-	MD5_PARA_DO(i) a[i] = _mm_add_epi32( a[i], tmp[i] ); \
-	MD5_PARA_DO(i) a[i] = _mm_add_epi32( a[i], data[i*16+x] ); \
-	MD5_PARA_DO(i) a[i] = _mm_roti_epi32( a[i], (s) ); \
-	MD5_PARA_DO(i) a[i] = _mm_add_epi32( a[i], b[i] );
+	MD5_VPARA_DO(i) a[i] = vadd_epi32( a[i], tmp[i] ); \
+	MD5_VPARA_DO(i) a[i] = vadd_epi32( a[i], data[i*16+x] ); \
+	MD5_VPARA_DO(i) a[i] = vroti_epi32( a[i], (s) ); \
+	MD5_VPARA_DO(i) a[i] = vadd_epi32( a[i], b[i] );
 
 #define MD5_STEP_r16(f, a, b, c, d, x, t, s) \
-	MD5_PARA_DO(i) a[i] = _mm_add_epi32( a[i], _mm_set_epi32(t,t,t,t) ); \
+	MD5_VPARA_DO(i) a[i] = vadd_epi32( a[i], vset1_epi32(t) ); \
 	f((b),(c),(d)) \
-	MD5_PARA_DO(i) a[i] = _mm_add_epi32( a[i], tmp[i] ); \
-	MD5_PARA_DO(i) a[i] = _mm_add_epi32( a[i], data[i*16+x] ); \
-	MD5_PARA_DO(i) a[i] = _mm_roti16_epi32( a[i], (s) ); \
-	MD5_PARA_DO(i) a[i] = _mm_add_epi32( a[i], b[i] );
+	MD5_VPARA_DO(i) a[i] = vadd_epi32( a[i], tmp[i] ); \
+	MD5_VPARA_DO(i) a[i] = vadd_epi32( a[i], data[i*16+x] ); \
+	MD5_VPARA_DO(i) a[i] = vroti16_epi32( a[i], (s) ); \
+	MD5_VPARA_DO(i) a[i] = vadd_epi32( a[i], b[i] );
 
 void SSEmd5body(__m128i* _data, unsigned int * out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags)
 {
-	__m128i w[16*MD5_SSE_PARA];
-	__m128i a[MD5_SSE_PARA];
-	__m128i b[MD5_SSE_PARA];
-	__m128i c[MD5_SSE_PARA];
-	__m128i d[MD5_SSE_PARA];
-	__m128i tmp[MD5_SSE_PARA];
-	__m128i mask;
+	vtype w[16*MD5_VPARA];
+	vtype a[MD5_VPARA];
+	vtype b[MD5_VPARA];
+	vtype c[MD5_VPARA];
+	vtype d[MD5_VPARA];
+	vtype tmp[MD5_VPARA];
+	vtype mask;
 	unsigned int i;
-	__m128i *data;
+	vtype *data;
 
-	mask = _mm_set1_epi32(0Xffffffff);
+#ifdef SSE_DISPATCH
+	if (SSEmd5body_level) {
+		SSEmd5body_level(_data, out, reload_state, SSEi_flags);
+		return;
+	}
+#endif
+
+	mask = vset1_epi32(0Xffffffff);
 
 	if(SSEi_flags & SSEi_FLAT_IN) {
 		// Move _data to __data, mixing it MMX_COEF wise.
 #ifdef __SSE4_1__
 		unsigned k;
-		__m128i *W = w;
+		vtype *W = w;
 		ARCH_WORD_32 *saved_key = (ARCH_WORD_32 *)_data;
-		MD5_PARA_DO(k)
+		MD5_VPARA_DO(k)
 		{
 			if (SSEi_flags & SSEi_4BUF_INPUT) {
 				for (i=0; i < 16; ++i) { GATHER_4x (W[i], saved_key, i); }
-				saved_key += (MMX_COEF<<6);
+				saved_key += ((MMX_COEF*VBLOCKS)<<6);
 			} else if (SSEi_flags & SSEi_2BUF_INPUT) {
 				for (i=0; i < 16; ++i) { GATHER_2x (W[i], saved_key, i); }
-				saved_key += (MMX_COEF<<5);
+				saved_key += ((MMX_COEF*VBLOCKS)<<5);
 			} else {
 				for (i=0; i < 16; ++i) { GATHER (W[i], saved_key, i); }
-				saved_key += (MMX_COEF<<4);
+				saved_key += ((MMX_COEF*VBLOCKS)<<4);
 			}
 			W += 16;
 		}
 #else
 		unsigned j, k;
 		ARCH_WORD_32 *p = (ARCH_WORD_32 *)w;
-		__m128i *W = w;
+		vtype *W = w;
 		ARCH_WORD_32 *saved_key = (ARCH_WORD_32 *)_data;
-		MD5_PARA_DO(k)
+		MD5_VPARA_DO(k)
 		{
 			if (SSEi_flags & SSEi_4BUF_INPUT) {
 				for (j=0; j < 16; j++)
@@ -283,38 +572,45 @@ void SSEmd5body(__m128i* _data, unsigned int * out, ARCH_WORD_32 *reload_state,
 		// now set our data pointer to point to this 'mixed' data.
 		data = w;
 	} else
+#if VBLOCKS > 1
+	{
+		vload_input(w, _data, MD5_VPARA);
+		data = w;
+	}
+#else
 		data = _data;
+#endif
 
 	if((SSEi_flags & SSEi_RELOAD)==0)
 	{
-		MD5_PARA_DO(i)
+		MD5_VPARA_DO(i)
 		{
-			a[i] = _mm_set1_epi32(0x67452301);
-			b[i] = _mm_set1_epi32(0xefcdab89);
-			c[i] = _mm_set1_epi32(0x98badcfe);
-			d[i] = _mm_set1_epi32(0x10325476);
+			a[i] = vset1_epi32(0x67452301);
+			b[i] = vset1_epi32(0xefcdab89);
+			c[i] = vset1_epi32(0x98badcfe);
+			d[i] = vset1_epi32(0x10325476);
 		}
 	}
 	else
 	{
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			MD5_PARA_DO(i)
+			MD5_VPARA_DO(i)
 			{
-				a[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+0]);
-				b[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+4]);
-				c[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+8]);
-				d[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+12]);
+				a[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 0);
+				b[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 4);
+				c[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 8);
+				d[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 12);
 			}
 		}
 		else
 		{
-			MD5_PARA_DO(i)
+			MD5_VPARA_DO(i)
 			{
-				a[i] = _mm_load_si128((__m128i *)&reload_state[i*16+0]);
-				b[i] = _mm_load_si128((__m128i *)&reload_state[i*16+4]);
-				c[i] = _mm_load_si128((__m128i *)&reload_state[i*16+8]);
-				d[i] = _mm_load_si128((__m128i *)&reload_state[i*16+12]);
+				a[i] = VLOAD_BLOCKS(reload_state, i, 16, 0);
+				b[i] = VLOAD_BLOCKS(reload_state, i, 16, 4);
+				c[i] = VLOAD_BLOCKS(reload_state, i, 16, 8);
+				d[i] = VLOAD_BLOCKS(reload_state, i, 16, 12);
 			}
 		}
 	}
@@ -393,59 +689,60 @@ void SSEmd5body(__m128i* _data, unsigned int * out, ARCH_WORD_32 *reload_state,
 
 	if((SSEi_flags & SSEi_RELOAD)==0)
 	{
-		MD5_PARA_DO(i)
+		MD5_VPARA_DO(i)
 		{
-			a[i] = _mm_add_epi32(a[i], _mm_set1_epi32(0x67452301));
-			b[i] = _mm_add_epi32(b[i], _mm_set1_epi32(0xefcdab89));
-			c[i] = _mm_add_epi32(c[i], _mm_set1_epi32(0x98badcfe));
-			d[i] = _mm_add_epi32(d[i], _mm_set1_epi32(0x10325476));
+			a[i] = vadd_epi32(a[i], vset1_epi32(0x67452301));
+			b[i] = vadd_epi32(b[i], vset1_epi32(0xefcdab89));
+			c[i] = vadd_epi32(c[i], vset1_epi32(0x98badcfe));
+			d[i] = vadd_epi32(d[i], vset1_epi32(0x10325476));
 		}
 	}
 	else
 	{
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			MD5_PARA_DO(i)
+			MD5_VPARA_DO(i)
 			{
-				a[i] = _mm_add_epi32(a[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+0]));
-				b[i] = _mm_add_epi32(b[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+4]));
-				c[i] = _mm_add_epi32(c[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+8]));
-				d[i] = _mm_add_epi32(d[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+12]));
+				a[i] = vadd_epi32(a[i], VLOAD_BLOCKS(reload_state, i, 16*4, 0));
+				b[i] = vadd_epi32(b[i], VLOAD_BLOCKS(reload_state, i, 16*4, 4));
+				c[i] = vadd_epi32(c[i], VLOAD_BLOCKS(reload_state, i, 16*4, 8));
+				d[i] = vadd_epi32(d[i], VLOAD_BLOCKS(reload_state, i, 16*4, 12));
 			}
 		}
 		else
 		{
-			MD5_PARA_DO(i)
+			MD5_VPARA_DO(i)
 			{
-				a[i] = _mm_add_epi32(a[i], _mm_load_si128((__m128i *)&reload_state[i*16+0]));
-				b[i] = _mm_add_epi32(b[i], _mm_load_si128((__m128i *)&reload_state[i*16+4]));
-				c[i] = _mm_add_epi32(c[i], _mm_load_si128((__m128i *)&reload_state[i*16+8]));
-				d[i] = _mm_add_epi32(d[i], _mm_load_si128((__m128i *)&reload_state[i*16+12]));
+				a[i] = vadd_epi32(a[i], VLOAD_BLOCKS(reload_state, i, 16, 0));
+				b[i] = vadd_epi32(b[i], VLOAD_BLOCKS(reload_state, i, 16, 4));
+				c[i] = vadd_epi32(c[i], VLOAD_BLOCKS(reload_state, i, 16, 8));
+				d[i] = vadd_epi32(d[i], VLOAD_BLOCKS(reload_state, i, 16, 12));
 			}
 		}
 	}
 	if (SSEi_flags & SSEi_OUTPUT_AS_INP_FMT)
 	{
-		MD5_PARA_DO(i)
+		MD5_VPARA_DO(i)
 		{
-			_mm_store_si128((__m128i *)&out[i*16*4+0], a[i]);
-			_mm_store_si128((__m128i *)&out[i*16*4+4], b[i]);
-			_mm_store_si128((__m128i *)&out[i*16*4+8], c[i]);
-			_mm_store_si128((__m128i *)&out[i*16*4+12], d[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 0, a[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 4, b[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 8, c[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 12, d[i]);
 		}
 	}
 	else
 	{
-		MD5_PARA_DO(i)
+		MD5_VPARA_DO(i)
 		{
-			_mm_store_si128((__m128i *)&out[i*16+0], a[i]);
-			_mm_store_si128((__m128i *)&out[i*16+4], b[i]);
-			_mm_store_si128((__m128i *)&out[i*16+8], c[i]);
-			_mm_store_si128((__m128i *)&out[i*16+12], d[i]);
+			VSTORE_BLOCKS(out, i, 16, 0, a[i]);
+			VSTORE_BLOCKS(out, i, 16, 4, b[i]);
+			VSTORE_BLOCKS(out, i, 16, 8, c[i]);
+			VSTORE_BLOCKS(out, i, 16, 12, d[i]);
 		}
 	}
 }
 
+#ifndef SSE_VARIANT
 #define GETPOS(i, index)                ( (index&3)*4 + (i& (0xffffffff-3) )*MMX_COEF + ((i)&3) )
 
 static MAYBE_INLINE void mmxput(void * buf, unsigned int index, unsigned int bid, unsigned int offset, unsigned char * src, unsigned int len)
@@ -676,71 +973,81 @@ void md5cryptsse(unsigned char pwd[MD5_SSE_NUM_KEYS][16], unsigned char * salt,
 	dispatch(buffers, F, length, saltlen);
 	memcpy(out, F, MD5_SSE_NUM_KEYS*16);
 }
+#endif /* SSE_VARIANT */
 #endif /* MD5_SSE_PARA */
 
 #ifdef MD4_SSE_PARA
 #define MD4_SSE_NUM_KEYS	(MMX_COEF*MD4_SSE_PARA)
 #define MD4_PARA_DO(x)	for((x)=0;(x)<MD4_SSE_PARA;(x)++)
+#define MD4_VPARA	(MD4_SSE_PARA/VBLOCKS)
+#define MD4_VPARA_DO(x)	for((x)=0;(x)<MD4_VPARA;(x)++)
 
 #define MD4_F(x,y,z) \
-	MD4_PARA_DO(i) tmp[i] = _mm_cmov_si128((y[i]),(z[i]),(x[i]));
+	MD4_VPARA_DO(i) tmp[i] = vcmov((y[i]),(z[i]),(x[i]));
 
 #define MD4_G(x,y,z) \
-	MD4_PARA_DO(i) tmp[i] = _mm_or_si128((y[i]),(z[i])); \
-	MD4_PARA_DO(i) tmp2[i] = _mm_and_si128((y[i]),(z[i])); \
-	MD4_PARA_DO(i) tmp[i] = _mm_and_si128((tmp[i]),(x[i])); \
-	MD4_PARA_DO(i) tmp[i] = _mm_or_si128((tmp[i]), (tmp2[i]) );
+	MD4_VPARA_DO(i) tmp[i] = vor((y[i]),(z[i])); \
+	MD4_VPARA_DO(i) tmp2[i] = vand((y[i]),(z[i])); \
+	MD4_VPARA_DO(i) tmp[i] = vand((tmp[i]),(x[i])); \
+	MD4_VPARA_DO(i) tmp[i] = vor((tmp[i]), (tmp2[i]) );
 
 #define MD4_H(x,y,z) \
-	MD4_PARA_DO(i) tmp[i] = _mm_xor_si128((y[i]),(z[i])); \
-	MD4_PARA_DO(i) tmp[i] = _mm_xor_si128((tmp[i]),(x[i]));
+	MD4_VPARA_DO(i) tmp[i] = vxor((y[i]),(z[i])); \
+	MD4_VPARA_DO(i) tmp[i] = vxor((tmp[i]),(x[i]));
 
 #define MD4_STEP(f, a, b, c, d, x, t, s) \
-	MD4_PARA_DO(i) a[i] = _mm_add_epi32( a[i], t ); \
+	MD4_VPARA_DO(i) a[i] = vadd_epi32( a[i], t ); \
 	f((b),(c),(d)) \
-	MD4_PARA_DO(i) a[i] = _mm_add_epi32( a[i], tmp[i] ); \
-	MD4_PARA_DO(i) a[i] = _mm_add_epi32( a[i], data[i*16+x] ); \
-	MD4_PARA_DO(i) a[i] = _mm_roti_epi32( a[i], (s) );
+	MD4_VPARA_DO(i) a[i] = vadd_epi32( a[i], tmp[i] ); \
+	MD4_VPARA_DO(i) a[i] = vadd_epi32( a[i], data[i*16+x] ); \
+	MD4_VPARA_DO(i) a[i] = vroti_epi32( a[i], (s) );
 
 void SSEmd4body(__m128i* _data, unsigned int * out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags)
 {
-	__m128i w[16*MD4_SSE_PARA];
-	__m128i a[MD4_SSE_PARA];
-	__m128i b[MD4_SSE_PARA];
-	__m128i c[MD4_SSE_PARA];
-	__m128i d[MD4_SSE_PARA];
-	__m128i tmp[MD4_SSE_PARA];
-	__m128i tmp2[MD4_SSE_PARA];
-	__m128i	cst;
+	vtype w[16*MD4_VPARA];
+	vtype a[MD4_VPARA];
+	vtype b[MD4_VPARA];
+	vtype c[MD4_VPARA];
+	vtype d[MD4_VPARA];
+	vtype tmp[MD4_VPARA];
+	vtype tmp2[MD4_VPARA];
+	vtype	cst;
 	unsigned int i;
-	__m128i *data;
+	vtype *data;
+
+#ifdef SSE_DISPATCH
+	if (SSEmd4body_level) {
+		SSEmd4body_level(_data, out, reload_state, SSEi_flags);
+		return;
+	}
+#endif
 
 if(SSEi_flags & SSEi_FLAT_IN) {
 		// Move _data to __data, mixing it MMX_COEF wise.
 #ifdef __SSE4_1__
 		unsigned k;
-		__m128i *W = w;
+		vtype *W = w;
 		ARCH_WORD_32 *saved_key = (ARCH_WORD_32 *)_data;
-		MD4_PARA_DO(k)
+		MD4_VPARA_DO(k)
 		{
 			if (SSEi_flags & SSEi_4BUF_INPUT) {
 				for (i=0; i < 16; ++i) { GATHER_4x (W[i], saved_key, i); }
-				saved_key += (MMX_COEF<<6);
+				saved_key += ((MMX_COEF*VBLOCKS)<<6);
 			} else if (SSEi_flags & SSEi_2BUF_INPUT) {
 				for (i=0; i < 16; ++i) { GATHER_2x (W[i], saved_key, i); }
-				saved_key += (MMX_COEF<<5);
+				saved_key += ((MMX_COEF*VBLOCKS)<<5);
 			} else {
 				for (i=0; i < 16; ++i) { GATHER (W[i], saved_key, i); }
-				saved_key += (MMX_COEF<<4);
+				saved_key += ((MMX_COEF*VBLOCKS)<<4);
 			}
 			W += 16;
 		}
 #else
 		unsigned j, k;
 		ARCH_WORD_32 *p = (ARCH_WORD_32 *)w;
-		__m128i *W = w;
+		vtype *W = w;
 		ARCH_WORD_32 *saved_key = (ARCH_WORD_32 *)_data;
-		MD4_PARA_DO(k)
+		MD4_VPARA_DO(k)
 		{
 			if (SSEi_flags & SSEi_4BUF_INPUT) {
 				for (j=0; j < 16; j++)
@@ -764,45 +1071,52 @@ if(SSEi_flags & SSEi_FLAT_IN) {
 		// now set our data pointer to point to this 'mixed' data.
 		data = w;
 	} else
+#if VBLOCKS > 1
+	{
+		vload_input(w, _data, MD4_VPARA);
+		data = w;
+	}
+#else
 		data = _data;
+#endif
 
 	if((SSEi_flags & SSEi_RELOAD)==0)
 	{
-		MD4_PARA_DO(i)
+		MD4_VPARA_DO(i)
 		{
-			a[i] = _mm_set1_epi32(0x67452301);
-			b[i] = _mm_set1_epi32(0xefcdab89);
-			c[i] = _mm_set1_epi32(0x98badcfe);
-			d[i] = _mm_set1_epi32(0x10325476);
+			a[i] = vset1_epi32(0x67452301);
+			b[i] = vset1_epi32(0xefcdab89);
+			c[i] = vset1_epi32(0x98badcfe);
+			d[i] = vset1_epi32(0x10325476);
 		}
 	}
 	else
 	{
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			MD4_PARA_DO(i)
+			MD4_VPARA_DO(i)
 			{
-				a[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+0]);
-				b[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+4]);
-				c[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+8]);
-				d[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+12]);
+				a[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 0);
+				b[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 4);
+				c[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 8);
+				d[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 12);
 			}
 		}
 		else
 		{
-			MD4_PARA_DO(i)
+			MD4_VPARA_DO(i)
 			{
-				a[i] = _mm_load_si128((__m128i *)&reload_state[i*16+0]);
-				b[i] = _mm_load_si128((__m128i *)&reload_state[i*16+4]);
-				c[i] = _mm_load_si128((__m128i *)&reload_state[i*16+8]);
-				d[i] = _mm_load_si128((__m128i *)&reload_state[i*16+12]);
+				a[i] = VLOAD_BLOCKS(reload_state, i, 16, 0);
+				b[i] = VLOAD_BLOCKS(reload_state, i, 16, 4);
+				c[i] = VLOAD_BLOCKS(reload_state, i, 16, 8);
+				d[i] = VLOAD_BLOCKS(reload_state, i, 16, 12);
 			}
 		}
 	}
 
 
 /* Round 1 */
-		cst = _mm_set_epi32(0,0,0,0);
+		cst = vset1_epi32(0);
 		MD4_STEP(MD4_F, a, b, c, d, 0, cst, 3)
 		MD4_STEP(MD4_F, d, a, b, c, 1, cst, 7)
 		MD4_STEP(MD4_F, c, d, a, b, 2, cst, 11)
@@ -821,7 +1135,7 @@ if(SSEi_flags & SSEi_FLAT_IN) {
 		MD4_STEP(MD4_F, b, c, d, a, 15, cst, 19)
 
 /* Round 2 */
-		cst = _mm_set_epi32(0x5A827999L,0x5A827999L,0x5A827999L,0x5A827999L);
+		cst = vset1_epi32(0x5A827999L);
 		MD4_STEP(MD4_G, a, b, c, d, 0, cst, 3)
 		MD4_STEP(MD4_G, d, a, b, c, 4, cst, 5)
 		MD4_STEP(MD4_G, c, d, a, b, 8, cst, 9)
@@ -840,7 +1154,7 @@ if(SSEi_flags & SSEi_FLAT_IN) {
 		MD4_STEP(MD4_G, b, c, d, a, 15, cst, 13)
 
 /* Round 3 */
-		cst = _mm_set_epi32(0x6ED9EBA1L,0x6ED9EBA1L,0x6ED9EBA1L,0x6ED9EBA1L);
+		cst = vset1_epi32(0x6ED9EBA1L);
 		MD4_STEP(MD4_H, a, b, c, d, 0, cst, 3)
 		MD4_STEP(MD4_H, d, a, b, c, 8, cst, 9)
 		MD4_STEP(MD4_H, c, d, a, b, 4, cst, 11)
@@ -861,55 +1175,55 @@ if(SSEi_flags & SSEi_FLAT_IN) {
 
 	if((SSEi_flags & SSEi_RELOAD)==0)
 	{
-		MD4_PARA_DO(i)
+		MD4_VPARA_DO(i)
 		{
-			a[i] = _mm_add_epi32(a[i], _mm_set1_epi32(0x67452301));
-			b[i] = _mm_add_epi32(b[i], _mm_set1_epi32(0xefcdab89));
-			c[i] = _mm_add_epi32(c[i], _mm_set1_epi32(0x98badcfe));
-			d[i] = _mm_add_epi32(d[i], _mm_set1_epi32(0x10325476));
+			a[i] = vadd_epi32(a[i], vset1_epi32(0x67452301));
+			b[i] = vadd_epi32(b[i], vset1_epi32(0xefcdab89));
+			c[i] = vadd_epi32(c[i], vset1_epi32(0x98badcfe));
+			d[i] = vadd_epi32(d[i], vset1_epi32(0x10325476));
 		}
 	}
 	else
 	{
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			MD4_PARA_DO(i)
+			MD4_VPARA_DO(i)
 			{
-				a[i] = _mm_add_epi32(a[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+0]));
-				b[i] = _mm_add_epi32(b[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+4]));
-				c[i] = _mm_add_epi32(c[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+8]));
-				d[i] = _mm_add_epi32(d[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+12]));
+				a[i] = vadd_epi32(a[i], VLOAD_BLOCKS(reload_state, i, 16*4, 0));
+				b[i] = vadd_epi32(b[i], VLOAD_BLOCKS(reload_state, i, 16*4, 4));
+				c[i] = vadd_epi32(c[i], VLOAD_BLOCKS(reload_state, i, 16*4, 8));
+				d[i] = vadd_epi32(d[i], VLOAD_BLOCKS(reload_state, i, 16*4, 12));
 			}
 		}
 		else
 		{
-			MD4_PARA_DO(i)
+			MD4_VPARA_DO(i)
 			{
-				a[i] = _mm_add_epi32(a[i], _mm_load_si128((__m128i *)&reload_state[i*16+0]));
-				b[i] = _mm_add_epi32(b[i], _mm_load_si128((__m128i *)&reload_state[i*16+4]));
-				c[i] = _mm_add_epi32(c[i], _mm_load_si128((__m128i *)&reload_state[i*16+8]));
-				d[i] = _mm_add_epi32(d[i], _mm_load_si128((__m128i *)&reload_state[i*16+12]));
+				a[i] = vadd_epi32(a[i], VLOAD_BLOCKS(reload_state, i, 16, 0));
+				b[i] = vadd_epi32(b[i], VLOAD_BLOCKS(reload_state, i, 16, 4));
+				c[i] = vadd_epi32(c[i], VLOAD_BLOCKS(reload_state, i, 16, 8));
+				d[i] = vadd_epi32(d[i], VLOAD_BLOCKS(reload_state, i, 16, 12));
 			}
 		}
 	}
 	if (SSEi_flags & SSEi_OUTPUT_AS_INP_FMT)
 	{
-		MD4_PARA_DO(i)
+		MD4_VPARA_DO(i)
 		{
-			_mm_store_si128((__m128i *)&out[i*16*4+0], a[i]);
-			_mm_store_si128((__m128i *)&out[i*16*4+4], b[i]);
-			_mm_store_si128((__m128i *)&out[i*16*4+8], c[i]);
-			_mm_store_si128((__m128i *)&out[i*16*4+12], d[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 0, a[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 4, b[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 8, c[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 12, d[i]);
 		}
 	}
 	else
 	{
-		MD4_PARA_DO(i)
+		MD4_VPARA_DO(i)
 		{
-			_mm_store_si128((__m128i *)&out[i*16+0], a[i]);
-			_mm_store_si128((__m128i *)&out[i*16+4], b[i]);
-			_mm_store_si128((__m128i *)&out[i*16+8], c[i]);
-			_mm_store_si128((__m128i *)&out[i*16+12], d[i]);
+			VSTORE_BLOCKS(out, i, 16, 0, a[i]);
+			VSTORE_BLOCKS(out, i, 16, 4, b[i]);
+			VSTORE_BLOCKS(out, i, 16, 8, c[i]);
+			VSTORE_BLOCKS(out, i, 16, 12, d[i]);
 		}
 	}
 }
@@ -919,25 +1233,27 @@ if(SSEi_flags & SSEi_FLAT_IN) {
 #ifdef SHA1_SSE_PARA
 #define SHA1_SSE_NUM_KEYS	(MMX_COEF*SHA1_SSE_PARA)
 #define SHA1_PARA_DO(x)		for((x)=0;(x)<SHA1_SSE_PARA;(x)++)
+#define SHA1_VPARA	(SHA1_SSE_PARA/VBLOCKS)
+#define SHA1_VPARA_DO(x)		for((x)=0;(x)<SHA1_VPARA;(x)++)
 
 #define SHA1_F(x,y,z) \
-	SHA1_PARA_DO(i) tmp[i] = _mm_cmov_si128((y[i]),(z[i]),(x[i]));
+	SHA1_VPARA_DO(i) tmp[i] = vcmov((y[i]),(z[i]),(x[i]));
 
 #define SHA1_G(x,y,z) \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128((y[i]),(z[i])); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128((tmp[i]),(x[i]));
+	SHA1_VPARA_DO(i) tmp[i] = vxor((y[i]),(z[i])); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor((tmp[i]),(x[i]));
 
 #ifdef __XOP__
 #define SHA1_H(x,y,z) \
-	SHA1_PARA_DO(i) tmp[i] = _mm_cmov_si128((x[i]),(y[i]),(z[i])); \
-	SHA1_PARA_DO(i) tmp2[i] = _mm_andnot_si128((x[i]),(y[i])); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128((tmp[i]),(tmp2[i]));
+	SHA1_VPARA_DO(i) tmp[i] = vcmov((x[i]),(y[i]),(z[i])); \
+	SHA1_VPARA_DO(i) tmp2[i] = vandnot((x[i]),(y[i])); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor((tmp[i]),(tmp2[i]));
 #else
 #define SHA1_H(x,y,z) \
-	SHA1_PARA_DO(i) tmp[i] = _mm_and_si128((x[i]),(y[i])); \
-	SHA1_PARA_DO(i) tmp2[i] = _mm_or_si128((x[i]),(y[i])); \
-	SHA1_PARA_DO(i) tmp2[i] = _mm_and_si128((tmp2[i]),(z[i])); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_or_si128((tmp[i]),(tmp2[i]));
+	SHA1_VPARA_DO(i) tmp[i] = vand((x[i]),(y[i])); \
+	SHA1_VPARA_DO(i) tmp2[i] = vor((x[i]),(y[i])); \
+	SHA1_VPARA_DO(i) tmp2[i] = vand((tmp2[i]),(z[i])); \
+	SHA1_VPARA_DO(i) tmp[i] = vor((tmp[i]),(tmp2[i]));
 #endif
 
 #define SHA1_I(x,y,z) SHA1_G(x,y,z)
@@ -946,31 +1262,35 @@ if(SSEi_flags & SSEi_FLAT_IN) {
 
 // Bartavelle's original code, using 80x4 words of buffer
 
+#if VBLOCKS > 1
+#error SHA_BUF_SIZ 80 is not supported with AVX2
+#endif
+
 #define SHA1_EXPAND(t) \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( data[i*80+t-3], data[i*80+t-8] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], data[i*80+t-14] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], data[i*80+t-16] ); \
-	SHA1_PARA_DO(i) data[i*80+t] = _mm_roti_epi32(tmp[i], 1);
+	SHA1_VPARA_DO(i) tmp[i] = vxor( data[i*80+t-3], data[i*80+t-8] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], data[i*80+t-14] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], data[i*80+t-16] ); \
+	SHA1_VPARA_DO(i) data[i*80+t] = vroti_epi32(tmp[i], 1);
 
 #define SHA1_ROUND(a,b,c,d,e,F,t) \
 	F(b,c,d) \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_roti_epi32(a[i], 5); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], cst ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], data[i*80+t] ); \
-	SHA1_PARA_DO(i) b[i] = _mm_roti_epi32(b[i], 30);
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vroti_epi32(a[i], 5); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], cst ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], data[i*80+t] ); \
+	SHA1_VPARA_DO(i) b[i] = vroti_epi32(b[i], 30);
 
 void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned int SSEi_flags)
 {
-	__m128i a[SHA1_SSE_PARA];
-	__m128i b[SHA1_SSE_PARA];
-	__m128i c[SHA1_SSE_PARA];
-	__m128i d[SHA1_SSE_PARA];
-	__m128i e[SHA1_SSE_PARA];
-	__m128i tmp[SHA1_SSE_PARA];
-	__m128i tmp2[SHA1_SSE_PARA];
-	__m128i	cst;
+	vtype a[SHA1_VPARA];
+	vtype b[SHA1_VPARA];
+	vtype c[SHA1_VPARA];
+	vtype d[SHA1_VPARA];
+	vtype e[SHA1_VPARA];
+	vtype tmp[SHA1_VPARA];
+	vtype tmp2[SHA1_VPARA];
+	vtype	cst;
 	unsigned int i,j;
 
 	for(j=16;j<80;j++)
@@ -980,42 +1300,42 @@ void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, u
 
 	if((SSEi_flags & SSEi_RELOAD)==0)
 	{
-		SHA1_PARA_DO(i)
+		SHA1_VPARA_DO(i)
 		{
-			a[i] = _mm_set1_epi32(0x67452301);
-			b[i] = _mm_set1_epi32(0xefcdab89);
-			c[i] = _mm_set1_epi32(0x98badcfe);
-			d[i] = _mm_set1_epi32(0x10325476);
-			e[i] = _mm_set1_epi32(0xC3D2E1F0);
+			a[i] = vset1_epi32(0x67452301);
+			b[i] = vset1_epi32(0xefcdab89);
+			c[i] = vset1_epi32(0x98badcfe);
+			d[i] = vset1_epi32(0x10325476);
+			e[i] = vset1_epi32(0xC3D2E1F0);
 		}
 	}
 	else
 	{
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			SHA1_PARA_DO(i)
+			SHA1_VPARA_DO(i)
 			{
-				a[i] = _mm_load_si128((__m128i *)&reload_state[i*80*4+0]);
-				b[i] = _mm_load_si128((__m128i *)&reload_state[i*80*4+4]);
-				c[i] = _mm_load_si128((__m128i *)&reload_state[i*80*4+8]);
-				d[i] = _mm_load_si128((__m128i *)&reload_state[i*80*4+12]);
-				e[i] = _mm_load_si128((__m128i *)&reload_state[i*80*4+16]);
+				a[i] = VLOAD_BLOCKS(reload_state, i, 80*4, 0);
+				b[i] = VLOAD_BLOCKS(reload_state, i, 80*4, 4);
+				c[i] = VLOAD_BLOCKS(reload_state, i, 80*4, 8);
+				d[i] = VLOAD_BLOCKS(reload_state, i, 80*4, 12);
+				e[i] = VLOAD_BLOCKS(reload_state, i, 80*4, 16);
 			}
 		}
 		else
 		{
-			SHA1_PARA_DO(i)
+			SHA1_VPARA_DO(i)
 			{
-				a[i] = _mm_load_si128((__m128i *)&reload_state[i*20+0]);
-				b[i] = _mm_load_si128((__m128i *)&reload_state[i*20+4]);
-				c[i] = _mm_load_si128((__m128i *)&reload_state[i*20+8]);
-				d[i] = _mm_load_si128((__m128i *)&reload_state[i*20+12]);
-				e[i] = _mm_load_si128((__m128i *)&reload_state[i*20+16]);
+				a[i] = VLOAD_BLOCKS(reload_state, i, 20, 0);
+				b[i] = VLOAD_BLOCKS(reload_state, i, 20, 4);
+				c[i] = VLOAD_BLOCKS(reload_state, i, 20, 8);
+				d[i] = VLOAD_BLOCKS(reload_state, i, 20, 12);
+				e[i] = VLOAD_BLOCKS(reload_state, i, 20, 16);
 			}
 		}
 	}
 
-	cst = _mm_set1_epi32(0x5A827999);
+	cst = vset1_epi32(0x5A827999);
 	SHA1_ROUND( a, b, c, d, e, SHA1_F,  0 );
 	SHA1_ROUND( e, a, b, c, d, SHA1_F,  1 );
 	SHA1_ROUND( d, e, a, b, c, SHA1_F,  2 );
@@ -1037,7 +1357,7 @@ void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, u
 	SHA1_ROUND( c, d, e, a, b, SHA1_F, 18 );
 	SHA1_ROUND( b, c, d, e, a, SHA1_F, 19 );
 
-	cst = _mm_set1_epi32(0x6ED9EBA1);
+	cst = vset1_epi32(0x6ED9EBA1);
 	SHA1_ROUND( a, b, c, d, e, SHA1_G, 20 );
 	SHA1_ROUND( e, a, b, c, d, SHA1_G, 21 );
 	SHA1_ROUND( d, e, a, b, c, SHA1_G, 22 );
@@ -1059,7 +1379,7 @@ void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, u
 	SHA1_ROUND( c, d, e, a, b, SHA1_G, 38 );
 	SHA1_ROUND( b, c, d, e, a, SHA1_G, 39 );
 
-	cst = _mm_set1_epi32(0x8F1BBCDC);
+	cst = vset1_epi32(0x8F1BBCDC);
 	SHA1_ROUND( a, b, c, d, e, SHA1_H, 40 );
 	SHA1_ROUND( e, a, b, c, d, SHA1_H, 41 );
 	SHA1_ROUND( d, e, a, b, c, SHA1_H, 42 );
@@ -1081,7 +1401,7 @@ void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, u
 	SHA1_ROUND( c, d, e, a, b, SHA1_H, 58 );
 	SHA1_ROUND( b, c, d, e, a, SHA1_H, 59 );
 
-	cst = _mm_set1_epi32(0xCA62C1D6);
+	cst = vset1_epi32(0xCA62C1D6);
 	SHA1_ROUND( a, b, c, d, e, SHA1_I, 60 );
 	SHA1_ROUND( e, a, b, c, d, SHA1_I, 61 );
 	SHA1_ROUND( d, e, a, b, c, SHA1_I, 62 );
@@ -1105,60 +1425,60 @@ void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, u
 
 	if((SSEi_flags & SSEi_RELOAD)==0)
 	{
-		SHA1_PARA_DO(i)
+		SHA1_VPARA_DO(i)
 		{
-			a[i] = _mm_add_epi32(a[i], _mm_set1_epi32(0x67452301));
-			b[i] = _mm_add_epi32(b[i], _mm_set1_epi32(0xefcdab89));
-			c[i] = _mm_add_epi32(c[i], _mm_set1_epi32(0x98badcfe));
-			d[i] = _mm_add_epi32(d[i], _mm_set1_epi32(0x10325476));
-			e[i] = _mm_add_epi32(e[i], _mm_set1_epi32(0xC3D2E1F0));
+			a[i] = vadd_epi32(a[i], vset1_epi32(0x67452301));
+			b[i] = vadd_epi32(b[i], vset1_epi32(0xefcdab89));
+			c[i] = vadd_epi32(c[i], vset1_epi32(0x98badcfe));
+			d[i] = vadd_epi32(d[i], vset1_epi32(0x10325476));
+			e[i] = vadd_epi32(e[i], vset1_epi32(0xC3D2E1F0));
 		}
 	}
 	else
 	{
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			SHA1_PARA_DO(i)
+			SHA1_VPARA_DO(i)
 			{
-				a[i] = _mm_add_epi32(a[i], _mm_load_si128((__m128i *)&reload_state[i*80*4+0]));
-				b[i] = _mm_add_epi32(b[i], _mm_load_si128((__m128i *)&reload_state[i*80*4+4]));
-				c[i] = _mm_add_epi32(c[i], _mm_load_si128((__m128i *)&reload_state[i*80*4+8]));
-				d[i] = _mm_add_epi32(d[i], _mm_load_si128((__m128i *)&reload_state[i*80*4+12]));
-				e[i] = _mm_add_epi32(e[i], _mm_load_si128((__m128i *)&reload_state[i*80*4+16]));
+				a[i] = vadd_epi32(a[i], VLOAD_BLOCKS(reload_state, i, 80*4, 0));
+				b[i] = vadd_epi32(b[i], VLOAD_BLOCKS(reload_state, i, 80*4, 4));
+				c[i] = vadd_epi32(c[i], VLOAD_BLOCKS(reload_state, i, 80*4, 8));
+				d[i] = vadd_epi32(d[i], VLOAD_BLOCKS(reload_state, i, 80*4, 12));
+				e[i] = vadd_epi32(e[i], VLOAD_BLOCKS(reload_state, i, 80*4, 16));
 			}
 		}
 		else
 		{
-			SHA1_PARA_DO(i)
+			SHA1_VPARA_DO(i)
 			{
-				a[i] = _mm_add_epi32(a[i], _mm_load_si128((__m128i *)&reload_state[i*20+0]));
-				b[i] = _mm_add_epi32(b[i], _mm_load_si128((__m128i *)&reload_state[i*20+4]));
-				c[i] = _mm_add_epi32(c[i], _mm_load_si128((__m128i *)&reload_state[i*20+8]));
-				d[i] = _mm_add_epi32(d[i], _mm_load_si128((__m128i *)&reload_state[i*20+12]));
-				e[i] = _mm_add_epi32(e[i], _mm_load_si128((__m128i *)&reload_state[i*20+16]));
+				a[i] = vadd_epi32(a[i], VLOAD_BLOCKS(reload_state, i, 20, 0));
+				b[i] = vadd_epi32(b[i], VLOAD_BLOCKS(reload_state, i, 20, 4));
+				c[i] = vadd_epi32(c[i], VLOAD_BLOCKS(reload_state, i, 20, 8));
+				d[i] = vadd_epi32(d[i], VLOAD_BLOCKS(reload_state, i, 20, 12));
+				e[i] = vadd_epi32(e[i], VLOAD_BLOCKS(reload_state, i, 20, 16));
 			}
 		}
 	}
 	if (SSEi_flags & SSEi_OUTPUT_AS_INP_FMT)
 	{
-		SHA1_PARA_DO(i)
+		SHA1_VPARA_DO(i)
 		{
-			_mm_store_si128((__m128i *)&out[i*80*4+0], a[i]);
-			_mm_store_si128((__m128i *)&out[i*80*4+4], b[i]);
-			_mm_store_si128((__m128i *)&out[i*80*4+8], c[i]);
-			_mm_store_si128((__m128i *)&out[i*80*4+12], d[i]);
-			_mm_store_si128((__m128i *)&out[i*80*4+16], e[i]);
+			VSTORE_BLOCKS(out, i, 80*4, 0, a[i]);
+			VSTORE_BLOCKS(out, i, 80*4, 4, b[i]);
+			VSTORE_BLOCKS(out, i, 80*4, 8, c[i]);
+			VSTORE_BLOCKS(out, i, 80*4, 12, d[i]);
+			VSTORE_BLOCKS(out, i, 80*4, 16, e[i]);
 		}
 	}
 	else
 	{
-		SHA1_PARA_DO(i)
+		SHA1_VPARA_DO(i)
 		{
-			_mm_store_si128((__m128i *)&out[i*20+0], a[i]);
-			_mm_store_si128((__m128i *)&out[i*20+4], b[i]);
-			_mm_store_si128((__m128i *)&out[i*20+8], c[i]);
-			_mm_store_si128((__m128i *)&out[i*20+12], d[i]);
-			_mm_store_si128((__m128i *)&out[i*20+16], e[i]);
+			VSTORE_BLOCKS(out, i, 20, 0, a[i]);
+			VSTORE_BLOCKS(out, i, 20, 4, b[i]);
+			VSTORE_BLOCKS(out, i, 20, 8, c[i]);
+			VSTORE_BLOCKS(out, i, 20, 12, d[i]);
+			VSTORE_BLOCKS(out, i, 20, 16, e[i]);
 		}
 	}
 }
@@ -1167,139 +1487,146 @@ void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, u
 // JimF's code, using 16x4 words of buffer just like MD4/5
 
 #define SHA1_EXPAND2a(t) \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( data[i*16+t-3], data[i*16+t-8] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], data[i*16+t-14] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], data[i*16+t-16] ); \
-	SHA1_PARA_DO(i) tmpR[i*16+((t)&0xF)] = _mm_roti_epi32(tmp[i], 1);
+	SHA1_VPARA_DO(i) tmp[i] = vxor( data[i*16+t-3], data[i*16+t-8] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], data[i*16+t-14] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], data[i*16+t-16] ); \
+	SHA1_VPARA_DO(i) tmpR[i*16+((t)&0xF)] = vroti_epi32(tmp[i], 1);
 #define SHA1_EXPAND2b(t) \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmpR[i*16+((t-3)&0xF)], data[i*16+t-8] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], data[i*16+t-14] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], data[i*16+t-16] ); \
-	SHA1_PARA_DO(i) tmpR[i*16+((t)&0xF)] = _mm_roti_epi32(tmp[i], 1);
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmpR[i*16+((t-3)&0xF)], data[i*16+t-8] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], data[i*16+t-14] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], data[i*16+t-16] ); \
+	SHA1_VPARA_DO(i) tmpR[i*16+((t)&0xF)] = vroti_epi32(tmp[i], 1);
 #define SHA1_EXPAND2c(t) \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmpR[i*16+((t-3)&0xF)], tmpR[i*16+((t-8)&0xF)] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], data[i*16+t-14] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], data[i*16+t-16] ); \
-	SHA1_PARA_DO(i) tmpR[i*16+((t)&0xF)] = _mm_roti_epi32(tmp[i], 1);
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmpR[i*16+((t-3)&0xF)], tmpR[i*16+((t-8)&0xF)] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], data[i*16+t-14] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], data[i*16+t-16] ); \
+	SHA1_VPARA_DO(i) tmpR[i*16+((t)&0xF)] = vroti_epi32(tmp[i], 1);
 #define SHA1_EXPAND2d(t) \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmpR[i*16+((t-3)&0xF)], tmpR[i*16+((t-8)&0xF)] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], tmpR[i*16+((t-14)&0xF)] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], data[i*16+t-16] ); \
-	SHA1_PARA_DO(i) tmpR[i*16+((t)&0xF)] = _mm_roti_epi32(tmp[i], 1);
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmpR[i*16+((t-3)&0xF)], tmpR[i*16+((t-8)&0xF)] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], tmpR[i*16+((t-14)&0xF)] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], data[i*16+t-16] ); \
+	SHA1_VPARA_DO(i) tmpR[i*16+((t)&0xF)] = vroti_epi32(tmp[i], 1);
 #define SHA1_EXPAND2(t) \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmpR[i*16+((t-3)&0xF)], tmpR[i*16+((t-8)&0xF)] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], tmpR[i*16+((t-14)&0xF)] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_xor_si128( tmp[i], tmpR[i*16+((t-16)&0xF)] ); \
-	SHA1_PARA_DO(i) tmpR[i*16+((t)&0xF)] = _mm_roti_epi32(tmp[i], 1);
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmpR[i*16+((t-3)&0xF)], tmpR[i*16+((t-8)&0xF)] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], tmpR[i*16+((t-14)&0xF)] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vxor( tmp[i], tmpR[i*16+((t-16)&0xF)] ); \
+	SHA1_VPARA_DO(i) tmpR[i*16+((t)&0xF)] = vroti_epi32(tmp[i], 1);
 
 #define SHA1_ROUND2a(a,b,c,d,e,F,t) \
 	SHA1_EXPAND2a(t+16) \
 	F(b,c,d) \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_roti_epi32(a[i], 5); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], cst ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], data[i*16+t] ); \
-	SHA1_PARA_DO(i) b[i] = _mm_roti_epi32(b[i], 30);
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vroti_epi32(a[i], 5); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], cst ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], data[i*16+t] ); \
+	SHA1_VPARA_DO(i) b[i] = vroti_epi32(b[i], 30);
 #define SHA1_ROUND2b(a,b,c,d,e,F,t) \
 	SHA1_EXPAND2b(t+16) \
 	F(b,c,d) \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_roti_epi32(a[i], 5); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], cst ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], data[i*16+t] ); \
-	SHA1_PARA_DO(i) b[i] = _mm_roti_epi32(b[i], 30);
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vroti_epi32(a[i], 5); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], cst ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], data[i*16+t] ); \
+	SHA1_VPARA_DO(i) b[i] = vroti_epi32(b[i], 30);
 #define SHA1_ROUND2c(a,b,c,d,e,F,t) \
 	SHA1_EXPAND2c(t+16) \
 	F(b,c,d) \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_roti_epi32(a[i], 5); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], cst ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], data[i*16+t] ); \
-	SHA1_PARA_DO(i) b[i] = _mm_roti_epi32(b[i], 30);
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vroti_epi32(a[i], 5); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], cst ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], data[i*16+t] ); \
+	SHA1_VPARA_DO(i) b[i] = vroti_epi32(b[i], 30);
 #define SHA1_ROUND2d(a,b,c,d,e,F,t) \
 	SHA1_EXPAND2d(t+16) \
 	F(b,c,d) \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_roti_epi32(a[i], 5); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], cst ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], data[i*16+t] ); \
-	SHA1_PARA_DO(i) b[i] = _mm_roti_epi32(b[i], 30);
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vroti_epi32(a[i], 5); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], cst ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], data[i*16+t] ); \
+	SHA1_VPARA_DO(i) b[i] = vroti_epi32(b[i], 30);
 #define SHA1_ROUND2(a,b,c,d,e,F,t) \
-	SHA1_PARA_DO(i) tmp3[i] = tmpR[i*16+(t&0xF)]; \
+	SHA1_VPARA_DO(i) tmp3[i] = tmpR[i*16+(t&0xF)]; \
 	SHA1_EXPAND2(t+16) \
 	F(b,c,d) \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_roti_epi32(a[i], 5); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], cst ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp3[i] ); \
-	SHA1_PARA_DO(i) b[i] = _mm_roti_epi32(b[i], 30);
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vroti_epi32(a[i], 5); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], cst ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp3[i] ); \
+	SHA1_VPARA_DO(i) b[i] = vroti_epi32(b[i], 30);
 #define SHA1_ROUND2x(a,b,c,d,e,F,t) \
 	F(b,c,d) \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) tmp[i] = _mm_roti_epi32(a[i], 5); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmp[i] ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], cst ); \
-	SHA1_PARA_DO(i) e[i] = _mm_add_epi32( e[i], tmpR[i*16+(t&0xF)] ); \
-	SHA1_PARA_DO(i) b[i] = _mm_roti_epi32(b[i], 30);
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) tmp[i] = vroti_epi32(a[i], 5); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmp[i] ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], cst ); \
+	SHA1_VPARA_DO(i) e[i] = vadd_epi32( e[i], tmpR[i*16+(t&0xF)] ); \
+	SHA1_VPARA_DO(i) b[i] = vroti_epi32(b[i], 30);
 
 void SSESHA1body(__m128i* _data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags)
 {
-	__m128i w[16*SHA1_SSE_PARA];
-	__m128i a[SHA1_SSE_PARA];
-	__m128i b[SHA1_SSE_PARA];
-	__m128i c[SHA1_SSE_PARA];
-	__m128i d[SHA1_SSE_PARA];
-	__m128i e[SHA1_SSE_PARA];
-	__m128i tmp[SHA1_SSE_PARA];
-	__m128i tmp2[SHA1_SSE_PARA];
-	__m128i tmp3[SHA1_SSE_PARA];
-	__m128i tmpR[SHA1_SSE_PARA*16];
-	__m128i	cst;
+	vtype w[16*SHA1_VPARA];
+	vtype a[SHA1_VPARA];
+	vtype b[SHA1_VPARA];
+	vtype c[SHA1_VPARA];
+	vtype d[SHA1_VPARA];
+	vtype e[SHA1_VPARA];
+	vtype tmp[SHA1_VPARA];
+	vtype tmp2[SHA1_VPARA];
+	vtype tmp3[SHA1_VPARA];
+	vtype tmpR[SHA1_VPARA*16];
+	vtype	cst;
 	unsigned int i;
-	__m128i *data;
+	vtype *data;
+
+#ifdef SSE_DISPATCH
+	if (SSESHA1body_level) {
+		SSESHA1body_level(_data, out, reload_state, SSEi_flags);
+		return;
+	}
+#endif
 
 	if(SSEi_flags & SSEi_FLAT_IN) {
 		// Move _data to __data, mixing it MMX_COEF wise.
 #ifdef __SSE4_1__
 		unsigned k;
-		__m128i *W = w;
+		vtype *W = w;
 		ARCH_WORD_32 *saved_key = (ARCH_WORD_32 *)_data;
-		SHA1_PARA_DO(k)
+		SHA1_VPARA_DO(k)
 		{
 			if (SSEi_flags & SSEi_4BUF_INPUT) {
-				for (i=0; i < 14; ++i) { GATHER_4x (W[i], saved_key, i); SWAP_ENDIAN (W[i]); }
+				for (i=0; i < 14; ++i) { GATHER_4x (W[i], saved_key, i); vswap_endian (W[i]); }
 				GATHER_4x (W[14], saved_key, 14);
 				GATHER_4x (W[15], saved_key, 15);
-				saved_key += (MMX_COEF<<6);
+				saved_key += ((MMX_COEF*VBLOCKS)<<6);
 			} else if (SSEi_flags & SSEi_2BUF_INPUT) {
-				for (i=0; i < 14; ++i) { GATHER_2x (W[i], saved_key, i); SWAP_ENDIAN (W[i]); }
+				for (i=0; i < 14; ++i) { GATHER_2x (W[i], saved_key, i); vswap_endian (W[i]); }
 				GATHER_2x (W[14], saved_key, 14);
 				GATHER_2x (W[15], saved_key, 15);
-				saved_key += (MMX_COEF<<5);
+				saved_key += ((MMX_COEF*VBLOCKS)<<5);
 			} else {
-				for (i=0; i < 14; ++i) { GATHER (W[i], saved_key, i); SWAP_ENDIAN (W[i]); }
+				for (i=0; i < 14; ++i) { GATHER (W[i], saved_key, i); vswap_endian (W[i]); }
 				GATHER (W[14], saved_key, 14);
 				GATHER (W[15], saved_key, 15);
-				saved_key += (MMX_COEF<<4);
+				saved_key += ((MMX_COEF*VBLOCKS)<<4);
 			}
 			if ( ((SSEi_flags & SSEi_2BUF_INPUT_FIRST_BLK) == SSEi_2BUF_INPUT_FIRST_BLK) ||
 				 ((SSEi_flags & SSEi_4BUF_INPUT_FIRST_BLK) == SSEi_4BUF_INPUT_FIRST_BLK)) {
-				SWAP_ENDIAN (W[14]);
-				SWAP_ENDIAN (W[15]);
+				vswap_endian (W[14]);
+				vswap_endian (W[15]);
 			}
 			W += 16;
 		}
 #else
 		unsigned j, k;
 		ARCH_WORD_32 *p = (ARCH_WORD_32 *)w;
-		__m128i *W = w;
+		vtype *W = w;
 		ARCH_WORD_32 *saved_key = (ARCH_WORD_32 *)_data;
-		SHA1_PARA_DO(k)
+		SHA1_VPARA_DO(k)
 		{
 			if (SSEi_flags & SSEi_4BUF_INPUT) {
 				for (j=0; j < 16; j++)
@@ -1318,11 +1645,11 @@ void SSESHA1body(__m128i* _data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 				saved_key += (MMX_COEF<<4);
 			}
 			for (i=0; i < 14; i++)
-				SWAP_ENDIAN (W[i]);
+				vswap_endian (W[i]);
 			if ( ((SSEi_flags & SSEi_2BUF_INPUT_FIRST_BLK) == SSEi_2BUF_INPUT_FIRST_BLK) ||
 				 ((SSEi_flags & SSEi_4BUF_INPUT_FIRST_BLK) == SSEi_4BUF_INPUT_FIRST_BLK)) {
-				SWAP_ENDIAN (W[14]);
-				SWAP_ENDIAN (W[15]);
+				vswap_endian (W[14]);
+				vswap_endian (W[15]);
 			}
 			W += 16;
 		}
@@ -1331,46 +1658,53 @@ void SSESHA1body(__m128i* _data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 		// now set our data pointer to point to this 'mixed' data.
 		data = w;
 	} else
+#if VBLOCKS > 1
+	{
+		vload_input(w, _data, SHA1_VPARA);
+		data = w;
+	}
+#else
 		data = _data;
+#endif
 
 	if((SSEi_flags & SSEi_RELOAD)==0)
 	{
-		SHA1_PARA_DO(i)
+		SHA1_VPARA_DO(i)
 		{
-			a[i] = _mm_set1_epi32(0x67452301);
-			b[i] = _mm_set1_epi32(0xefcdab89);
-			c[i] = _mm_set1_epi32(0x98badcfe);
-			d[i] = _mm_set1_epi32(0x10325476);
-			e[i] = _mm_set1_epi32(0xC3D2E1F0);
+			a[i] = vset1_epi32(0x67452301);
+			b[i] = vset1_epi32(0xefcdab89);
+			c[i] = vset1_epi32(0x98badcfe);
+			d[i] = vset1_epi32(0x10325476);
+			e[i] = vset1_epi32(0xC3D2E1F0);
 		}
 	}
 	else
 	{
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			SHA1_PARA_DO(i)
+			SHA1_VPARA_DO(i)
 			{
-				a[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+0]);
-				b[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+4]);
-				c[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+8]);
-				d[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+12]);
-				e[i] = _mm_load_si128((__m128i *)&reload_state[i*16*4+16]);
+				a[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 0);
+				b[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 4);
+				c[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 8);
+				d[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 12);
+				e[i] = VLOAD_BLOCKS(reload_state, i, 16*4, 16);
 			}
 		}
 		else
 		{
-			SHA1_PARA_DO(i)
+			SHA1_VPARA_DO(i)
 			{
-				a[i] = _mm_load_si128((__m128i *)&reload_state[i*20+0]);
-				b[i] = _mm_load_si128((__m128i *)&reload_state[i*20+4]);
-				c[i] = _mm_load_si128((__m128i *)&reload_state[i*20+8]);
-				d[i] = _mm_load_si128((__m128i *)&reload_state[i*20+12]);
-				e[i] = _mm_load_si128((__m128i *)&reload_state[i*20+16]);
+				a[i] = VLOAD_BLOCKS(reload_state, i, 20, 0);
+				b[i] = VLOAD_BLOCKS(reload_state, i, 20, 4);
+				c[i] = VLOAD_BLOCKS(reload_state, i, 20, 8);
+				d[i] = VLOAD_BLOCKS(reload_state, i, 20, 12);
+				e[i] = VLOAD_BLOCKS(reload_state, i, 20, 16);
 			}
 		}
 	}
 
-	cst = _mm_set1_epi32(0x5A827999);
+	cst = vset1_epi32(0x5A827999);
 	SHA1_ROUND2a( a, b, c, d, e, SHA1_F,  0 );
 	SHA1_ROUND2a( e, a, b, c, d, SHA1_F,  1 );
 	SHA1_ROUND2a( d, e, a, b, c, SHA1_F,  2 );
@@ -1392,7 +1726,7 @@ void SSESHA1body(__m128i* _data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 	SHA1_ROUND2( c, d, e, a, b, SHA1_F, 18 );
 	SHA1_ROUND2( b, c, d, e, a, SHA1_F, 19 );
 
-	cst = _mm_set1_epi32(0x6ED9EBA1);
+	cst = vset1_epi32(0x6ED9EBA1);
 	SHA1_ROUND2( a, b, c, d, e, SHA1_G, 20 );
 	SHA1_ROUND2( e, a, b, c, d, SHA1_G, 21 );
 	SHA1_ROUND2( d, e, a, b, c, SHA1_G, 22 );
@@ -1414,7 +1748,7 @@ void SSESHA1body(__m128i* _data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 	SHA1_ROUND2( c, d, e, a, b, SHA1_G, 38 );
 	SHA1_ROUND2( b, c, d, e, a, SHA1_G, 39 );
 
-	cst = _mm_set1_epi32(0x8F1BBCDC);
+	cst = vset1_epi32(0x8F1BBCDC);
 	SHA1_ROUND2( a, b, c, d, e, SHA1_H, 40 );
 	SHA1_ROUND2( e, a, b, c, d, SHA1_H, 41 );
 	SHA1_ROUND2( d, e, a, b, c, SHA1_H, 42 );
@@ -1436,7 +1770,7 @@ void SSESHA1body(__m128i* _data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 	SHA1_ROUND2( c, d, e, a, b, SHA1_H, 58 );
 	SHA1_ROUND2( b, c, d, e, a, SHA1_H, 59 );
 
-	cst = _mm_set1_epi32(0xCA62C1D6);
+	cst = vset1_epi32(0xCA62C1D6);
 	SHA1_ROUND2( a, b, c, d, e, SHA1_I, 60 );
 	SHA1_ROUND2( e, a, b, c, d, SHA1_I, 61 );
 	SHA1_ROUND2( d, e, a, b, c, SHA1_I, 62 );
@@ -1460,60 +1794,60 @@ void SSESHA1body(__m128i* _data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 
 	if((SSEi_flags & SSEi_RELOAD)==0)
 	{
-		SHA1_PARA_DO(i)
+		SHA1_VPARA_DO(i)
 		{
-			a[i] = _mm_add_epi32(a[i], _mm_set1_epi32(0x67452301));
-			b[i] = _mm_add_epi32(b[i], _mm_set1_epi32(0xefcdab89));
-			c[i] = _mm_add_epi32(c[i], _mm_set1_epi32(0x98badcfe));
-			d[i] = _mm_add_epi32(d[i], _mm_set1_epi32(0x10325476));
-			e[i] = _mm_add_epi32(e[i], _mm_set1_epi32(0xC3D2E1F0));
+			a[i] = vadd_epi32(a[i], vset1_epi32(0x67452301));
+			b[i] = vadd_epi32(b[i], vset1_epi32(0xefcdab89));
+			c[i] = vadd_epi32(c[i], vset1_epi32(0x98badcfe));
+			d[i] = vadd_epi32(d[i], vset1_epi32(0x10325476));
+			e[i] = vadd_epi32(e[i], vset1_epi32(0xC3D2E1F0));
 		}
 	}
 	else
 	{
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			SHA1_PARA_DO(i)
+			SHA1_VPARA_DO(i)
 			{
-				a[i] = _mm_add_epi32(a[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+0]));
-				b[i] = _mm_add_epi32(b[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+4]));
-				c[i] = _mm_add_epi32(c[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+8]));
-				d[i] = _mm_add_epi32(d[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+12]));
-				e[i] = _mm_add_epi32(e[i], _mm_load_si128((__m128i *)&reload_state[i*16*4+16]));
+				a[i] = vadd_epi32(a[i], VLOAD_BLOCKS(reload_state, i, 16*4, 0));
+				b[i] = vadd_epi32(b[i], VLOAD_BLOCKS(reload_state, i, 16*4, 4));
+				c[i] = vadd_epi32(c[i], VLOAD_BLOCKS(reload_state, i, 16*4, 8));
+				d[i] = vadd_epi32(d[i], VLOAD_BLOCKS(reload_state, i, 16*4, 12));
+				e[i] = vadd_epi32(e[i], VLOAD_BLOCKS(reload_state, i, 16*4, 16));
 			}
 		}
 		else
 		{
-			SHA1_PARA_DO(i)
+			SHA1_VPARA_DO(i)
 			{
-				a[i] = _mm_add_epi32(a[i], _mm_load_si128((__m128i *)&reload_state[i*20+0]));
-				b[i] = _mm_add_epi32(b[i], _mm_load_si128((__m128i *)&reload_state[i*20+4]));
-				c[i] = _mm_add_epi32(c[i], _mm_load_si128((__m128i *)&reload_state[i*20+8]));
-				d[i] = _mm_add_epi32(d[i], _mm_load_si128((__m128i *)&reload_state[i*20+12]));
-				e[i] = _mm_add_epi32(e[i], _mm_load_si128((__m128i *)&reload_state[i*20+16]));
+				a[i] = vadd_epi32(a[i], VLOAD_BLOCKS(reload_state, i, 20, 0));
+				b[i] = vadd_epi32(b[i], VLOAD_BLOCKS(reload_state, i, 20, 4));
+				c[i] = vadd_epi32(c[i], VLOAD_BLOCKS(reload_state, i, 20, 8));
+				d[i] = vadd_epi32(d[i], VLOAD_BLOCKS(reload_state, i, 20, 12));
+				e[i] = vadd_epi32(e[i], VLOAD_BLOCKS(reload_state, i, 20, 16));
 			}
 		}
 	}
 	if (SSEi_flags & SSEi_OUTPUT_AS_INP_FMT)
 	{
-		SHA1_PARA_DO(i)
+		SHA1_VPARA_DO(i)
 		{
-			_mm_store_si128((__m128i *)&out[i*16*4+0], a[i]);
-			_mm_store_si128((__m128i *)&out[i*16*4+4], b[i]);
-			_mm_store_si128((__m128i *)&out[i*16*4+8], c[i]);
-			_mm_store_si128((__m128i *)&out[i*16*4+12], d[i]);
-			_mm_store_si128((__m128i *)&out[i*16*4+16], e[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 0, a[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 4, b[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 8, c[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 12, d[i]);
+			VSTORE_BLOCKS(out, i, 16*4, 16, e[i]);
 		}
 	}
 	else
 	{
-		SHA1_PARA_DO(i)
+		SHA1_VPARA_DO(i)
 		{
-			_mm_store_si128((__m128i *)&out[i*20+0], a[i]);
-			_mm_store_si128((__m128i *)&out[i*20+4], b[i]);
-			_mm_store_si128((__m128i *)&out[i*20+8], c[i]);
-			_mm_store_si128((__m128i *)&out[i*20+12], d[i]);
-			_mm_store_si128((__m128i *)&out[i*20+16], e[i]);
+			VSTORE_BLOCKS(out, i, 20, 0, a[i]);
+			VSTORE_BLOCKS(out, i, 20, 4, b[i]);
+			VSTORE_BLOCKS(out, i, 20, 8, c[i]);
+			VSTORE_BLOCKS(out, i, 20, 12, d[i]);
+			VSTORE_BLOCKS(out, i, 20, 16, e[i]);
 		}
 	}
 }
@@ -1523,80 +1857,80 @@ void SSESHA1body(__m128i* _data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 
 #define S0(x)                           \
 (                                       \
-    _mm_xor_si128 (                     \
-        _mm_roti_epi32 (x, -22),        \
-        _mm_xor_si128 (                 \
-            _mm_roti_epi32 (x,  -2),    \
-            _mm_roti_epi32 (x, -13)     \
+    vxor (                     \
+        vroti_epi32 (x, -22),        \
+        vxor (                 \
+            vroti_epi32 (x,  -2),    \
+            vroti_epi32 (x, -13)     \
         )                               \
     )                                   \
 )
 
 #define S1(x)                           \
 (                                       \
-    _mm_xor_si128 (                     \
-        _mm_roti_epi32 (x, -25),        \
-        _mm_xor_si128 (                 \
-            _mm_roti_epi32 (x,  -6),    \
-            _mm_roti_epi32 (x, -11)     \
+    vxor (                     \
+        vroti_epi32 (x, -25),        \
+        vxor (                 \
+            vroti_epi32 (x,  -6),    \
+            vroti_epi32 (x, -11)     \
         )                               \
     )                                   \
 )
 
 #define s0(x)                           \
 (                                       \
-    _mm_xor_si128 (                     \
-        _mm_srli_epi32 (x, 3),          \
-        _mm_xor_si128 (                 \
-            _mm_roti_epi32 (x,  -7),    \
-            _mm_roti_epi32 (x, -18)     \
+    vxor (                     \
+        vsrli_epi32 (x, 3),          \
+        vxor (                 \
+            vroti_epi32 (x,  -7),    \
+            vroti_epi32 (x, -18)     \
         )                               \
     )                                   \
 )
 
 #define s1(x)                           \
 (                                       \
-    _mm_xor_si128 (                     \
-        _mm_srli_epi32 (x, 10),         \
-        _mm_xor_si128 (                 \
-            _mm_roti_epi32 (x, -17),    \
-            _mm_roti_epi32 (x, -19)     \
+    vxor (                     \
+        vsrli_epi32 (x, 10),         \
+        vxor (                 \
+            vroti_epi32 (x, -17),    \
+            vroti_epi32 (x, -19)     \
         )                               \
     )                                   \
 )
 
-#define Maj(x,y,z) _mm_cmov_si128 (x, y, _mm_xor_si128 (z, y))
+#define Maj(x,y,z) vcmov (x, y, vxor (z, y))
 
-#define Ch(x,y,z) _mm_cmov_si128 (y, z, x)
+#define Ch(x,y,z) vcmov (y, z, x)
 
 #undef R
 #define R(x,x1,x2,x3)                         \
 {                                             \
-    tmp1 = _mm_add_epi32 (s1(w[x1]), w[x2]);  \
-    tmp1 = _mm_add_epi32 (w[x],  tmp1);       \
-    w[x] = _mm_add_epi32 (s0(w[x3]), tmp1);   \
+    tmp1 = vadd_epi32 (s1(w[x1]), w[x2]);  \
+    tmp1 = vadd_epi32 (w[x],  tmp1);       \
+    w[x] = vadd_epi32 (s0(w[x3]), tmp1);   \
 }
 
 #define SHA256_STEP0(a,b,c,d,e,f,g,h,x,K)            \
 {                                                    \
-    tmp1 = _mm_add_epi32 (h,    S1(e));              \
-    tmp1 = _mm_add_epi32 (tmp1, Ch(e,f,g));          \
-    tmp1 = _mm_add_epi32 (tmp1, _mm_set1_epi32(K));  \
-    tmp1 = _mm_add_epi32 (tmp1, w[x]);               \
-    tmp2 = _mm_add_epi32 (S0(a),Maj(a,b,c));         \
-    d    = _mm_add_epi32 (tmp1, d);                  \
-    h    = _mm_add_epi32 (tmp1, tmp2);               \
+    tmp1 = vadd_epi32 (h,    S1(e));              \
+    tmp1 = vadd_epi32 (tmp1, Ch(e,f,g));          \
+    tmp1 = vadd_epi32 (tmp1, vset1_epi32(K));  \
+    tmp1 = vadd_epi32 (tmp1, w[x]);               \
+    tmp2 = vadd_epi32 (S0(a),Maj(a,b,c));         \
+    d    = vadd_epi32 (tmp1, d);                  \
+    h    = vadd_epi32 (tmp1, tmp2);               \
 }
 #define SHA256_STEP_R(a,b,c,d,e,f,g,h, x,x1,x2,x3, K)\
 {                                                    \
 	R(x,x1,x2,x3);								     \
-    tmp1 = _mm_add_epi32 (h,    S1(e));              \
-    tmp1 = _mm_add_epi32 (tmp1, Ch(e,f,g));          \
-    tmp1 = _mm_add_epi32 (tmp1, _mm_set1_epi32(K));  \
-    tmp1 = _mm_add_epi32 (tmp1, w[x]);				 \
-    tmp2 = _mm_add_epi32 (S0(a),Maj(a,b,c));         \
-    d    = _mm_add_epi32 (tmp1, d);                  \
-    h    = _mm_add_epi32 (tmp1, tmp2);               \
+    tmp1 = vadd_epi32 (h,    S1(e));              \
+    tmp1 = vadd_epi32 (tmp1, Ch(e,f,g));          \
+    tmp1 = vadd_epi32 (tmp1, vset1_epi32(K));  \
+    tmp1 = vadd_epi32 (tmp1, w[x]);				 \
+    tmp2 = vadd_epi32 (S0(a),Maj(a,b,c));         \
+    d    = vadd_epi32 (tmp1, d);                  \
+    h    = vadd_epi32 (tmp1, tmp2);               \
 }
 
 // this macro was used to create the new macros for the smaller w[16] array.
@@ -1618,40 +1952,48 @@ void SSESHA1body(__m128i* _data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
  *  6. Optimizations.  Look at intel, AMD, newest intel, newest AMD, etc performances.
  *  7. See if we can do anything better using 'DO_PARA' type methods, like we do in SHA1/MD4/5
  */
-#if defined (MMX_COEF_SHA256)
+#if defined (MMX_COEF_SHA256) && !defined(SSE_VARIANT_NO_SHA2)
 void SSESHA256body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags)
 {
-	__m128i a, b, c, d, e, f, g, h;
+	vtype a, b, c, d, e, f, g, h;
 	union {
-		__m128i w[16];
-		ARCH_WORD_32 p[16*sizeof(__m128i)/sizeof(ARCH_WORD_32)];
+		vtype w[16];
+		ARCH_WORD_32 p[16*sizeof(vtype)/sizeof(ARCH_WORD_32)];
 
 	}_w;
-	__m128i tmp1, tmp2, *w=_w.w;
+	vtype tmp1, tmp2, *w=_w.w;
 	ARCH_WORD_32 *saved_key=0;
 
 	int i;
+
+#ifdef SSE_DISPATCH
+	if (SSESHA256body_level) {
+		SSESHA256body_level(data, out, reload_state, SSEi_flags);
+		return;
+	}
+#endif
+
 	if (SSEi_flags & SSEi_FLAT_IN) {
 
 #ifdef __SSE4_1__
 		saved_key = (ARCH_WORD_32 *)data;
 		if (SSEi_flags & SSEi_4BUF_INPUT) {
-			for (i=0; i < 14; ++i) { GATHER_4x (w[i], saved_key, i); SWAP_ENDIAN (w[i]); }
+			for (i=0; i < 14; ++i) { GATHER_4x (w[i], saved_key, i); vswap_endian (w[i]); }
 			GATHER_4x (w[14], saved_key, 14);
 			GATHER_4x (w[15], saved_key, 15);
 		} else if (SSEi_flags & SSEi_2BUF_INPUT) {
-			for (i=0; i < 14; ++i) { GATHER_2x (w[i], saved_key, i); SWAP_ENDIAN (w[i]); }
+			for (i=0; i < 14; ++i) { GATHER_2x (w[i], saved_key, i); vswap_endian (w[i]); }
 			GATHER_2x (w[14], saved_key, 14);
 			GATHER_2x (w[15], saved_key, 15);
 		} else {
-			for (i=0; i < 14; ++i) { GATHER (w[i], saved_key, i); SWAP_ENDIAN (w[i]); }
+			for (i=0; i < 14; ++i) { GATHER (w[i], saved_key, i); vswap_endian (w[i]); }
 			GATHER (w[14], saved_key, 14);
 			GATHER (w[15], saved_key, 15);
 		}
 		if ( ((SSEi_flags & SSEi_2BUF_INPUT_FIRST_BLK) == SSEi_2BUF_INPUT_FIRST_BLK) ||
 			 ((SSEi_flags & SSEi_4BUF_INPUT_FIRST_BLK) == SSEi_4BUF_INPUT_FIRST_BLK)) {
-			SWAP_ENDIAN (w[14]);
-			SWAP_ENDIAN (w[15]);
+			vswap_endian (w[14]);
+			vswap_endian (w[15]);
 		}
 #else
 		int j;
@@ -1671,15 +2013,15 @@ void SSESHA256body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 					*p++ = saved_key[(i<<4)+j];
 		}
 		for (i=0; i < 14; i++)
-			SWAP_ENDIAN (w[i]);
+			vswap_endian (w[i]);
 		if ( ((SSEi_flags & SSEi_2BUF_INPUT_FIRST_BLK) == SSEi_2BUF_INPUT_FIRST_BLK) ||
 			 ((SSEi_flags & SSEi_4BUF_INPUT_FIRST_BLK) == SSEi_4BUF_INPUT_FIRST_BLK)) {
-			SWAP_ENDIAN (w[14]);
-			SWAP_ENDIAN (w[15]);
+			vswap_endian (w[14]);
+			vswap_endian (w[15]);
 		}
 #endif
 	} else
-		memcpy(w, data, 16*sizeof(__m128i));
+		memcpy(w, data, 16*sizeof(vtype));
 
 //	dump_stuff_shammx(w, 64, 0);
 
@@ -1687,49 +2029,47 @@ void SSESHA256body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 	if (SSEi_flags & SSEi_RELOAD) {
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			i=0; // later if we do PARA, i will be used in the PARA_FOR loop
-			a = _mm_load_si128((__m128i *)&reload_state[i*16*4+0]);
-			b = _mm_load_si128((__m128i *)&reload_state[i*16*4+4]);
-			c = _mm_load_si128((__m128i *)&reload_state[i*16*4+8]);
-			d = _mm_load_si128((__m128i *)&reload_state[i*16*4+12]);
-			e = _mm_load_si128((__m128i *)&reload_state[i*16*4+16]);
-			f = _mm_load_si128((__m128i *)&reload_state[i*16*4+20]);
-			g = _mm_load_si128((__m128i *)&reload_state[i*16*4+24]);
-			h = _mm_load_si128((__m128i *)&reload_state[i*16*4+28]);
+			a = vload(&reload_state[0*MMX_COEF_SHA256]);
+			b = vload(&reload_state[1*MMX_COEF_SHA256]);
+			c = vload(&reload_state[2*MMX_COEF_SHA256]);
+			d = vload(&reload_state[3*MMX_COEF_SHA256]);
+			e = vload(&reload_state[4*MMX_COEF_SHA256]);
+			f = vload(&reload_state[5*MMX_COEF_SHA256]);
+			g = vload(&reload_state[6*MMX_COEF_SHA256]);
+			h = vload(&reload_state[7*MMX_COEF_SHA256]);
 		}
 		else
 		{
-			i=0;
-			a = _mm_load_si128((__m128i *)&reload_state[i*32+0]);
-			b = _mm_load_si128((__m128i *)&reload_state[i*32+4]);
-			c = _mm_load_si128((__m128i *)&reload_state[i*32+8]);
-			d = _mm_load_si128((__m128i *)&reload_state[i*32+12]);
-			e = _mm_load_si128((__m128i *)&reload_state[i*32+16]);
-			f = _mm_load_si128((__m128i *)&reload_state[i*32+20]);
-			g = _mm_load_si128((__m128i *)&reload_state[i*32+24]);
-			h = _mm_load_si128((__m128i *)&reload_state[i*32+28]);
+			a = vload(&reload_state[0*MMX_COEF_SHA256]);
+			b = vload(&reload_state[1*MMX_COEF_SHA256]);
+			c = vload(&reload_state[2*MMX_COEF_SHA256]);
+			d = vload(&reload_state[3*MMX_COEF_SHA256]);
+			e = vload(&reload_state[4*MMX_COEF_SHA256]);
+			f = vload(&reload_state[5*MMX_COEF_SHA256]);
+			g = vload(&reload_state[6*MMX_COEF_SHA256]);
+			h = vload(&reload_state[7*MMX_COEF_SHA256]);
 		}
 	} else {
 		if (SSEi_flags & SSEi_CRYPT_SHA224) {
 			/* SHA-224 IV */
-			a = _mm_set1_epi32 (0xc1059ed8);
-			b = _mm_set1_epi32 (0x367cd507);
-			c = _mm_set1_epi32 (0x3070dd17);
-			d = _mm_set1_epi32 (0xf70e5939);
-			e = _mm_set1_epi32 (0xffc00b31);
-			f = _mm_set1_epi32 (0x68581511);
-			g = _mm_set1_epi32 (0x64f98fa7);
-			h = _mm_set1_epi32 (0xbefa4fa4);
+			a = vset1_epi32 (0xc1059ed8);
+			b = vset1_epi32 (0x367cd507);
+			c = vset1_epi32 (0x3070dd17);
+			d = vset1_epi32 (0xf70e5939);
+			e = vset1_epi32 (0xffc00b31);
+			f = vset1_epi32 (0x68581511);
+			g = vset1_epi32 (0x64f98fa7);
+			h = vset1_epi32 (0xbefa4fa4);
 		} else {
 			// SHA-256 IV */
-			a = _mm_set1_epi32 (0x6a09e667);
-			b = _mm_set1_epi32 (0xbb67ae85);
-			c = _mm_set1_epi32 (0x3c6ef372);
-			d = _mm_set1_epi32 (0xa54ff53a);
-			e = _mm_set1_epi32 (0x510e527f);
-			f = _mm_set1_epi32 (0x9b05688c);
-			g = _mm_set1_epi32 (0x1f83d9ab);
-			h = _mm_set1_epi32 (0x5be0cd19);
+			a = vset1_epi32 (0x6a09e667);
+			b = vset1_epi32 (0xbb67ae85);
+			c = vset1_epi32 (0x3c6ef372);
+			d = vset1_epi32 (0xa54ff53a);
+			e = vset1_epi32 (0x510e527f);
+			f = vset1_epi32 (0x9b05688c);
+			g = vset1_epi32 (0x1f83d9ab);
+			h = vset1_epi32 (0x5be0cd19);
 		}
 	}
 	SHA256_STEP0(a, b, c, d, e, f, g, h,  0, 0x428a2f98);
@@ -1803,49 +2143,47 @@ void SSESHA256body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 	if (SSEi_flags & SSEi_RELOAD) {
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			i=0; // later if we do PARA, i will be used in the PARA_FOR loop
-			a = _mm_add_epi32(a,_mm_load_si128((__m128i *)&reload_state[i*16*2+0]));
-			b = _mm_add_epi32(b,_mm_load_si128((__m128i *)&reload_state[i*16*2+4]));
-			c = _mm_add_epi32(c,_mm_load_si128((__m128i *)&reload_state[i*16*2+8]));
-			d = _mm_add_epi32(d,_mm_load_si128((__m128i *)&reload_state[i*16*2+12]));
-			e = _mm_add_epi32(e,_mm_load_si128((__m128i *)&reload_state[i*16*2+16]));
-			f = _mm_add_epi32(f,_mm_load_si128((__m128i *)&reload_state[i*16*2+20]));
-			g = _mm_add_epi32(g,_mm_load_si128((__m128i *)&reload_state[i*16*2+24]));
-			h = _mm_add_epi32(h,_mm_load_si128((__m128i *)&reload_state[i*16*2+28]));
+			a = vadd_epi32(a,vload(&reload_state[0*MMX_COEF_SHA256]));
+			b = vadd_epi32(b,vload(&reload_state[1*MMX_COEF_SHA256]));
+			c = vadd_epi32(c,vload(&reload_state[2*MMX_COEF_SHA256]));
+			d = vadd_epi32(d,vload(&reload_state[3*MMX_COEF_SHA256]));
+			e = vadd_epi32(e,vload(&reload_state[4*MMX_COEF_SHA256]));
+			f = vadd_epi32(f,vload(&reload_state[5*MMX_COEF_SHA256]));
+			g = vadd_epi32(g,vload(&reload_state[6*MMX_COEF_SHA256]));
+			h = vadd_epi32(h,vload(&reload_state[7*MMX_COEF_SHA256]));
 		}
 		else
 		{
-			i=0;
-			a = _mm_add_epi32(a,_mm_load_si128((__m128i *)&reload_state[i*32+0]));
-			b = _mm_add_epi32(b,_mm_load_si128((__m128i *)&reload_state[i*32+4]));
-			c = _mm_add_epi32(c,_mm_load_si128((__m128i *)&reload_state[i*32+8]));
-			d = _mm_add_epi32(d,_mm_load_si128((__m128i *)&reload_state[i*32+12]));
-			e = _mm_add_epi32(e,_mm_load_si128((__m128i *)&reload_state[i*32+16]));
-			f = _mm_add_epi32(f,_mm_load_si128((__m128i *)&reload_state[i*32+20]));
-			g = _mm_add_epi32(g,_mm_load_si128((__m128i *)&reload_state[i*32+24]));
-			h = _mm_add_epi32(h,_mm_load_si128((__m128i *)&reload_state[i*32+28]));
+			a = vadd_epi32(a,vload(&reload_state[0*MMX_COEF_SHA256]));
+			b = vadd_epi32(b,vload(&reload_state[1*MMX_COEF_SHA256]));
+			c = vadd_epi32(c,vload(&reload_state[2*MMX_COEF_SHA256]));
+			d = vadd_epi32(d,vload(&reload_state[3*MMX_COEF_SHA256]));
+			e = vadd_epi32(e,vload(&reload_state[4*MMX_COEF_SHA256]));
+			f = vadd_epi32(f,vload(&reload_state[5*MMX_COEF_SHA256]));
+			g = vadd_epi32(g,vload(&reload_state[6*MMX_COEF_SHA256]));
+			h = vadd_epi32(h,vload(&reload_state[7*MMX_COEF_SHA256]));
 		}
 	} else if ((SSEi_flags & SSEi_SKIP_FINAL_ADD) == 0) {
 		if (SSEi_flags & SSEi_CRYPT_SHA224) {
 			/* SHA-224 IV */
-			a = _mm_add_epi32 (a, _mm_set1_epi32 (0xc1059ed8));
-			b = _mm_add_epi32 (b, _mm_set1_epi32 (0x367cd507));
-			c = _mm_add_epi32 (c, _mm_set1_epi32 (0x3070dd17));
-			d = _mm_add_epi32 (d, _mm_set1_epi32 (0xf70e5939));
-			e = _mm_add_epi32 (e, _mm_set1_epi32 (0xffc00b31));
-			f = _mm_add_epi32 (f, _mm_set1_epi32 (0x68581511));
-			g = _mm_add_epi32 (g, _mm_set1_epi32 (0x64f98fa7));
-			h = _mm_add_epi32 (h, _mm_set1_epi32 (0xbefa4fa4));
+			a = vadd_epi32 (a, vset1_epi32 (0xc1059ed8));
+			b = vadd_epi32 (b, vset1_epi32 (0x367cd507));
+			c = vadd_epi32 (c, vset1_epi32 (0x3070dd17));
+			d = vadd_epi32 (d, vset1_epi32 (0xf70e5939));
+			e = vadd_epi32 (e, vset1_epi32 (0xffc00b31));
+			f = vadd_epi32 (f, vset1_epi32 (0x68581511));
+			g = vadd_epi32 (g, vset1_epi32 (0x64f98fa7));
+			h = vadd_epi32 (h, vset1_epi32 (0xbefa4fa4));
 		} else {
 			/* SHA-256 IV */
-			a = _mm_add_epi32 (a, _mm_set1_epi32 (0x6a09e667));
-			b = _mm_add_epi32 (b, _mm_set1_epi32 (0xbb67ae85));
-			c = _mm_add_epi32 (c, _mm_set1_epi32 (0x3c6ef372));
-			d = _mm_add_epi32 (d, _mm_set1_epi32 (0xa54ff53a));
-			e = _mm_add_epi32 (e, _mm_set1_epi32 (0x510e527f));
-			f = _mm_add_epi32 (f, _mm_set1_epi32 (0x9b05688c));
-			g = _mm_add_epi32 (g, _mm_set1_epi32 (0x1f83d9ab));
-			h = _mm_add_epi32 (h, _mm_set1_epi32 (0x5be0cd19));
+			a = vadd_epi32 (a, vset1_epi32 (0x6a09e667));
+			b = vadd_epi32 (b, vset1_epi32 (0xbb67ae85));
+			c = vadd_epi32 (c, vset1_epi32 (0x3c6ef372));
+			d = vadd_epi32 (d, vset1_epi32 (0xa54ff53a));
+			e = vadd_epi32 (e, vset1_epi32 (0x510e527f));
+			f = vadd_epi32 (f, vset1_epi32 (0x9b05688c));
+			g = vadd_epi32 (g, vset1_epi32 (0x1f83d9ab));
+			h = vadd_epi32 (h, vset1_epi32 (0x5be0cd19));
 		}
 	}
 	if (SSEi_flags & SSEi_SWAP_FINAL) {
@@ -1853,46 +2191,44 @@ void SSESHA256body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 		 * used in a sha256_flags&SHA256_RELOAD manner, without swapping back into BE format.
 		 * NORMALLY, a format will switch binary values into BE format at start, and then
 		 * just take the 'normal' non swapped output of this function (i.e. keep it in BE) */
-		SWAP_ENDIAN (a);
-		SWAP_ENDIAN (b);
-		SWAP_ENDIAN (c);
-		SWAP_ENDIAN (d);
-		SWAP_ENDIAN (e);
-		SWAP_ENDIAN (f);
-		SWAP_ENDIAN (g);
-		SWAP_ENDIAN (h);
+		vswap_endian (a);
+		vswap_endian (b);
+		vswap_endian (c);
+		vswap_endian (d);
+		vswap_endian (e);
+		vswap_endian (f);
+		vswap_endian (g);
+		vswap_endian (h);
 	}
 	/* We store the MMX_mixed values.  This will be in proper 'mixed' format, in BE
 	 * format (i.e. correct to reload on a subsquent call), UNLESS, swapped in the prior
 	 * if statement (the SHA256_SWAP_FINAL) */
 	if (SSEi_flags & SSEi_OUTPUT_AS_INP_FMT)
 	{
-		i=0;
 		//SHA512_PARA_DO(i)
 		{
-			_mm_store_si128((__m128i *)&out[i*16*4+0], a);
-			_mm_store_si128((__m128i *)&out[i*16*4+4], b);
-			_mm_store_si128((__m128i *)&out[i*16*4+8], c);
-			_mm_store_si128((__m128i *)&out[i*16*4+12], d);
-			_mm_store_si128((__m128i *)&out[i*16*4+16], e);
-			_mm_store_si128((__m128i *)&out[i*16*4+20], f);
-			_mm_store_si128((__m128i *)&out[i*16*4+24], g);
-			_mm_store_si128((__m128i *)&out[i*16*4+28], h);
+			vstore(&out[0*MMX_COEF_SHA256], a);
+			vstore(&out[1*MMX_COEF_SHA256], b);
+			vstore(&out[2*MMX_COEF_SHA256], c);
+			vstore(&out[3*MMX_COEF_SHA256], d);
+			vstore(&out[4*MMX_COEF_SHA256], e);
+			vstore(&out[5*MMX_COEF_SHA256], f);
+			vstore(&out[6*MMX_COEF_SHA256], g);
+			vstore(&out[7*MMX_COEF_SHA256], h);
 		}
 	}
 	else
 	{
-		i=0;
 		//SHA512_PARA_DO(i)
 		{
-			_mm_store_si128 ((__m128i *)&(out[i*32+0]), a);
-			_mm_store_si128 ((__m128i *)&(out[i*32+4]), b);
-			_mm_store_si128 ((__m128i *)&(out[i*32+8]), c);
-			_mm_store_si128 ((__m128i *)&(out[i*32+12]), d);
-			_mm_store_si128 ((__m128i *)&(out[i*32+16]), e);
-			_mm_store_si128 ((__m128i *)&(out[i*32+20]), f);
-			_mm_store_si128 ((__m128i *)&(out[i*32+24]), g);
-			_mm_store_si128 ((__m128i *)&(out[i*32+28]), h);
+			vstore(&out[0*MMX_COEF_SHA256], a);
+			vstore(&out[1*MMX_COEF_SHA256], b);
+			vstore(&out[2*MMX_COEF_SHA256], c);
+			vstore(&out[3*MMX_COEF_SHA256], d);
+			vstore(&out[4*MMX_COEF_SHA256], e);
+			vstore(&out[5*MMX_COEF_SHA256], f);
+			vstore(&out[6*MMX_COEF_SHA256], g);
+			vstore(&out[7*MMX_COEF_SHA256], h);
 		}
 	}
 
@@ -1904,11 +2240,11 @@ void SSESHA256body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 #undef S0
 #define S0(x)                          \
 (                                      \
-    _mm_xor_si128 (                    \
-        _mm_roti_epi64 (x, -39),       \
-        _mm_xor_si128 (                \
-            _mm_roti_epi64 (x, -28),   \
-            _mm_roti_epi64 (x, -34)    \
+    vxor (                    \
+        vroti_epi64 (x, -39),       \
+        vxor (                \
+            vroti_epi64 (x, -28),   \
+            vroti_epi64 (x, -34)    \
         )                              \
     )                                  \
 )
@@ -1916,11 +2252,11 @@ void SSESHA256body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 #undef S1
 #define S1(x)                          \
 (                                      \
-    _mm_xor_si128 (                    \
-        _mm_roti_epi64 (x, -41),       \
-        _mm_xor_si128 (                \
-            _mm_roti_epi64 (x, -14),   \
-            _mm_roti_epi64 (x, -18)    \
+    vxor (                    \
+        vroti_epi64 (x, -41),       \
+        vxor (                \
+            vroti_epi64 (x, -14),   \
+            vroti_epi64 (x, -18)    \
         )                              \
     )                                  \
 )
@@ -1928,11 +2264,11 @@ void SSESHA256body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 #undef s0
 #define s0(x)                          \
 (                                      \
-    _mm_xor_si128 (                    \
-        _mm_srli_epi64 (x, 7),         \
-        _mm_xor_si128 (                \
-            _mm_roti_epi64 (x, -1),    \
-            _mm_roti_epi64 (x, -8)     \
+    vxor (                    \
+        vsrli_epi64 (x, 7),         \
+        vxor (                \
+            vroti_epi64 (x, -1),    \
+            vroti_epi64 (x, -8)     \
         )                              \
     )                                  \
 )
@@ -1940,45 +2276,52 @@ void SSESHA256body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state,
 #undef s1
 #define s1(x)                          \
 (                                      \
-    _mm_xor_si128 (                    \
-        _mm_srli_epi64 (x, 6),         \
-        _mm_xor_si128 (                \
-            _mm_roti_epi64 (x, -19),   \
-            _mm_roti_epi64 (x, -61)    \
+    vxor (                    \
+        vsrli_epi64 (x, 6),         \
+        vxor (                \
+            vroti_epi64 (x, -19),   \
+            vroti_epi64 (x, -61)    \
         )                              \
     )                                  \
 )
 
-#define Maj(x,y,z) _mm_cmov_si128 (x, y, _mm_xor_si128 (z, y))
+#define Maj(x,y,z) vcmov (x, y, vxor (z, y))
 
-#define Ch(x,y,z)  _mm_cmov_si128 (y, z, x)
+#define Ch(x,y,z)  vcmov (y, z, x)
 
 #undef R
 #define R(t)                                         \
 {                                                    \
-    tmp1 = _mm_add_epi64 (s1(w[t -  2]), w[t - 7]);  \
-    tmp2 = _mm_add_epi64 (s0(w[t - 15]), w[t - 16]); \
-    w[t] = _mm_add_epi64 (tmp1, tmp2);               \
+    tmp1 = vadd_epi64 (s1(w[t -  2]), w[t - 7]);  \
+    tmp2 = vadd_epi64 (s0(w[t - 15]), w[t - 16]); \
+    w[t] = vadd_epi64 (tmp1, tmp2);               \
 }
 
 #define SHA512_STEP(a,b,c,d,e,f,g,h,x,K)             \
 {                                                    \
-    tmp1 = _mm_add_epi64 (h,    w[x]);               \
-    tmp2 = _mm_add_epi64 (S1(e),_mm_set1_epi64x(K)); \
-    tmp1 = _mm_add_epi64 (tmp1, Ch(e,f,g));          \
-    tmp1 = _mm_add_epi64 (tmp1, tmp2);               \
-    tmp2 = _mm_add_epi64 (S0(a),Maj(a,b,c));         \
-    d    = _mm_add_epi64 (tmp1, d);                  \
-    h    = _mm_add_epi64 (tmp1, tmp2);               \
+    tmp1 = vadd_epi64 (h,    w[x]);               \
+    tmp2 = vadd_epi64 (S1(e),vset1_epi64x(K)); \
+    tmp1 = vadd_epi64 (tmp1, Ch(e,f,g));          \
+    tmp1 = vadd_epi64 (tmp1, tmp2);               \
+    tmp2 = vadd_epi64 (S0(a),Maj(a,b,c));         \
+    d    = vadd_epi64 (tmp1, d);                  \
+    h    = vadd_epi64 (tmp1, tmp2);               \
 }
 
-#if defined (MMX_COEF_SHA512)
+#if defined (MMX_COEF_SHA512) && !defined(SSE_VARIANT_NO_SHA2)
 void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state, unsigned SSEi_flags)
 {
 	int i;
 
-	__m128i a, b, c, d, e, f, g, h;
-	__m128i w[80], tmp1, tmp2;
+	vtype a, b, c, d, e, f, g, h;
+	vtype w[80], tmp1, tmp2;
+
+#ifdef SSE_DISPATCH
+	if (SSESHA512body_level) {
+		SSESHA512body_level(data, out, reload_state, SSEi_flags);
+		return;
+	}
+#endif
 
 	if (SSEi_flags & SSEi_FLAT_IN) {
 
@@ -1987,8 +2330,8 @@ void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state,
 			for (i = 0; i < 14; i += 2) {
 				GATHER64 (tmp1, saved_key, i);
 				GATHER64 (tmp2, saved_key, i + 1);
-				SWAP_ENDIAN64 (tmp1);
-				SWAP_ENDIAN64 (tmp2);
+				vswap_endian64 (tmp1);
+				vswap_endian64 (tmp2);
 				w[i] = tmp1;
 				w[i + 1] = tmp2;
 			}
@@ -1999,8 +2342,8 @@ void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state,
 			for (i = 0; i < 14; i += 2) {
 				GATHER64 (tmp1, saved_key, i);
 				GATHER64 (tmp2, saved_key, i + 1);
-				SWAP_ENDIAN64 (tmp1);
-				SWAP_ENDIAN64 (tmp2);
+				vswap_endian64 (tmp1);
+				vswap_endian64 (tmp2);
 				w[i] = tmp1;
 				w[i + 1] = tmp2;
 			}
@@ -2008,13 +2351,13 @@ void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state,
 			GATHER64 (tmp2, saved_key, 15);
 		}
 		if ( ((SSEi_flags & SSEi_2BUF_INPUT_FIRST_BLK) == SSEi_2BUF_INPUT_FIRST_BLK)) {
-			SWAP_ENDIAN64 (tmp1);
-			SWAP_ENDIAN64 (tmp2);
+			vswap_endian64 (tmp1);
+			vswap_endian64 (tmp2);
 		}
 		w[14] = tmp1;
 		w[15] = tmp2;
 	} else
-		memcpy(w, data, 16*sizeof(__m128i));
+		memcpy(w, data, 16*sizeof(vtype));
 
 	for (i = 16; i < 80; i++)
 		R(i);
@@ -2022,49 +2365,47 @@ void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state,
 	if (SSEi_flags & SSEi_RELOAD) {
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			i=0; // later if we do PARA, i will be used in the PARA_FOR loop
-			a = _mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+( 0/2)]);
-			b = _mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+( 4/2)]);
-			c = _mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+( 8/2)]);
-			d = _mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+(12/2)]);
-			e = _mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+(16/2)]);
-			f = _mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+(20/2)]);
-			g = _mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+(24/2)]);
-			h = _mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+(28/2)]);
+			a = vload(&reload_state[0*MMX_COEF_SHA512]);
+			b = vload(&reload_state[1*MMX_COEF_SHA512]);
+			c = vload(&reload_state[2*MMX_COEF_SHA512]);
+			d = vload(&reload_state[3*MMX_COEF_SHA512]);
+			e = vload(&reload_state[4*MMX_COEF_SHA512]);
+			f = vload(&reload_state[5*MMX_COEF_SHA512]);
+			g = vload(&reload_state[6*MMX_COEF_SHA512]);
+			h = vload(&reload_state[7*MMX_COEF_SHA512]);
 		}
 		else
 		{
-			i=0;
-			a = _mm_load_si128((__m128i *)&reload_state[i*(32/2)+( 0/2)]);
-			b = _mm_load_si128((__m128i *)&reload_state[i*(32/2)+( 4/2)]);
-			c = _mm_load_si128((__m128i *)&reload_state[i*(32/2)+( 8/2)]);
-			d = _mm_load_si128((__m128i *)&reload_state[i*(32/2)+(12/2)]);
-			e = _mm_load_si128((__m128i *)&reload_state[i*(32/2)+(16/2)]);
-			f = _mm_load_si128((__m128i *)&reload_state[i*(32/2)+(20/2)]);
-			g = _mm_load_si128((__m128i *)&reload_state[i*(32/2)+(24/2)]);
-			h = _mm_load_si128((__m128i *)&reload_state[i*(32/2)+(28/2)]);
+			a = vload(&reload_state[0*MMX_COEF_SHA512]);
+			b = vload(&reload_state[1*MMX_COEF_SHA512]);
+			c = vload(&reload_state[2*MMX_COEF_SHA512]);
+			d = vload(&reload_state[3*MMX_COEF_SHA512]);
+			e = vload(&reload_state[4*MMX_COEF_SHA512]);
+			f = vload(&reload_state[5*MMX_COEF_SHA512]);
+			g = vload(&reload_state[6*MMX_COEF_SHA512]);
+			h = vload(&reload_state[7*MMX_COEF_SHA512]);
 		}
 	} else {
 		if (SSEi_flags & SSEi_CRYPT_SHA384) {
 			/* SHA-384 IV */
-			a = _mm_set1_epi64x (0xcbbb9d5dc1059ed8ULL);
-			b = _mm_set1_epi64x (0x629a292a367cd507ULL);
-			c = _mm_set1_epi64x (0x9159015a3070dd17ULL);
-			d = _mm_set1_epi64x (0x152fecd8f70e5939ULL);
-			e = _mm_set1_epi64x (0x67332667ffc00b31ULL);
-			f = _mm_set1_epi64x (0x8eb44a8768581511ULL);
-			g = _mm_set1_epi64x (0xdb0c2e0d64f98fa7ULL);
-			h = _mm_set1_epi64x (0x47b5481dbefa4fa4ULL);
+			a = vset1_epi64x (0xcbbb9d5dc1059ed8ULL);
+			b = vset1_epi64x (0x629a292a367cd507ULL);
+			c = vset1_epi64x (0x9159015a3070dd17ULL);
+			d = vset1_epi64x (0x152fecd8f70e5939ULL);
+			e = vset1_epi64x (0x67332667ffc00b31ULL);
+			f = vset1_epi64x (0x8eb44a8768581511ULL);
+			g = vset1_epi64x (0xdb0c2e0d64f98fa7ULL);
+			h = vset1_epi64x (0x47b5481dbefa4fa4ULL);
 		} else {
 			// SHA-512 IV */
-			a = _mm_set1_epi64x (0x6a09e667f3bcc908ULL);
-			b = _mm_set1_epi64x (0xbb67ae8584caa73bULL);
-			c = _mm_set1_epi64x (0x3c6ef372fe94f82bULL);
-			d = _mm_set1_epi64x (0xa54ff53a5f1d36f1ULL);
-			e = _mm_set1_epi64x (0x510e527fade682d1ULL);
-			f = _mm_set1_epi64x (0x9b05688c2b3e6c1fULL);
-			g = _mm_set1_epi64x (0x1f83d9abfb41bd6bULL);
-			h = _mm_set1_epi64x (0x5be0cd19137e2179ULL);
+			a = vset1_epi64x (0x6a09e667f3bcc908ULL);
+			b = vset1_epi64x (0xbb67ae8584caa73bULL);
+			c = vset1_epi64x (0x3c6ef372fe94f82bULL);
+			d = vset1_epi64x (0xa54ff53a5f1d36f1ULL);
+			e = vset1_epi64x (0x510e527fade682d1ULL);
+			f = vset1_epi64x (0x9b05688c2b3e6c1fULL);
+			g = vset1_epi64x (0x1f83d9abfb41bd6bULL);
+			h = vset1_epi64x (0x5be0cd19137e2179ULL);
 		}
 	}
 
@@ -2156,55 +2497,53 @@ void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state,
 	if (SSEi_flags & SSEi_RELOAD) {
 		if ((SSEi_flags & SSEi_RELOAD_INP_FMT)==SSEi_RELOAD_INP_FMT)
 		{
-			i=0; // later if we do PARA, i will be used in the PARA_FOR loop
 			//SHA512_PARA_DO(i)
 			{
-				a = _mm_add_epi64(a,_mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+( 0/2)]));
-				b = _mm_add_epi64(b,_mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+( 4/2)]));
-				c = _mm_add_epi64(c,_mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+( 8/2)]));
-				d = _mm_add_epi64(d,_mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+(12/2)]));
-				e = _mm_add_epi64(e,_mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+(16/2)]));
-				f = _mm_add_epi64(f,_mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+(20/2)]));
-				g = _mm_add_epi64(g,_mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+(24/2)]));
-				h = _mm_add_epi64(h,_mm_load_si128((__m128i *)&reload_state[i*(16/2)*8+(28/2)]));
+				a = vadd_epi64(a,vload(&reload_state[0*MMX_COEF_SHA512]));
+				b = vadd_epi64(b,vload(&reload_state[1*MMX_COEF_SHA512]));
+				c = vadd_epi64(c,vload(&reload_state[2*MMX_COEF_SHA512]));
+				d = vadd_epi64(d,vload(&reload_state[3*MMX_COEF_SHA512]));
+				e = vadd_epi64(e,vload(&reload_state[4*MMX_COEF_SHA512]));
+				f = vadd_epi64(f,vload(&reload_state[5*MMX_COEF_SHA512]));
+				g = vadd_epi64(g,vload(&reload_state[6*MMX_COEF_SHA512]));
+				h = vadd_epi64(h,vload(&reload_state[7*MMX_COEF_SHA512]));
 			}
 		}
 		else
 		{
-			i=0;
 			//SHA512_PARA_DO(i)
 			{
-				a = _mm_add_epi64(a,_mm_load_si128((__m128i *)&reload_state[i*(32/2)+( 0/2)]));
-				b = _mm_add_epi64(b,_mm_load_si128((__m128i *)&reload_state[i*(32/2)+( 4/2)]));
-				c = _mm_add_epi64(c,_mm_load_si128((__m128i *)&reload_state[i*(32/2)+( 8/2)]));
-				d = _mm_add_epi64(d,_mm_load_si128((__m128i *)&reload_state[i*(32/2)+(12/2)]));
-				e = _mm_add_epi64(e,_mm_load_si128((__m128i *)&reload_state[i*(32/2)+(16/2)]));
-				f = _mm_add_epi64(f,_mm_load_si128((__m128i *)&reload_state[i*(32/2)+(20/2)]));
-				g = _mm_add_epi64(g,_mm_load_si128((__m128i *)&reload_state[i*(32/2)+(24/2)]));
-				h = _mm_add_epi64(h,_mm_load_si128((__m128i *)&reload_state[i*(32/2)+(28/2)]));
+				a = vadd_epi64(a,vload(&reload_state[0*MMX_COEF_SHA512]));
+				b = vadd_epi64(b,vload(&reload_state[1*MMX_COEF_SHA512]));
+				c = vadd_epi64(c,vload(&reload_state[2*MMX_COEF_SHA512]));
+				d = vadd_epi64(d,vload(&reload_state[3*MMX_COEF_SHA512]));
+				e = vadd_epi64(e,vload(&reload_state[4*MMX_COEF_SHA512]));
+				f = vadd_epi64(f,vload(&reload_state[5*MMX_COEF_SHA512]));
+				g = vadd_epi64(g,vload(&reload_state[6*MMX_COEF_SHA512]));
+				h = vadd_epi64(h,vload(&reload_state[7*MMX_COEF_SHA512]));
 				}
 		}
 	} else if ((SSEi_flags & SSEi_SKIP_FINAL_ADD) == 0) {
 		if (SSEi_flags & SSEi_CRYPT_SHA384) {
 			/* SHA-384 IV */
-			a = _mm_add_epi64 (a, _mm_set1_epi64x (0xcbbb9d5dc1059ed8ULL));
-			b = _mm_add_epi64 (b, _mm_set1_epi64x (0x629a292a367cd507ULL));
-			c = _mm_add_epi64 (c, _mm_set1_epi64x (0x9159015a3070dd17ULL));
-			d = _mm_add_epi64 (d, _mm_set1_epi64x (0x152fecd8f70e5939ULL));
-			e = _mm_add_epi64 (e, _mm_set1_epi64x (0x67332667ffc00b31ULL));
-			f = _mm_add_epi64 (f, _mm_set1_epi64x (0x8eb44a8768581511ULL));
-			g = _mm_add_epi64 (g, _mm_set1_epi64x (0xdb0c2e0d64f98fa7ULL));
-			h = _mm_add_epi64 (h, _mm_set1_epi64x (0x47b5481dbefa4fa4ULL));
+			a = vadd_epi64 (a, vset1_epi64x (0xcbbb9d5dc1059ed8ULL));
+			b = vadd_epi64 (b, vset1_epi64x (0x629a292a367cd507ULL));
+			c = vadd_epi64 (c, vset1_epi64x (0x9159015a3070dd17ULL));
+			d = vadd_epi64 (d, vset1_epi64x (0x152fecd8f70e5939ULL));
+			e = vadd_epi64 (e, vset1_epi64x (0x67332667ffc00b31ULL));
+			f = vadd_epi64 (f, vset1_epi64x (0x8eb44a8768581511ULL));
+			g = vadd_epi64 (g, vset1_epi64x (0xdb0c2e0d64f98fa7ULL));
+			h = vadd_epi64 (h, vset1_epi64x (0x47b5481dbefa4fa4ULL));
 		} else {
 			/* SHA-512 IV */
-			a = _mm_add_epi64 (a, _mm_set1_epi64x (0x6a09e667f3bcc908ULL));
-			b = _mm_add_epi64 (b, _mm_set1_epi64x (0xbb67ae8584caa73bULL));
-			c = _mm_add_epi64 (c, _mm_set1_epi64x (0x3c6ef372fe94f82bULL));
-			d = _mm_add_epi64 (d, _mm_set1_epi64x (0xa54ff53a5f1d36f1ULL));
-			e = _mm_add_epi64 (e, _mm_set1_epi64x (0x510e527fade682d1ULL));
-			f = _mm_add_epi64 (f, _mm_set1_epi64x (0x9b05688c2b3e6c1fULL));
-			g = _mm_add_epi64 (g, _mm_set1_epi64x (0x1f83d9abfb41bd6bULL));
-			h = _mm_add_epi64 (h, _mm_set1_epi64x (0x5be0cd19137e2179ULL));
+			a = vadd_epi64 (a, vset1_epi64x (0x6a09e667f3bcc908ULL));
+			b = vadd_epi64 (b, vset1_epi64x (0xbb67ae8584caa73bULL));
+			c = vadd_epi64 (c, vset1_epi64x (0x3c6ef372fe94f82bULL));
+			d = vadd_epi64 (d, vset1_epi64x (0xa54ff53a5f1d36f1ULL));
+			e = vadd_epi64 (e, vset1_epi64x (0x510e527fade682d1ULL));
+			f = vadd_epi64 (f, vset1_epi64x (0x9b05688c2b3e6c1fULL));
+			g = vadd_epi64 (g, vset1_epi64x (0x1f83d9abfb41bd6bULL));
+			h = vadd_epi64 (h, vset1_epi64x (0x5be0cd19137e2179ULL));
 		}
 	}
 
@@ -2213,14 +2552,14 @@ void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state,
 		 * used in a sha512_flags&SHA512_RELOAD manner, without swapping back into BE format.
 		 * NORMALLY, a format will switch binary values into BE format at start, and then
 		 * just take the 'normal' non swapped output of this function (i.e. keep it in BE) */
-		SWAP_ENDIAN64(a);
-		SWAP_ENDIAN64(b);
-		SWAP_ENDIAN64(c);
-		SWAP_ENDIAN64(d);
-		SWAP_ENDIAN64(e);
-		SWAP_ENDIAN64(f);
-		SWAP_ENDIAN64(g);
-		SWAP_ENDIAN64(h);
+		vswap_endian64(a);
+		vswap_endian64(b);
+		vswap_endian64(c);
+		vswap_endian64(d);
+		vswap_endian64(e);
+		vswap_endian64(f);
+		vswap_endian64(g);
+		vswap_endian64(h);
 	}
 
 	/* We store the MMX_mixed values.  This will be in proper 'mixed' format, in BE
@@ -2228,35 +2567,374 @@ void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state,
 	 * if statement (the SHA512_SWAP_FINAL) */
 	if (SSEi_flags & SSEi_OUTPUT_AS_INP_FMT)
 	{
-		i=0;
 		//SHA512_PARA_DO(i)
 		{
-			_mm_store_si128((__m128i *)&out[i*(16/2)*8+( 0/2)], a);
-			_mm_store_si128((__m128i *)&out[i*(16/2)*8+( 4/2)], b);
-			_mm_store_si128((__m128i *)&out[i*(16/2)*8+( 8/2)], c);
-			_mm_store_si128((__m128i *)&out[i*(16/2)*8+(12/2)], d);
-			_mm_store_si128((__m128i *)&out[i*(16/2)*8+(16/2)], e);
-			_mm_store_si128((__m128i *)&out[i*(16/2)*8+(20/2)], f);
-			_mm_store_si128((__m128i *)&out[i*(16/2)*8+(24/2)], g);
-			_mm_store_si128((__m128i *)&out[i*(16/2)*8+(28/2)], h);
+			vstore(&out[0*MMX_COEF_SHA512], a);
+			vstore(&out[1*MMX_COEF_SHA512], b);
+			vstore(&out[2*MMX_COEF_SHA512], c);
+			vstore(&out[3*MMX_COEF_SHA512], d);
+			vstore(&out[4*MMX_COEF_SHA512], e);
+			vstore(&out[5*MMX_COEF_SHA512], f);
+			vstore(&out[6*MMX_COEF_SHA512], g);
+			vstore(&out[7*MMX_COEF_SHA512], h);
 		}
 	}
 	else
 	{
-		i=0;
 		//SHA512_PARA_DO(i)
 		{
-			_mm_store_si128 ((__m128i *)&(out[i*(32/2)+( 0/2)]), a);
-			_mm_store_si128 ((__m128i *)&(out[i*(32/2)+( 4/2)]), b);
-			_mm_store_si128 ((__m128i *)&(out[i*(32/2)+( 8/2)]), c);
-			_mm_store_si128 ((__m128i *)&(out[i*(32/2)+(12/2)]), d);
-			_mm_store_si128 ((__m128i *)&(out[i*(32/2)+(16/2)]), e);
-			_mm_store_si128 ((__m128i *)&(out[i*(32/2)+(20/2)]), f);
-			_mm_store_si128 ((__m128i *)&(out[i*(32/2)+(24/2)]), g);
-			_mm_store_si128 ((__m128i *)&(out[i*(32/2)+(28/2)]), h);
+			vstore(&out[0*MMX_COEF_SHA512], a);
+			vstore(&out[1*MMX_COEF_SHA512], b);
+			vstore(&out[2*MMX_COEF_SHA512], c);
+			vstore(&out[3*MMX_COEF_SHA512], d);
+			vstore(&out[4*MMX_COEF_SHA512], e);
+			vstore(&out[5*MMX_COEF_SHA512], f);
+			vstore(&out[6*MMX_COEF_SHA512], g);
+			vstore(&out[7*MMX_COEF_SHA512], h);
 		}
 	}
 
 
 }
 #endif
+
+/* RIPEMD-160 below */
+
+#define RIPEMD160_F1(x,y,z)	vxor(vxor(x, y), z)
+#define RIPEMD160_F2(x,y,z)	vcmov(y, z, x)
+#define RIPEMD160_F3(x,y,z)	vxor(vxor(vandnot(x, y), z), vset1_epi32(0xffffffff))
+#define RIPEMD160_F4(x,y,z)	vcmov(x, y, z)
+#define RIPEMD160_F5(x,y,z)	vxor(vxor(x, vandnot(y, z)), vset1_epi32(0xffffffff))
+
+#define RIPEMD160_K11		0x00000000
+#define RIPEMD160_K12		0x5a827999
+#define RIPEMD160_K13		0x6ed9eba1
+#define RIPEMD160_K14		0x8f1bbcdc
+#define RIPEMD160_K15		0xa953fd4e
+#define RIPEMD160_K21		0x50a28be6
+#define RIPEMD160_K22		0x5c4dd124
+#define RIPEMD160_K23		0x6d703ef3
+#define RIPEMD160_K24		0x7a6d76e9
+#define RIPEMD160_K25		0x00000000
+
+#define RIPEMD160_STEP(a,b,c,d,e, f, s, x, K)                     \
+{                                                                 \
+    tmp = vadd_epi32(w[x], vset1_epi32(RIPEMD160_##K));           \
+    tmp = vadd_epi32(tmp, RIPEMD160_##f(b, c, d));                \
+    a = vadd_epi32(vroti_epi32(vadd_epi32(a, tmp), s), e);        \
+    c = vroti_epi32(c, 10);                                       \
+}
+
+/*
+ * One RIPEMD-160 block for each of MMX_COEF_RIPEMD160 keys.  The input is
+ * SSEi_MIXED_IN only, 16 little-endian words per key, and the output is 5
+ * words per key in the same layout, so with SSEi_OUTPUT_AS_INP_FMT (which
+ * changes nothing here) it can be the first 20 bytes of the next input.
+ * The two lines of the compression are interleaved, one step of each at a
+ * time.
+ */
+#if defined (MMX_COEF_RIPEMD160) && !defined(SSE_VARIANT)
+void SSERIPEMD160body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags)
+{
+	vtype A1, B1, C1, D1, E1, A2, B2, C2, D2, E2;
+	vtype h0, h1, h2, h3, h4;
+	vtype w[16], tmp;
+
+	memcpy(w, data, 16*sizeof(vtype));
+
+	if (SSEi_flags & SSEi_RELOAD) {
+		h0 = vload(&reload_state[0*MMX_COEF_RIPEMD160]);
+		h1 = vload(&reload_state[1*MMX_COEF_RIPEMD160]);
+		h2 = vload(&reload_state[2*MMX_COEF_RIPEMD160]);
+		h3 = vload(&reload_state[3*MMX_COEF_RIPEMD160]);
+		h4 = vload(&reload_state[4*MMX_COEF_RIPEMD160]);
+	} else {
+		h0 = vset1_epi32(0x67452301);
+		h1 = vset1_epi32(0xefcdab89);
+		h2 = vset1_epi32(0x98badcfe);
+		h3 = vset1_epi32(0x10325476);
+		h4 = vset1_epi32(0xc3d2e1f0);
+	}
+	A1 = A2 = h0;
+	B1 = B2 = h1;
+	C1 = C2 = h2;
+	D1 = D2 = h3;
+	E1 = E2 = h4;
+
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F1, 11,  0, K11);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F5,  8,  5, K21);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F1, 14,  1, K11);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F5,  9, 14, K21);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F1, 15,  2, K11);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F5,  9,  7, K21);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F1, 12,  3, K11);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F5, 11,  0, K21);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F1,  5,  4, K11);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F5, 13,  9, K21);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F1,  8,  5, K11);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F5, 15,  2, K21);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F1,  7,  6, K11);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F5, 15, 11, K21);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F1,  9,  7, K11);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F5,  5,  4, K21);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F1, 11,  8, K11);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F5,  7, 13, K21);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F1, 13,  9, K11);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F5,  7,  6, K21);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F1, 14, 10, K11);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F5,  8, 15, K21);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F1, 15, 11, K11);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F5, 11,  8, K21);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F1,  6, 12, K11);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F5, 14,  1, K21);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F1,  7, 13, K11);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F5, 14, 10, K21);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F1,  9, 14, K11);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F5, 12,  3, K21);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F1,  8, 15, K11);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F5,  6, 12, K21);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F2,  7,  7, K12);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F4,  9,  6, K22);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F2,  6,  4, K12);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F4, 13, 11, K22);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F2,  8, 13, K12);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F4, 15,  3, K22);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F2, 13,  1, K12);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F4,  7,  7, K22);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F2, 11, 10, K12);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F4, 12,  0, K22);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F2,  9,  6, K12);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F4,  8, 13, K22);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F2,  7, 15, K12);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F4,  9,  5, K22);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F2, 15,  3, K12);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F4, 11, 10, K22);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F2,  7, 12, K12);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F4,  7, 14, K22);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F2, 12,  0, K12);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F4,  7, 15, K22);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F2, 15,  9, K12);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F4, 12,  8, K22);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F2,  9,  5, K12);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F4,  7, 12, K22);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F2, 11,  2, K12);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F4,  6,  4, K22);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F2,  7, 14, K12);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F4, 15,  9, K22);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F2, 13, 11, K12);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F4, 13,  1, K22);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F2, 12,  8, K12);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F4, 11,  2, K22);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F3, 11,  3, K13);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F3,  9, 15, K23);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F3, 13, 10, K13);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F3,  7,  5, K23);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F3,  6, 14, K13);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F3, 15,  1, K23);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F3,  7,  4, K13);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F3, 11,  3, K23);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F3, 14,  9, K13);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F3,  8,  7, K23);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F3,  9, 15, K13);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F3,  6, 14, K23);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F3, 13,  8, K13);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F3,  6,  6, K23);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F3, 15,  1, K13);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F3, 14,  9, K23);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F3, 14,  2, K13);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F3, 12, 11, K23);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F3,  8,  7, K13);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F3, 13,  8, K23);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F3, 13,  0, K13);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F3,  5, 12, K23);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F3,  6,  6, K13);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F3, 14,  2, K23);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F3,  5, 13, K13);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F3, 13, 10, K23);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F3, 12, 11, K13);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F3, 13,  0, K23);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F3,  7,  5, K13);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F3,  7,  4, K23);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F3,  5, 12, K13);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F3,  5, 13, K23);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F4, 11,  1, K14);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F2, 15,  8, K24);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F4, 12,  9, K14);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F2,  5,  6, K24);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F4, 14, 11, K14);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F2,  8,  4, K24);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F4, 15, 10, K14);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F2, 11,  1, K24);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F4, 14,  0, K14);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F2, 14,  3, K24);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F4, 15,  8, K14);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F2, 14, 11, K24);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F4,  9, 12, K14);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F2,  6, 15, K24);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F4,  8,  4, K14);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F2, 14,  0, K24);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F4,  9, 13, K14);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F2,  6,  5, K24);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F4, 14,  3, K14);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F2,  9, 12, K24);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F4,  5,  7, K14);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F2, 12,  2, K24);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F4,  6, 15, K14);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F2,  9, 13, K24);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F4,  8, 14, K14);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F2, 12,  9, K24);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F4,  6,  5, K14);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F2,  5,  7, K24);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F4,  5,  6, K14);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F2, 15, 10, K24);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F4, 12,  2, K14);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F2,  8, 14, K24);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F5,  9,  4, K15);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F1,  8, 12, K25);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F5, 15,  0, K15);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F1,  5, 15, K25);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F5,  5,  5, K15);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F1, 12, 10, K25);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F5, 11,  9, K15);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F1,  9,  4, K25);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F5,  6,  7, K15);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F1, 12,  1, K25);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F5,  8, 12, K15);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F1,  5,  5, K25);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F5, 13,  2, K15);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F1, 14,  8, K25);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F5, 12, 10, K15);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F1,  6,  7, K25);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F5,  5, 14, K15);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F1,  8,  6, K25);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F5, 12,  1, K15);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F1, 13,  2, K25);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F5, 13,  3, K15);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F1,  6, 13, K25);
+	RIPEMD160_STEP(A1,B1,C1,D1,E1, F5, 14,  8, K15);
+	RIPEMD160_STEP(A2,B2,C2,D2,E2, F1,  5, 14, K25);
+	RIPEMD160_STEP(E1,A1,B1,C1,D1, F5, 11, 11, K15);
+	RIPEMD160_STEP(E2,A2,B2,C2,D2, F1, 15,  0, K25);
+	RIPEMD160_STEP(D1,E1,A1,B1,C1, F5,  8,  6, K15);
+	RIPEMD160_STEP(D2,E2,A2,B2,C2, F1, 13,  3, K25);
+	RIPEMD160_STEP(C1,D1,E1,A1,B1, F5,  5, 15, K15);
+	RIPEMD160_STEP(C2,D2,E2,A2,B2, F1, 11,  9, K25);
+	RIPEMD160_STEP(B1,C1,D1,E1,A1, F5,  6, 13, K15);
+	RIPEMD160_STEP(B2,C2,D2,E2,A2, F1, 11, 11, K25);
+
+	tmp = vadd_epi32(vadd_epi32(h1, C1), D2);
+	h1 = vadd_epi32(vadd_epi32(h2, D1), E2);
+	h2 = vadd_epi32(vadd_epi32(h3, E1), A2);
+	h3 = vadd_epi32(vadd_epi32(h4, A1), B2);
+	h4 = vadd_epi32(vadd_epi32(h0, B1), C2);
+
+	vstore(&out[0*MMX_COEF_RIPEMD160], tmp);
+	vstore(&out[1*MMX_COEF_RIPEMD160], h1);
+	vstore(&out[2*MMX_COEF_RIPEMD160], h2);
+	vstore(&out[3*MMX_COEF_RIPEMD160], h3);
+	vstore(&out[4*MMX_COEF_RIPEMD160], h4);
+}
+#endif
+
+/* WHIRLPOOL below */
+
+/*
+ * The WHIRLPOOL of MMX_COEF_WHIRLPOOL keys, one key per byte of a vector:
+ * byte i of the message and state (byte i&7 of little-endian word i>>3) of
+ * key j is byte i*MMX_COEF_WHIRLPOOL+j of the buffers.  Sliced like this,
+ * the ShiftColumns step is just a matter of which vector is read, the
+ * S-box is its three 4-bit mini-boxes looked up with vpshufb, and the
+ * MixRows multiplications are a few doublings in GF(2^8), so the 8 lookup
+ * tables of the plain code (which keep the load ports busy on their own)
+ * are not needed.
+ */
+#if defined (MMX_COEF_WHIRLPOOL) && !defined(SSE_VARIANT)
+
+#define WHIRLPOOL_E		1,11,9,12,13,6,15,3,14,8,7,4,10,2,5,0
+#define WHIRLPOOL_EINV		15,0,13,7,11,14,5,10,9,2,12,1,3,4,8,6
+#define WHIRLPOOL_R		7,12,11,13,14,4,9,15,6,3,8,10,2,5,1,0
+
+static const ARCH_WORD_64 whirlpool_RC[10] = {
+	0x4F01B887E8C62318ULL, 0x52916F79F5D2A636ULL,
+	0x357B0CA38E9BBC60ULL, 0x57FE4B2EC2D7E01DULL,
+	0xDA4AF09FE5377715ULL, 0x856BA0B10A29C958ULL,
+	0x67053ECBF4105DBDULL, 0xD8957DA78B4127E4ULL,
+	0x9E4717DD667CEEFBULL, 0x33835AAD07BF2DCAULL
+};
+
+#define WHIRLPOOL_SBOX(x)						\
+{									\
+	u = _mm256_shuffle_epi8(E, vand(_mm256_srli_epi16(x, 4), m0f));	\
+	l = _mm256_shuffle_epi8(Einv, vand(x, m0f));			\
+	r = _mm256_shuffle_epi8(R, vxor(u, l));				\
+	x = vor(_mm256_slli_epi16(_mm256_shuffle_epi8(E, vxor(u, r)), 4),\
+	        _mm256_shuffle_epi8(Einv, vxor(l, r)));			\
+}
+
+/* multiplication by 2 in GF(2^8) mod x^8+x^4+x^3+x^2+1 */
+#define WHIRLPOOL_X2(x)							\
+	vxor(_mm256_add_epi8(x, x),					\
+	     vand(_mm256_cmpgt_epi8(_mm256_setzero_si256(), x), poly))
+
+/*
+ * One round of the W block cipher, without the key.  Row d of the output
+ * is MixRows of the S-boxed bytes k of rows d-k, whose circulant matrix
+ * row (1 1 4 1 8 5 2 9) is applied by Horner's rule on the 8, 4, 2 and 1
+ * bits of the coefficients.
+ */
+static void whirlpool_round_sse(const vtype *in, vtype *out)
+{
+	const vtype E = _mm256_setr_epi8(WHIRLPOOL_E, WHIRLPOOL_E);
+	const vtype Einv = _mm256_setr_epi8(WHIRLPOOL_EINV, WHIRLPOOL_EINV);
+	const vtype R = _mm256_setr_epi8(WHIRLPOOL_R, WHIRLPOOL_R);
+	const vtype m0f = _mm256_set1_epi8(0x0f);
+	const vtype poly = _mm256_set1_epi8(0x1d);
+	vtype x[8], u, l, r, p1, p4, p8;
+	int d, k;
+
+	for (d = 0; d < 8; d++) {
+		for (k = 0; k < 8; k++) {
+			x[k] = in[((d - k) & 7) * 8 + k];
+			WHIRLPOOL_SBOX(x[k]);
+		}
+		for (k = 0; k < 8; k++) {
+			p8 = vxor(x[(k - 4) & 7], x[(k - 7) & 7]);
+			p4 = vxor(x[(k - 2) & 7], x[(k - 5) & 7]);
+			p1 = vxor(vxor(x[k], x[(k - 1) & 7]),
+			          vxor(vxor(x[(k - 3) & 7], x[(k - 5) & 7]),
+			               x[(k - 7) & 7]));
+			p4 = vxor(p4, WHIRLPOOL_X2(p8));
+			p4 = vxor(x[(k - 6) & 7], WHIRLPOOL_X2(p4));
+			out[d * 8 + k] = vxor(p1, WHIRLPOOL_X2(p4));
+		}
+	}
+}
+
+/*
+ * Compresses the message block data into the state reload_state, and puts
+ * the new state into out, which may be reload_state itself.
+ */
+void SSEWHIRLPOOLbody(unsigned char *data, unsigned char *out, unsigned char *reload_state)
+{
+	vtype *msg = (vtype *)data, *state = (vtype *)reload_state;
+	vtype K[64], n[64], tmp[64];
+	int i, r;
+
+	for (i = 0; i < 64; i++) {
+		K[i] = vload(&state[i]);
+		n[i] = vxor(vload(&msg[i]), K[i]);
+	}
+	for (r = 0; r < 10; r++) {
+		whirlpool_round_sse(K, tmp);
+		for (i = 0; i < 8; i++)
+			K[i] = vxor(tmp[i], _mm256_set1_epi8((char)(whirlpool_RC[r] >> (8 * i))));
+		for (; i < 64; i++)
+			K[i] = tmp[i];
+		whirlpool_round_sse(n, tmp);
+		for (i = 0; i < 64; i++)
+			n[i] = vxor(tmp[i], K[i]);
+	}
+	for (i = 0; i < 64; i++)
+		vstore(&((vtype *)out)[i], vxor(vload(&state[i]), vxor(n[i], vload(&msg[i]))));
+}
+#endif
@@ -25,7 +25,10 @@
 #define STRINGIZE2(s) #s
 #define STRINGIZE(s) STRINGIZE2(s)
 
-#if defined(__XOP__)
+#if defined(__AVX2__)
+#undef SSE_type
+#define SSE_type			"AVX2"
+#elif defined(__XOP__)
 #undef SSE_type
 #define SSE_type			"XOP"
 #elif defined(__AVX__)
@@ -42,11 +45,26 @@
 #define SSE_type			"SSE2"
 #endif
 
+/*
+ * Algorithm names of the SIMD code read "<vector bits> <instruction set>
+ * <keys per call>x".  With AVX2, MD4, MD5 and SHA-1 keep their 4 keys wide
+ * layout and put two blocks in each 256-bit vector, so e.g. MD5 with a PARA
+ * of 4 is "256/256 AVX2 16x", while SHA-256 is natively "256/256 AVX2 8x".
+ * Formats that make up their own names (dynamic) use SSE_BITS_STR as well.
+ */
+#ifdef __AVX2__
+#define SSE_BITS_STR			"256/256 "
+#else
+#define SSE_BITS_STR			"128/128 "
+#endif
+
+#include "sse-dispatch.h"
+
 #ifdef MD5_SSE_PARA
 void md5cryptsse(unsigned char * buf, unsigned char * salt, char * out, int md5_type);
 void SSEmd5body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags);
 #define MD5_SSE_type			SSE_type
-#define MD5_ALGORITHM_NAME		"128/128 " MD5_SSE_type " " MD5_N_STR
+#define MD5_ALGORITHM_NAME		SSE_BITS_STR MD5_SSE_type " " MD5_N_STR
 #else
 #define MD5_SSE_type			"1x"
 #define MD5_ALGORITHM_NAME		"32/" ARCH_BITS_STR
@@ -56,7 +74,7 @@ void SSEmd5body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, un
 //void SSEmd4body(__m128i* data, unsigned int * out, int init);
 void SSEmd4body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags);
 #define MD4_SSE_type			SSE_type
-#define MD4_ALGORITHM_NAME		"128/128 " MD4_SSE_type " " MD4_N_STR
+#define MD4_ALGORITHM_NAME		SSE_BITS_STR MD4_SSE_type " " MD4_N_STR
 #else
 #define MD4_SSE_type			"1x"
 #define MD4_ALGORITHM_NAME		"32/" ARCH_BITS_STR
@@ -65,7 +83,7 @@ void SSEmd4body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, un
 #ifdef SHA1_SSE_PARA
 void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags);
 #define SHA1_SSE_type			SSE_type
-#define SHA1_ALGORITHM_NAME		"128/128 " SHA1_SSE_type " " SHA1_N_STR
+#define SHA1_ALGORITHM_NAME		SSE_BITS_STR SHA1_SSE_type " " SHA1_N_STR
 #else
 #define SHA1_SSE_type			"1x"
 #define SHA1_ALGORITHM_NAME		"32/" ARCH_BITS_STR
@@ -73,7 +91,9 @@ void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, u
 
 // code for SHA256 and SHA512 (from rawSHA256_ng_fmt.c and rawSHA512_ng_fmt.c)
 
-#if defined __XOP__
+#if defined __AVX2__
+#define SIMD_TYPE                 "AVX2"
+#elif defined __XOP__
 #define SIMD_TYPE                 "XOP"
 #elif defined __SSE4_1__
 #define SIMD_TYPE                 "SSE4.1"
@@ -87,20 +107,31 @@ void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, u
 #if MMX_COEF==4
 
 #ifdef MMX_COEF_SHA256
-#define SHA256_ALGORITHM_NAME	"128/128 " SIMD_TYPE " " STRINGIZE(MMX_COEF_SHA256)"x"
+#define SHA256_ALGORITHM_NAME	SSE_BITS_STR SIMD_TYPE " " STRINGIZE(MMX_COEF_SHA256)"x"
 void SSESHA256body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags);
 #define SHA256_BUF_SIZ 16
 #define SHA256_SSE_PARA 1
 #endif
 
 #ifdef MMX_COEF_SHA512
-#define SHA512_ALGORITHM_NAME	"128/128 " SIMD_TYPE " " STRINGIZE(MMX_COEF_SHA512)"x"
+#define SHA512_ALGORITHM_NAME	SSE_BITS_STR SIMD_TYPE " " STRINGIZE(MMX_COEF_SHA512)"x"
 void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state, unsigned SSEi_flags);
 // ????  (16 long longs).
 #define SHA512_BUF_SIZ 16
 #define SHA512_SSE_PARA 1
 #endif
 
+#ifdef MMX_COEF_RIPEMD160
+#define RIPEMD160_ALGORITHM_NAME	SSE_BITS_STR SIMD_TYPE " " STRINGIZE(MMX_COEF_RIPEMD160)"x"
+void SSERIPEMD160body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags);
+#define RIPEMD160_BUF_SIZ 16
+#endif
+
+#ifdef MMX_COEF_WHIRLPOOL
+#define WHIRLPOOL_ALGORITHM_NAME	SSE_BITS_STR SIMD_TYPE " " STRINGIZE(MMX_COEF_WHIRLPOOL)"x"
+void SSEWHIRLPOOLbody(unsigned char *data, unsigned char *out, unsigned char *reload_state);
+#endif
+
 #endif
 
 #endif // __JTR_SSE_INTRINSICS_H__
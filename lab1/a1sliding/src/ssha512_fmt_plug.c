@@ -28,12 +28,19 @@ john_register_one(&fmt_saltedsha2);
 #include "common.h"
 #include "sha2.h"
 #include "base64.h"
+#include "sha512_sse.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL                    "SSHA512"
 #define FORMAT_NAME                     "LDAP"
 
-#define ALGORITHM_NAME                  "32/" ARCH_BITS_STR " " SHA2_LIB
+#ifdef MMX_COEF_SHA512
+#define ALGORITHM_NAME                  "SHA512 " SHA512_ALGORITHM_NAME
+#elif ARCH_BITS >= 64
+#define ALGORITHM_NAME                  "SHA512 64/" ARCH_BITS_STR " " SHA2_LIB
+#else
+#define ALGORITHM_NAME                  "SHA512 32/" ARCH_BITS_STR " " SHA2_LIB
+#endif
 
 #define BENCHMARK_COMMENT               ""
 #define BENCHMARK_LENGTH                0
@@ -48,7 +55,11 @@ john_register_one(&fmt_saltedsha2);
 #define CIPHERTEXT_LENGTH               ((BINARY_SIZE + 1 + MAX_SALT_LEN + 2) / 3 * 4)
 
 #define MIN_KEYS_PER_CRYPT              1
+#ifdef MMX_COEF_SHA512
+#define MAX_KEYS_PER_CRYPT              MMX_COEF_SHA512
+#else
 #define MAX_KEYS_PER_CRYPT              1
+#endif
 
 #define NSLDAP_MAGIC "{SSHA512}"
 #define NSLDAP_MAGIC_LENGTH (sizeof(NSLDAP_MAGIC) - 1)
@@ -70,12 +81,19 @@ static struct fmt_tests tests[] = {
 	{"{SSHA512}SCMmLlStPIxVtJc8Y6REiGTMsgSEFF7xVQFoYZYg39H0nEeDuK/fWxxNZCdSYlRgJK3U3q0lYTka3Nre2CjXzeNUjbvHabYP", "password"},
 	{"{SSHA512}WucBQuH6NyeRYMz6gHQddkJLwzTUXaf8Ag0n9YM0drMFHG9XCO+FllvvwjXmo5/yFPvs+n1JVvJmdsvX5XHYvSUn9Xw=", "test123"},
 	{"{SSHA512}uURShqzuCx/8BKVrc4HkTpYnv2eVfwEzg+Zi2AbsTQaIV7Xo6pDhRAZnp70h5P8MC6XyotrB2f27aLhhRj4GYrkJSFmbKmuF", "testpass"},
+	{"{SSHA512}VKjY2BpULiXwo+6uaFzUBu4ZnTvz7oEzehwHpOUR8650YXHFbgGNncf6D61S9v6UkrVcynpJgtvph85x9UqCOjAxMjM0NTY3ODlhYmNkZWY=", "123456789012345678901234567890123456789"},
 	{NULL}
 };
 
 static unsigned char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static int *saved_len;
+#ifdef MMX_COEF_SHA512
+static ARCH_WORD_64 (*crypt_key)[8*MMX_COEF_SHA512];
+#define HASH_WORD(index, i)	((ARCH_WORD_64 *)crypt_key)[SHA512_SSE_OUT(index, i)]
+#else
 static ARCH_WORD_32 (*crypt_key)[BINARY_SIZE / 4];
+#define HASH_WORD(index, i)	crypt_key[index][i]
+#endif
 
 static void init(struct fmt_main *self)
 {
@@ -89,7 +107,11 @@ static void init(struct fmt_main *self)
 #endif
 	saved_key = mem_calloc_tiny(sizeof(*saved_key) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	saved_len = mem_calloc_tiny(sizeof(*saved_len) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+#ifdef MMX_COEF_SHA512
+	crypt_key = mem_calloc_tiny(sizeof(*crypt_key) * self->params.max_keys_per_crypt / MMX_COEF_SHA512, MEM_ALIGN_SIMD);
+#else
 	crypt_key = mem_calloc_tiny(sizeof(*crypt_key) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+#endif
 }
 
 static void * binary(char *ciphertext) {
@@ -100,6 +122,9 @@ static void * binary(char *ciphertext) {
 	ciphertext += NSLDAP_MAGIC_LENGTH;
 	memset(realcipher, 0, BINARY_SIZE);
 	base64_decode(ciphertext, strlen(ciphertext), realcipher);
+#ifdef MMX_COEF_SHA512
+	alter_endianity_to_BE64(realcipher, BINARY_SIZE / 8);
+#endif
 	return (void*)realcipher;
 }
 
@@ -163,14 +188,27 @@ static int cmp_all(void *binary, int count) {
 	int index;
 
 	for (index = 0; index < count; index++)
+#ifdef MMX_COEF_SHA512
+		if (((ARCH_WORD_64*)binary)[0] == HASH_WORD(index, 0))
+#else
 		if (((ARCH_WORD_32*)binary)[0] == crypt_key[index][0])
+#endif
 			return 1;
 	return 0;
 }
 
 static int cmp_one(void *binary, int index)
 {
+#ifdef MMX_COEF_SHA512
+	int i;
+
+	for (i = 0; i < BINARY_SIZE / 8; i++)
+		if (((ARCH_WORD_64*)binary)[i] != HASH_WORD(index, i))
+			return 0;
+	return 1;
+#else
 	return !memcmp(binary, crypt_key[index], BINARY_SIZE);
+#endif
 }
 
 static int cmp_exact(char *source, int count){
@@ -185,7 +223,26 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
 	int index;
+#ifdef MMX_COEF_SHA512
+	int loops = (count + MMX_COEF_SHA512 - 1) / MMX_COEF_SHA512;
 
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < loops; index++) {
+		JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_64 buf[SHA512_BUF_SIZ*MMX_COEF_SHA512];
+		int i;
+
+		for (i = 0; i < MMX_COEF_SHA512; i++) {
+			int k = index * MMX_COEF_SHA512 + i;
+
+			sha512_sse_load(buf, i, saved_key[k], saved_len[k],
+			                saved_salt->data.c, saved_salt->len);
+		}
+		SSESHA512body((__m128i *)buf, crypt_key[index], NULL,
+		              SSEi_MIXED_IN);
+	}
+#else
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
@@ -197,16 +254,17 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		SHA512_Update(&ctx, saved_salt->data.c, saved_salt->len);
 		SHA512_Final((unsigned char*)crypt_key[index], &ctx);
 	}
+#endif
 	return count;
 }
 
-static int get_hash_0(int index) { return ((ARCH_WORD_32*)crypt_key[index])[0] & 0xf; }
-static int get_hash_1(int index) { return ((ARCH_WORD_32*)crypt_key[index])[0] & 0xff; }
-static int get_hash_2(int index) { return ((ARCH_WORD_32*)crypt_key[index])[0] & 0xfff; }
-static int get_hash_3(int index) { return ((ARCH_WORD_32*)crypt_key[index])[0] & 0xffff; }
-static int get_hash_4(int index) { return ((ARCH_WORD_32*)crypt_key[index])[0] & 0xfffff; }
-static int get_hash_5(int index) { return ((ARCH_WORD_32*)crypt_key[index])[0] & 0xffffff; }
-static int get_hash_6(int index) { return ((ARCH_WORD_32*)crypt_key[index])[0] & 0x7ffffff; }
+static int get_hash_0(int index) { return HASH_WORD(index, 0) & 0xf; }
+static int get_hash_1(int index) { return HASH_WORD(index, 0) & 0xff; }
+static int get_hash_2(int index) { return HASH_WORD(index, 0) & 0xfff; }
+static int get_hash_3(int index) { return HASH_WORD(index, 0) & 0xffff; }
+static int get_hash_4(int index) { return HASH_WORD(index, 0) & 0xfffff; }
+static int get_hash_5(int index) { return HASH_WORD(index, 0) & 0xffffff; }
+static int get_hash_6(int index) { return HASH_WORD(index, 0) & 0x7ffffff; }
 
 static int salt_hash(void *salt)
 {
@@ -0,0 +1,241 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Self-test result cache, see testcache.h.
+ *
+ * The file is a cache file (see cachefile.h) with one line per format that
+ * passed, holding the key and the label of the format (for the curious only).
+ * It is read into memory once, and concurrent john processes at worst test a
+ * format once more than needed.
+ */
+
+#if AC_BUILT
+#include "autoconfig.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#define TESTCACHE_CPUID			1
+#endif
+
+#include "arch.h"
+#include "misc.h"
+#include "params.h"
+#include "path.h"
+#include "memory.h"
+#include "options.h"
+#include "config.h"
+#include "bench.h"
+#include "john.h"
+#include "testcache.h"
+#include "cachefile.h"
+#include "john_build_rule.h"
+#include "memdbg.h"
+
+static char *tc_name;
+static int tc_state;		/* 0 - not read yet, 1 - read, -1 - disabled */
+static uint64_t *tc_keys;
+static int tc_count, tc_size;
+
+/* The key of the format last looked up, if the cache applies to it */
+static struct fmt_main *tc_format;
+static uint64_t tc_key;
+static int tc_hit;
+
+/*
+ * Adds what this run of john is: the build, the executable and the CPU.
+ * Returns zero if the executable can't be told apart from a rebuild.
+ */
+static int tc_add_build(uint64_t *hash)
+{
+	struct stat st;
+	char *exe;
+
+#ifdef __linux__
+	exe = "/proc/self/exe";
+#else
+	exe = path_expand("$JOHN/john");
+#endif
+	if (stat(exe, &st))
+		return 0;
+
+	cachefile_hash_str(hash, JOHN_VERSION);
+	cachefile_hash_str(hash, JOHN_BLD);
+	cachefile_hash_str(hash, __DATE__ " " __TIME__);
+	cachefile_hash_int(hash, st.st_size);
+	cachefile_hash_int(hash, st.st_mtime);
+
+#ifdef TESTCACHE_CPUID
+	{
+		unsigned int eax, ebx, ecx, edx;
+
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+			cachefile_hash_int(hash, eax);
+			cachefile_hash_int(hash, ((uint64_t)ecx << 32) | edx);
+		}
+		if (__get_cpuid_max(0, NULL) >= 7) {
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			cachefile_hash_int(hash, ((uint64_t)ecx << 32) | ebx);
+		}
+	}
+#endif
+
+	return 1;
+}
+
+/*
+ * Adds the format's parameters and test vectors, and the options that change
+ * how the format is initialized or tested.
+ */
+static void tc_add_format(uint64_t *hash, struct fmt_main *format)
+{
+	struct fmt_tests *current;
+	int index;
+
+	cachefile_hash_str(hash, format->params.label);
+	cachefile_hash_str(hash, format->params.format_name);
+	cachefile_hash_str(hash, format->params.algorithm_name);
+	cachefile_hash_int(hash, format->params.plaintext_length);
+	cachefile_hash_int(hash, format->params.binary_size);
+	cachefile_hash_int(hash, format->params.salt_size);
+	cachefile_hash_int(hash, format->params.min_keys_per_crypt);
+	cachefile_hash_int(hash, format->params.max_keys_per_crypt);
+	cachefile_hash_int(hash, format->params.flags);
+#if FMT_MAIN_VERSION > 11
+	for (index = 0; index < FMT_TUNABLE_COSTS; index++)
+		cachefile_hash_str(hash, format->params.tunable_cost_name[index]);
+#endif
+
+	if ((current = format->params.tests))
+	while (current->ciphertext) {
+		cachefile_hash_str(hash, current->ciphertext);
+		cachefile_hash_str(hash, current->plaintext);
+		for (index = 0; index < 10; index++)
+			cachefile_hash_str(hash, current->fields[index]);
+		current++;
+	}
+
+	cachefile_hash_int(hash, pers_opts.target_enc);
+	cachefile_hash_int(hash, pers_opts.internal_enc);
+	cachefile_hash_int(hash, options.force_maxlength);
+	cachefile_hash_int(hash, options.force_maxkeys);
+	cachefile_hash_int(hash, !!(options.flags & FLG_TEST_CHK));
+#ifdef _OPENMP
+	cachefile_hash_int(hash, omp_get_max_threads());
+#endif
+}
+
+/*
+ * Whether the self-test result of this format may be cached at all.
+ */
+static int tc_applies(struct fmt_main *format)
+{
+	char *label = format->params.label;
+
+	if (options.flags & (FLG_NOTESTS | FLG_LOOPTEST | FLG_FORCE_TESTS))
+		return 0;
+	if ((options.flags & FLG_TEST_CHK) && !benchmark_time)
+		return 0;
+
+	if (strstr(label, "-opencl") || strstr(label, "-cuda"))
+		return 0;
+/* Dynamic formats numbered 1000 and up come from the configuration files */
+	if ((format->params.flags & FMT_DYNAMIC) &&
+	    !strncmp(label, "dynamic_", 8) && atoi(&label[8]) >= 1000)
+		return 0;
+
+	return 1;
+}
+
+static void tc_read(void)
+{
+	char *name, line[LINE_BUFFER_SIZE];
+	uint64_t key;
+	FILE *file;
+
+	tc_state = -1;
+
+	name = cfg_get_param(SECTION_OPTIONS, NULL, "SelfTestCache");
+	if (!name || !*name)
+		return;
+	tc_name = str_alloc_copy(path_expand(name));
+
+	if ((file = fopen(tc_name, "r"))) {
+		while (fgets(line, sizeof(line), file)) {
+			if (!cachefile_parse(line, &key))
+				continue;
+			if (tc_count >= tc_size) {
+				tc_size = tc_size ? tc_size * 2 : 0x100;
+				if (!(tc_keys = realloc(tc_keys,
+				    tc_size * sizeof(*tc_keys))))
+					pexit("realloc");
+			}
+			tc_keys[tc_count++] = key;
+		}
+		fclose(file);
+	}
+
+	tc_state = 1;
+}
+
+int testcache_lookup(struct fmt_main *format)
+{
+	uint64_t hash = CACHEFILE_HASH_INIT;
+	int index;
+
+	tc_format = NULL;
+	tc_hit = 0;
+
+	if (format->private.initialized == 2 || !tc_applies(format))
+		return 0;
+/*
+ * The key takes the algorithm name, which for these tells which of their
+ * SIMD or scalar code init() picked
+ */
+	if ((format->params.flags & FMT_INIT_PARAMS) &&
+	    !format->private.initialized)
+		return 0;
+
+	if (!tc_state)
+		tc_read();
+	if (tc_state < 0)
+		return 0;
+
+	if (!tc_add_build(&hash))
+		return 0;
+	tc_add_format(&hash, format);
+
+	tc_format = format;
+	tc_key = hash;
+
+	for (index = 0; index < tc_count; index++)
+	if (tc_keys[index] == hash)
+		return tc_hit = 1;
+
+	return 0;
+}
+
+void testcache_store(struct fmt_main *format)
+{
+	if (format != tc_format || tc_hit)
+		return;
+	tc_format = NULL;
+
+	cachefile_append(tc_name, tc_key, format->params.label,
+	    TESTCACHE_MAX_SIZE);
+}
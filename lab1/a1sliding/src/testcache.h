@@ -0,0 +1,47 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Self-test result cache: a file listing the formats that have passed their
+ * self-test, each under a key made of the build of john (its version, build
+ * time and executable), the features of the CPU, the format's parameters and
+ * test vectors, and the options that the self-test depends on.  A format whose
+ * key is listed is only initialized the way --skip-self-tests would do it,
+ * which saves the start-up time of slow formats and of dynamic formats.
+ *
+ * The cache is the "SelfTestCache" file in john.conf, if set.  It is not used
+ * by --test=0, --stress-test and --force-self-test, nor for the GPU formats
+ * and the dynamic formats defined in the configuration files, whose behavior
+ * doesn't only depend on the key.
+ */
+
+#ifndef _JOHN_TESTCACHE_H
+#define _JOHN_TESTCACHE_H
+
+#include "formats.h"
+
+/*
+ * Grow the cache file to at most this many bytes.  It's started over when
+ * this is exceeded, such as after many rebuilds.
+ */
+#define TESTCACHE_MAX_SIZE		0x100000
+
+/*
+ * Returns non-zero if the format, which is about to be self-tested, is known
+ * to pass its self-test.  This is to be called before the format's init().
+ */
+extern int testcache_lookup(struct fmt_main *format);
+
+/*
+ * Records that the format has passed its self-test, unless testcache_lookup()
+ * wouldn't have used the cache for it.
+ */
+extern void testcache_store(struct fmt_main *format);
+
+#endif
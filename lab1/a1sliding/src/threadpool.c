@@ -0,0 +1,397 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Persistent work-stealing thread pool, see threadpool.h.
+ *
+ * A job of "count" items is cut into chunks and the chunk numbers are dealt
+ * out as one contiguous range per thread.  Each thread works its own range
+ * from the bottom; a thread that runs dry steals the upper half of another
+ * thread's remaining range.  Ranges are protected by a per-thread mutex, which
+ * is only ever contended while stealing.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "arch.h"
+#include "misc.h"
+#include "memory.h"
+#include "affinity.h"
+#include "threadpool.h"
+
+#if defined(_OPENMP) && !defined(_MSC_VER) && (!AC_BUILT || HAVE_PTHREAD)
+#define TPOOL_PTHREADS 1
+#include <omp.h>
+#include <pthread.h>
+#include <sys/types.h>
+#if !AC_BUILT || HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#endif
+
+#include "memdbg.h"
+
+/*
+ * Number of chunks per thread when the caller passes a chunk size of 0.
+ * More chunks give finer balancing at the cost of more queue operations.
+ */
+#define TPOOL_CHUNKS_PER_THREAD		8
+
+#ifdef TPOOL_PTHREADS
+
+/*
+ * Number of polls of the job generation before an idle worker goes to sleep
+ * on the condition variable.  This keeps the wake-up latency low for formats
+ * that call us many times per second (one job per salt).
+ */
+#define TPOOL_SPIN			4096
+
+struct tpool_queue {
+	pthread_mutex_t lock;
+	int next, end;
+};
+
+/* Keep each thread's queue on its own cache line */
+union tpool_slot {
+	struct tpool_queue q;
+	char pad[(sizeof(struct tpool_queue) + 63) & ~63];
+};
+
+static union tpool_slot *queues;
+static int queues_size;
+static pthread_t *workers;
+static pthread_key_t self_key;
+static int key_created, nthreads, started, running, in_job;
+static pid_t owner;
+
+static pthread_mutex_t pool_lock;
+static pthread_cond_t work_cond, done_cond;
+
+static volatile unsigned int generation;
+static volatile int quit;
+static volatile int busy;	/* Workers still inside the current job */
+static volatile int pending;	/* Chunks not yet completed */
+
+static tpool_fn job_fn;
+static void *job_arg;
+static int job_count, job_chunk;
+
+static int take_chunk(int self, int *chunk)
+{
+	struct tpool_queue *q = &queues[self].q;
+	int i;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->next < q->end) {
+		*chunk = q->next++;
+		pthread_mutex_unlock(&q->lock);
+		return 1;
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	for (i = 1; i < nthreads; i++) {
+		struct tpool_queue *victim = &queues[(self + i) % nthreads].q;
+		int first, last;
+
+		if (victim->next >= victim->end)
+			continue;
+
+		pthread_mutex_lock(&victim->lock);
+		if (victim->next >= victim->end) {
+			pthread_mutex_unlock(&victim->lock);
+			continue;
+		}
+		last = victim->end;
+		first = last - (last - victim->next + 1) / 2;
+		victim->end = first;
+		pthread_mutex_unlock(&victim->lock);
+
+		*chunk = first++;
+		if (first < last) {
+			pthread_mutex_lock(&q->lock);
+			q->next = first;
+			q->end = last;
+			pthread_mutex_unlock(&q->lock);
+		}
+		return 1;
+	}
+
+	return 0;
+}
+
+static void run_chunks(int self)
+{
+	int chunk;
+
+	while (take_chunk(self, &chunk)) {
+		int start = chunk * job_chunk;
+		int end = start + job_chunk;
+
+		if (end > job_count)
+			end = job_count;
+		job_fn(start, end, self, job_arg);
+
+		if (__sync_sub_and_fetch(&pending, 1) == 0) {
+			pthread_mutex_lock(&pool_lock);
+			pthread_cond_broadcast(&done_cond);
+			pthread_mutex_unlock(&pool_lock);
+		}
+	}
+}
+
+static void *worker(void *arg)
+{
+	int self = (int)(size_t)arg;
+	unsigned int seen = 0;
+
+	pthread_setspecific(self_key, arg);
+	affinity_bind_thread(self);
+
+	while (1) {
+		int spin = TPOOL_SPIN;
+
+		while (generation == seen && !quit && --spin)
+			;
+		if (generation == seen && !quit) {
+			pthread_mutex_lock(&pool_lock);
+			while (generation == seen && !quit)
+				pthread_cond_wait(&work_cond, &pool_lock);
+			pthread_mutex_unlock(&pool_lock);
+		}
+		if (quit)
+			break;
+
+		seen = generation;
+		__sync_synchronize();
+		run_chunks(self);
+
+		if (__sync_sub_and_fetch(&busy, 1) == 0) {
+			pthread_mutex_lock(&pool_lock);
+			pthread_cond_broadcast(&done_cond);
+			pthread_mutex_unlock(&pool_lock);
+		}
+	}
+
+	return NULL;
+}
+
+void tpool_init(int threads)
+{
+	int i, ret;
+
+	if (threads <= 0)
+		threads = omp_get_max_threads();
+
+	if (started && owner == getpid()) {
+		if (threads == nthreads)
+			return;
+		tpool_done();
+	}
+
+	/*
+	 * Either first use, or we're a child of fork() and the threads we
+	 * think we have are the parent's.  Start from scratch.
+	 */
+	nthreads = threads;
+	owner = getpid();
+	started = 1;
+	running = in_job = 0;
+	quit = 0;
+	generation = 0;
+
+	pthread_mutex_init(&pool_lock, NULL);
+	pthread_cond_init(&work_cond, NULL);
+	pthread_cond_init(&done_cond, NULL);
+	if (!key_created) {
+		pthread_key_create(&self_key, NULL);
+		key_created = 1;
+	}
+
+	/* Kept across re-inits (and inherited across fork()), grown if need be */
+	if (nthreads > queues_size) {
+		queues = mem_alloc_tiny(sizeof(*queues) * nthreads,
+		    MEM_ALIGN_CACHE);
+		queues_size = nthreads;
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_mutex_init(&queues[i].q.lock, NULL);
+		queues[i].q.next = queues[i].q.end = 0;
+	}
+	pthread_setspecific(self_key, (void*)0);
+
+	if (nthreads < 2) {
+		workers = NULL;
+		return;
+	}
+
+	workers = mem_alloc(sizeof(*workers) * nthreads);
+	for (i = 1; i < nthreads; i++)
+	if ((ret = pthread_create(&workers[i], NULL, worker,
+	    (void*)(size_t)i))) {
+		errno = ret;
+		pexit("pthread_create");
+	}
+}
+
+int tpool_threads(void)
+{
+	if (!started || owner != getpid())
+		tpool_init(0);
+
+	return nthreads;
+}
+
+static void run_serial(int count, int chunk, tpool_fn fn, void *arg)
+{
+	int self = (int)(size_t)pthread_getspecific(self_key);
+	int start;
+
+	if (!chunk)
+		chunk = count;
+	for (start = 0; start < count; start += chunk)
+		fn(start, start + chunk < count ? start + chunk : count,
+		   self, arg);
+}
+
+void tpool_submit(int count, int chunk, tpool_fn fn, void *arg)
+{
+	int nchunks, i;
+
+	if (!started || owner != getpid())
+		tpool_init(0);
+
+	if (count <= 0)
+		return;
+
+	if (nthreads < 2 || in_job) {
+		run_serial(count, chunk, fn, arg);
+		return;
+	}
+
+	if (!chunk)
+		chunk = (count + nthreads * TPOOL_CHUNKS_PER_THREAD - 1) /
+			(nthreads * TPOOL_CHUNKS_PER_THREAD);
+	nchunks = (count + chunk - 1) / chunk;
+
+	job_fn = fn;
+	job_arg = arg;
+	job_count = count;
+	job_chunk = chunk;
+
+	for (i = 0; i < nthreads; i++) {
+		struct tpool_queue *q = &queues[i].q;
+
+		pthread_mutex_lock(&q->lock);
+		q->next = (int)((long long)nchunks * i / nthreads);
+		q->end = (int)((long long)nchunks * (i + 1) / nthreads);
+		pthread_mutex_unlock(&q->lock);
+	}
+
+	pending = nchunks;
+	busy = nthreads - 1;
+	running = in_job = 1;
+	__sync_synchronize();
+
+	pthread_mutex_lock(&pool_lock);
+	generation++;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+void tpool_wait(void)
+{
+	if (!running)
+		return;
+
+	pthread_mutex_lock(&pool_lock);
+	while (pending || busy)
+		pthread_cond_wait(&done_cond, &pool_lock);
+	pthread_mutex_unlock(&pool_lock);
+
+	running = in_job = 0;
+}
+
+void tpool_for(int count, int chunk, tpool_fn fn, void *arg)
+{
+	if (!started || owner != getpid())
+		tpool_init(0);
+
+	if (nthreads < 2 || in_job) {
+		if (count > 0)
+			run_serial(count, chunk, fn, arg);
+		return;
+	}
+
+	tpool_submit(count, chunk, fn, arg);
+	run_chunks(0);
+	tpool_wait();
+}
+
+void tpool_done(void)
+{
+	int i;
+
+	if (!started || owner != getpid()) {
+		started = 0;
+		return;
+	}
+
+	tpool_wait();
+
+	pthread_mutex_lock(&pool_lock);
+	quit = 1;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&pool_lock);
+
+	for (i = 1; i < nthreads; i++)
+		pthread_join(workers[i], NULL);
+	MEM_FREE(workers);
+
+	started = 0;
+}
+
+#else /* !TPOOL_PTHREADS: everything is done by the caller */
+
+void tpool_init(int threads)
+{
+}
+
+int tpool_threads(void)
+{
+	return 1;
+}
+
+void tpool_submit(int count, int chunk, tpool_fn fn, void *arg)
+{
+	int start;
+
+	if (count <= 0)
+		return;
+	if (!chunk)
+		chunk = count;
+	for (start = 0; start < count; start += chunk)
+		fn(start, start + chunk < count ? start + chunk : count, 0, arg);
+}
+
+void tpool_wait(void)
+{
+}
+
+void tpool_for(int count, int chunk, tpool_fn fn, void *arg)
+{
+	tpool_submit(count, chunk, fn, arg);
+}
+
+void tpool_done(void)
+{
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * This file is part of John the Ripper password cracker.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * There's ABSOLUTELY NO WARRANTY, express or implied.
+ */
+
+/*
+ * Persistent work-stealing thread pool.
+ *
+ * Formats (and anything else that wants to) may hand chunked work to this
+ * pool instead of opening an OpenMP parallel region per crypt_all() call.
+ * The worker threads are created once and are kept around between calls, so
+ * there's no fork/join cost per salt, and uneven work items (e.g. archives
+ * where most candidates are rejected early) are balanced by idle threads
+ * stealing chunks from busy ones.
+ *
+ * The pool is sized after omp_get_max_threads() and is only multi-threaded
+ * in OpenMP-enabled builds; otherwise all work is done in the caller.
+ */
+
+#ifndef _JOHN_THREADPOOL_H
+#define _JOHN_THREADPOOL_H
+
+/*
+ * Work callback: process items [start, end).  "thread" is in the range
+ * 0 to tpool_threads() - 1 and is unique among concurrently running
+ * callbacks, so it may be used to index per-thread scratch buffers.
+ */
+typedef void (*tpool_fn)(int start, int end, int thread, void *arg);
+
+/*
+ * Starts the pool with "threads" threads (including the caller), or with
+ * omp_get_max_threads() threads if "threads" is 0.  Calling this is
+ * optional; the pool is started on first use.  A pool inherited across
+ * fork() is re-created in the child.
+ */
+extern void tpool_init(int threads);
+
+/*
+ * Returns the number of threads the pool will use.
+ */
+extern int tpool_threads(void);
+
+/*
+ * Queues "count" items, in chunks of "chunk" items (0 for automatic), to be
+ * processed by the pool threads, and returns without waiting (a pool of one
+ * thread does the work before returning).  Only one job may be in flight at
+ * a time; tpool_wait() must be called before the next tpool_submit() or
+ * tpool_for().
+ */
+extern void tpool_submit(int count, int chunk, tpool_fn fn, void *arg);
+
+/*
+ * Waits for the job queued by tpool_submit() to complete.
+ */
+extern void tpool_wait(void);
+
+/*
+ * Processes "count" items with "fn", with the calling thread taking part
+ * in the work, and returns when all of them are done.  This is the drop-in
+ * replacement for a "#pragma omp parallel for" loop.  Nested calls (from
+ * within a callback) are run serially by the calling thread.
+ */
+extern void tpool_for(int count, int chunk, tpool_fn fn, void *arg);
+
+/*
+ * Stops and joins the worker threads.
+ */
+extern void tpool_done(void);
+
+#endif
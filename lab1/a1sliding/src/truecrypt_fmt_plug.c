@@ -50,6 +50,9 @@ john_register_one(&fmt_truecrypt_whirlpool);
 #include "formats.h"
 #include "crc32.h"
 #define PBKDF2_HMAC_SHA512_ALSO_INCLUDE_CTX
+#define PBKDF2_HMAC_SHA512_SSE_LOADED
+#define PBKDF2_HMAC_RIPEMD160_SSE_LOADED
+#define PBKDF2_HMAC_WHIRLPOOL_SSE_LOADED
 #include "pbkdf2_hmac_sha512.h"
 #include "pbkdf2_hmac_ripemd160.h"
 #include "pbkdf2_hmac_whirlpool.h"
@@ -66,11 +69,67 @@ john_register_one(&fmt_truecrypt_whirlpool);
 #define SALT_ALIGN		4
 #define BINARY_SIZE		0
 #define BINARY_ALIGN		1
-#define MIN_KEYS_PER_CRYPT	1
-#define MAX_KEYS_PER_CRYPT	1
+/*
+ * Each format hashes its keys in groups that fill the SIMD PBKDF2 of its
+ * PRF.  tc_aes_xts runs all three, so it takes the largest group, which the
+ * other two divide as the lane counts are powers of 2.  That is Whirlpool's
+ * (a key per byte of a vector) when it has SIMD at all, and tc_aes_xts is
+ * named after that widest PRF.
+ */
+#if SSE_GROUP_SZ_SHA512
+#define KEYS_SHA512		SSE_GROUP_SZ_SHA512
+#else
+#define KEYS_SHA512		1
+#endif
+#if SSE_GROUP_SZ_RIPEMD160
+#define KEYS_RIPEMD160		SSE_GROUP_SZ_RIPEMD160
+#else
+#define KEYS_RIPEMD160		1
+#endif
+#if SSE_GROUP_SZ_WHIRLPOOL
+#define KEYS_WHIRLPOOL		SSE_GROUP_SZ_WHIRLPOOL
+#else
+#define KEYS_WHIRLPOOL		1
+#endif
+#if SSE_GROUP_SZ_WHIRLPOOL
+#define KEYS_ALL		SSE_GROUP_SZ_WHIRLPOOL
+#define ALGORITHM_NAME_ALL	WHIRLPOOL_ALGORITHM_NAME
+#elif SSE_GROUP_SZ_RIPEMD160 > SSE_GROUP_SZ_SHA512
+#define KEYS_ALL		SSE_GROUP_SZ_RIPEMD160
+#define ALGORITHM_NAME_ALL	RIPEMD160_ALGORITHM_NAME
+#elif SSE_GROUP_SZ_SHA512
+#define KEYS_ALL		SSE_GROUP_SZ_SHA512
+#define ALGORITHM_NAME_ALL	SHA512_ALGORITHM_NAME
+#else
+#define KEYS_ALL		1
+#if ARCH_BITS >= 64
+#define ALGORITHM_NAME_ALL	"64/" ARCH_BITS_STR
+#else
+#define ALGORITHM_NAME_ALL	"32/" ARCH_BITS_STR
+#endif
+#endif
+
+/* The SIMD Whirlpool needs the sph contexts, even when the scalar one is oSSL */
+#if SSE_GROUP_SZ_WHIRLPOOL
+#define WHIRLPOOL_PAD_CTX		sph_whirlpool_context
+#define WHIRLPOOL_PAD_Init(a)		sph_whirlpool_init(a)
+#define WHIRLPOOL_PAD_Update(a,b,c)	sph_whirlpool(a,b,c)
+#else
+#define WHIRLPOOL_PAD_CTX		WHIRLPOOL_CTX
+#define WHIRLPOOL_PAD_Init(a)		WHIRLPOOL_Init(a)
+#define WHIRLPOOL_PAD_Update(a,b,c)	WHIRLPOOL_Update(a,b,c)
+#endif
 
 static unsigned char (*key_buffer)[PLAINTEXT_LENGTH + 1];
-static unsigned char (*first_block_dec)[16];
+static int *cracked;
+/* The loaded HMAC ipad/opad contexts of each key, see precompute() */
+static SHA512_CTX *sha512_ipad, *sha512_opad;
+static sph_ripemd160_context *ripemd160_ipad, *ripemd160_opad;
+static WHIRLPOOL_PAD_CTX *whirlpool_ipad, *whirlpool_opad;
+/* Keys with their contexts up to date */
+static int precomputed;
+/* The PRFs (1 << IS_xxx) the format runs, and its keys per group */
+static int format_prfs, keys_per_group;
 
 #define TAG_WHIRLPOOL "truecrypt_WHIRLPOOL$"
 #define TAG_SHA512    "truecrypt_SHA_512$"
@@ -83,11 +142,12 @@ static unsigned char (*first_block_dec)[16];
 #define IS_RIPEMD160 2
 #define IS_WHIRLPOOL 3
 
+#define ITERATIONS		1000
+#define ITERATIONS_RIPEMD160	2000
+
 struct cust_salt {
 	unsigned char salt[64];
 	unsigned char bin[512-64];
-	int loop_inc;
-	int num_iterations;
 	int hash_type;
 } *psalt;
 
@@ -118,18 +178,53 @@ static struct fmt_tests tests_all[] = {
 	{NULL}
 };
 
-static void init(struct fmt_main *self)
+static void init(struct fmt_main *self, int prfs)
 {
+	int count;
 #ifdef _OPENMP
 	int omp_t = omp_get_max_threads();
+#endif
+
+	format_prfs = prfs;
+	keys_per_group = self->params.min_keys_per_crypt;
+#ifdef _OPENMP
 	self->params.min_keys_per_crypt *= omp_t;
 	omp_t *= OMP_SCALE;
 	self->params.max_keys_per_crypt *= omp_t;
 #endif
-	key_buffer = mem_calloc_tiny(sizeof(*key_buffer) *
-			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
-	first_block_dec = mem_calloc_tiny(sizeof(*first_block_dec) *
-			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	count = self->params.max_keys_per_crypt;
+	key_buffer = mem_calloc_tiny(sizeof(*key_buffer) * count, MEM_ALIGN_WORD);
+	cracked = mem_calloc_tiny(sizeof(*cracked) * count, MEM_ALIGN_WORD);
+	if (prfs & (1 << IS_SHA512)) {
+		sha512_ipad = mem_calloc_tiny(sizeof(*sha512_ipad) * count, MEM_ALIGN_WORD);
+		sha512_opad = mem_calloc_tiny(sizeof(*sha512_opad) * count, MEM_ALIGN_WORD);
+	}
+	if (prfs & (1 << IS_RIPEMD160)) {
+		ripemd160_ipad = mem_calloc_tiny(sizeof(*ripemd160_ipad) * count, MEM_ALIGN_WORD);
+		ripemd160_opad = mem_calloc_tiny(sizeof(*ripemd160_opad) * count, MEM_ALIGN_WORD);
+	}
+	if (prfs & (1 << IS_WHIRLPOOL)) {
+		whirlpool_ipad = mem_calloc_tiny(sizeof(*whirlpool_ipad) * count, MEM_ALIGN_WORD);
+		whirlpool_opad = mem_calloc_tiny(sizeof(*whirlpool_opad) * count, MEM_ALIGN_WORD);
+	}
+	precomputed = 0;
+}
+
+static void init_all(struct fmt_main *self)
+{
+	init(self, (1 << IS_SHA512) | (1 << IS_RIPEMD160) | (1 << IS_WHIRLPOOL));
+}
+static void init_ripemd160(struct fmt_main *self)
+{
+	init(self, 1 << IS_RIPEMD160);
+}
+static void init_sha512(struct fmt_main *self)
+{
+	init(self, 1 << IS_SHA512);
+}
+static void init_whirlpool(struct fmt_main *self)
+{
+	init(self, 1 << IS_WHIRLPOOL);
 }
 
 static char *prepare(char *split_fields[10], struct fmt_main *self)
@@ -199,32 +294,31 @@ static void set_salt(void *salt)
 	psalt = salt;
 }
 
+// returns the IS_xxx of the tag, and skips it
+static int get_prf(char **ciphertext)
+{
+	if (!strncmp(*ciphertext, TAG_WHIRLPOOL, TAG_WHIRLPOOL_LEN)) {
+		*ciphertext += TAG_WHIRLPOOL_LEN;
+		return IS_WHIRLPOOL;
+	} else if (!strncmp(*ciphertext, TAG_SHA512, TAG_SHA512_LEN)) {
+		*ciphertext += TAG_SHA512_LEN;
+		return IS_SHA512;
+	} else if (!strncmp(*ciphertext, TAG_RIPEMD160, TAG_RIPEMD160_LEN)) {
+		*ciphertext += TAG_RIPEMD160_LEN;
+		return IS_RIPEMD160;
+	}
+	// should never get here!  valid() should catch all lines that do not have the tags.
+	fprintf(stderr, "Error, unknown type in truecrypt::get_prf(), [%s]\n", *ciphertext);
+	exit(0);
+}
+
 static void* get_salt(char *ciphertext)
 {
 	static char buf[sizeof(struct cust_salt)+4];
 	struct cust_salt *s = (struct cust_salt *)mem_align(buf, 4);
 	unsigned int i;
 
-	s->num_iterations = 1000;
-	s->loop_inc = 1;
-	if (!strncmp(ciphertext, TAG_WHIRLPOOL, TAG_WHIRLPOOL_LEN)) {
-		ciphertext += TAG_WHIRLPOOL_LEN;
-		s->hash_type = IS_WHIRLPOOL;
-	} else if (!strncmp(ciphertext, TAG_SHA512, TAG_SHA512_LEN)) {
-		ciphertext += TAG_SHA512_LEN;
-		s->hash_type = IS_SHA512;
-#if SSE_GROUP_SZ_SHA512
-		s->loop_inc = SSE_GROUP_SZ_SHA512;
-#endif
-	} else if (!strncmp(ciphertext, TAG_RIPEMD160, TAG_RIPEMD160_LEN)) {
-		ciphertext += TAG_RIPEMD160_LEN;
-		s->hash_type = IS_RIPEMD160;
-		s->num_iterations = 2000;
-	} else {
-		// should never get here!  valid() should catch all lines that do not have the tags.
-		fprintf(stderr, "Error, unknown type in truecrypt::get_salt(), [%s]\n", ciphertext);
-		exit(0);
-	}
+	s->hash_type = get_prf(&ciphertext);
 
 	// Convert the hexadecimal salt in binary
 	for(i = 0; i < 64; i++)
@@ -281,49 +375,106 @@ static void AES_256_XTS_first_sector(const unsigned char *double_key, unsigned c
 		out += 16;
 	}
 }
+
+/*
+ * Loads the HMAC ipad/opad contexts of the PRFs the format runs.  They only
+ * depend on the key, so this is done once per key rather than for every
+ * salt.  The pads are built once for all three PRFs: keys are at most 64
+ * bytes so they are never hashed down first, and the 64 byte pads of
+ * RIPEMD-160 and Whirlpool (see pbkdf2_hmac_whirlpool.h) are the start of
+ * the 128 byte ones of SHA-512.
+ */
+static void precompute(int count)
+{
+	int index;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = precomputed; index < count; index++) {
+		unsigned char ipad[SHA512_CBLOCK], opad[SHA512_CBLOCK];
+		int i, len = strlen((char*)(key_buffer[index]));
+
+		memset(ipad, 0x36, SHA512_CBLOCK);
+		memset(opad, 0x5C, SHA512_CBLOCK);
+		for (i = 0; i < len; i++) {
+			ipad[i] ^= key_buffer[index][i];
+			opad[i] ^= key_buffer[index][i];
+		}
+
+		if (format_prfs & (1 << IS_SHA512)) {
+			SHA512_Init(&sha512_ipad[index]);
+			SHA512_Update(&sha512_ipad[index], ipad, SHA512_CBLOCK);
+			SHA512_Init(&sha512_opad[index]);
+			SHA512_Update(&sha512_opad[index], opad, SHA512_CBLOCK);
+		}
+		if (format_prfs & (1 << IS_RIPEMD160)) {
+			sph_ripemd160_init(&ripemd160_ipad[index]);
+			sph_ripemd160(&ripemd160_ipad[index], ipad, RIPEMD160_CBLOCK);
+			sph_ripemd160_init(&ripemd160_opad[index]);
+			sph_ripemd160(&ripemd160_opad[index], opad, RIPEMD160_CBLOCK);
+		}
+		if (format_prfs & (1 << IS_WHIRLPOOL)) {
+			WHIRLPOOL_PAD_Init(&whirlpool_ipad[index]);
+			WHIRLPOOL_PAD_Update(&whirlpool_ipad[index], ipad, WHIRLPOOL_CBLOCK);
+			WHIRLPOOL_PAD_Init(&whirlpool_opad[index]);
+			WHIRLPOOL_PAD_Update(&whirlpool_opad[index], opad, WHIRLPOOL_CBLOCK);
+		}
+	}
+	if (count > precomputed)
+		precomputed = count;
+}
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int i, count = *pcount;
 
+	// whole groups are hashed, so their keys all need the contexts
+	precompute((count + keys_per_group - 1) / keys_per_group * keys_per_group);
+
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-	for(i = 0; i < count; i+=psalt->loop_inc)
+	for(i = 0; i < count; i += keys_per_group)
 	{
-		unsigned char key[64];
+		unsigned char key[KEYS_ALL][64];
+		unsigned char *pout[KEYS_ALL];
+		unsigned char first_block_dec[16];
 		int j;
 
-#if SSE_GROUP_SZ_SHA512
-		unsigned char Keys[SSE_GROUP_SZ_SHA512][64];
+		for (j = 0; j < keys_per_group; ++j)
+			pout[j] = key[j];
+
 		if (psalt->hash_type == IS_SHA512) {
-			int lens[SSE_GROUP_SZ_SHA512];
-			unsigned char *pin[SSE_GROUP_SZ_SHA512];
-			union {
-				unsigned char *pout[SSE_GROUP_SZ_SHA512];
-				unsigned char *poutc;
-			} x;
-			for (j = 0; j < SSE_GROUP_SZ_SHA512; ++j) {
-				lens[j] = strlen((char*)(key_buffer[i+j]));
-				pin[j] = key_buffer[i+j];
-				x.pout[j] = Keys[j];
-			}
-			pbkdf2_sha512_sse((const unsigned char **)pin, lens, psalt->salt, 64, psalt->num_iterations, &(x.poutc), sizeof(key), 0);
-		}
+#if SSE_GROUP_SZ_SHA512
+			for (j = 0; j < keys_per_group; j += SSE_GROUP_SZ_SHA512)
+				pbkdf2_sha512_sse_loaded(&sha512_ipad[i+j], &sha512_opad[i+j], psalt->salt, 64, ITERATIONS, &pout[j], sizeof(key[0]), 0);
 #else
-		if (is_sha512)
-			pbkdf2_sha512((const unsigned char*)key_buffer[i], strlen(key_buffer[i]), psalt->salt, 64, num_iterations, key, sizeof(key), 0);
+			for (j = 0; j < keys_per_group; ++j)
+				pbkdf2_sha512_loaded(&sha512_ipad[i+j], &sha512_opad[i+j], psalt->salt, 64, ITERATIONS, pout[j], sizeof(key[0]), 0);
 #endif
-		else if (psalt->hash_type == IS_RIPEMD160)
-			pbkdf2_ripemd160(key_buffer[i], strlen((char*)(key_buffer[i])), psalt->salt, 64, psalt->num_iterations, key, sizeof(key), 0);
-		else
-			pbkdf2_whirlpool(key_buffer[i], strlen((char*)(key_buffer[i])), psalt->salt, 64, psalt->num_iterations, key, sizeof(key), 0);
-		for (j = 0; j < psalt->loop_inc; ++j) {
-#if SSE_GROUP_SZ_SHA512
-			if (psalt->hash_type == IS_SHA512)
-				memcpy(key, Keys[j], sizeof(key));
+		} else if (psalt->hash_type == IS_RIPEMD160) {
+#if SSE_GROUP_SZ_RIPEMD160
+			for (j = 0; j < keys_per_group; j += SSE_GROUP_SZ_RIPEMD160)
+				pbkdf2_ripemd160_sse_loaded(&ripemd160_ipad[i+j], &ripemd160_opad[i+j], psalt->salt, 64, ITERATIONS_RIPEMD160, &pout[j], sizeof(key[0]), 0);
+#else
+			for (j = 0; j < keys_per_group; ++j)
+				pbkdf2_ripemd160_loaded(&ripemd160_ipad[i+j], &ripemd160_opad[i+j], psalt->salt, 64, ITERATIONS_RIPEMD160, pout[j], sizeof(key[0]), 0);
+#endif
+		} else {
+#if SSE_GROUP_SZ_WHIRLPOOL
+			for (j = 0; j < keys_per_group; j += SSE_GROUP_SZ_WHIRLPOOL)
+				pbkdf2_whirlpool_sse_loaded(&whirlpool_ipad[i+j], &whirlpool_opad[i+j], psalt->salt, 64, ITERATIONS, &pout[j], sizeof(key[0]), 0);
+#else
+			for (j = 0; j < keys_per_group; ++j)
+				pbkdf2_whirlpool_loaded(&whirlpool_ipad[i+j], &whirlpool_opad[i+j], psalt->salt, 64, ITERATIONS, pout[j], sizeof(key[0]), 0);
 #endif
-			// Try to decrypt using AES
-			AES_256_XTS_first_sector(key, first_block_dec[i+j], psalt->bin, 16);
+		}
+
+		// Try to decrypt using AES
+		for (j = 0; j < keys_per_group; ++j) {
+			AES_256_XTS_first_sector(key[j], first_block_dec, psalt->bin, 16);
+			cracked[i+j] = !memcmp(first_block_dec, "TRUE", 4);
 		}
 	}
 	return count;
@@ -333,7 +484,7 @@ static int cmp_all(void* binary, int count)
 {
 	int i;
 	for (i = 0; i < count; ++i) {
-		if (!memcmp(first_block_dec[i], "TRUE", 4))
+		if (cracked[i])
 			return 1;
 	}
 	return 0;
@@ -341,9 +492,7 @@ static int cmp_all(void* binary, int count)
 
 static int cmp_one(void* binary, int index)
 {
-	if (!memcmp(first_block_dec[index], "TRUE", 4))
-		return 1;
-	return 0;
+	return cracked[index];
 }
 
 // compare a BE string crc32, against crc32, and do it in a safe for non-aligned CPU way.
@@ -357,10 +506,6 @@ static int cmp_crc32s(unsigned char *given_crc32, CRC32_t comp_crc32) {
 
 static int cmp_exact(char *source, int idx)
 {
-#if 0
-	if (!memcmp(first_block_dec[idx], "TRUE", 4) && !memcmp(&first_block_dec[idx][12], "\0\0\0\0", 4))
-		return 1;
-#else
 	unsigned char key[64];
 	unsigned char decr_header[512-64];
 	CRC32_t check_sum;
@@ -371,11 +516,11 @@ static int cmp_exact(char *source, int idx)
 #endif
 
 	if (psalt->hash_type == IS_SHA512)
-		pbkdf2_sha512((const unsigned char*)key_buffer[idx], strlen((char*)(key_buffer[idx])), psalt->salt, 64, psalt->num_iterations, key, sizeof(key), 0);
+		pbkdf2_sha512((const unsigned char*)key_buffer[idx], strlen((char*)(key_buffer[idx])), psalt->salt, 64, ITERATIONS, key, sizeof(key), 0);
 	else if (psalt->hash_type == IS_RIPEMD160)
-		pbkdf2_ripemd160((const unsigned char*)key_buffer[idx], strlen((char*)(key_buffer[idx])), psalt->salt, 64, psalt->num_iterations, key, sizeof(key), 0);
+		pbkdf2_ripemd160((const unsigned char*)key_buffer[idx], strlen((char*)(key_buffer[idx])), psalt->salt, 64, ITERATIONS_RIPEMD160, key, sizeof(key), 0);
 	else
-		pbkdf2_whirlpool((const unsigned char*)key_buffer[idx], strlen((char*)(key_buffer[idx])), psalt->salt, 64, psalt->num_iterations, key, sizeof(key), 0);
+		pbkdf2_whirlpool((const unsigned char*)key_buffer[idx], strlen((char*)(key_buffer[idx])), psalt->salt, 64, ITERATIONS, key, sizeof(key), 0);
 
 	// we have 448 bytes of header (64 bytes unencrypted salt were the first 64 bytes).
 	// decrypt it and look for 3 items.
@@ -411,12 +556,12 @@ static int cmp_exact(char *source, int idx)
 
 	// Passed 96 bits of tests.  This is the right password!
 	return 1;
-#endif
-	return 0;
 }
 
 static void set_key(char* key, int index)
 {
+	if (precomputed > index)
+		precomputed = index;
 	strcpy((char*)(key_buffer[index]), key);
 }
 
@@ -425,6 +570,13 @@ static char *get_key(int index)
 	return (char*)(key_buffer[index]);
 }
 
+#if FMT_MAIN_VERSION > 11
+static unsigned int tc_hash_algorithm(void *salt)
+{
+	return (unsigned int)((struct cust_salt*)salt)->hash_type;
+}
+#endif
+
 static int salt_hash(void *salt)
 {
 	unsigned v=0, i;
@@ -436,26 +588,11 @@ static int salt_hash(void *salt)
 	return v & (SALT_HASH_SIZE - 1);
 }
 
-#if FMT_MAIN_VERSION > 11
-static unsigned int tc_hash_algorithm(void *salt)
-{
-	return (unsigned int)((struct cust_salt*)salt)->hash_type;
-}
-#endif
-
 struct fmt_main fmt_truecrypt = {
 	{
 		"tc_aes_xts",                     // FORMAT_LABEL
 		"TrueCrypt (RIPEMD160/SHA512/WHIRLPOOL) AES256_XTS", // FORMAT_NAME
-#if SSE_GROUP_SZ_SHA512
-		SHA512_ALGORITHM_NAME,            // ALGORITHM_NAME,
-#else
-#if ARCH_BITS >= 64
-		"64/" ARCH_BITS_STR,              // ALGORITHM_NAME,
-#else
-		"32/" ARCH_BITS_STR,              // ALGORITHM_NAME,
-#endif
-#endif
+		ALGORITHM_NAME_ALL,               // ALGORITHM_NAME,
 		"",                               // BENCHMARK_COMMENT
 		-1,                               // BENCHMARK_LENGTH
 		PLAINTEXT_LENGTH,
@@ -463,8 +600,8 @@ struct fmt_main fmt_truecrypt = {
 		BINARY_ALIGN,
 		SALT_SIZE,
 		SALT_ALIGN,
-		MIN_KEYS_PER_CRYPT,
-		MAX_KEYS_PER_CRYPT,
+		KEYS_ALL,
+		KEYS_ALL,
 		FMT_CASE | FMT_8_BIT | FMT_OMP,
 #if FMT_MAIN_VERSION > 11
 		{
@@ -473,7 +610,7 @@ struct fmt_main fmt_truecrypt = {
 #endif
 		tests_all
 	}, {
-		init,
+		init_all,
 		fmt_default_done,
 		fmt_default_reset,
 		prepare,
@@ -501,7 +638,8 @@ struct fmt_main fmt_truecrypt = {
 		},
 		cmp_all,
 		cmp_one,
-		cmp_exact
+		cmp_exact,
+		precompute
 	}
 };
 
@@ -509,7 +647,11 @@ struct fmt_main fmt_truecrypt_ripemd160 = {
 	{
 		"tc_ripemd160",                   // FORMAT_LABEL
 		"TrueCrypt RIPEMD160 AES256_XTS", // FORMAT_NAME
+#if SSE_GROUP_SZ_RIPEMD160
+		RIPEMD160_ALGORITHM_NAME,         // ALGORITHM_NAME,
+#else
 		"32/" ARCH_BITS_STR,              // ALGORITHM_NAME,
+#endif
 		"",                               // BENCHMARK_COMMENT
 		-1,                               // BENCHMARK_LENGTH
 		PLAINTEXT_LENGTH,
@@ -517,15 +659,15 @@ struct fmt_main fmt_truecrypt_ripemd160 = {
 		BINARY_ALIGN,
 		SALT_SIZE,
 		SALT_ALIGN,
-		MIN_KEYS_PER_CRYPT,
-		MAX_KEYS_PER_CRYPT,
+		KEYS_RIPEMD160,
+		KEYS_RIPEMD160,
 		FMT_CASE | FMT_8_BIT | FMT_OMP,
 #if FMT_MAIN_VERSION > 11
 		{ NULL },
 #endif
 		tests_ripemd160
 	}, {
-		init,
+		init_ripemd160,
 		fmt_default_done,
 		fmt_default_reset,
 		prepare,
@@ -551,7 +693,8 @@ struct fmt_main fmt_truecrypt_ripemd160 = {
 		},
 		cmp_all,
 		cmp_one,
-		cmp_exact
+		cmp_exact,
+		precompute
 	}
 };
 
@@ -575,20 +718,15 @@ struct fmt_main fmt_truecrypt_sha512 = {
 		BINARY_ALIGN,
 		SALT_SIZE,
 		SALT_ALIGN,
-#if SSE_GROUP_SZ_SHA512
-		SSE_GROUP_SZ_SHA512,
-		SSE_GROUP_SZ_SHA512,
-#else
-		MIN_KEYS_PER_CRYPT,
-		MAX_KEYS_PER_CRYPT,
-#endif
+		KEYS_SHA512,
+		KEYS_SHA512,
 		FMT_CASE | FMT_8_BIT | FMT_OMP,
 #if FMT_MAIN_VERSION > 11
 		{ NULL },
 #endif
 		tests_sha512
 	}, {
-		init,
+		init_sha512,
 		fmt_default_done,
 		fmt_default_reset,
 		prepare,
@@ -614,7 +752,8 @@ struct fmt_main fmt_truecrypt_sha512 = {
 		},
 		cmp_all,
 		cmp_one,
-		cmp_exact
+		cmp_exact,
+		precompute
 	}
 };
 
@@ -622,7 +761,9 @@ struct fmt_main fmt_truecrypt_whirlpool = {
 	{
 		"tc_whirlpool",                   // FORMAT_LABEL
 		"TrueCrypt WHIRLPOOL AES256_XTS", // FORMAT_NAME
-#if ARCH_BITS >= 64
+#if SSE_GROUP_SZ_WHIRLPOOL
+		WHIRLPOOL_ALGORITHM_NAME,         // ALGORITHM_NAME,
+#elif ARCH_BITS >= 64
 		"64/" ARCH_BITS_STR,              // ALGORITHM_NAME,
 #else
 		"32/" ARCH_BITS_STR,              // ALGORITHM_NAME,
@@ -634,15 +775,15 @@ struct fmt_main fmt_truecrypt_whirlpool = {
 		BINARY_ALIGN,
 		SALT_SIZE,
 		SALT_ALIGN,
-		MIN_KEYS_PER_CRYPT,
-		MAX_KEYS_PER_CRYPT,
+		KEYS_WHIRLPOOL,
+		KEYS_WHIRLPOOL,
 		FMT_CASE | FMT_8_BIT | FMT_OMP,
 #if FMT_MAIN_VERSION > 11
 		{ NULL },
 #endif
 		tests_whirlpool
 	}, {
-		init,
+		init_whirlpool,
 		fmt_default_done,
 		fmt_default_reset,
 		prepare,
@@ -668,7 +809,8 @@ struct fmt_main fmt_truecrypt_whirlpool = {
 		},
 		cmp_all,
 		cmp_one,
-		cmp_exact
+		cmp_exact,
+		precompute
 	}
 };
 
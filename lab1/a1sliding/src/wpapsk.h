@@ -16,7 +16,9 @@
 #include "stdint.h"
 
 #include <assert.h>
-#include <openssl/hmac.h>
+#include "sha.h"
+#include "md5.h"
+#include "hmacmd5.h"
 
 #define HCCAP_SIZE		sizeof(hccap_t)
 
@@ -198,20 +200,82 @@ static int valid(char *ciphertext, struct fmt_main *self)
 }
 
 #ifndef JOHN_OCL_WPAPSK
-static MAYBE_INLINE void prf_512(uint32_t * key, uint8_t * data, uint32_t * ret)
+/*
+ * HMAC-SHA1 contexts keyed with each candidate's PMK, past the ipad and opad
+ * blocks.  The PMK only depends on the key and the ESSID, and the loader sorts
+ * the salts by ESSID, so crypt_all() sets these up along with the PMKs, once
+ * per ESSID and batch of keys, and all handshakes for the ESSID share them.
+ */
+typedef struct {
+	SHA_CTX ipad, opad;
+} wpapsk_pmk_ctx;
+
+static wpapsk_pmk_ctx *pmk_ctx;
+static int pmk_ctx_size;
+
+static void wpapsk_pmk_setup(int keys)
 {
-	HMAC_CTX ctx;
-	char *text = (char*)"Pairwise key expansion";
-	unsigned char buff[100];
-
-	memcpy(buff, text, 22);
-	memcpy(buff + 23, data, 76);
-	buff[22] = 0;
-	buff[76 + 23] = 0;
-	HMAC_Init(&ctx, key, 32, EVP_sha1());
-	HMAC_Update(&ctx, buff, 100);
-	HMAC_Final(&ctx, (unsigned char *) ret, NULL);
-	HMAC_CTX_cleanup(&ctx);
+	int i;
+
+	if (keys > pmk_ctx_size) {
+		pmk_ctx = mem_alloc_tiny(sizeof(*pmk_ctx) * keys,
+		    MEM_ALIGN_WORD);
+		pmk_ctx_size = keys;
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) private(i) shared(keys, outbuffer, pmk_ctx)
+#endif
+	for (i = 0; i < keys; i++) {
+		unsigned char pad[64];
+		int j;
+
+		memset(pad, 0x36, sizeof(pad));
+		for (j = 0; j < 32; j++)
+			pad[j] ^= ((unsigned char *)outbuffer[i].v)[j];
+		SHA1_Init(&pmk_ctx[i].ipad);
+		SHA1_Update(&pmk_ctx[i].ipad, pad, 64);
+		for (j = 0; j < 64; j++)
+			pad[j] ^= 0x36 ^ 0x5c;
+		SHA1_Init(&pmk_ctx[i].opad);
+		SHA1_Update(&pmk_ctx[i].opad, pad, 64);
+	}
+}
+
+/* buff is "Pairwise key expansion\0", the MACs and nonces, and a 0 */
+static MAYBE_INLINE void prf_512(wpapsk_pmk_ctx *pmk, uint8_t * buff, uint32_t * ret)
+{
+	SHA_CTX ctx;
+	unsigned char inner[20];
+
+	memcpy(&ctx, &pmk->ipad, sizeof(ctx));
+	SHA1_Update(&ctx, buff, 100);
+	SHA1_Final(inner, &ctx);
+	memcpy(&ctx, &pmk->opad, sizeof(ctx));
+	SHA1_Update(&ctx, inner, 20);
+	SHA1_Final((unsigned char *) ret, &ctx);
+}
+
+/* HMAC-SHA1 with the 16 byte KCK as the key, for the MIC of WPA2 */
+static MAYBE_INLINE void hmac_sha1_kck(uint32_t * key, uint8_t * data, int len, unsigned char * ret)
+{
+	SHA_CTX ctx;
+	unsigned char pad[64], inner[20];
+	int j;
+
+	memset(pad, 0x36, sizeof(pad));
+	for (j = 0; j < 16; j++)
+		pad[j] ^= ((unsigned char *)key)[j];
+	SHA1_Init(&ctx);
+	SHA1_Update(&ctx, pad, 64);
+	SHA1_Update(&ctx, data, len);
+	SHA1_Final(inner, &ctx);
+	for (j = 0; j < 64; j++)
+		pad[j] ^= 0x36 ^ 0x5c;
+	SHA1_Init(&ctx);
+	SHA1_Update(&ctx, pad, 64);
+	SHA1_Update(&ctx, inner, 20);
+	SHA1_Final(ret, &ctx);
 }
 #endif
 
@@ -336,30 +400,33 @@ static char *get_key(int index)
 static void wpapsk_postprocess(int keys)
 {
 	int i;
-	uint8_t data[64 + 12];
-	insert_mac(data);
-	insert_nonce(data + 12);
+	uint8_t buff[100];
+
+	memcpy(buff, "Pairwise key expansion", 23);
+	insert_mac(buff + 23);
+	insert_nonce(buff + 23 + 12);
+	buff[99] = 0;
 
 	if (hccap.keyver == 1) {
 #ifdef _OPENMP
-#pragma omp parallel for default(none) private(i) shared(keys, outbuffer, data, hccap, mic)
+#pragma omp parallel for default(none) private(i) shared(keys, pmk_ctx, buff, hccap, mic)
 #endif
 		for (i = 0; i < keys; i++) {
 			uint32_t prf[20/4];
-			prf_512(outbuffer[i].v, data, prf);
-			HMAC(EVP_md5(), prf, 16, hccap.eapol, hccap.eapol_size,
-			    mic[i].keymic, NULL);
+			prf_512(&pmk_ctx[i], buff, prf);
+			hmac_md5((unsigned char *)prf, hccap.eapol,
+			    hccap.eapol_size, mic[i].keymic);
 		}
 	} else {
 #ifdef _OPENMP
-#pragma omp parallel for default(none) private(i) shared(keys, outbuffer, data, hccap, mic)
+#pragma omp parallel for default(none) private(i) shared(keys, pmk_ctx, buff, hccap, mic)
 #endif
 		for (i = 0; i < keys; i++) {
 			uint32_t prf[20/4];
 			unsigned char keymic[20];
-			prf_512(outbuffer[i].v, data, prf);
-			HMAC(EVP_sha1(), prf, 16, hccap.eapol,
-			    hccap.eapol_size, keymic, NULL);
+			prf_512(&pmk_ctx[i], buff, prf);
+			hmac_sha1_kck(prf, hccap.eapol, hccap.eapol_size,
+			    keymic);
 			memcpy(mic[i].keymic, keymic, 16);
 		}
 	}
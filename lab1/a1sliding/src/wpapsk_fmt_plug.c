@@ -357,6 +357,7 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 #else
 		wpapsk_sse(count, inbuffer, outbuffer, &currentsalt);
 #endif
+		wpapsk_pmk_setup(count);
 		new_keys = 0;
 		strcpy(last_ssid, hccap.essid);
 	}
@@ -54,7 +54,10 @@
 #ifdef __XOP__
 #define JOHN_XOP
 #endif
-#if defined(__AVX__) || defined(JOHN_XOP)
+#ifdef __AVX2__
+#define JOHN_AVX2
+#endif
+#if defined(__AVX__) || defined(JOHN_XOP) || defined(JOHN_AVX2)
 #define JOHN_AVX
 #endif
 
@@ -161,7 +164,8 @@
 #define DES_BS_ALGORITHM_NAME		"DES 128/128 AVX-16"
 #endif
 #endif
-#elif (defined(__SSE2__) && defined(_OPENMP))
+#elif defined(__SSE2__) && (defined(_OPENMP) || defined(JOHN_FAT))
+/* Fat builds also compile DES_bs_b.c for AVX, see sse-dispatch.h */
 #define DES_BS_ASM			0
 #if 1
 #define DES_BS_VECTOR			2
@@ -200,6 +204,16 @@
 #endif
 #endif
 
+#if CPU_DETECT && defined(JOHN_AVX2)
+#define CPU_REQ_AVX2
+#undef CPU_NAME
+#define CPU_NAME			"AVX2"
+#ifdef CPU_FALLBACK_BINARY_DEFAULT
+#undef CPU_FALLBACK_BINARY
+#define CPU_FALLBACK_BINARY		"john-non-avx2"
+#endif
+#endif
+
 #define MD5_ASM				0
 #define MD5_X2				1
 #define MD5_IMM				1
@@ -212,6 +226,26 @@
 
 #ifdef __SSE2__
 
+/*
+ * With AVX2, each 256-bit vector of the MD4, MD5 and SHA-1 code holds two of
+ * the 4-key blocks, so their PARA has to be even.  Fat builds (JOHN_FAT) may
+ * pick the AVX2 code at run time, so the same goes for them.
+ */
+#if defined(__AVX2__) || defined(JOHN_FAT)
+#ifndef MD5_SSE_PARA
+#define MD5_SSE_PARA			4
+#define MD5_N_STR			"16x"
+#endif
+#ifndef MD4_SSE_PARA
+#define MD4_SSE_PARA			4
+#define MD4_N_STR			"16x"
+#endif
+#ifndef SHA1_SSE_PARA
+#define SHA1_SSE_PARA			2
+#define SHA1_N_STR			"8x"
+#endif
+#endif
+
 #ifndef MD5_SSE_PARA
 #if defined(__INTEL_COMPILER) || defined(USING_ICC_S_FILE)
 #define MD5_SSE_PARA			3
@@ -316,13 +350,35 @@
 
 #define NT_X86_64
 
+#if defined(__AVX2__) || defined(JOHN_FAT)
+#if (MD5_SSE_PARA | MD4_SSE_PARA | SHA1_SSE_PARA) & 1
+#error MD5_SSE_PARA, MD4_SSE_PARA and SHA1_SSE_PARA must be even with AVX2
+#endif
+#endif
+/* Fat builds keep the 128-bit SHA-2 lanes at every level, see sse-dispatch.h */
+#if defined(__AVX2__) && !defined(JOHN_FAT)
+#define MMX_COEF_SHA256 8
+#define MMX_COEF_SHA512 4
+/* one WHIRLPOOL per byte of a vector, this needs vpshufb on 256 bits */
+#define MMX_COEF_WHIRLPOOL 32
+#else
 #define MMX_COEF_SHA256 4
 #define MMX_COEF_SHA512 2
+#endif
+/* RIPEMD-160 has 32-bit words like SHA-256, so it gets as many lanes */
+#define MMX_COEF_RIPEMD160 MMX_COEF_SHA256
 
 #endif /* __SSE2__ */
 
 #define BF_ASM				0
 #define BF_SCALE			1
 #define BF_X2				3
+/*
+ * Lanes of the AVX2 gather code, used when it's faster than BF_X2.  Fat
+ * builds compile it for AVX2 alone and use it on CPUs that have that.
+ */
+#if defined(__AVX2__) || defined(JOHN_FAT)
+#define BF_SIMD				8
+#endif
 
 #endif
@@ -173,6 +173,25 @@
 			 + __GNUC_PATCHLEVEL__)
 #endif
 
+/*
+ * With AVX2, each 256-bit vector of the MD4, MD5 and SHA-1 code holds two of
+ * the 4-key blocks, so their PARA has to be even.
+ */
+#ifdef __AVX2__
+#ifndef MD5_SSE_PARA
+#define MD5_SSE_PARA			4
+#define MD5_N_STR			"16x"
+#endif
+#ifndef MD4_SSE_PARA
+#define MD4_SSE_PARA			4
+#define MD4_N_STR			"16x"
+#endif
+#ifndef SHA1_SSE_PARA
+#define SHA1_SSE_PARA			2
+#define SHA1_N_STR			"8x"
+#endif
+#endif
+
 #ifndef MD5_SSE_PARA
 #if defined(__INTEL_COMPILER) || defined(USING_ICC_S_FILE)
 #define MD5_SSE_PARA			3
@@ -272,7 +291,19 @@
 
 #define NT_SSE2
 
+#ifdef __AVX2__
+#if (MD5_SSE_PARA | MD4_SSE_PARA | SHA1_SSE_PARA) & 1
+#error MD5_SSE_PARA, MD4_SSE_PARA and SHA1_SSE_PARA must be even with AVX2
+#endif
+#define MMX_COEF_SHA256 8
+#define MMX_COEF_SHA512 4
+/* one WHIRLPOOL per byte of a vector, this needs vpshufb on 256 bits */
+#define MMX_COEF_WHIRLPOOL 32
+#else
 #define MMX_COEF_SHA256 4
 #define MMX_COEF_SHA512 2
+#endif
+/* RIPEMD-160 has 32-bit words like SHA-256, so it gets as many lanes */
+#define MMX_COEF_RIPEMD160 MMX_COEF_SHA256
 
 #endif
@@ -0,0 +1 @@
+/* dropped in scratch build */